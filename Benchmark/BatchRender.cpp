@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QByteArray>
+#include <windows.h>
+#include <psapi.h>
+#include "Benchmarks.h"
+#include "ComputeDevice.h"
+#include "ComputeDeviceRepository.h"
+#include "renderer/OptixRenderer.h"
+#include "renderer/RenderMethod.h"
+#include "renderer/Sampler.h"
+#include "clientserver/RenderServerRenderRequestDetails.h"
+#include "scene/SceneFactory.h"
+#include "scene/IScene.h"
+
+#pragma comment(lib, "psapi.lib")
+
+static bool parseRenderMethod( const QString & name, RenderMethod::E & method )
+{
+    if(name == "pt")
+    {
+        method = RenderMethod::PATH_TRACING;
+    }
+    else if(name == "ppm")
+    {
+        method = RenderMethod::PROGRESSIVE_PHOTON_MAPPING;
+    }
+    else if(name == "vcm")
+    {
+        method = RenderMethod::VCM_BIDIRECTIONAL_PATH_TRACING;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool parsePhotonMapStructure( const QString & name, PhotonMapStructure::E & structure )
+{
+    if(name == "grid")
+    {
+        structure = PhotonMapStructure::UNIFORM_GRID;
+    }
+    else if(name == "hashgrid")
+    {
+        structure = PhotonMapStructure::HASHED_GRID;
+    }
+    else if(name == "kdtree")
+    {
+        structure = PhotonMapStructure::KD_TREE_CPU;
+    }
+    else if(name == "hash")
+    {
+        structure = PhotonMapStructure::STOCHASTIC_HASH;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool parseSampler( const QString & name, Sampler::E & sampler )
+{
+    if(name == "random")
+    {
+        sampler = Sampler::RANDOM;
+    }
+    else if(name == "sobol")
+    {
+        sampler = Sampler::SOBOL;
+    }
+    else if(name == "halton")
+    {
+        sampler = Sampler::HALTON;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static unsigned long long getPeakHostMemoryBytes()
+{
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+}
+
+// The output buffer holds the sum of all iterations, the image is the mean. The rows of the buffer go bottom up.
+// .pfm files get the floats as they are, anything else is written as an 8 bit binary PPM with gamma 2.2.
+
+static void saveImage( const QString & fileName, const std::vector<float> & output, unsigned int width, unsigned int height,
+    unsigned long long numIterations )
+{
+    const float scale = 1.f/float(std::max(1ull, numIterations));
+    QByteArray data;
+    if(fileName.endsWith(".pfm", Qt::CaseInsensitive))
+    {
+        data = QString("PF\n%1 %2\n-1.0\n").arg(width).arg(height).toLatin1();
+        std::vector<float> pixels(output.size());
+        for(size_t i = 0; i < output.size(); i++)
+        {
+            pixels[i] = output[i]*scale;
+        }
+        data.append(reinterpret_cast<const char*>(&pixels[0]), int(pixels.size()*sizeof(float)));
+    }
+    else
+    {
+        data = QString("P6\n%1 %2\n255\n").arg(width).arg(height).toLatin1();
+        for(int y = int(height) - 1; y >= 0; y--)
+        {
+            for(unsigned int i = y*width*3; i < (y+1)*width*3; i++)
+            {
+                float value = std::pow(std::max(0.f, output[i]*scale), 1.f/2.2f)*255.f;
+                data.append(char(std::min(255.f, value + 0.5f)));
+            }
+        }
+    }
+
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+    {
+        throw std::exception("Could not write the image file.");
+    }
+}
+
+static QByteArray escapeJson( const QByteArray & string )
+{
+    QByteArray escaped = string;
+    return escaped.replace('\\', "\\\\").replace('"', "\\\"");
+}
+
+// Renders a scene without a display for a number of iterations or seconds (whichever comes first) and writes the
+// mean image and a JSON report of the iteration times, photon throughput, pass timings and memory high-water marks.
+// Scenes are loaded by name through SceneFactory. The seed makes repeated runs on the same build render the same
+// image, so runs across builds and scenes can be compared.
+int runBatchRender( const QStringList & arguments )
+{
+    QString sceneName = "Cornell";
+    QString methodName = "pt";
+    QString structureName = "grid";
+    QString samplerName = "sobol";
+    unsigned int width = 1024;
+    unsigned int height = 768;
+    unsigned long long maxIterations = 0;
+    double maxSeconds = 0;
+    unsigned int seed = 1;
+    unsigned int numEmittedPhotons = 0;
+    unsigned int deviceIndex = 0;
+    QString imageFile;
+    QString reportFile;
+    for(int i = 0; i+1 < arguments.size(); i += 2)
+    {
+        if(arguments[i] == "--scene")
+        {
+            sceneName = arguments[i+1];
+        }
+        else if(arguments[i] == "--method")
+        {
+            methodName = arguments[i+1];
+        }
+        else if(arguments[i] == "--structure")
+        {
+            structureName = arguments[i+1];
+        }
+        else if(arguments[i] == "--sampler")
+        {
+            samplerName = arguments[i+1];
+        }
+        else if(arguments[i] == "--width")
+        {
+            width = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--height")
+        {
+            height = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--iterations")
+        {
+            maxIterations = arguments[i+1].toULongLong();
+        }
+        else if(arguments[i] == "--seconds")
+        {
+            maxSeconds = std::max(0.0, arguments[i+1].toDouble());
+        }
+        else if(arguments[i] == "--seed")
+        {
+            seed = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--photons")
+        {
+            numEmittedPhotons = arguments[i+1].toUInt();
+        }
+        else if(arguments[i] == "--device")
+        {
+            deviceIndex = arguments[i+1].toUInt();
+        }
+        else if(arguments[i] == "--image")
+        {
+            imageFile = arguments[i+1];
+        }
+        else if(arguments[i] == "--report")
+        {
+            reportFile = arguments[i+1];
+        }
+    }
+    if(maxIterations == 0 && maxSeconds == 0)
+    {
+        maxIterations = 100;
+    }
+
+    RenderMethod::E method;
+    PhotonMapStructure::E structure;
+    Sampler::E sampler;
+    if(!parseRenderMethod(methodName, method) || !parsePhotonMapStructure(structureName, structure) ||
+        !parseSampler(samplerName, sampler))
+    {
+        printf("Unknown render method %s, photon map structure %s or sampler %s\n", methodName.toLatin1().constData(),
+            structureName.toLatin1().constData(), samplerName.toLatin1().constData());
+        return 1;
+    }
+
+    std::vector<ComputeDevice> & devices = ComputeDeviceRepository::get().getComputeDevices();
+    if(deviceIndex >= devices.size())
+    {
+        printf("No compute device %u, there are %u\n", deviceIndex, (unsigned int)devices.size());
+        return 1;
+    }
+    const ComputeDevice & device = devices[deviceIndex];
+
+    SceneFactory sceneFactory;
+    IScene* scene = sceneFactory.getSceneByName(sceneName.toUtf8().constData());
+    Camera camera = scene->getDefaultCamera();
+    camera.setAspectRatio(float(width)/float(height));
+    const double PPMAlpha = 2.0/3.0;
+
+    OptixRenderer renderer;
+    renderer.setRandomSeed(seed);
+    renderer.setSampler(sampler);
+    renderer.initialize(device);
+    renderer.initScene(*scene);
+
+    RenderServerRenderRequestDetails details (camera, QByteArray(scene->getSceneName()), method, width, height, PPMAlpha,
+        structure);
+    details.setNumEmittedPhotonsPerIteration(numEmittedPhotons);
+
+    printf("Rendering %s with %s on %s, %ux%u, seed %u, %s sampler\n", scene->getSceneName(), methodName.toLatin1().constData(),
+        device.getName(), width, height, seed, samplerName.toLatin1().constData());
+
+    const unsigned long long totalDeviceMemory = device.isHost() ? 0 : (unsigned long long)device.getGlobalMemoryKB()*1024;
+    unsigned long long minAvailableDeviceMemory = renderer.getAvailableDeviceMemoryBytes();
+    const unsigned long long firstTraceEvent = renderer.getRenderTrace().getNumRecordedEvents();
+
+    std::vector<double> iterationSeconds;
+    std::vector<unsigned long long> lightVertexCacheBytesUsed, lightVertexCacheBytesAllocated;
+    double PPMRadius = scene->getSceneInitialPPMRadiusEstimate();
+    QElapsedTimer totalTimer;
+    totalTimer.start();
+    for(unsigned long long i = 0; (maxIterations == 0 || i < maxIterations) && (maxSeconds == 0 || totalTimer.nsecsElapsed()*1e-9 < maxSeconds); i++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        renderer.renderNextIteration(i, i, float(PPMRadius), false, details);
+        iterationSeconds.push_back(timer.nsecsElapsed()*1e-9);
+        if(method == RenderMethod::VCM_BIDIRECTIONAL_PATH_TRACING)
+        {
+            lightVertexCacheBytesUsed.push_back(renderer.getLightVertexCacheBytesUsed());
+            lightVertexCacheBytesAllocated.push_back(renderer.getLightVertexCacheBytesAllocated());
+        }
+        minAvailableDeviceMemory = std::min(minAvailableDeviceMemory, renderer.getAvailableDeviceMemoryBytes());
+        PPMRadius = sqrt(PPMRadius*PPMRadius*(i+PPMAlpha)/double(i+1));
+    }
+    const double totalSeconds = totalTimer.nsecsElapsed()*1e-9;
+    const unsigned long long numIterations = iterationSeconds.size();
+
+    double renderSeconds = 0;
+    for(size_t i = 0; i < iterationSeconds.size(); i++)
+    {
+        renderSeconds += iterationSeconds[i];
+    }
+    const double photonsPerSecond = method == RenderMethod::PROGRESSIVE_PHOTON_MAPPING && renderSeconds > 0 ?
+        numIterations*double(renderer.getNumEmittedPhotonsPerIteration())/renderSeconds : 0;
+    const unsigned long long peakDeviceMemory = totalDeviceMemory > minAvailableDeviceMemory ? totalDeviceMemory - minAvailableDeviceMemory : 0;
+    const unsigned long long peakHostMemory = getPeakHostMemoryBytes();
+
+    printf("%llu iterations in %.2f s, %.2f ms per iteration", numIterations, totalSeconds,
+        numIterations > 0 ? renderSeconds/numIterations*1000 : 0);
+    if(photonsPerSecond > 0)
+    {
+        printf(", %.2f Mphotons/s", photonsPerSecond*1e-6);
+    }
+    printf("\nPeak memory: device %.1f MB, host %.1f MB\n", peakDeviceMemory/double(1024*1024), peakHostMemory/double(1024*1024));
+    if(!lightVertexCacheBytesUsed.empty())
+    {
+        unsigned long long maxUsed = *std::max_element(lightVertexCacheBytesUsed.begin(), lightVertexCacheBytesUsed.end());
+        printf("Light vertex cache: %.1f MB used at most, %.1f MB allocated\n", maxUsed/double(1024*1024),
+            lightVertexCacheBytesAllocated.back()/double(1024*1024));
+    }
+
+    if(!imageFile.isEmpty())
+    {
+        std::vector<float> output(width*height*3);
+        renderer.getOutputBuffer(&output[0]);
+        saveImage(imageFile, output, width, height, numIterations);
+    }
+
+    if(!reportFile.isEmpty())
+    {
+        QByteArray report;
+        report += "{\n";
+        report += "  \"scene\": \"" + escapeJson(QByteArray(scene->getSceneName())) + "\",\n";
+        report += "  \"method\": \"" + methodName.toLatin1() + "\",\n";
+        if(method == RenderMethod::PROGRESSIVE_PHOTON_MAPPING)
+        {
+            report += "  \"photonMapStructure\": \"" + structureName.toLatin1() + "\",\n";
+            report += "  \"emittedPhotonsPerIteration\": " + QByteArray::number(renderer.getNumEmittedPhotonsPerIteration()) + ",\n";
+        }
+        report += "  \"device\": \"" + escapeJson(QByteArray(device.getName())) + "\",\n";
+        report += "  \"width\": " + QByteArray::number(width) + ",\n";
+        report += "  \"height\": " + QByteArray::number(height) + ",\n";
+        report += "  \"seed\": " + QByteArray::number(seed) + ",\n";
+        report += "  \"sampler\": \"" + samplerName.toLatin1() + "\",\n";
+        report += "  \"iterations\": " + QByteArray::number(numIterations) + ",\n";
+        report += "  \"totalSeconds\": " + QByteArray::number(totalSeconds, 'f', 6) + ",\n";
+        report += "  \"renderSeconds\": " + QByteArray::number(renderSeconds, 'f', 6) + ",\n";
+        report += "  \"photonsPerSecond\": " + QByteArray::number(photonsPerSecond, 'f', 0) + ",\n";
+        report += "  \"peakDeviceMemoryBytes\": " + QByteArray::number(peakDeviceMemory) + ",\n";
+        report += "  \"peakHostMemoryBytes\": " + QByteArray::number(peakHostMemory) + ",\n";
+
+        report += "  \"iterationMilliseconds\": [";
+        for(size_t i = 0; i < iterationSeconds.size(); i++)
+        {
+            report += (i > 0 ? ", " : "") + QByteArray::number(iterationSeconds[i]*1000, 'f', 3);
+        }
+        report += "],\n";
+
+        if(method == RenderMethod::VCM_BIDIRECTIONAL_PATH_TRACING)
+        {
+            report += "  \"lightVertexCacheBytesUsed\": [";
+            for(size_t i = 0; i < lightVertexCacheBytesUsed.size(); i++)
+            {
+                report += (i > 0 ? ", " : "") + QByteArray::number(lightVertexCacheBytesUsed[i]);
+            }
+            report += "],\n";
+            report += "  \"lightVertexCacheBytesAllocated\": [";
+            for(size_t i = 0; i < lightVertexCacheBytesAllocated.size(); i++)
+            {
+                report += (i > 0 ? ", " : "") + QByteArray::number(lightVertexCacheBytesAllocated[i]);
+            }
+            report += "],\n";
+        }
+
+        // Pass timings of the iterations still in the trace buffer, the oldest may have been overwritten on long runs
+        RenderTraceSummary traceSummary = renderer.getRenderTrace().summarize(firstTraceEvent);
+        const QVector<RenderTraceSummary::Pass> & passes = traceSummary.getPasses();
+        report += "  \"passes\": [";
+        for(int i = 0; i < passes.size(); i++)
+        {
+            report += i > 0 ? ",\n    " : "\n    ";
+            report += "{\"name\": \"" + escapeJson(passes[i].name) + "\"";
+            report += ", \"count\": " + QByteArray::number(passes[i].count);
+            report += ", \"milliseconds\": " + QByteArray::number(passes[i].seconds*1000, 'f', 3);
+            report += ", \"elements\": " + QByteArray::number(passes[i].numElements);
+            report += ", \"bytes\": " + QByteArray::number(passes[i].numBytes) + "}";
+        }
+        report += "\n  ]\n}\n";
+
+        QFile file(reportFile);
+        if(!file.open(QIODevice::WriteOnly) || file.write(report) != report.size())
+        {
+            throw std::exception("Could not write the report file.");
+        }
+    }
+
+    delete scene;
+    return 0;
+}
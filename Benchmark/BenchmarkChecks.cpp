@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "BenchmarkChecks.h"
+#include <cstdio>
+
+void printCheckHeader(int nameWidth)
+{
+    printf("\n%-*s %12s %12s\n", nameWidth, "check", "value", "limit");
+}
+
+bool check(bool passed, const char* name, double value, double limit, int nameWidth)
+{
+    printf("%-*s %12.5g %12.5g %s\n", nameWidth, name, value, limit, passed ? "ok" : "FAILED");
+    return passed;
+}
+
+int printCheckResult(bool passed)
+{
+    printf("%s\n", passed ? "All checks passed" : "Some checks FAILED");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+
+/*
+Pass/fail table of the benchmarks that verify their results. printCheckHeader() starts the table, check() prints one
+line with the value and its limit and returns passed, so the results combine as passed &= check(...).
+printCheckResult() prints the verdict and returns the exit code of the benchmark, 1 if a check failed. Names longer
+than the default column pass a wider nameWidth to the header and every check.
+*/
+
+const int CHECK_NAME_WIDTH = 36;
+
+void printCheckHeader(int nameWidth = CHECK_NAME_WIDTH);
+bool check(bool passed, const char* name, double value, double limit, int nameWidth = CHECK_NAME_WIDTH);
+int printCheckResult(bool passed);
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QStringList>
+
+/*
+Host side micro-benchmarks and the headless batch renderer. Each benchmark gets the command line arguments
+following its name and returns 0 on success. Results are printed to stdout.
+*/
+
+int runPhotonKdTreeBenchmark(const QStringList & arguments);
+int runPhotonGatherBenchmark(const QStringList & arguments);
+int runPpmIterationBenchmark(const QStringList & arguments);
+int runPhotonGridLayoutBenchmark(const QStringList & arguments);
+int runRenderResultPacketBenchmark(const QStringList & arguments);
+int runSceneBvhBenchmark(const QStringList & arguments);
+int runBatchRender(const QStringList & arguments);
+int runRandomNumberBenchmark(const QStringList & arguments);
+int runSamplerConvergenceBenchmark(const QStringList & arguments);
+int runPhotonRadiusBenchmark(const QStringList & arguments);
+int runLightSelectionBenchmark(const QStringList & arguments);
+int runVcmMisBenchmark(const QStringList & arguments);
+int runLightVertexBenchmark(const QStringList & arguments);
+int runBsdfDispatchBenchmark(const QStringList & arguments);
+int runPhotonPackingBenchmark(const QStringList & arguments);
+int runRenderTileBenchmark(const QStringList & arguments);
+int runPPMBackBufferBenchmark(const QStringList & arguments);
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "renderer/RandomState.h"
+#include "renderer/BSDF.h"
+
+using namespace optix;
+
+// The BxDF dispatch BSDF used before the tagged dispatch: a chain of type flag tests and reinterpret_casts, kept here
+// as the baseline of the benchmark
+#define CALL_BXDF_BY_TYPE_FLAGS(lvalue, op, bxdf, function, ...) \
+    if (bxdf->type() & BxDF::Lambertian) \
+        lvalue op reinterpret_cast<const Lambertian *>(bxdf)->function(__VA_ARGS__); \
+    else if (bxdf->type() & BxDF::SpecularReflection) \
+        lvalue op reinterpret_cast<const SpecularReflection *>(bxdf)->function(__VA_ARGS__); \
+    else if (bxdf->type() & BxDF::SpecularTransmission) \
+        lvalue op reinterpret_cast<const SpecularTransmission *>(bxdf)->function(__VA_ARGS__); \
+    else if (bxdf->type() & BxDF::Phong) \
+        lvalue op reinterpret_cast<const Phong *>(bxdf)->function(__VA_ARGS__);
+
+namespace
+{
+    struct Evaluation
+    {
+        float3 f;
+        float directPdfW;
+        float reversePdfW;
+        float continuationProb;
+    };
+
+    float3 getRandomUnitVector(RandomState* state)
+    {
+        float2 sample = getRandomUniformFloat2(state);
+        float z = 1.f - 2.f*sample.x;
+        float r = sqrtf(std::max(0.f, 1.f - z*z));
+        float phi = 2.f*M_PIf*sample.y;
+        return make_float3(r*cosf(phi), r*sinf(phi), z);
+    }
+
+    // BSDFs of the materials in random order: Diffuse (Lambertian), Glossy (Lambertian and Phong), Mirror (specular
+    // reflection) and Glass (specular transmission and reflection)
+    std::vector<VcmBSDF> createBsdfs(unsigned int numBsdfs, unsigned int seed)
+    {
+        std::vector<VcmBSDF> bsdfs (numBsdfs);
+        RandomState state = createRandomState(seed, 0, 0, RandomStream::CAMERA);
+        for(unsigned int i = 0; i < numBsdfs; i++)
+        {
+            float3 normal = getRandomUnitVector(&state);
+            float3 incident = getRandomUnitVector(&state);
+            if(dot(normal, incident) < 0)
+            {
+                incident = -incident;
+            }
+            VcmBSDF & bsdf = bsdfs[i];
+            bsdf = VcmBSDF(normal, incident, true);
+            float3 reflectance = 0.9f*getRandomUniformFloat3(&state);
+            unsigned int material = std::min(3u, (unsigned int)(4*getRandomUniformFloat(&state)));
+            if(material == 0)
+            {
+                Lambertian lambertian(reflectance);
+                bsdf.AddBxDF(&lambertian);
+            }
+            else if(material == 1)
+            {
+                Lambertian lambertian(reflectance);
+                bsdf.AddBxDF(&lambertian);
+                Phong phong(0.1f*getRandomUniformFloat3(&state), powf(10.f, 3.f*getRandomUniformFloat(&state)));
+                bsdf.AddBxDF(&phong);
+            }
+            else if(material == 2)
+            {
+                FresnelNoOp fresnel;
+                SpecularReflection reflection(reflectance, &fresnel);
+                bsdf.AddBxDF(&reflection);
+            }
+            else
+            {
+                SpecularTransmission transmission(reflectance, 1.f, 1.5f);
+                bsdf.AddBxDF(&transmission);
+                FresnelDielectric fresnel(1.f, 1.5f);
+                SpecularReflection reflection(reflectance, &fresnel);
+                bsdf.AddBxDF(&reflection);
+            }
+        }
+        return bsdfs;
+    }
+
+    // Sum of the BxDFs of each BSDF in a random direction, as VcmBSDF::vcmF does it before the pick probabilities
+    template<bool TypeFlags>
+    void evaluate(const std::vector<VcmBSDF> & bsdfs, const std::vector<float3> & directions,
+        std::vector<Evaluation> & evaluations)
+    {
+        for(size_t i = 0; i < bsdfs.size(); i++)
+        {
+            const VcmBSDF & bsdf = bsdfs[i];
+            const float3 localDirFix = bsdf.localDirFix();
+            const float3 localDirGen = bsdf.differentialGeometry().ToLocal(directions[i]);
+            Evaluation evaluation = { make_float3(0.f), 0.f, 0.f, 0.f };
+            for(unsigned int b = 0; b < bsdf.nBxDFs(); b++)
+            {
+                const BxDF * bxdf = bsdf.bxdfAt(b);
+                float directPdfW = 0.f, reversePdfW = 0.f;
+                if(TypeFlags)
+                {
+                    CALL_BXDF_BY_TYPE_FLAGS(evaluation.f, +=, bxdf, vcmF, localDirFix, localDirGen, &directPdfW,
+                        &reversePdfW);
+                    CALL_BXDF_BY_TYPE_FLAGS(evaluation.continuationProb, +=, bxdf, continuationProb, localDirFix);
+                }
+                else
+                {
+                    CALL_BXDF_CONST_VIRTUAL_FUNCTION(evaluation.f, +=, bxdf, vcmF, localDirFix, localDirGen,
+                        &directPdfW, &reversePdfW);
+                    CALL_BXDF_CONST_VIRTUAL_FUNCTION(evaluation.continuationProb, +=, bxdf, continuationProb,
+                        localDirFix);
+                }
+                evaluation.directPdfW += directPdfW;
+                evaluation.reversePdfW += reversePdfW;
+            }
+            evaluations[i] = evaluation;
+        }
+    }
+
+    // The whole VcmBSDF evaluation with the tagged dispatch
+    void evaluateBsdf(const std::vector<VcmBSDF> & bsdfs, const std::vector<float3> & directions,
+        std::vector<Evaluation> & evaluations)
+    {
+        for(size_t i = 0; i < bsdfs.size(); i++)
+        {
+            Evaluation & evaluation = evaluations[i];
+            float cosTheta = 0.f;
+            evaluation.f = bsdfs[i].vcmF(directions[i], cosTheta, &evaluation.directPdfW, &evaluation.reversePdfW);
+            evaluation.continuationProb = bsdfs[i].continuationProb();
+        }
+    }
+
+    bool isSame(const Evaluation & a, const Evaluation & b)
+    {
+        return a.f.x == b.f.x && a.f.y == b.f.y && a.f.z == b.f.z && a.directPdfW == b.directPdfW
+            && a.reversePdfW == b.reversePdfW && a.continuationProb == b.continuationProb;
+    }
+}
+
+// BxDF dispatch of the BSDFs on the host: the type flag chain used before against the switch over the BxDF tag
+// (BxDFTypes in renderer/BxDF.h). --bsdfs BSDFs of the four materials in random order are evaluated in a random
+// direction each, through both dispatches and through VcmBSDF::vcmF. Prints the evaluation throughput and checks that
+// both dispatches give identical results. Returns 1 if a check fails.
+int runBsdfDispatchBenchmark( const QStringList & arguments )
+{
+    unsigned int numBsdfs = 1024*1024;
+    unsigned int seed = 1;
+    int repeat = 5;
+    for(int i = 0; i+1 < arguments.size(); i++)
+    {
+        if(arguments[i] == "--bsdfs")
+        {
+            numBsdfs = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--seed")
+        {
+            seed = arguments[i+1].toUInt();
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+        else
+        {
+            continue;
+        }
+        i++;
+    }
+
+    std::vector<VcmBSDF> bsdfs = createBsdfs(numBsdfs, seed);
+    std::vector<float3> directions (numBsdfs);
+    RandomState state = createRandomState(seed, 1, 0, RandomStream::CAMERA);
+    for(unsigned int i = 0; i < numBsdfs; i++)
+    {
+        directions[i] = getRandomUnitVector(&state);
+    }
+
+    printf("BxDF dispatch, %u BSDFs (%u bytes each)\n", numBsdfs, (unsigned int)sizeof(VcmBSDF));
+    printf("%-24s %16s %12s\n", "dispatch", "M BSDFs/s", "speedup");
+    const char* names[] = { "type flags (before)", "tag switch", "VcmBSDF::vcmF" };
+    std::vector<Evaluation> evaluations[3];
+    double seconds[3];
+    for(int method = 0; method < 3; method++)
+    {
+        evaluations[method].resize(numBsdfs);
+        seconds[method] = std::numeric_limits<double>::max();
+        for(int i = 0; i < repeat; i++)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            if(method == 0)
+            {
+                evaluate<true>(bsdfs, directions, evaluations[method]);
+            }
+            else if(method == 1)
+            {
+                evaluate<false>(bsdfs, directions, evaluations[method]);
+            }
+            else
+            {
+                evaluateBsdf(bsdfs, directions, evaluations[method]);
+            }
+            seconds[method] = std::min(seconds[method], timer.nsecsElapsed()*1e-9);
+        }
+        printf("%-24s %16.1f %11.2fx\n", names[method], numBsdfs/seconds[method]*1e-6, seconds[0]/seconds[method]);
+    }
+
+    unsigned int numDifferent = 0, numNonZero = 0;
+    for(unsigned int i = 0; i < numBsdfs; i++)
+    {
+        numDifferent += isSame(evaluations[0][i], evaluations[1][i]) ? 0 : 1;
+        numNonZero += evaluations[1][i].f.x + evaluations[1][i].f.y + evaluations[1][i].f.z > 0 ? 1 : 0;
+    }
+
+    printCheckHeader();
+    bool passed = true;
+    passed &= check(numDifferent == 0, "results differing between dispatches", numDifferent, 0);
+    passed &= check(numNonZero > 0, "non-zero evaluations", numNonZero, 1);
+
+    return printCheckResult(passed);
+}
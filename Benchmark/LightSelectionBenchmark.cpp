@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "renderer/Light.h"
+#include "renderer/LightAliasTable.h"
+#include "renderer/RandomState.h"
+
+using namespace optix;
+
+namespace
+{
+    struct Receiver
+    {
+        float3 position;
+        std::vector<float> irradiance; // of each light
+        double totalIrradiance;
+    };
+
+    // Point lights over the unit square at height 1, the first one brighter than the others
+    std::vector<Light> createLights(unsigned int numLights, float brightness, unsigned int seed)
+    {
+        std::vector<Light> lights;
+        RandomState state = createRandomState(seed, 0, 0, RandomStream::CAMERA);
+        for(unsigned int i = 0; i < numLights; i++)
+        {
+            float2 position = getRandomUniformFloat2(&state);
+            float power = (i == 0 ? brightness : 1.f)*(0.5f + getRandomUniformFloat(&state));
+            lights.push_back(Light(Vector3(power, power, power), Vector3(position.x, position.y, 1.f)));
+        }
+        return lights;
+    }
+
+    // Irradiance of each light on points of the floor below them
+    std::vector<Receiver> createReceivers(const std::vector<Light> & lights, unsigned int numReceivers, unsigned int seed)
+    {
+        std::vector<Receiver> receivers (numReceivers);
+        RandomState state = createRandomState(seed, 1, 0, RandomStream::CAMERA);
+        for(unsigned int r = 0; r < numReceivers; r++)
+        {
+            Receiver & receiver = receivers[r];
+            float2 position = getRandomUniformFloat2(&state);
+            receiver.position = make_float3(position.x, position.y, 0.f);
+            receiver.irradiance.resize(lights.size());
+            receiver.totalIrradiance = 0;
+            for(size_t i = 0; i < lights.size(); i++)
+            {
+                float3 towardsLight = lights[i].position - receiver.position;
+                float distanceSquared = dot(towardsLight, towardsLight);
+                float cosine = towardsLight.z/sqrtf(distanceSquared);
+                receiver.irradiance[i] = lights[i].intensity.x*cosine/distanceSquared;
+                receiver.totalIrradiance += receiver.irradiance[i];
+            }
+        }
+        return receivers;
+    }
+
+    // Average over the receivers of the variance of a one light estimate of the irradiance, relative to its square
+    double getRelativeVariance(const std::vector<Receiver> & receivers, const std::vector<LightAliasEntry> & table,
+        bool uniform, unsigned int numSamples, unsigned int seed)
+    {
+        const unsigned int numLights = (unsigned int)table.size();
+        double sumRelativeVariance = 0;
+        for(size_t r = 0; r < receivers.size(); r++)
+        {
+            const Receiver & receiver = receivers[r];
+            RandomState state = createRandomState(seed, 2, (unsigned int)r, RandomStream::DIRECT_LIGHT);
+            double sum = 0, sumSquares = 0;
+            for(unsigned int s = 0; s < numSamples; s++)
+            {
+                float sample = getRandomUniformFloat(&state);
+                unsigned int index;
+                float pdf;
+                if(uniform)
+                {
+                    index = std::min((unsigned int)(sample*numLights), numLights - 1);
+                    pdf = 1.f/numLights;
+                }
+                else
+                {
+                    index = sampleLightAliasTable(table, sample, pdf);
+                }
+                double estimate = receiver.irradiance[index]/pdf;
+                sum += estimate;
+                sumSquares += estimate*estimate;
+            }
+            double mean = sum/numSamples;
+            double variance = sumSquares/numSamples - mean*mean;
+            sumRelativeVariance += variance/(receiver.totalIrradiance*receiver.totalIrradiance);
+        }
+        return sumRelativeVariance/receivers.size();
+    }
+}
+
+// Uniform versus power-proportional (alias table, renderer/LightAliasTable.h) light selection. --lights point lights
+// hang over the unit square, the first --brightness times brighter than the others, and the irradiance at --receivers
+// points of the floor is estimated from one picked light at a time, --samples times per point. Prints the relative
+// variance of the estimate and the pick throughput of both, and checks that the alias table picks the lights with its
+// pdf. Returns 1 if a check fails.
+int runLightSelectionBenchmark( const QStringList & arguments )
+{
+    unsigned int numLights = 64;
+    float brightness = 100.f;
+    unsigned int numReceivers = 4096;
+    unsigned int numSamples = 256;
+    unsigned int seed = 1;
+    int repeat = 3;
+    for(int i = 0; i+1 < arguments.size(); i++)
+    {
+        if(arguments[i] == "--lights")
+        {
+            numLights = std::max(2u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--brightness")
+        {
+            brightness = std::max(1e-3f, arguments[i+1].toFloat());
+        }
+        else if(arguments[i] == "--receivers")
+        {
+            numReceivers = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--samples")
+        {
+            numSamples = std::max(2u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--seed")
+        {
+            seed = arguments[i+1].toUInt();
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+        else
+        {
+            continue;
+        }
+        i++;
+    }
+
+    std::vector<Light> lights = createLights(numLights, brightness, seed);
+    std::vector<Receiver> receivers = createReceivers(lights, numReceivers, seed);
+    std::vector<LightAliasEntry> table (numLights);
+    buildLightAliasTable(&lights[0], numLights, &table[0]);
+
+    printf("Light selection, %u point lights (first %.1fx brighter), %u receivers x %u samples\n", numLights, brightness,
+        numReceivers, numSamples);
+    printCheckHeader();
+    bool passed = true;
+
+    double sumPdf = 0;
+    for(unsigned int i = 0; i < numLights; i++)
+    {
+        sumPdf += table[i].pdf;
+    }
+    passed &= check(fabs(sumPdf - 1) < 1e-4, "sum of pdfs - 1", sumPdf - 1, 1e-4);
+
+    // Chi-square of the picks against the pdf, as the number of standard deviations from its mean
+    const unsigned int numPicks = 4*1024*1024;
+    std::vector<unsigned int> picks (numLights, 0);
+    unsigned int numWrongPdfs = 0;
+    RandomState state = createRandomState(seed, 3, 0, RandomStream::PHOTON);
+    for(unsigned int i = 0; i < numPicks; i++)
+    {
+        float pdf;
+        unsigned int index = sampleLightAliasTable(table, getRandomUniformFloat(&state), pdf);
+        picks[index]++;
+        numWrongPdfs += pdf != table[index].pdf ? 1 : 0;
+    }
+    double chiSquare = 0;
+    for(unsigned int i = 0; i < numLights; i++)
+    {
+        double expected = double(numPicks)*table[i].pdf;
+        chiSquare += expected > 0 ? (picks[i] - expected)*(picks[i] - expected)/expected : picks[i];
+    }
+    double chiSquareDeviation = (chiSquare - (numLights - 1))/sqrt(2.0*(numLights - 1));
+    passed &= check(numWrongPdfs == 0, "picks with the wrong pdf", numWrongPdfs, 0);
+    passed &= check(fabs(chiSquareDeviation) < 5, "chi-square picks against pdf (sd)", chiSquareDeviation, 5);
+
+    printf("\n%-12s %20s %16s\n", "selection", "relative variance", "M picks/s");
+    const char* names[] = { "uniform", "alias" };
+    double variances[2];
+    for(int method = 0; method < 2; method++)
+    {
+        double seconds = std::numeric_limits<double>::max();
+        for(int i = 0; i < repeat; i++)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            variances[method] = getRelativeVariance(receivers, table, method == 0, numSamples, seed);
+            seconds = std::min(seconds, timer.nsecsElapsed()*1e-9);
+        }
+        printf("%-12s %20.5g %16.1f\n", names[method], variances[method],
+            double(numReceivers)*numSamples/seconds*1e-6);
+    }
+    printf("Variance reduction of the alias table: %.2fx\n", variances[0]/variances[1]);
+
+    return printCheckResult(passed);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "renderer/RandomState.h"
+#include "renderer/vcm/LightVertex.h"
+
+using namespace optix;
+
+namespace
+{
+    struct StoredVertex
+    {
+        LightVertexMaterial material;
+        unsigned int pathLen;
+    };
+
+    float3 getRandomUnitVector(RandomState* state)
+    {
+        float2 sample = getRandomUniformFloat2(state);
+        float z = 1.f - 2.f*sample.x;
+        float r = sqrtf(std::max(0.f, 1.f - z*z));
+        float phi = 2.f*M_PIf*sample.y;
+        return make_float3(r*cosf(phi), r*sinf(phi), z);
+    }
+
+    // The BxDF combinations of the materials that store light vertices: Lambertian (Diffuse, Texture) and
+    // Lambertian with Phong (Glossy), reflectances in [0,1] and Phong exponents up to 10^4
+    std::vector<StoredVertex> createVertices(unsigned int numVertices, unsigned int seed)
+    {
+        std::vector<StoredVertex> vertices (numVertices);
+        RandomState state = createRandomState(seed, 0, 0, RandomStream::CAMERA);
+        for(unsigned int i = 0; i < numVertices; i++)
+        {
+            LightVertexMaterial & material = vertices[i].material;
+            material.normal = getRandomUnitVector(&state);
+            material.dirFix = getRandomUnitVector(&state);
+            material.bxdfs = LightVertexBxDF::LAMBERTIAN | (i % 2 ? LightVertexBxDF::PHONG : 0);
+            material.diffuseReflectance = getRandomUniformFloat3(&state);
+            material.glossyReflectance = (i % 2) ? getRandomUniformFloat3(&state) : make_float3(0.f);
+            material.glossyExponent = (i % 2) ? powf(10.f, 4.f*getRandomUniformFloat(&state)) : 0.f;
+            vertices[i].pathLen = (unsigned int)(getRandomUniformFloat(&state)*(1 << 24)) & 0xffffff;
+        }
+        return vertices;
+    }
+
+    // From the sine and the cosine, acos alone loses the small angles
+    double getAngle(const float3 & a, const float3 & b)
+    {
+        double cosine = double(a.x)*b.x + double(a.y)*b.y + double(a.z)*b.z;
+        double crossX = double(a.y)*b.z - double(a.z)*b.y;
+        double crossY = double(a.z)*b.x - double(a.x)*b.z;
+        double crossZ = double(a.x)*b.y - double(a.y)*b.x;
+        return atan2(sqrt(crossX*crossX + crossY*crossY + crossZ*crossZ), cosine);
+    }
+
+    // Largest component error relative to the largest component, at most one step of the shared exponent mantissas
+    double getReflectanceError(const float3 & reference, const float3 & value)
+    {
+        double maxComponent = std::max(reference.x, std::max(reference.y, reference.z));
+        double error = std::max(fabs(value.x - reference.x),
+            std::max(fabs(value.y - reference.y), fabs(value.z - reference.z)));
+        return maxComponent > 0 ? error/maxComponent : error;
+    }
+}
+
+// Round trip of the compact light vertex encoding of the VCM light vertex cache (renderer/vcm/LightVertex.h) on
+// --vertices random light vertices. Checks the error of the unpacked directions and reflectances and that the BxDFs,
+// Phong exponent and path length come back exactly, and prints the size of a light vertex and the pack and unpack
+// throughput. Returns 1 if a check fails.
+int runLightVertexBenchmark( const QStringList & arguments )
+{
+    unsigned int numVertices = 1024*1024;
+    unsigned int seed = 1;
+    int repeat = 3;
+    for(int i = 0; i+1 < arguments.size(); i++)
+    {
+        if(arguments[i] == "--vertices")
+        {
+            numVertices = std::max(2u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--seed")
+        {
+            seed = arguments[i+1].toUInt();
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+        else
+        {
+            continue;
+        }
+        i++;
+    }
+
+    std::vector<StoredVertex> vertices = createVertices(numVertices, seed);
+    std::vector<LightVertex> packed (numVertices);
+    std::vector<LightVertexMaterial> unpacked (numVertices);
+
+    double packSeconds = std::numeric_limits<double>::max();
+    double unpackSeconds = std::numeric_limits<double>::max();
+    for(int r = 0; r < repeat; r++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        for(unsigned int i = 0; i < numVertices; i++)
+        {
+            packLightVertexMaterial(packed[i], vertices[i].material, vertices[i].pathLen);
+        }
+        packSeconds = std::min(packSeconds, timer.nsecsElapsed()*1e-9);
+
+        timer.restart();
+        for(unsigned int i = 0; i < numVertices; i++)
+        {
+            unpacked[i] = unpackLightVertexMaterial(packed[i]);
+        }
+        unpackSeconds = std::min(unpackSeconds, timer.nsecsElapsed()*1e-9);
+    }
+
+    double maxNormalError = 0, maxDirFixError = 0, maxDiffuseError = 0, maxGlossyError = 0;
+    unsigned int numWrongBxDFs = 0, numWrongExponents = 0, numWrongPathLengths = 0;
+    for(unsigned int i = 0; i < numVertices; i++)
+    {
+        const LightVertexMaterial & reference = vertices[i].material;
+        const LightVertexMaterial & material = unpacked[i];
+        maxNormalError = std::max(maxNormalError, getAngle(reference.normal, material.normal));
+        maxDirFixError = std::max(maxDirFixError, getAngle(reference.dirFix, getLightVertexDirFix(packed[i])));
+        maxDiffuseError = std::max(maxDiffuseError, getReflectanceError(reference.diffuseReflectance,
+            material.diffuseReflectance));
+        maxGlossyError = std::max(maxGlossyError, getReflectanceError(reference.glossyReflectance,
+            material.glossyReflectance));
+        numWrongBxDFs += material.bxdfs != reference.bxdfs ? 1 : 0;
+        numWrongExponents += material.glossyExponent != reference.glossyExponent ? 1 : 0;
+        numWrongPathLengths += getLightVertexPathLen(packed[i]) != vertices[i].pathLen ? 1 : 0;
+    }
+
+    printf("Light vertex encoding, %u vertices, %u bytes each (%.1f MB)\n", numVertices, (unsigned int)sizeof(LightVertex),
+        double(numVertices)*sizeof(LightVertex)/(1024*1024));
+    printf("%-12s %16s\n", "", "M vertices/s");
+    printf("%-12s %16.1f\n", "pack", numVertices/packSeconds*1e-6);
+    printf("%-12s %16.1f\n", "unpack", numVertices/unpackSeconds*1e-6);
+
+    printCheckHeader();
+    bool passed = true;
+    passed &= check(sizeof(LightVertex) == 60, "bytes per light vertex", double(sizeof(LightVertex)), 60);
+    passed &= check(maxNormalError < 1e-4, "max normal error (rad)", maxNormalError, 1e-4);
+    passed &= check(maxDirFixError < 1e-4, "max direction error (rad)", maxDirFixError, 1e-4);
+    passed &= check(maxDiffuseError < 1.0/256, "max diffuse reflectance error", maxDiffuseError, 1.0/256);
+    passed &= check(maxGlossyError < 1.0/256, "max glossy reflectance error", maxGlossyError, 1.0/256);
+    passed &= check(numWrongBxDFs == 0, "vertices with wrong BxDFs", numWrongBxDFs, 0);
+    passed &= check(numWrongExponents == 0, "vertices with wrong Phong exponent", numWrongExponents, 0);
+    passed &= check(numWrongPathLengths == 0, "vertices with wrong path length", numWrongPathLengths, 0);
+
+    return printCheckResult(passed);
+}
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "renderer/RandomState.h"
+#include "client/PPMBackBuffer.h"
+
+namespace
+{
+    struct Packet
+    {
+        QVector<unsigned long long> iterationNumbers;
+        unsigned int numFloats;
+    };
+
+    struct Errors
+    {
+        unsigned int numPackets;
+        unsigned int numWrongDrops;
+        unsigned int numWrongFrontIterations;
+        unsigned int numBackBufferNotEmpty;
+        unsigned int numWrongSizes;
+        double maxFrameError;
+    };
+
+    // Value of a float of the output of an iteration, in [0,1)
+    float getIterationValue(unsigned long long iteration, unsigned int index)
+    {
+        unsigned int hash = (unsigned int)(iteration*2654435761u) ^ (index*2246822519u);
+        hash ^= hash >> 15;
+        hash *= 3266489917u;
+        hash ^= hash >> 16;
+        return float(hash >> 8)/float(1 << 24);
+    }
+
+    std::vector<float> getPacketOutput(const Packet & packet)
+    {
+        std::vector<float> output (packet.numFloats);
+        for(unsigned int i = 0; i < packet.numFloats; i++)
+        {
+            double sum = 0;
+            for(int j = 0; j < packet.iterationNumbers.size(); j++)
+            {
+                sum += getIterationValue(packet.iterationNumbers[j], i);
+            }
+            output[i] = float(sum/packet.iterationNumbers.size());
+        }
+        return output;
+    }
+
+    unsigned int getRandomIndex(RandomState* state, unsigned int size)
+    {
+        return std::min(size-1, (unsigned int)(getRandomUniformFloat(state)*size));
+    }
+
+    // Packets of 1 to 8 iterations covering the iterations 0 to numIterations-1 in order, with their iteration numbers
+    // shuffled within the packet as the servers may send them
+    std::vector<Packet> createPackets(unsigned long long numIterations, unsigned int numFloats, RandomState* state)
+    {
+        std::vector<Packet> packets;
+        for(unsigned long long first = 0; first < numIterations;)
+        {
+            unsigned long long last = std::min(numIterations-1, first + getRandomIndex(state, 8));
+            Packet packet;
+            packet.numFloats = numFloats;
+            for(unsigned long long i = last+1; i > first; i--)
+            {
+                packet.iterationNumbers.append(i-1);
+            }
+            packets.push_back(packet);
+            first = last+1;
+        }
+        return packets;
+    }
+
+    void shufflePackets(std::vector<Packet> & packets, RandomState* state)
+    {
+        for(unsigned int i = (unsigned int)packets.size(); i > 1; i--)
+        {
+            std::swap(packets[i-1], packets[getRandomIndex(state, i)]);
+        }
+    }
+
+    // Inserts a packet after a random packet it comes after in the sequence, so it is always dropped
+    void insertAfter(std::vector<Packet> & packets, unsigned int index, const Packet & packet, RandomState* state)
+    {
+        unsigned int position = index + 1 + getRandomIndex(state, (unsigned int)packets.size() - index);
+        packets.insert(packets.begin() + position, packet);
+    }
+
+    // Packets to be dropped, each sent after the packet it repeats: exact repeats of a packet, packets overlapping one
+    // by an iteration, packets with a gap in their iterations and packets of another frame size
+    unsigned int insertPacketsToDrop(std::vector<Packet> & packets, unsigned long long numIterations, RandomState* state)
+    {
+        unsigned int numPacketsToDrop = (unsigned int)packets.size()/4;
+        for(unsigned int i = 0; i < numPacketsToDrop; i++)
+        {
+            unsigned int index = getRandomIndex(state, (unsigned int)packets.size());
+            Packet packet = packets[index];
+            if(i % 4 == 1)
+            {
+                unsigned long long last = *std::max_element(packet.iterationNumbers.begin(), packet.iterationNumbers.end());
+                packet.iterationNumbers.append(last+1 < numIterations ? last+1 : packet.iterationNumbers.first()+numIterations);
+            }
+            else if(i % 4 == 2)
+            {
+                packet.iterationNumbers.clear();
+                packet.iterationNumbers << numIterations + 2*i << numIterations + 2*i + 2;
+            }
+            else if(i % 4 == 3)
+            {
+                packet.numFloats++;
+            }
+            insertAfter(packets, index, packet, state);
+        }
+        return numPacketsToDrop;
+    }
+
+    // Sends the packets through the back buffer for a frame of numFloats floats, checking the counters on the way and the
+    // front buffer against the average of all iterations at the end
+    void checkBackBuffer(PPMBackBuffer & backBuffer, const std::vector<Packet> & packets, unsigned int numPacketsToDrop,
+        unsigned long long numIterations, unsigned int numFloats, Errors & errors)
+    {
+        std::vector<float> frontBuffer (numFloats);
+        backBuffer.reset(&frontBuffer[0], numFloats);
+        const unsigned int frameSizeBytes = numFloats*sizeof(float);
+        unsigned int numDropped = 0;
+        for(size_t i = 0; i < packets.size(); i++)
+        {
+            std::vector<float> output = getPacketOutput(packets[i]);
+            numDropped += backBuffer.addPacket(&output[0], packets[i].numFloats, packets[i].iterationNumbers) ? 0 : 1;
+            unsigned int sizeBytes = backBuffer.getSizeBytes();
+            errors.numWrongSizes += sizeBytes % frameSizeBytes != 0 || sizeBytes > PPMBackBuffer::MAX_BUFFERS*frameSizeBytes
+                || (sizeBytes > 0) != (backBuffer.getNumIterations() > 0) ? 1 : 0;
+        }
+        errors.numPackets += (unsigned int)packets.size();
+        errors.numWrongDrops += numDropped != numPacketsToDrop ? 1 : 0;
+        errors.numWrongFrontIterations += backBuffer.getNextExpectedIteration() != numIterations
+            || backBuffer.getFrontBufferNumIterations() != numIterations ? 1 : 0;
+        errors.numBackBufferNotEmpty += backBuffer.getNumIterations() != 0 || backBuffer.getSizeBytes() != 0 ? 1 : 0;
+        errors.numWrongSizes += backBuffer.getPeakSizeBytes() > PPMBackBuffer::MAX_BUFFERS*frameSizeBytes ? 1 : 0;
+
+        for(unsigned int i = 0; i < numFloats; i++)
+        {
+            double sum = 0;
+            for(unsigned long long iteration = 0; iteration < numIterations; iteration++)
+            {
+                sum += getIterationValue(iteration, i);
+            }
+            errors.maxFrameError = std::max(errors.maxFrameError, fabs(frontBuffer[i] - sum/numIterations));
+        }
+    }
+}
+
+// Checks of the PPM back buffer of the client (client/PPMBackBuffer.h) with --iterations iterations sent in packets
+// of up to 8 iterations: in order, in reverse order so the pool is used up and runs are pre-combined, shuffled, and
+// shuffled with repeated, overlapping, non sequential and wrongly sized packets in between, which must all be dropped.
+// Each order is run on two frame sizes with the same back buffer. Checks the dropped packets, the counters and
+// back buffer size on the way and the front buffer against the average of all iterations. Returns 1 if a check fails.
+int runPPMBackBufferBenchmark( const QStringList & arguments )
+{
+    unsigned long long numIterations = 1000;
+    unsigned int seed = 1;
+    for(int i = 0; i+1 < arguments.size(); i++)
+    {
+        if(arguments[i] == "--iterations")
+        {
+            numIterations = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--seed")
+        {
+            seed = arguments[i+1].toUInt();
+        }
+        else
+        {
+            continue;
+        }
+        i++;
+    }
+
+    const unsigned int frameNumFloats[] = { 64*48*3, 37*29*3 };
+    const char* orders[] = { "in order", "reversed", "shuffled", "shuffled with packets to drop" };
+    Errors errors = { 0, 0, 0, 0, 0, 0 };
+    PPMBackBuffer backBuffer;
+    RandomState state = createRandomState(seed, 0, 0, RandomStream::CAMERA);
+    for(int order = 0; order < 4; order++)
+    {
+        for(int frame = 0; frame < 2; frame++)
+        {
+            std::vector<Packet> packets = createPackets(numIterations, frameNumFloats[frame], &state);
+            unsigned int numPacketsToDrop = 0;
+            if(order == 1)
+            {
+                std::reverse(packets.begin(), packets.end());
+            }
+            else if(order >= 2)
+            {
+                shufflePackets(packets, &state);
+            }
+            if(order == 3)
+            {
+                numPacketsToDrop = insertPacketsToDrop(packets, numIterations, &state);
+            }
+            checkBackBuffer(backBuffer, packets, numPacketsToDrop, numIterations, frameNumFloats[frame], errors);
+        }
+    }
+
+    printf("PPM back buffer, %llu iterations, %u packets in %d orders\n", numIterations, errors.numPackets, 4);
+    for(int order = 0; order < 4; order++)
+    {
+        printf("  %s\n", orders[order]);
+    }
+    printCheckHeader();
+    bool passed = true;
+    passed &= check(errors.numWrongDrops == 0, "runs with wrong packets dropped", errors.numWrongDrops, 0);
+    passed &= check(errors.numWrongFrontIterations == 0, "runs with wrong front iterations", errors.numWrongFrontIterations, 0);
+    passed &= check(errors.numBackBufferNotEmpty == 0, "runs ending with back buffer in use", errors.numBackBufferNotEmpty, 0);
+    passed &= check(errors.numWrongSizes == 0, "wrong back buffer sizes", errors.numWrongSizes, 0);
+    passed &= check(errors.maxFrameError < 1e-4, "max front buffer error", errors.maxFrameError, 1e-4);
+
+    return printCheckResult(passed);
+}
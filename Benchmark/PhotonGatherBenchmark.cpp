@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "SyntheticPhotons.h"
+#include "renderer/ppm/HostPhotonGather.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+static const PhotonMapStructure::E structures[] =
+{
+    PhotonMapStructure::UNIFORM_GRID,
+    PhotonMapStructure::HASHED_GRID,
+    PhotonMapStructure::STOCHASTIC_HASH,
+    PhotonMapStructure::KD_TREE_CPU
+};
+
+static const char* structureNames[] = { "grid", "kdtree", "hash", "hashgrid" };
+
+int runPhotonGatherBenchmark( const QStringList & arguments )
+{
+    unsigned int numPhotons = 1024*1024;
+    unsigned int width = 512;
+    unsigned int height = 512;
+    float radius = 0.01f;
+    int repeat = 3;
+    for(int i = 0; i+1 < arguments.size(); i += 2)
+    {
+        if(arguments[i] == "--photons")
+        {
+            numPhotons = arguments[i+1].toUInt()*1024*1024;
+        }
+        else if(arguments[i] == "--width")
+        {
+            width = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--height")
+        {
+            height = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--radius")
+        {
+            radius = arguments[i+1].toFloat();
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+    }
+
+    // A fifth of the slots is left empty, as in the photon pass output
+    std::vector<Photon> photons;
+    generateSyntheticPhotons(photons, numPhotons, 0.2f);
+    std::vector<Hitpoint> hitpoints;
+    generateSyntheticHitpoints(hitpoints, width, height);
+    const unsigned int numHitpoints = (unsigned int)hitpoints.size();
+
+    std::vector<float3> indirectRadiance(numHitpoints);
+    std::vector<unsigned int> photonsVisited(numHitpoints);
+    std::vector<unsigned int> cellsVisited(numHitpoints);
+
+    TaskScheduler & scheduler = TaskScheduler::get();
+    printf("Photon gather, %u photon slots, %ux%u hitpoints, radius %.4f, best of %d, %u threads\n", numPhotons,
+        width, height, radius, repeat, scheduler.getNumThreads());
+    printf("%8s %10s %10s %12s %14s %12s %14s\n", "mode", "build ms", "gather ms", "Mqueries/s", "photons/query",
+        "cells/query", "mean radiance");
+
+    for(size_t s = 0; s < sizeof(structures)/sizeof(PhotonMapStructure::E); s++)
+    {
+        const PhotonMapStructure::E structure = structures[s];
+        HostPhotonGather photonMap(scheduler);
+        QElapsedTimer timer;
+        timer.start();
+        photonMap.build(structure, &photons[0], numPhotons, radius);
+        double build = timer.nsecsElapsed()*1e-9;
+
+        double best = std::numeric_limits<double>::max();
+        for(int i = 0; i < repeat; i++)
+        {
+            timer.start();
+            photonMap.gather(&hitpoints[0], numHitpoints, radius, float(numPhotons), &indirectRadiance[0],
+                &photonsVisited[0], &cellsVisited[0]);
+            best = std::min(best, timer.nsecsElapsed()*1e-9);
+        }
+
+        double totalPhotonsVisited = 0;
+        double totalCellsVisited = 0;
+        double totalRadiance = 0;
+        for(unsigned int i = 0; i < numHitpoints; i++)
+        {
+            totalPhotonsVisited += photonsVisited[i];
+            totalCellsVisited += cellsVisited[i];
+            totalRadiance += (indirectRadiance[i].x + indirectRadiance[i].y + indirectRadiance[i].z)/3.0f;
+        }
+
+        printf("%8s %10.2f %10.2f %12.2f %14.1f %12.1f %14.6g\n", structureNames[structure], build*1000, best*1000,
+            numHitpoints/best*1e-6, totalPhotonsVisited/numHitpoints, totalCellsVisited/numHitpoints,
+            totalRadiance/numHitpoints);
+    }
+
+    return 0;
+}
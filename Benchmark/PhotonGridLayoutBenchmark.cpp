@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "SyntheticPhotons.h"
+#include "renderer/ppm/HostPhotonGather.h"
+#include "renderer/ppm/PhotonGrid.h"
+#include "renderer/ppm/PhotonDump.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+namespace
+{
+    const unsigned int CACHE_LINE_SIZE = 64;
+
+    // Set associative cache with LRU replacement, counting the misses of a stream of reads
+    class CacheSimulator
+    {
+    public:
+        CacheSimulator(unsigned int sizeBytes, unsigned int ways)
+            : m_ways(ways), m_numSets(sizeBytes/(CACHE_LINE_SIZE*ways)),
+              m_lines(m_numSets*ways, std::numeric_limits<unsigned long long>::max()), m_misses(0)
+        {
+
+        }
+
+        // Returns false on a miss
+        bool read(unsigned long long line)
+        {
+            unsigned long long* set = &m_lines[(line % m_numSets)*m_ways];
+            unsigned int way = 0;
+            while(way < m_ways-1 && set[way] != line)
+            {
+                way++;
+            }
+            bool hit = set[way] == line;
+            m_misses += hit ? 0 : 1;
+            // Most recently used first, a miss evicts the last way
+            for(; way > 0; way--)
+            {
+                set[way] = set[way-1];
+            }
+            set[0] = line;
+            return hit;
+        }
+
+        unsigned long long getMisses() const { return m_misses; }
+
+    private:
+        unsigned int m_ways;
+        unsigned int m_numSets;
+        std::vector<unsigned long long> m_lines;
+        unsigned long long m_misses;
+    };
+
+    // Replays the reads of the uniform grid gather of one thread through a private L1 and L2
+    class GatherReplay
+    {
+    public:
+        GatherReplay(const HostPhotonGather & photonMap)
+            : m_photonMap(photonMap), m_mortonMasks(getPhotonGridMortonMasks(photonMap.getGridSize())),
+              m_l1(32*1024, 8), m_l2(256*1024, 8), m_reads(0)
+        {
+
+        }
+
+        void gather(const Hitpoint & rec, float radius)
+        {
+            const uint3 & gridSize = m_photonMap.getGridSize();
+            float invCellSize = 1.f/m_photonMap.getCellSize();
+            float3 normalizedPosition = rec.position - m_photonMap.getWorldOrigo();
+            uint3 lo, hi;
+            lo.x = (unsigned int)std::max(0, (int)((normalizedPosition.x - radius) * invCellSize));
+            lo.y = (unsigned int)std::max(0, (int)((normalizedPosition.y - radius) * invCellSize));
+            lo.z = (unsigned int)std::max(0, (int)((normalizedPosition.z - radius) * invCellSize));
+            hi.x = std::min(gridSize.x-1, (unsigned int)((normalizedPosition.x + radius) * invCellSize));
+            hi.y = std::min(gridSize.y-1, (unsigned int)((normalizedPosition.y + radius) * invCellSize));
+            hi.z = std::min(gridSize.z-1, (unsigned int)((normalizedPosition.z + radius) * invCellSize));
+            if(lo.x > hi.x)
+            {
+                return;
+            }
+
+            for(unsigned int z = lo.z; z <= hi.z; z++)
+            {
+                for(unsigned int y = lo.y; y <= hi.y; y++)
+                {
+                    if(m_photonMap.getGridLayout() == PhotonGridLayout::LINEAR)
+                    {
+                        unsigned int from = getPhotonGridIndex1D(make_uint3(lo.x, y, z), gridSize);
+                        readCellRange(from, from + (hi.x-lo.x));
+                        continue;
+                    }
+
+                    unsigned int cell = getPhotonGridIndexMorton(make_uint3(lo.x, y, z), m_mortonMasks);
+                    unsigned int from = cell;
+                    for(unsigned int x = lo.x; x <= hi.x; x++)
+                    {
+                        unsigned int next = incrementPhotonGridIndexMorton(cell, m_mortonMasks.x);
+                        if(x == hi.x || next != cell+1)
+                        {
+                            readCellRange(from, cell);
+                            from = next;
+                        }
+                        cell = next;
+                    }
+                }
+            }
+        }
+
+        unsigned long long getReads() const { return m_reads; }
+        unsigned long long getL1Misses() const { return m_l1.getMisses(); }
+        unsigned long long getL2Misses() const { return m_l2.getMisses(); }
+
+    private:
+        void readCellRange(unsigned int fromCell, unsigned int toCell)
+        {
+            const unsigned int* offsets = m_photonMap.getCellOffsets();
+            read(offsets + fromCell, sizeof(unsigned int));
+            read(offsets + toCell + 1, sizeof(unsigned int));
+            const unsigned int numPhotons = offsets[toCell+1] - offsets[fromCell];
+            if(numPhotons > 0)
+            {
+                read(m_photonMap.getPhotons() + offsets[fromCell], numPhotons*sizeof(Photon));
+            }
+        }
+
+        void read(const void* address, size_t bytes)
+        {
+            unsigned long long first = (unsigned long long)address / CACHE_LINE_SIZE;
+            unsigned long long last = ((unsigned long long)address + bytes - 1) / CACHE_LINE_SIZE;
+            for(unsigned long long line = first; line <= last; line++)
+            {
+                m_reads++;
+                if(!m_l1.read(line))
+                {
+                    m_l2.read(line);
+                }
+            }
+        }
+
+        const HostPhotonGather & m_photonMap;
+        uint3 m_mortonMasks;
+        CacheSimulator m_l1;
+        CacheSimulator m_l2;
+        unsigned long long m_reads;
+    };
+}
+
+// Compares the x-major and the Morton cell order of the uniform grid photon map: build time, gather throughput and
+// the cache lines the gather reads, replayed in scanline order through a simulated 32 KB L1 and 256 KB L2 (8-way,
+// LRU). Uses a photon dump captured with "ppm --save-photons" or, without --dump, the synthetic Cornell box.
+int runPhotonGridLayoutBenchmark( const QStringList & arguments )
+{
+    QString photonDumpFile;
+    unsigned int numPhotons = 1024*1024;
+    unsigned int width = 512;
+    unsigned int height = 512;
+    float radius = 0.01f;
+    int repeat = 3;
+    for(int i = 0; i+1 < arguments.size(); i += 2)
+    {
+        if(arguments[i] == "--dump")
+        {
+            photonDumpFile = arguments[i+1];
+        }
+        else if(arguments[i] == "--photons")
+        {
+            numPhotons = arguments[i+1].toUInt()*1024*1024;
+        }
+        else if(arguments[i] == "--width")
+        {
+            width = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--height")
+        {
+            height = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--radius")
+        {
+            radius = arguments[i+1].toFloat();
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+    }
+
+    PhotonDump dump;
+    if(!photonDumpFile.isEmpty())
+    {
+        loadPhotonDump(photonDumpFile, dump);
+    }
+    else
+    {
+        generateSyntheticPhotons(dump.photons, numPhotons, 0.2f);
+        generateSyntheticHitpoints(dump.hitpoints, width, height);
+        dump.width = width;
+        dump.height = height;
+        dump.ppmRadius = radius;
+        dump.emittedPhotonsPerIteration = float(numPhotons);
+    }
+    const unsigned int numHitpoints = (unsigned int)dump.hitpoints.size();
+    if(dump.photons.empty() || numHitpoints == 0)
+    {
+        printf("No photons or hitpoints to gather\n");
+        return 1;
+    }
+
+    TaskScheduler & scheduler = TaskScheduler::get();
+    printf("Photon grid layout, %s, %u photon slots, %ux%u hitpoints, radius %.4f, best of %d, %u threads\n",
+        photonDumpFile.isEmpty() ? "synthetic" : photonDumpFile.toLatin1().constData(), (unsigned int)dump.photons.size(),
+        dump.width, dump.height, dump.ppmRadius, repeat, scheduler.getNumThreads());
+    printf("%8s %10s %10s %12s %12s %12s %12s %12s\n", "layout", "build ms", "gather ms", "Mqueries/s", "ranges/query",
+        "lines/query", "L1 miss %", "L2 miss/query");
+
+    const PhotonGridLayout::E layouts[] = { PhotonGridLayout::LINEAR, PhotonGridLayout::MORTON };
+    const char* layoutNames[] = { "linear", "morton" };
+    std::vector<float3> indirectRadiance[2];
+    for(int l = 0; l < 2; l++)
+    {
+        HostPhotonGather photonMap(scheduler);
+        photonMap.setGridLayout(layouts[l]);
+        QElapsedTimer timer;
+        double build = std::numeric_limits<double>::max();
+        for(int i = 0; i < repeat; i++)
+        {
+            timer.start();
+            photonMap.build(PhotonMapStructure::UNIFORM_GRID, &dump.photons[0], (unsigned int)dump.photons.size(), dump.ppmRadius);
+            build = std::min(build, timer.nsecsElapsed()*1e-9);
+        }
+
+        indirectRadiance[l].resize(numHitpoints);
+        std::vector<unsigned int> cellsVisited(numHitpoints);
+        double best = std::numeric_limits<double>::max();
+        for(int i = 0; i < repeat; i++)
+        {
+            timer.start();
+            photonMap.gather(&dump.hitpoints[0], numHitpoints, dump.ppmRadius, dump.emittedPhotonsPerIteration,
+                &indirectRadiance[l][0], NULL, &cellsVisited[0]);
+            best = std::min(best, timer.nsecsElapsed()*1e-9);
+        }
+
+        GatherReplay replay(photonMap);
+        unsigned int numQueries = 0;
+        double totalCellsVisited = 0;
+        for(unsigned int i = 0; i < numHitpoints; i++)
+        {
+            if(dump.hitpoints[i].flags & PRD_HIT_NON_SPECULAR)
+            {
+                replay.gather(dump.hitpoints[i], dump.ppmRadius);
+                numQueries++;
+            }
+            totalCellsVisited += cellsVisited[i];
+        }
+        numQueries = std::max(1u, numQueries);
+
+        printf("%8s %10.2f %10.2f %12.2f %12.2f %12.1f %12.2f %12.2f\n", layoutNames[l], build*1000, best*1000,
+            numHitpoints/best*1e-6, totalCellsVisited/numQueries, double(replay.getReads())/numQueries,
+            100.0*replay.getL1Misses()/std::max(1ull, replay.getReads()), double(replay.getL2Misses())/numQueries);
+    }
+
+    // Both layouts gather the same photons, only the summation order differs
+    double maxDifference = 0;
+    for(unsigned int i = 0; i < numHitpoints; i++)
+    {
+        float3 difference = indirectRadiance[1][i] - indirectRadiance[0][i];
+        float reference = fmaxf(indirectRadiance[0][i]);
+        if(reference > 0)
+        {
+            float largest = std::max(fabsf(difference.x), std::max(fabsf(difference.y), fabsf(difference.z)));
+            maxDifference = std::max(maxDifference, double(largest/reference));
+        }
+    }
+    printf("Largest relative difference of the indirect radiance between the layouts: %g\n", maxDifference);
+    return 0;
+}
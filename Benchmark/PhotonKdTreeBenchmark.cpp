@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "SyntheticPhotons.h"
+#include "renderer/ppm/PhotonKdTreeBuilder.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+static unsigned int pow2roundup(unsigned int x)
+{
+    --x;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    return x+1;
+}
+
+static void hashBytes(unsigned long long & hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i])*1099511628211ull;
+    }
+}
+
+// Checks that every photon of the tree lies on the correct side of the split planes of all its ancestors and that the
+// tree holds numPhotons photons. hash is an FNV-1a hash of the photons in traversal order, equal for equal trees.
+static bool validateTree(const std::vector<Photon> & tree, unsigned int numPhotons, unsigned long long & hash)
+{
+    struct Node
+    {
+        unsigned int index;
+        float3 bbmin;
+        float3 bbmax;
+    };
+
+    hash = 14695981039346656037ull;
+    unsigned int numTreePhotons = 0;
+    std::vector<Node> stack;
+    Node root = { 0, make_float3(-std::numeric_limits<float>::max()), make_float3(std::numeric_limits<float>::max()) };
+    stack.push_back(root);
+    while(!stack.empty())
+    {
+        Node node = stack.back();
+        stack.pop_back();
+        if(node.index >= tree.size() || (tree[node.index].axis & PPM_NULL))
+        {
+            continue;
+        }
+
+        const Photon & photon = tree[node.index];
+        for(int axis = 0; axis < 3; axis++)
+        {
+            float position = (&photon.position.x)[axis];
+            if(!(position >= (&node.bbmin.x)[axis] && position <= (&node.bbmax.x)[axis]))
+            {
+                return false;
+            }
+        }
+        hashBytes(hash, &photon.position, sizeof(photon.position));
+        hashBytes(hash, &photon.power, sizeof(photon.power));
+        hashBytes(hash, &photon.axis, sizeof(photon.axis));
+        numTreePhotons++;
+        if(photon.axis & PPM_LEAF)
+        {
+            continue;
+        }
+
+        int axis = photon.axis & PPM_X ? 0 : (photon.axis & PPM_Y ? 1 : 2);
+        Node left = node;
+        Node right = node;
+        left.index = 2*node.index + 1;
+        right.index = 2*node.index + 2;
+        (&left.bbmax.x)[axis] = (&photon.position.x)[axis];
+        (&right.bbmin.x)[axis] = (&photon.position.x)[axis];
+        stack.push_back(right);
+        stack.push_back(left);
+    }
+    return numTreePhotons == numPhotons;
+}
+
+static double timeBuild(TaskScheduler & scheduler, const std::vector<Photon> & source, std::vector<Photon> & photons,
+                        std::vector<Photon> & tree, int repeat, bool & valid, unsigned long long & hash)
+{
+    Photon nullNode = Photon();
+    nullNode.axis = PPM_NULL;
+
+    float3 bbmin = make_float3(  std::numeric_limits<float>::max() );
+    float3 bbmax = make_float3( -std::numeric_limits<float>::max() );
+    for(size_t i = 0; i < source.size(); i++)
+    {
+        bbmin = fminf(bbmin, source[i].position);
+        bbmax = fmaxf(bbmax, source[i].position);
+    }
+
+    PhotonKdTreeBuilder builder(scheduler);
+    double best = std::numeric_limits<double>::max();
+    for(int i = 0; i < repeat; i++)
+    {
+        // Every build starts from the unsorted photons, as in the renderer, and from an empty tree so the check sees
+        // the nodes a build did not write
+        std::copy(source.begin(), source.end(), photons.begin());
+        std::fill(tree.begin(), tree.end(), nullNode);
+        QElapsedTimer timer;
+        timer.start();
+        builder.build(&photons[0], (unsigned int)photons.size(), &tree[0], bbmin, bbmax);
+        best = std::min(best, timer.nsecsElapsed()*1e-9);
+    }
+    valid = validateTree(tree, (unsigned int)source.size(), hash);
+    return best;
+}
+
+int runPhotonKdTreeBenchmark( const QStringList & arguments )
+{
+    std::vector<unsigned int> sizes;
+    int repeat = 3;
+    for(int i = 0; i < arguments.size(); i++)
+    {
+        if(arguments[i] == "--repeat" && i+1 < arguments.size())
+        {
+            repeat = std::max(1, arguments[++i].toInt());
+        }
+        else
+        {
+            sizes.push_back(arguments[i].toUInt()*1024*1024);
+        }
+    }
+    if(sizes.empty())
+    {
+        for(unsigned int millions = 1; millions <= 16; millions *= 2)
+        {
+            sizes.push_back(millions*1024*1024);
+        }
+    }
+
+    TaskScheduler serialScheduler(0);
+    TaskScheduler & parallelScheduler = TaskScheduler::get();
+
+    printf("Photon kd-tree build, best of %d, %u threads\n", repeat, parallelScheduler.getNumThreads());
+    printf("%10s %12s %12s %10s %14s %6s %6s\n", "photons", "serial ms", "parallel ms", "speedup", "Mphotons/s", "valid",
+        "equal");
+
+    unsigned int numInvalidTrees = 0, numDifferentTrees = 0;
+    for(size_t i = 0; i < sizes.size(); i++)
+    {
+        const unsigned int numPhotons = sizes[i];
+        const unsigned int treeSize = pow2roundup(numPhotons + 1) - 1;
+
+        std::vector<Photon> source;
+        generateSyntheticPhotons(source, numPhotons);
+        std::vector<Photon> photons(numPhotons);
+        std::vector<Photon> tree(treeSize);
+
+        // The parallel build partitions the same ranges as the serial one, only on other threads, so both must
+        // produce the same tree
+        bool serialValid, parallelValid;
+        unsigned long long serialHash, parallelHash;
+        double serial = timeBuild(serialScheduler, source, photons, tree, repeat, serialValid, serialHash);
+        double parallel = timeBuild(parallelScheduler, source, photons, tree, repeat, parallelValid, parallelHash);
+        numInvalidTrees += (serialValid ? 0 : 1) + (parallelValid ? 0 : 1);
+        numDifferentTrees += serialHash == parallelHash ? 0 : 1;
+
+        printf("%10u %12.2f %12.2f %9.2fx %14.2f %6s %6s\n", numPhotons, serial*1000, parallel*1000, serial/parallel,
+            numPhotons/parallel*1e-6, serialValid && parallelValid ? "yes" : "NO", serialHash == parallelHash ? "yes" : "NO");
+    }
+
+    printCheckHeader();
+    bool passed = true;
+    passed &= check(numInvalidTrees == 0, "invalid trees", numInvalidTrees, 0);
+    passed &= check(numDifferentTrees == 0, "parallel trees not equal to serial", numDifferentTrees, 0);
+    return printCheckResult(passed);
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "renderer/RandomState.h"
+#include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PhotonPacking.h"
+#include "renderer/ppm/PackedPhotons.h"
+#include "renderer/Light.h"
+#include "renderer/LightAliasTable.h"
+
+using namespace optix;
+
+namespace
+{
+    float3 getRandomUnitVector(RandomState* state)
+    {
+        float2 sample = getRandomUniformFloat2(state);
+        float z = 1.f - 2.f*sample.x;
+        float r = sqrtf(std::max(0.f, 1.f - z*z));
+        float phi = 2.f*M_PIf*sample.y;
+        return make_float3(r*cosf(phi), r*sinf(phi), z);
+    }
+
+    Light createLight(const float3 & power)
+    {
+        Light light;
+        light.power = power;
+        return light;
+    }
+
+    // Power of a photon leaving the light, as the photon generator picks it with the alias table
+    float3 getEmittedPower(const std::vector<Light> & lights, const std::vector<LightAliasEntry> & aliasTable,
+        unsigned int index)
+    {
+        return lights[index].power/(lights.size() > 1 ? aliasTable[index].pdf : 1.f);
+    }
+
+    // Photons of a photon pass output: random directions, and the emitted power of a random light tinted by a random
+    // color, with its largest component between 10^-4 and 1 times the largest emitted one, within the range the shared
+    // exponent keeps its precision in below the power scale. Every fourth slot is left empty (zero power), as the
+    // photon generator leaves the slots of absorbed photons
+    std::vector<Photon> createPhotons(unsigned int numPhotons, unsigned int seed, const std::vector<Light> & lights,
+        const std::vector<LightAliasEntry> & aliasTable)
+    {
+        std::vector<Photon> photons (numPhotons);
+        RandomState state = createRandomState(seed, 0, 0, RandomStream::CAMERA);
+        for(unsigned int i = 0; i < numPhotons; i++)
+        {
+            Photon & photon = photons[i];
+            photon.position = 10.f*getRandomUniformFloat3(&state) - make_float3(5.f);
+            photon.rayDirection = getRandomUnitVector(&state);
+            float3 color = getRandomUniformFloat3(&state);
+            color.x = std::max(color.x, 1e-3f);
+            float attenuation = powf(10.f, 4.f*getRandomUniformFloat(&state) - 4.f);
+            unsigned int light = std::min((unsigned int)lights.size() - 1,
+                (unsigned int)(getRandomUniformFloat(&state)*lights.size()));
+            float3 emittedPower = getEmittedPower(lights, aliasTable, light);
+            float3 power = emittedPower*color*(attenuation*fmaxf(emittedPower)/fmaxf(emittedPower*color));
+            photon.power = (i % 4 == 3) ? make_float3(0.f) : power;
+            photon.axis = 0;
+        }
+        return photons;
+    }
+
+    // The axes and the folding edges of the octahedron, where the sign handling of the encoding matters most
+    std::vector<float3> createEdgeDirections()
+    {
+        std::vector<float3> directions;
+        const float s = sqrtf(0.5f);
+        const float t = sqrtf(1.f/3.f);
+        for(int sign = -1; sign <= 1; sign += 2)
+        {
+            directions.push_back(make_float3(float(sign), 0.f, 0.f));
+            directions.push_back(make_float3(0.f, float(sign), 0.f));
+            directions.push_back(make_float3(0.f, 0.f, float(sign)));
+            directions.push_back(make_float3(s*sign, s, 0.f));
+            directions.push_back(make_float3(s*sign, -s, 0.f));
+            directions.push_back(make_float3(s*sign, 0.f, -s));
+            directions.push_back(make_float3(0.f, s*sign, -s));
+            directions.push_back(make_float3(t*sign, t, -t));
+            directions.push_back(make_float3(t*sign, -t, -t));
+        }
+        return directions;
+    }
+
+    // From the sine and the cosine, acos alone loses the small angles
+    double getAngle(const float3 & a, const float3 & b)
+    {
+        double cosine = double(a.x)*b.x + double(a.y)*b.y + double(a.z)*b.z;
+        double crossX = double(a.y)*b.z - double(a.z)*b.y;
+        double crossY = double(a.z)*b.x - double(a.x)*b.z;
+        double crossZ = double(a.x)*b.y - double(a.y)*b.x;
+        return atan2(sqrt(crossX*crossX + crossY*crossY + crossZ*crossZ), cosine);
+    }
+
+    // Largest component error relative to the largest component
+    double getPowerError(const float3 & reference, const float3 & value)
+    {
+        double maxComponent = std::max(reference.x, std::max(reference.y, reference.z));
+        double error = std::max(fabs(value.x - reference.x),
+            std::max(fabs(value.y - reference.y), fabs(value.z - reference.z)));
+        return maxComponent > 0 ? error/maxComponent : error;
+    }
+
+    bool isBlack(const float3 & rgb)
+    {
+        return rgb.x == 0.f && rgb.y == 0.f && rgb.z == 0.f;
+    }
+}
+
+// Round trip of the packed photon pass output (renderer/ppm/PhotonPacking.h and PackedPhotons.h) on --photons random
+// photons of the lights of the Cornell scenes and a weaker one. Checks the error of the octahedral directions, random
+// and on the folding edges, and of the RGB9E5 powers relative to the photon power scale, of the emitted photons of each
+// light on their own too, that negative and NaN powers are stored as 0, that the positions come back exactly and that
+// empty slots stay empty, and prints the pack and unpack throughput. Returns 1 if a check fails.
+int runPhotonPackingBenchmark( const QStringList & arguments )
+{
+    unsigned int numPhotons = 1024*1024;
+    unsigned int seed = 1;
+    int repeat = 3;
+    for(int i = 0; i+1 < arguments.size(); i++)
+    {
+        if(arguments[i] == "--photons")
+        {
+            numPhotons = std::max(4u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--seed")
+        {
+            seed = arguments[i+1].toUInt();
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+        else
+        {
+            continue;
+        }
+        i++;
+    }
+
+    // The area light of Cornell and CornellSmall, far beyond the RGB9E5 range, and a weak colored light that is
+    // picked much less often so its photons leave it with a power of the same order
+    std::vector<Light> lights;
+    lights.push_back(createLight(make_float3(0.5e6f, 0.4e6f, 0.2e6f)));
+    lights.push_back(createLight(make_float3(20.f, 100.f, 300.f)));
+    std::vector<LightAliasEntry> aliasTable (lights.size());
+    buildLightAliasTable(&lights[0], (unsigned int)lights.size(), &aliasTable[0]);
+    const float powerScale = getPhotonPowerScale(&lights[0], &aliasTable[0], (unsigned int)lights.size());
+
+    std::vector<Photon> photons = createPhotons(numPhotons, seed, lights, aliasTable);
+    std::vector<float3> positions (numPhotons);
+    std::vector<unsigned int> directions (numPhotons);
+    std::vector<unsigned int> powers (numPhotons);
+    std::vector<Photon> unpacked (numPhotons);
+
+    double packSeconds = std::numeric_limits<double>::max();
+    double unpackSeconds = std::numeric_limits<double>::max();
+    for(int r = 0; r < repeat; r++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        packPhotons(&photons[0], numPhotons, powerScale, &positions[0], &directions[0], &powers[0]);
+        packSeconds = std::min(packSeconds, timer.nsecsElapsed()*1e-9);
+
+        timer.restart();
+        unpackPhotons(&positions[0], &directions[0], &powers[0], numPhotons, powerScale, &unpacked[0]);
+        unpackSeconds = std::min(unpackSeconds, timer.nsecsElapsed()*1e-9);
+    }
+
+    double maxDirectionError = 0, maxPowerError = 0;
+    unsigned int numWrongPositions = 0, numEmptyNotKept = 0, numPowersLost = 0;
+    for(unsigned int i = 0; i < numPhotons; i++)
+    {
+        const Photon & reference = photons[i];
+        const Photon & photon = unpacked[i];
+        maxDirectionError = std::max(maxDirectionError, getAngle(reference.rayDirection, photon.rayDirection));
+        maxPowerError = std::max(maxPowerError, getPowerError(reference.power, photon.power));
+        numWrongPositions += reference.position.x != photon.position.x || reference.position.y != photon.position.y
+            || reference.position.z != photon.position.z ? 1 : 0;
+        if(isBlack(reference.power))
+        {
+            numEmptyNotKept += powers[i] != 0 || !isBlack(photon.power) ? 1 : 0;
+        }
+        else
+        {
+            numPowersLost += powers[i] == 0 ? 1 : 0;
+        }
+    }
+
+    std::vector<float3> edgeDirections = createEdgeDirections();
+    double maxEdgeDirectionError = 0;
+    for(size_t i = 0; i < edgeDirections.size(); i++)
+    {
+        float3 direction = unpackUnitVectorOctahedral(packUnitVectorOctahedral(edgeDirections[i]));
+        maxEdgeDirectionError = std::max(maxEdgeDirectionError, getAngle(edgeDirections[i], direction));
+    }
+
+    // The photons straight from each light, the single light scenes pick their light with pdf 1
+    double maxEmittedPowerError = 0;
+    for(unsigned int i = 0; i < lights.size(); i++)
+    {
+        float3 power = getEmittedPower(lights, aliasTable, i);
+        maxEmittedPowerError = std::max(maxEmittedPowerError,
+            getPowerError(power, unpackPhotonPower(packPhotonPower(power, powerScale), powerScale)));
+        float singleLightScale = getPhotonPowerScale(&lights[i], &aliasTable[i], 1);
+        maxEmittedPowerError = std::max(maxEmittedPowerError, getPowerError(lights[i].power,
+            unpackPhotonPower(packPhotonPower(lights[i].power, singleLightScale), singleLightScale)));
+    }
+
+    float3 invalidPower = unpackPhotonPower(packPhotonPower(make_float3(-1.f, std::numeric_limits<float>::quiet_NaN(),
+        0.f), powerScale), powerScale);
+    double invalidPowerError = fabs(invalidPower.x) + fabs(invalidPower.y) + fabs(invalidPower.z);
+
+    printf("Packed photons, %u photons, %u bytes each instead of %u, power scale %g\n", numPhotons,
+        (unsigned int)(sizeof(float3) + 2*sizeof(unsigned int)), (unsigned int)sizeof(Photon), powerScale);
+    printf("%-12s %16s\n", "", "M photons/s");
+    printf("%-12s %16.1f\n", "pack", numPhotons/packSeconds*1e-6);
+    printf("%-12s %16.1f\n", "unpack", numPhotons/unpackSeconds*1e-6);
+
+    // Half a step of the 9 bit mantissas, relative to a largest component that may have been rounded up into the next
+    // exponent (a mantissa of 255.75)
+    const double powerLimit = 1.0/511;
+    printCheckHeader();
+    bool passed = true;
+    passed &= check(maxDirectionError < 1e-4, "max direction error (rad)", maxDirectionError, 1e-4);
+    passed &= check(maxEdgeDirectionError < 1e-4, "max edge direction error (rad)", maxEdgeDirectionError, 1e-4);
+    passed &= check(maxPowerError < powerLimit, "max power error", maxPowerError, powerLimit);
+    passed &= check(maxEmittedPowerError < powerLimit, "max emitted power error", maxEmittedPowerError, powerLimit);
+    passed &= check(invalidPowerError == 0, "negative and NaN power error", invalidPowerError, 0);
+    passed &= check(numWrongPositions == 0, "photons with wrong position", numWrongPositions, 0);
+    passed &= check(numEmptyNotKept == 0, "empty slots not kept empty", numEmptyNotKept, 0);
+    passed &= check(numPowersLost == 0, "photons packed as empty", numPowersLost, 0);
+
+    return printCheckResult(passed);
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "SyntheticPhotons.h"
+#include "renderer/ppm/HostPhotonGather.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+static const PhotonMapStructure::E structures[] =
+{
+    PhotonMapStructure::UNIFORM_GRID,
+    PhotonMapStructure::HASHED_GRID
+};
+
+static const char* structureNames[] = { "grid", "kdtree", "hash", "hashgrid" };
+
+// Shrinks the radius like progressive photon mapping does, r(i+1)^2 = r(i)^2 (i + alpha)/(i + 1) with every hitpoint
+// collecting as many photons as the PPM estimate expects, and gathers the same photons with the uniform grid and the
+// hashed grid at iterations 1, 2, 4, ... The cells of the uniform grid are as small as its cell cap allows whatever
+// the radius, so once the radius is smaller than a cell each gather visits more photons than it collects, while the
+// cells of the hashed grid stay one radius wide.
+int runPhotonRadiusBenchmark( const QStringList & arguments )
+{
+    unsigned int numPhotons = 1024*1024;
+    unsigned int width = 512;
+    unsigned int height = 512;
+    float initialRadius = 0.05f;
+    float alpha = 0.7f;
+    unsigned int iterations = 1u << 16;
+    int repeat = 3;
+    for(int i = 0; i+1 < arguments.size(); i += 2)
+    {
+        if(arguments[i] == "--photons")
+        {
+            numPhotons = arguments[i+1].toUInt()*1024*1024;
+        }
+        else if(arguments[i] == "--width")
+        {
+            width = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--height")
+        {
+            height = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--radius")
+        {
+            initialRadius = arguments[i+1].toFloat();
+        }
+        else if(arguments[i] == "--alpha")
+        {
+            alpha = arguments[i+1].toFloat();
+        }
+        else if(arguments[i] == "--iterations")
+        {
+            iterations = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+    }
+
+    std::vector<Photon> photons;
+    generateSyntheticPhotons(photons, numPhotons, 0.2f);
+    std::vector<Hitpoint> hitpoints;
+    generateSyntheticHitpoints(hitpoints, width, height);
+    const unsigned int numHitpoints = (unsigned int)hitpoints.size();
+
+    std::vector<float3> indirectRadiance(numHitpoints);
+    std::vector<unsigned int> photonsVisited(numHitpoints);
+    std::vector<unsigned int> cellsVisited(numHitpoints);
+
+    TaskScheduler & scheduler = TaskScheduler::get();
+    printf("Photon gather as the PPM radius shrinks, %u photon slots, %ux%u hitpoints, radius %.4f, alpha %.2f, "
+        "best of %d\n", numPhotons, width, height, initialRadius, alpha, repeat);
+    printf("%10s %10s %8s %10s %10s %14s %12s %10s\n", "iteration", "radius", "mode", "cell size", "cells",
+        "photons/query", "cells/query", "gather ms");
+
+    double radiusSquared = double(initialRadius)*initialRadius;
+    for(unsigned int iteration = 1; iteration <= iterations; iteration++)
+    {
+        radiusSquared *= (iteration - 1 + alpha)/iteration;
+        if((iteration & (iteration - 1)) != 0 && iteration != iterations)
+        {
+            continue;
+        }
+
+        const float radius = float(sqrt(radiusSquared));
+        for(size_t s = 0; s < sizeof(structures)/sizeof(PhotonMapStructure::E); s++)
+        {
+            const PhotonMapStructure::E structure = structures[s];
+            HostPhotonGather photonMap(scheduler);
+            photonMap.build(structure, &photons[0], numPhotons, radius);
+
+            double best = std::numeric_limits<double>::max();
+            for(int i = 0; i < repeat; i++)
+            {
+                QElapsedTimer timer;
+                timer.start();
+                photonMap.gather(&hitpoints[0], numHitpoints, radius, float(numPhotons), &indirectRadiance[0],
+                    &photonsVisited[0], &cellsVisited[0]);
+                best = std::min(best, timer.nsecsElapsed()*1e-9);
+            }
+
+            double totalPhotonsVisited = 0;
+            double totalCellsVisited = 0;
+            for(unsigned int i = 0; i < numHitpoints; i++)
+            {
+                totalPhotonsVisited += photonsVisited[i];
+                totalCellsVisited += cellsVisited[i];
+            }
+
+            const uint3 & gridSize = photonMap.getGridSize();
+            double numCells = structure == PhotonMapStructure::HASHED_GRID ? photonMap.getNumHashedGridCells()
+                : double(gridSize.x)*gridSize.y*gridSize.z;
+            printf("%10u %10.5f %8s %10.5f %10.0f %14.1f %12.1f %10.2f\n", iteration, radius, structureNames[structure],
+                photonMap.getCellSize(), numCells, totalPhotonsVisited/numHitpoints, totalCellsVisited/numHitpoints,
+                best*1000);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "ComputeDeviceRepository.h"
+#include "renderer/OptixRenderer.h"
+#include "renderer/RenderMethod.h"
+#include "clientserver/RenderServerRenderRequestDetails.h"
+#include "scene/Scene.h"
+#include "scene/Cornell.h"
+#include "scene/CornellSmall.h"
+
+static const PhotonMapStructure::E structures[] =
+{
+    PhotonMapStructure::UNIFORM_GRID,
+    PhotonMapStructure::HASHED_GRID,
+    PhotonMapStructure::STOCHASTIC_HASH,
+    PhotonMapStructure::KD_TREE_CPU
+};
+
+static const char* structureNames[] = { "grid", "kdtree", "hash", "hashgrid" };
+
+static IScene* loadScene( const QString & name )
+{
+    if(name == "Cornell")
+    {
+        return new Cornell();
+    }
+    else if(name == "CornellSmall")
+    {
+        return new CornellSmall(CornellSmall::Default);
+    }
+    return Scene::createFromFile(name.toUtf8().constData());
+}
+
+// Renders the same scene with progressive photon mapping once for each photon map acceleration structure and
+// reports the time per iteration. Every structure starts over from iteration 0 with the initial radius of the scene.
+// --save-photons writes the photons and hitpoints of the last uniform grid iteration to a photon dump (PhotonDump.h).
+// --trace saves the pass timings of all iterations as a Chrome trace (RenderTrace.h) and prints them per pass.
+int runPpmIterationBenchmark( const QStringList & arguments )
+{
+    QString sceneName = "Cornell";
+    unsigned int width = 1024;
+    unsigned int height = 768;
+    int iterations = 50;
+    int warmup = 3;
+    QString photonDumpFile;
+    QString traceFile;
+    for(int i = 0; i+1 < arguments.size(); i += 2)
+    {
+        if(arguments[i] == "--scene")
+        {
+            sceneName = arguments[i+1];
+        }
+        else if(arguments[i] == "--width")
+        {
+            width = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--height")
+        {
+            height = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--iterations")
+        {
+            iterations = std::max(1, arguments[i+1].toInt());
+        }
+        else if(arguments[i] == "--warmup")
+        {
+            warmup = std::max(0, arguments[i+1].toInt());
+        }
+        else if(arguments[i] == "--save-photons")
+        {
+            photonDumpFile = arguments[i+1];
+        }
+        else if(arguments[i] == "--trace")
+        {
+            traceFile = arguments[i+1];
+        }
+    }
+
+    std::vector<ComputeDevice> & devices = ComputeDeviceRepository::get().getComputeDevices();
+    if(devices.empty() || devices[0].isHost())
+    {
+        printf("No CUDA device found\n");
+        return 1;
+    }
+
+    IScene* scene = loadScene(sceneName);
+    Camera camera = scene->getDefaultCamera();
+    camera.setAspectRatio(float(width)/float(height));
+    const double PPMAlpha = 2.0/3.0;
+
+    OptixRenderer renderer;
+    renderer.initialize(devices[0]);
+    renderer.initScene(*scene);
+
+    printf("PPM iteration, scene %s, %ux%u, %d iterations after %d warm-up, %u photons emitted per iteration\n",
+        scene->getSceneName(), width, height, iterations, warmup, OptixRenderer::EMITTED_PHOTONS_PER_ITERATION);
+    printf("%8s %12s %12s %14s\n", "mode", "mean ms", "min ms", "iterations/s");
+
+    for(size_t s = 0; s < sizeof(structures)/sizeof(PhotonMapStructure::E); s++)
+    {
+        const PhotonMapStructure::E structure = structures[s];
+        RenderServerRenderRequestDetails details (camera, QByteArray(scene->getSceneName()),
+            RenderMethod::PROGRESSIVE_PHOTON_MAPPING, width, height, PPMAlpha, structure);
+
+        double PPMRadius = scene->getSceneInitialPPMRadiusEstimate();
+        double lastPPMRadius = PPMRadius;
+        double total = 0;
+        double best = std::numeric_limits<double>::max();
+        QElapsedTimer timer;
+        for(int i = 0; i < warmup + iterations; i++)
+        {
+            timer.start();
+            renderer.renderNextIteration(i, i, float(PPMRadius), false, details);
+            lastPPMRadius = PPMRadius;
+            double elapsed = timer.nsecsElapsed()*1e-9;
+            if(i >= warmup)
+            {
+                total += elapsed;
+                best = std::min(best, elapsed);
+            }
+            PPMRadius = sqrt(PPMRadius*PPMRadius*(i+PPMAlpha)/double(i+1));
+        }
+
+        printf("%8s %12.2f %12.2f %14.2f\n", structureNames[structure], total/iterations*1000, best*1000,
+            iterations/total);
+
+        if(!photonDumpFile.isEmpty() && structure == PhotonMapStructure::UNIFORM_GRID)
+        {
+            renderer.savePhotonDump(photonDumpFile, float(lastPPMRadius));
+        }
+    }
+
+    if(!traceFile.isEmpty())
+    {
+        const RenderTrace & trace = renderer.getRenderTrace();
+        printf("\n%s\n", trace.summarize().toString().toLatin1().constData());
+        trace.saveChromeTrace(traceFile);
+    }
+
+    delete scene;
+    return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <exception>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "renderer/RandomState.h"
+#include "renderer/RandomStateDevice.h"
+
+using namespace optix;
+
+namespace
+{
+    // Correlation coefficient of the pairs (a[i*stride], b[i*stride])
+    double getCorrelation(const float* a, const float* b, unsigned int count, unsigned int stride)
+    {
+        double sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+        for(unsigned int i = 0; i < count; i++)
+        {
+            double x = a[i*stride];
+            double y = b[i*stride];
+            sumA += x;
+            sumB += y;
+            sumAA += x*x;
+            sumBB += y*y;
+            sumAB += x*y;
+        }
+        double covariance = sumAB/count - (sumA/count)*(sumB/count);
+        double varianceA = sumAA/count - (sumA/count)*(sumA/count);
+        double varianceB = sumBB/count - (sumB/count)*(sumB/count);
+        return covariance/sqrt(varianceA*varianceB);
+    }
+
+    // Chi-square of the counts against a uniform distribution, as the number of standard deviations from its mean
+    double getChiSquareDeviation(const std::vector<unsigned int> & bins, unsigned long long count)
+    {
+        double expected = double(count)/bins.size();
+        double chiSquare = 0;
+        for(size_t i = 0; i < bins.size(); i++)
+        {
+            chiSquare += (bins[i] - expected)*(bins[i] - expected)/expected;
+        }
+        double degreesOfFreedom = double(bins.size() - 1);
+        return (chiSquare - degreesOfFreedom)/sqrt(2*degreesOfFreedom);
+    }
+
+    void generate(unsigned int seed, unsigned long long iterationNumber, unsigned int numIndices, unsigned int numDimensions,
+        std::vector<float> & values, Sampler::E sampler = Sampler::RANDOM)
+    {
+        values.resize(size_t(numIndices)*numDimensions);
+        for(unsigned int index = 0; index < numIndices; index++)
+        {
+            RandomState state = createRandomState(seed, iterationNumber, index, RandomStream::CAMERA, sampler);
+            for(unsigned int i = 0; i < numDimensions; i++)
+            {
+                values[size_t(index)*numDimensions + i] = getRandomUniformFloat(&state);
+            }
+        }
+    }
+}
+
+// Checks of the counter-based generator of renderer/RandomState.h. The Philox known answers are those of the Random123
+// reference implementation. The numbers of a seed are drawn for --indices pixels of --dimensions numbers each and
+// tested for their moments, a 256 bin histogram per dimension, a 64x64 histogram of getRandomUniformFloat2 pairs and
+// the correlation of neighbouring dimensions, pixels, iterations and seeds. With --device the same numbers are
+// generated on the CUDA device for each sampler and must be bit-exact with the host ones. Returns 1 if a check fails.
+int runRandomNumberBenchmark( const QStringList & arguments )
+{
+    unsigned int numIndices = 1024*1024;
+    unsigned int numDimensions = 16;
+    unsigned int seed = 1;
+    bool compareDevice = false;
+    int repeat = 3;
+    for(int i = 0; i < arguments.size(); i++)
+    {
+        if(arguments[i] == "--device")
+        {
+            compareDevice = true;
+        }
+        else if(i+1 < arguments.size())
+        {
+            if(arguments[i] == "--indices")
+            {
+                numIndices = std::max(1024u, arguments[i+1].toUInt());
+            }
+            else if(arguments[i] == "--dimensions")
+            {
+                numDimensions = std::max(2u, arguments[i+1].toUInt());
+            }
+            else if(arguments[i] == "--seed")
+            {
+                seed = arguments[i+1].toUInt();
+            }
+            else if(arguments[i] == "--repeat")
+            {
+                repeat = std::max(1, arguments[i+1].toInt());
+            }
+            else
+            {
+                continue;
+            }
+            i++;
+        }
+    }
+
+    printf("Counter-based random numbers, seed %u, %u indices x %u dimensions\n", seed, numIndices, numDimensions);
+    printCheckHeader();
+    bool passed = true;
+
+    // Known answers of Philox2x32-10
+    const unsigned int knownAnswers[][5] =
+    {
+        { 0x00000000, 0x00000000, 0x00000000, 0xff1dae59, 0x6cd10df2 },
+        { 0xffffffff, 0xffffffff, 0xffffffff, 0x2c3f628b, 0xab4fd7ad },
+        { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0xdd7ce038, 0xf62a4c12 },
+    };
+    unsigned int numWrongAnswers = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        uint2 result = philox2x32(make_uint2(knownAnswers[i][0], knownAnswers[i][1]), knownAnswers[i][2]);
+        numWrongAnswers += (result.x != knownAnswers[i][3] || result.y != knownAnswers[i][4]) ? 1 : 0;
+    }
+    passed &= check(numWrongAnswers == 0, "Philox2x32-10 wrong known answers", numWrongAnswers, 0);
+    passed &= check(toUniformFloat(0xffffffff) < 1.f, "largest float", toUniformFloat(0xffffffff), 1);
+
+    std::vector<float> values;
+    double seconds = std::numeric_limits<double>::max();
+    for(int i = 0; i < repeat; i++)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        generate(seed, 0, numIndices, numDimensions, values);
+        seconds = std::min(seconds, timer.nsecsElapsed()*1e-9);
+    }
+
+    // A correlation of independent samples is about normal with a standard deviation of 1/sqrt(n), the limits are at
+    // five standard deviations
+    const unsigned long long count = values.size();
+    double sum = 0, sumSquares = 0;
+    std::vector<unsigned int> bins (256*numDimensions, 0);
+    for(unsigned int index = 0; index < numIndices; index++)
+    {
+        for(unsigned int i = 0; i < numDimensions; i++)
+        {
+            float value = values[size_t(index)*numDimensions + i];
+            sum += value;
+            sumSquares += value*value;
+            bins[i*256 + int(value*256)]++;
+        }
+    }
+    double mean = sum/count;
+    double variance = sumSquares/count - mean*mean;
+    passed &= check(fabs(mean - 0.5) < 5*sqrt(1/12.0/count), "mean - 1/2", mean - 0.5, 5*sqrt(1/12.0/count));
+    passed &= check(fabs(variance - 1/12.0) < 5*sqrt(1/180.0/count), "variance - 1/12", variance - 1/12.0,
+        5*sqrt(1/180.0/count));
+    double chiSquare = getChiSquareDeviation(bins, count);
+    passed &= check(fabs(chiSquare) < 5, "chi-square 256 bins x dimension (sd)", chiSquare, 5);
+
+    std::vector<unsigned int> pairBins (64*64, 0);
+    for(unsigned int index = 0; index < numIndices; index++)
+    {
+        RandomState state = createRandomState(seed, 0, index, RandomStream::CAMERA);
+        float2 sample = getRandomUniformFloat2(&state);
+        pairBins[int(sample.y*64)*64 + int(sample.x*64)]++;
+    }
+    double pairChiSquare = getChiSquareDeviation(pairBins, numIndices);
+    passed &= check(fabs(pairChiSquare) < 5, "chi-square 64x64 float2 (sd)", pairChiSquare, 5);
+
+    const double limit = 5/sqrt(double(numIndices));
+    double dimensionCorrelation = getCorrelation(&values[0], &values[1], numIndices, numDimensions);
+    passed &= check(fabs(dimensionCorrelation) < limit, "correlation of dimensions 0 and 1", dimensionCorrelation, limit);
+    double pixelCorrelation = getCorrelation(&values[0], &values[numDimensions], numIndices - 1, numDimensions);
+    passed &= check(fabs(pixelCorrelation) < limit, "correlation of neighbour pixels", pixelCorrelation, limit);
+
+    std::vector<float> otherValues;
+    generate(seed, 1, numIndices, numDimensions, otherValues);
+    double iterationCorrelation = getCorrelation(&values[0], &otherValues[0], numIndices, numDimensions);
+    passed &= check(fabs(iterationCorrelation) < limit, "correlation of iterations 0 and 1", iterationCorrelation, limit);
+    generate(seed + 1, 0, numIndices, numDimensions, otherValues);
+    double seedCorrelation = getCorrelation(&values[0], &otherValues[0], numIndices, numDimensions);
+    passed &= check(fabs(seedCorrelation) < limit, "correlation of seeds", seedCorrelation, limit);
+
+    printf("Host: %.1f M numbers/s (best of %d, one thread)\n", count/seconds*1e-6, repeat);
+
+    if(compareDevice)
+    {
+        const Sampler::E samplers[] = { Sampler::RANDOM, Sampler::SOBOL, Sampler::HALTON };
+        const char* names[] = { "host and device mismatches, random", "host and device mismatches, sobol",
+            "host and device mismatches, halton" };
+        std::vector<float> deviceValues (values.size());
+        for(int s = 0; s < 3; s++)
+        {
+            // An iteration past 0 so the low-discrepancy samplers use their index bits
+            generate(seed, 5, numIndices, numDimensions, values, samplers[s]);
+            generateRandomUniformFloatsOnDevice(seed, 5, RandomStream::CAMERA, samplers[s], numIndices, numDimensions,
+                &deviceValues[0]);
+            unsigned long long numMismatches = 0;
+            for(size_t i = 0; i < values.size(); i++)
+            {
+                numMismatches += memcmp(&values[i], &deviceValues[i], sizeof(float)) != 0 ? 1 : 0;
+            }
+            passed &= check(numMismatches == 0, names[s], double(numMismatches), 0);
+        }
+    }
+
+    return printCheckResult(passed);
+}
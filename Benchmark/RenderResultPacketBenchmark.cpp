@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <exception>
+#include <limits>
+#include <algorithm>
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "SyntheticPhotons.h"
+#include "clientserver/RenderResultPacket.h"
+#include "clientserver/RenderResultPacketEncoding.h"
+#include "renderer/ppm/HostPhotonGather.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+namespace
+{
+    // Layout of an encoded frame (RenderResultPacketEncoding.cpp): three words of header (encoding, pixels, blocks),
+    // the size of each block, the blocks
+    const int ENCODED_HEADER_SIZE = 3*sizeof(unsigned int);
+
+    unsigned int getNumBlocks(const QByteArray & encoded)
+    {
+        unsigned int numBlocks;
+        memcpy(&numBlocks, encoded.constData() + 2*sizeof(unsigned int), sizeof(numBlocks));
+        return numBlocks;
+    }
+
+    unsigned int getBlockSize(const QByteArray & encoded, unsigned int block)
+    {
+        unsigned int size;
+        memcpy(&size, encoded.constData() + ENCODED_HEADER_SIZE + block*sizeof(unsigned int), sizeof(size));
+        return size;
+    }
+
+    int getBlockOffset(const QByteArray & encoded, unsigned int block)
+    {
+        int offset = ENCODED_HEADER_SIZE + getNumBlocks(encoded)*sizeof(unsigned int);
+        for(unsigned int i = 0; i < block; i++)
+        {
+            offset += getBlockSize(encoded, i);
+        }
+        return offset;
+    }
+
+    bool decodeThrows(const QByteArray & encoded, TaskScheduler & scheduler)
+    {
+        try
+        {
+            decodeRenderResultOutput(encoded, scheduler);
+        }
+        catch(const std::exception &)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    // The ways a frame gets corrupt that the decoder must reject as a whole, each applied to the middle block. Returns
+    // the number of them that decoded without an error.
+    unsigned int countAcceptedCorruptFrames(const QByteArray & encoded, unsigned int encoding, TaskScheduler & scheduler)
+    {
+        const unsigned int block = getNumBlocks(encoded)/2;
+        const int blockOffset = getBlockOffset(encoded, block);
+        const int blockSizeOffset = ENCODED_HEADER_SIZE + block*sizeof(unsigned int);
+        unsigned int numAccepted = 0;
+
+        // The block one byte short, with its size to match so the frame size still adds up
+        QByteArray shortBlock = encoded;
+        shortBlock.remove(blockOffset, 1);
+        unsigned int size = getBlockSize(encoded, block) - 1;
+        memcpy(shortBlock.data() + blockSizeOffset, &size, sizeof(size));
+        numAccepted += decodeThrows(shortBlock, scheduler) ? 0 : 1;
+
+        if(encoding & RenderResultPacketEncoding::COMPRESS)
+        {
+            // A deflated block that does not inflate: its zlib header (after the uncompressed size) overwritten
+            QByteArray badStream = encoded;
+            memset(badStream.data() + blockOffset + 4, 0xff, 2);
+            numAccepted += decodeThrows(badStream, scheduler) ? 0 : 1;
+
+            // A deflated block that claims another uncompressed size
+            QByteArray badSize = encoded;
+            badSize.data()[blockOffset] ^= 0x10;
+            numAccepted += decodeThrows(badSize, scheduler) ? 0 : 1;
+        }
+
+        // A header whose block count does not match its pixel count
+        QByteArray badHeader = encoded;
+        unsigned int numBlocks = getNumBlocks(encoded) + 1;
+        memcpy(badHeader.data() + 2*sizeof(unsigned int), &numBlocks, sizeof(numBlocks));
+        numAccepted += decodeThrows(badHeader, scheduler) ? 0 : 1;
+        return numAccepted;
+    }
+
+    // Cuts the encoded frame through the header, the block sizes and at random points of the blocks, and returns the
+    // number of cuts that decoded without an error
+    unsigned int countAcceptedTruncatedFrames(const QByteArray & encoded, TaskScheduler & scheduler)
+    {
+        std::vector<int> lengths;
+        const int tableEnd = ENCODED_HEADER_SIZE + getNumBlocks(encoded)*sizeof(unsigned int);
+        for(int length = 0; length <= tableEnd + 16 && length < encoded.size(); length++)
+        {
+            lengths.push_back(length);
+        }
+        unsigned int random = 1;
+        for(int i = 0; i < 32; i++)
+        {
+            random = random*1664525u + 1013904223u;
+            lengths.push_back(tableEnd + int(random % (unsigned int)(encoded.size() - tableEnd)));
+        }
+        lengths.push_back(encoded.size() - 1);
+
+        unsigned int numAccepted = 0;
+        for(size_t i = 0; i < lengths.size(); i++)
+        {
+            numAccepted += decodeThrows(encoded.left(lengths[i]), scheduler) ? 0 : 1;
+        }
+        return numAccepted;
+    }
+
+    // Reads a packet cut short as the client does, returns whether that was detected
+    bool isTruncatedPacketDetected(const QByteArray & wire, int length)
+    {
+        QDataStream in (wire.left(length));
+        in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+        quint64 size;
+        in >> size;
+        RenderResultPacket received;
+        try
+        {
+            in >> received;
+        }
+        catch(const std::exception &)
+        {
+            return true;
+        }
+        return in.status() != QDataStream::Ok;
+    }
+}
+
+// Bytes on the wire and encode/decode throughput of each RenderResultPacket encoding. The frame is the indirect
+// radiance of one PPM iteration of the synthetic Cornell box gathered on the host, so it has the noise of a real
+// packet. The wire size is that of the serialized packet, and the transfer time assumes a 1 Gbit/s link.
+// Checks the error of each encoding, that the packet read back from the stream is the decoded frame, and that
+// corrupt and truncated frames and truncated packets are rejected. Returns 1 if a check fails.
+int runRenderResultPacketBenchmark( const QStringList & arguments )
+{
+    unsigned int width = 2000;
+    unsigned int height = 2000;
+    unsigned int numPhotons = 1024*1024;
+    int repeat = 3;
+    for(int i = 0; i+1 < arguments.size(); i += 2)
+    {
+        if(arguments[i] == "--width")
+        {
+            width = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--height")
+        {
+            height = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--photons")
+        {
+            numPhotons = std::max(1u, arguments[i+1].toUInt())*1024*1024;
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+    }
+
+    TaskScheduler & scheduler = TaskScheduler::get();
+    const float radius = 0.01f;
+    std::vector<Photon> photons;
+    std::vector<Hitpoint> hitpoints;
+    generateSyntheticPhotons(photons, numPhotons, 0.2f);
+    generateSyntheticHitpoints(hitpoints, width, height);
+    HostPhotonGather photonMap(scheduler);
+    photonMap.build(PhotonMapStructure::UNIFORM_GRID, &photons[0], numPhotons, radius);
+    QByteArray frame (width*height*sizeof(float3), Qt::Uninitialized);
+    float3* pixels = reinterpret_cast<float3*>(frame.data());
+    photonMap.gather(&hitpoints[0], width*height, radius, float(numPhotons), pixels);
+
+    printf("Render result packet, %ux%u frame (%.1f MB), best of %d, %u threads\n", width, height,
+        frame.size()/(1024.0*1024.0), repeat, scheduler.getNumThreads());
+    printf("%-24s %10s %8s %10s %12s %12s %12s\n", "encoding", "wire MB", "ratio", "1 Gbit ms", "encode MB/s",
+        "decode MB/s", "max rel err");
+
+    const unsigned int encodings[] =
+    {
+        RenderResultPacketEncoding::FLOAT,
+        RenderResultPacketEncoding::FLOAT | RenderResultPacketEncoding::COMPRESS,
+        RenderResultPacketEncoding::FLOAT | RenderResultPacketEncoding::BYTE_SHUFFLE | RenderResultPacketEncoding::COMPRESS,
+        RenderResultPacketEncoding::HALF,
+        RenderResultPacketEncoding::HALF | RenderResultPacketEncoding::COMPRESS,
+        RenderResultPacketEncoding::HALF | RenderResultPacketEncoding::BYTE_SHUFFLE | RenderResultPacketEncoding::COMPRESS,
+        RenderResultPacketEncoding::RGB9E5,
+        RenderResultPacketEncoding::RGB9E5 | RenderResultPacketEncoding::BYTE_SHUFFLE | RenderResultPacketEncoding::COMPRESS,
+    };
+    const int numEncodings = sizeof(encodings)/sizeof(unsigned int);
+
+    QVector<unsigned long long> iterationNumbers;
+    iterationNumbers << 0;
+    bool passed = true;
+    std::vector<double> maxErrors (numEncodings);
+    std::vector<bool> packetMatches (numEncodings);
+    std::vector<unsigned int> numAcceptedCorrupt (numEncodings);
+    std::vector<unsigned int> numAcceptedTruncated (numEncodings);
+    std::vector<unsigned int> numUndetectedTruncatedPackets (numEncodings);
+    for(int e = 0; e < numEncodings; e++)
+    {
+        QElapsedTimer timer;
+        QByteArray encoded;
+        double encode = std::numeric_limits<double>::max();
+        for(int i = 0; i < repeat; i++)
+        {
+            timer.start();
+            encoded = encodeRenderResultOutput(frame, encodings[e], scheduler);
+            encode = std::min(encode, timer.nsecsElapsed()*1e-9);
+        }
+
+        QByteArray decoded;
+        double decode = std::numeric_limits<double>::max();
+        for(int i = 0; i < repeat; i++)
+        {
+            timer.start();
+            decoded = decodeRenderResultOutput(encoded, scheduler);
+            decode = std::min(decode, timer.nsecsElapsed()*1e-9);
+        }
+
+        // The serialized packet is what goes over the socket, and must come back as the decoded frame
+        RenderResultPacket packet (1, iterationNumbers, frame);
+        packet.setEncoding(encodings[e]);
+        QByteArray wire;
+        {
+            QDataStream out (&wire, QIODevice::WriteOnly);
+            out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+            out << packet;
+        }
+        RenderResultPacket received;
+        {
+            QDataStream in (wire);
+            in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+            quint64 size;
+            in >> size;
+            in >> received;
+        }
+        packetMatches[e] = received.getOutput() == decoded;
+
+        // Relative to the largest channel of the pixel, the precision the shared exponent keeps. Below the smallest
+        // value the format keeps at full precision (the smallest normal half, the smallest shared exponent) the error
+        // is relative to that value.
+        const unsigned int format = encodings[e] & RenderResultPacketEncoding::FORMAT_MASK;
+        const float smallestFullPrecision = format == RenderResultPacketEncoding::HALF ? ldexpf(1.f, -14)
+            : (format == RenderResultPacketEncoding::RGB9E5 ? ldexpf(1.f, -15) : 0.f);
+        const float3* decodedPixels = reinterpret_cast<const float3*>(decoded.constData());
+        double maxError = 0;
+        for(unsigned int i = 0; i < width*height; i++)
+        {
+            float reference = std::max(fmaxf(pixels[i]), smallestFullPrecision);
+            if(reference > 0)
+            {
+                float3 difference = decodedPixels[i] - pixels[i];
+                float largest = std::max(fabsf(difference.x), std::max(fabsf(difference.y), fabsf(difference.z)));
+                maxError = std::max(maxError, double(largest/reference));
+            }
+        }
+        maxErrors[e] = maxError;
+        numAcceptedCorrupt[e] = countAcceptedCorruptFrames(encoded, encodings[e], scheduler);
+        numAcceptedTruncated[e] = countAcceptedTruncatedFrames(encoded, scheduler);
+        numUndetectedTruncatedPackets[e] = 0;
+        for(int length = wire.size() - 1; length > 0; length /= 2)
+        {
+            numUndetectedTruncatedPackets[e] += isTruncatedPacketDetected(wire, length) ? 0 : 1;
+        }
+
+        const double frameMB = frame.size()/(1024.0*1024.0);
+        printf("%-24s %10.2f %8.2f %10.1f %12.0f %12.0f %12.2g\n", renderResultPacketEncodingToString(encodings[e]).toLatin1().constData(),
+            wire.size()/(1024.0*1024.0), double(frame.size())/wire.size(), wire.size()*8.0/1e9*1000, frameMB/encode, frameMB/decode,
+            maxError);
+    }
+
+    // Half floats and shared exponents round to nearest: half a step of their 11 and 9 bit mantissas, relative to a
+    // largest channel the shared exponent may have rounded up into the next exponent
+    const int nameWidth = 44;
+    printCheckHeader(nameWidth);
+    for(int e = 0; e < numEncodings; e++)
+    {
+        const unsigned int format = encodings[e] & RenderResultPacketEncoding::FORMAT_MASK;
+        const double limit = format == RenderResultPacketEncoding::HALF ? ldexp(1.0, -11)
+            : (format == RenderResultPacketEncoding::RGB9E5 ? 1.0/511 : 0.0);
+        const QString name = renderResultPacketEncodingToString(encodings[e]);
+        passed &= check(maxErrors[e] <= limit, (name + " max rel err").toLatin1().constData(), maxErrors[e], limit,
+            nameWidth);
+        passed &= check(packetMatches[e], (name + " packets not matching").toLatin1().constData(),
+            packetMatches[e] ? 0 : 1, 0, nameWidth);
+        passed &= check(numAcceptedCorrupt[e] == 0, (name + " corrupt frames accepted").toLatin1().constData(),
+            numAcceptedCorrupt[e], 0, nameWidth);
+        passed &= check(numAcceptedTruncated[e] == 0, (name + " truncated frames accepted").toLatin1().constData(),
+            numAcceptedTruncated[e], 0, nameWidth);
+        passed &= check(numUndetectedTruncatedPackets[e] == 0,
+            (name + " truncated packets accepted").toLatin1().constData(), numUndetectedTruncatedPackets[e], 0,
+            nameWidth);
+    }
+
+    return printCheckResult(passed);
+}
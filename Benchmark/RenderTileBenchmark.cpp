@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <QByteArray>
+#include <QDataStream>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "client/RenderTileScheduler.h"
+#include "clientserver/RenderTile.h"
+#include "clientserver/RenderServerRenderRequest.h"
+#include "clientserver/RenderResultPacket.h"
+#include "clientserver/RenderResultPacketEncoding.h"
+
+namespace
+{
+    struct TileErrors
+    {
+        unsigned int numTiles;
+        unsigned int numUncoveredPixels;
+        unsigned int numOverlappingPixels;
+        unsigned int numTilesOutsideFrame;
+        unsigned int numTilesTooLarge;
+        unsigned int numNonContiguousSamples;
+        unsigned int numWrongRadii;
+        unsigned long long maxSampleDifference;
+    };
+
+    // Tiles the scheduler hands out for a frame, first each tile once and then work units for servers of different
+    // speeds. The tiles of the first round must cover the frame exactly once, every work unit must continue the sample
+    // numbers of its tile with the radii of the full frame reduction, and the tiles must stay within one work unit of
+    // each other.
+    void checkTileScheduler(unsigned int width, unsigned int height, unsigned int numWorkUnits, TileErrors & errors)
+    {
+        const double initialRadius = 0.01;
+        const double ppmAlpha = 2.0/3.0;
+        RenderTileScheduler scheduler;
+        scheduler.reset(width, height, initialRadius);
+        errors.numTiles += scheduler.getNumTiles();
+
+        std::vector<unsigned char> coverage (width*height, 0);
+        std::vector<RenderTile> tiles;
+        std::vector<unsigned long long> numSamples;
+        std::vector<double> radii;
+        const double pixelSamplesPerSecond[] = { 0, 1e6, 3e7, 2e8 };
+        for(unsigned int unit = 0; unit < scheduler.getNumTiles() + numWorkUnits; unit++)
+        {
+            QVector<unsigned long long> sampleNumbers;
+            QVector<double> sampleRadii;
+            RenderTile tile = scheduler.getNextTile(pixelSamplesPerSecond[unit % 4], ppmAlpha, sampleNumbers, sampleRadii);
+            if(!tile.isInsideFrame(width, height) || tile.isFullFrame())
+            {
+                errors.numTilesOutsideFrame++;
+                continue;
+            }
+            if(tile.getWidth() > RenderTileScheduler::TILE_SIZE || tile.getHeight() > RenderTileScheduler::TILE_SIZE)
+            {
+                errors.numTilesTooLarge++;
+            }
+
+            size_t index = std::find(tiles.begin(), tiles.end(), tile) - tiles.begin();
+            if(index == tiles.size())
+            {
+                tiles.push_back(tile);
+                numSamples.push_back(0);
+                radii.push_back(initialRadius);
+            }
+            if(unit < scheduler.getNumTiles())
+            {
+                for(unsigned int y = tile.getY(); y < tile.getY() + tile.getHeight(); y++)
+                {
+                    for(unsigned int x = tile.getX(); x < tile.getX() + tile.getWidth(); x++)
+                    {
+                        coverage[y*width + x]++;
+                    }
+                }
+            }
+
+            for(int i = 0; i < sampleNumbers.size(); i++)
+            {
+                errors.numNonContiguousSamples += sampleNumbers[i] != numSamples[index] ? 1 : 0;
+                errors.numWrongRadii += fabs(sampleRadii[i] - radii[index]) > 1e-12*initialRadius ? 1 : 0;
+                double radiusSq = radii[index]*radii[index];
+                radii[index] = sqrt(radiusSq*(numSamples[index] + ppmAlpha)/(numSamples[index] + 1));
+                numSamples[index]++;
+            }
+        }
+
+        for(size_t i = 0; i < coverage.size(); i++)
+        {
+            errors.numUncoveredPixels += coverage[i] == 0 ? 1 : 0;
+            errors.numOverlappingPixels += coverage[i] > 1 ? 1 : 0;
+        }
+        if(numSamples.size() > 0)
+        {
+            unsigned long long difference = *std::max_element(numSamples.begin(), numSamples.end())
+                - *std::min_element(numSamples.begin(), numSamples.end());
+            errors.maxSampleDifference = std::max(errors.maxSampleDifference, difference);
+        }
+    }
+
+    template<typename T>
+    T roundTrip(const T & value)
+    {
+        QByteArray data;
+        {
+            QDataStream out (&data, QIODevice::WriteOnly);
+            out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+            out << value;
+        }
+        T result;
+        QDataStream in (data);
+        in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+        in >> result;
+        return result;
+    }
+
+    // Tiles through QDataStream on their own, in a render request and in a result packet holding the pixels of the
+    // tile, as they go between client and server
+    unsigned int countTileRoundTripErrors(const std::vector<RenderTile> & tiles)
+    {
+        unsigned int numErrors = 0;
+        QVector<unsigned long long> sampleNumbers;
+        QVector<double> radii;
+        sampleNumbers << 3 << 4;
+        radii << 0.01 << 0.009;
+        for(size_t i = 0; i < tiles.size(); i++)
+        {
+            const RenderTile & tile = tiles[i];
+            numErrors += roundTrip(tile) == tile ? 0 : 1;
+
+            RenderServerRenderRequest request (7, sampleNumbers, radii, RenderServerRenderRequestDetails(), tile);
+            QByteArray requestData;
+            {
+                QDataStream out (&requestData, QIODevice::WriteOnly);
+                out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+                out << request;
+            }
+            RenderServerRenderRequest receivedRequest;
+            {
+                QDataStream in (requestData);
+                in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+                int size;
+                in >> size;
+                in >> receivedRequest;
+            }
+            numErrors += receivedRequest.getTile() == tile && receivedRequest.getIterationNumbers() == sampleNumbers ? 0 : 1;
+
+            QByteArray output (tile.getNumPixels()*3*sizeof(float), Qt::Uninitialized);
+            float* pixels = reinterpret_cast<float*>(output.data());
+            for(unsigned int p = 0; p < tile.getNumPixels()*3; p++)
+            {
+                pixels[p] = float(p % 1000)/1000.f + float(i);
+            }
+            RenderResultPacket packet (7, sampleNumbers, output);
+            packet.setTile(tile);
+            packet.setEncoding(RenderResultPacketEncoding::FLOAT);
+            QByteArray packetData;
+            {
+                QDataStream out (&packetData, QIODevice::WriteOnly);
+                out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+                out << packet;
+            }
+            RenderResultPacket receivedPacket;
+            {
+                QDataStream in (packetData);
+                in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+                quint64 size;
+                in >> size;
+                in >> receivedPacket;
+            }
+            numErrors += receivedPacket.getTile() == tile && receivedPacket.getOutput() == output ? 0 : 1;
+        }
+        return numErrors;
+    }
+}
+
+// Checks of tiled rendering (client/RenderTileScheduler.h, clientserver/RenderTile.h) on frames of several sizes, from
+// smaller than a tile to sizes that are no multiple of it: the tiles cover the frame without overlap and stay inside it,
+// every tile counts its samples and reduces its radius as the full frame does over --units work units, tiles stay
+// within one work unit of each other, and tiles come back from QDataStream on their own, in requests and in result
+// packets. Returns 1 if a check fails.
+int runRenderTileBenchmark( const QStringList & arguments )
+{
+    unsigned int numWorkUnits = 1000;
+    for(int i = 0; i+1 < arguments.size(); i++)
+    {
+        if(arguments[i] == "--units")
+        {
+            numWorkUnits = arguments[i+1].toUInt();
+        }
+        else
+        {
+            continue;
+        }
+        i++;
+    }
+
+    const unsigned int frameSizes[][2] = { { 1, 1 }, { 255, 257 }, { 256, 256 }, { 1024, 768 }, { 1920, 1080 },
+        { 2000, 2000 }, { 4097, 3 } };
+    const int numFrameSizes = sizeof(frameSizes)/sizeof(frameSizes[0]);
+    TileErrors errors = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    std::vector<RenderTile> tiles;
+    for(int i = 0; i < numFrameSizes; i++)
+    {
+        checkTileScheduler(frameSizes[i][0], frameSizes[i][1], numWorkUnits, errors);
+        tiles.push_back(RenderTile(frameSizes[i][0]/3, frameSizes[i][1]/2, frameSizes[i][0] - frameSizes[i][0]/3, 1));
+    }
+    tiles.push_back(RenderTile());
+    tiles.push_back(RenderTile(0, 0, RenderTileScheduler::TILE_SIZE, RenderTileScheduler::TILE_SIZE));
+    unsigned int numRoundTripErrors = countTileRoundTripErrors(tiles);
+
+    printf("Render tiles, %d frame sizes, %u tiles, %u work units each\n", numFrameSizes, errors.numTiles, numWorkUnits);
+    printCheckHeader();
+    bool passed = true;
+    passed &= check(errors.numUncoveredPixels == 0, "pixels not covered by a tile", errors.numUncoveredPixels, 0);
+    passed &= check(errors.numOverlappingPixels == 0, "pixels covered by several tiles", errors.numOverlappingPixels, 0);
+    passed &= check(errors.numTilesOutsideFrame == 0, "tiles not inside the frame", errors.numTilesOutsideFrame, 0);
+    passed &= check(errors.numTilesTooLarge == 0, "tiles larger than TILE_SIZE", errors.numTilesTooLarge, 0);
+    passed &= check(errors.numNonContiguousSamples == 0, "non contiguous sample numbers", errors.numNonContiguousSamples, 0);
+    passed &= check(errors.numWrongRadii == 0, "samples with the wrong radius", errors.numWrongRadii, 0);
+    passed &= check(errors.maxSampleDifference <= RenderTileScheduler::MAX_SAMPLES_PER_WORK_UNIT,
+        "max sample difference of tiles", double(errors.maxSampleDifference), RenderTileScheduler::MAX_SAMPLES_PER_WORK_UNIT);
+    passed &= check(numRoundTripErrors == 0, "tiles not surviving QDataStream", numRoundTripErrors, 0);
+
+    return printCheckResult(passed);
+}
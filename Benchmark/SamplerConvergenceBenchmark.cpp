@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "ComputeDevice.h"
+#include "ComputeDeviceRepository.h"
+#include "renderer/OptixRenderer.h"
+#include "renderer/RenderMethod.h"
+#include "renderer/Sampler.h"
+#include "clientserver/RenderServerRenderRequestDetails.h"
+#include "scene/SceneFactory.h"
+#include "scene/IScene.h"
+
+namespace
+{
+    struct Checkpoint
+    {
+        unsigned long long numIterations;
+        double seconds;
+        double rmse;
+    };
+
+    // Renders iterations 0 to numIterations-1 as a new sequence and returns the RMSE of the mean image against
+    // reference at every power of two iterations. Without a reference the checkpoints only have the time.
+    std::vector<Checkpoint> renderSequence(OptixRenderer & renderer, const RenderServerRenderRequestDetails & details,
+        double initialPPMRadius, unsigned long long numIterations, const std::vector<float> & reference,
+        std::vector<float> & output)
+    {
+        const double PPMAlpha = 2.0/3.0;
+        std::vector<Checkpoint> checkpoints;
+        output.resize(details.getWidth()*details.getHeight()*3);
+        double PPMRadius = initialPPMRadius;
+        double seconds = 0;
+        for(unsigned long long i = 0; i < numIterations; i++)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            renderer.renderNextIteration(i, i, float(PPMRadius), false, details);
+            renderer.getOutputBuffer(&output[0]);
+            seconds += timer.nsecsElapsed()*1e-9;
+            PPMRadius = sqrt(PPMRadius*PPMRadius*(i+PPMAlpha)/double(i+1));
+
+            const unsigned long long n = i + 1;
+            if((n & (n - 1)) == 0 || n == numIterations)
+            {
+                Checkpoint checkpoint;
+                checkpoint.numIterations = n;
+                checkpoint.seconds = seconds;
+                checkpoint.rmse = 0;
+                if(!reference.empty())
+                {
+                    double sumSquares = 0;
+                    for(size_t p = 0; p < output.size(); p++)
+                    {
+                        double difference = output[p]/double(n) - reference[p];
+                        sumSquares += difference*difference;
+                    }
+                    checkpoint.rmse = sqrt(sumSquares/output.size());
+                }
+                checkpoints.push_back(checkpoint);
+            }
+        }
+        return checkpoints;
+    }
+}
+
+// Convergence of the samplers of RandomState.h on the Cornell scenes. The reference image of a scene is the mean of
+// --reference iterations with the random sampler and another seed. Each sampler then renders --iterations iterations
+// from iteration 0, and the RMSE against the reference is printed at powers of two with the render time (including
+// the output readback, which every sampler pays alike). With --target the iterations and seconds each sampler needs
+// to get below that RMSE are printed as well.
+int runSamplerConvergenceBenchmark( const QStringList & arguments )
+{
+    QStringList sceneNames;
+    QString methodName = "pt";
+    unsigned int width = 256;
+    unsigned int height = 256;
+    unsigned long long numIterations = 256;
+    unsigned long long numReferenceIterations = 4096;
+    double targetRmse = 0;
+    unsigned int seed = 1;
+    unsigned int deviceIndex = 0;
+    for(int i = 0; i+1 < arguments.size(); i += 2)
+    {
+        if(arguments[i] == "--scene")
+        {
+            sceneNames << arguments[i+1];
+        }
+        else if(arguments[i] == "--method")
+        {
+            methodName = arguments[i+1];
+        }
+        else if(arguments[i] == "--width")
+        {
+            width = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--height")
+        {
+            height = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--iterations")
+        {
+            numIterations = std::max(1ull, arguments[i+1].toULongLong());
+        }
+        else if(arguments[i] == "--reference")
+        {
+            numReferenceIterations = std::max(1ull, arguments[i+1].toULongLong());
+        }
+        else if(arguments[i] == "--target")
+        {
+            targetRmse = std::max(0.0, arguments[i+1].toDouble());
+        }
+        else if(arguments[i] == "--seed")
+        {
+            seed = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--device")
+        {
+            deviceIndex = arguments[i+1].toUInt();
+        }
+    }
+    if(sceneNames.isEmpty())
+    {
+        sceneNames << "Cornell" << "CornellSmall";
+    }
+
+    RenderMethod::E method;
+    if(methodName == "pt")
+    {
+        method = RenderMethod::PATH_TRACING;
+    }
+    else if(methodName == "vcm")
+    {
+        method = RenderMethod::VCM_BIDIRECTIONAL_PATH_TRACING;
+    }
+    else
+    {
+        printf("Unknown render method %s, the samplers are used by pt and vcm\n", methodName.toLatin1().constData());
+        return 1;
+    }
+
+    std::vector<ComputeDevice> & devices = ComputeDeviceRepository::get().getComputeDevices();
+    if(deviceIndex >= devices.size())
+    {
+        printf("No compute device %u, there are %u\n", deviceIndex, (unsigned int)devices.size());
+        return 1;
+    }
+    const ComputeDevice & device = devices[deviceIndex];
+
+    const Sampler::E samplers[] = { Sampler::RANDOM, Sampler::SOBOL, Sampler::HALTON };
+    const char* samplerNames[] = { "random", "sobol", "halton" };
+    const int numSamplers = sizeof(samplers)/sizeof(Sampler::E);
+
+    SceneFactory sceneFactory;
+    for(int s = 0; s < sceneNames.size(); s++)
+    {
+        IScene* scene = sceneFactory.getSceneByName(sceneNames[s].toUtf8().constData());
+        Camera camera = scene->getDefaultCamera();
+        camera.setAspectRatio(float(width)/float(height));
+        RenderServerRenderRequestDetails details (camera, QByteArray(scene->getSceneName()), method, width, height, 2.0/3.0,
+            PhotonMapStructure::E(DEFAULT_ACCELERATION_STRUCTURE));
+        const double initialPPMRadius = scene->getSceneInitialPPMRadiusEstimate();
+
+        OptixRenderer renderer;
+        renderer.initialize(device);
+        renderer.initScene(*scene);
+
+        printf("%s, %s on %s, %ux%u, reference of %llu iterations\n", scene->getSceneName(), methodName.toLatin1().constData(),
+            device.getName(), width, height, numReferenceIterations);
+
+        std::vector<float> output;
+        std::vector<float> reference;
+        renderer.setRandomSeed(seed + 1);
+        renderer.setSampler(Sampler::RANDOM);
+        renderSequence(renderer, details, initialPPMRadius, numReferenceIterations, reference, output);
+        reference.resize(output.size());
+        for(size_t p = 0; p < output.size(); p++)
+        {
+            reference[p] = output[p]/float(numReferenceIterations);
+        }
+
+        std::vector<std::vector<Checkpoint> > results (numSamplers);
+        renderer.setRandomSeed(seed);
+        for(int i = 0; i < numSamplers; i++)
+        {
+            renderer.setSampler(samplers[i]);
+            results[i] = renderSequence(renderer, details, initialPPMRadius, numIterations, reference, output);
+        }
+
+        printf("%10s", "iterations");
+        for(int i = 0; i < numSamplers; i++)
+        {
+            printf(" %10s %8s", samplerNames[i], "s");
+        }
+        printf("\n");
+        for(size_t c = 0; c < results[0].size(); c++)
+        {
+            printf("%10llu", results[0][c].numIterations);
+            for(int i = 0; i < numSamplers; i++)
+            {
+                printf(" %10.5f %8.2f", results[i][c].rmse, results[i][c].seconds);
+            }
+            printf("\n");
+        }
+
+        if(targetRmse > 0)
+        {
+            for(int i = 0; i < numSamplers; i++)
+            {
+                const std::vector<Checkpoint> & checkpoints = results[i];
+                size_t c = 0;
+                while(c < checkpoints.size() && checkpoints[c].rmse > targetRmse)
+                {
+                    c++;
+                }
+                if(c < checkpoints.size())
+                {
+                    printf("%s reaches RMSE %g in %llu iterations, %.2f s\n", samplerNames[i], targetRmse,
+                        checkpoints[c].numIterations, checkpoints[c].seconds);
+                }
+                else
+                {
+                    printf("%s does not reach RMSE %g in %llu iterations\n", samplerNames[i], targetRmse, numIterations);
+                }
+            }
+        }
+        printf("\n");
+        delete scene;
+    }
+    return 0;
+}
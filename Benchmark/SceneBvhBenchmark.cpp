@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <QElapsedTimer>
+#include "Benchmarks.h"
+#include "scene/HostBvh.h"
+#include "scene/HostSceneGeometry.h"
+#include "scene/Scene.h"
+#include "scene/Cornell.h"
+#include "scene/CornellSmall.h"
+#include "renderer/Camera.h"
+#include "renderer/Light.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+static IScene* loadScene( const QString & name )
+{
+    if(name == "Cornell")
+    {
+        return new Cornell();
+    }
+    else if(name == "CornellSmall")
+    {
+        return new CornellSmall(CornellSmall::Default);
+    }
+    return Scene::createFromFile(name.toUtf8().constData());
+}
+
+namespace
+{
+    struct Ray
+    {
+        float3 origin;
+        float3 direction;
+        float tMax;
+    };
+
+    class TraceRays
+    {
+    public:
+        TraceRays(const HostBvh & bvh, const std::vector<Ray> & rays, bool anyHit, std::vector<HostBvh::Hit> & hits,
+                  std::vector<unsigned char> & isHit)
+            : m_bvh(bvh), m_rays(rays), m_anyHit(anyHit), m_hits(hits), m_isHit(isHit)
+        {
+
+        }
+
+        void operator()(unsigned int from, unsigned int to) const
+        {
+            for(unsigned int i = from; i < to; i++)
+            {
+                const Ray & ray = m_rays[i];
+                if(m_anyHit)
+                {
+                    m_isHit[i] = m_bvh.isOccluded(ray.origin, ray.direction, 0.f, ray.tMax);
+                }
+                else
+                {
+                    m_isHit[i] = m_bvh.intersect(ray.origin, ray.direction, 0.f, ray.tMax, m_hits[i]);
+                }
+            }
+        }
+
+    private:
+        const HostBvh & m_bvh;
+        const std::vector<Ray> & m_rays;
+        bool m_anyHit;
+        std::vector<HostBvh::Hit> & m_hits;
+        std::vector<unsigned char> & m_isHit;
+    };
+
+    // Returns the best time in seconds and the number of rays that hit
+    double traceRays(TaskScheduler & scheduler, const HostBvh & bvh, const std::vector<Ray> & rays, bool anyHit, int repeat,
+        std::vector<HostBvh::Hit> & hits, std::vector<unsigned char> & isHit, unsigned int & numHits)
+    {
+        hits.resize(rays.size());
+        isHit.resize(rays.size());
+        double best = std::numeric_limits<double>::max();
+        QElapsedTimer timer;
+        for(int i = 0; i < repeat; i++)
+        {
+            timer.start();
+            scheduler.parallelFor(0, (unsigned int)rays.size(), 256, TraceRays(bvh, rays, anyHit, hits, isHit));
+            best = std::min(best, timer.nsecsElapsed()*1e-9);
+        }
+        numHits = (unsigned int)std::count(isHit.begin(), isHit.end(), 1);
+        return best;
+    }
+
+    float getRandomFloat(unsigned int & state)
+    {
+        state = state*1664525u + 1013904223u;
+        return float(state >> 8)/float(1 << 24);
+    }
+}
+
+// Builds the host BVH of each scene and traces three sets of rays through it: the primary rays of the default camera
+// (closest hit, coherent), cosine distributed rays from the primary hits (closest hit, incoherent) and shadow rays from
+// the primary hits to the first light (any hit). Scenes other than Cornell and CornellSmall are loaded from file,
+// e.g. the Sponza and Conference scenes.
+int runSceneBvhBenchmark( const QStringList & arguments )
+{
+    QStringList sceneNames;
+    unsigned int width = 1024;
+    unsigned int height = 768;
+    int repeat = 3;
+    for(int i = 0; i+1 < arguments.size(); i += 2)
+    {
+        if(arguments[i] == "--scene")
+        {
+            sceneNames << arguments[i+1];
+        }
+        else if(arguments[i] == "--width")
+        {
+            width = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--height")
+        {
+            height = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--repeat")
+        {
+            repeat = std::max(1, arguments[i+1].toInt());
+        }
+    }
+    if(sceneNames.isEmpty())
+    {
+        sceneNames << "Cornell";
+    }
+
+    TaskScheduler & scheduler = TaskScheduler::get();
+    printf("Host BVH, %ux%u rays per set, best of %d, %u threads\n", width, height, repeat, scheduler.getNumThreads());
+    printf("%-16s %10s %8s %10s %12s %12s %12s %10s\n", "scene", "triangles", "nodes", "build ms", "primary Mr/s",
+        "diffuse Mr/s", "shadow Mr/s", "hit rate");
+
+    for(int s = 0; s < sceneNames.size(); s++)
+    {
+        IScene* scene = loadScene(sceneNames[s]);
+        HostSceneGeometry geometry;
+        scene->getHostSceneGeometry(geometry);
+
+        HostBvh bvh(scheduler);
+        QElapsedTimer timer;
+        timer.start();
+        bvh.build(geometry);
+        double build = timer.nsecsElapsed()*1e-9;
+
+        Camera camera = scene->getDefaultCamera();
+        camera.setAspectRatio(float(width)/float(height));
+        std::vector<Ray> primaryRays(width*height);
+        for(unsigned int y = 0; y < height; y++)
+        {
+            for(unsigned int x = 0; x < width; x++)
+            {
+                float2 d = make_float2((x + 0.5f)/width, (y + 0.5f)/height)*2.f - 1.f;
+                Ray & ray = primaryRays[y*width + x];
+                ray.origin = camera.eye;
+                ray.direction = normalize(d.x*camera.camera_u + d.y*camera.camera_v + camera.lookdir);
+                ray.tMax = std::numeric_limits<float>::max();
+            }
+        }
+
+        std::vector<HostBvh::Hit> hits;
+        std::vector<unsigned char> isHit;
+        unsigned int numPrimaryHits;
+        double primary = traceRays(scheduler, bvh, primaryRays, false, repeat, hits, isHit, numPrimaryHits);
+
+        // Secondary rays start at the primary hits, offset along the geometric normal facing the camera
+        const QVector<float3> & positions = geometry.getPositions();
+        const QVector<int3> & triangles = geometry.getTriangles();
+        const Light* light = scene->getSceneLights().size() > 0 ? &scene->getSceneLights()[0] : NULL;
+        std::vector<Ray> diffuseRays;
+        std::vector<Ray> shadowRays;
+        unsigned int randomState = 1;
+        for(unsigned int i = 0; i < primaryRays.size(); i++)
+        {
+            if(!isHit[i])
+            {
+                continue;
+            }
+            const int3 & triangle = triangles[hits[i].triangle];
+            float3 normal = normalize(cross(positions[triangle.y] - positions[triangle.x], positions[triangle.z] - positions[triangle.x]));
+            normal = dot(normal, primaryRays[i].direction) < 0 ? normal : -normal;
+            float3 position = primaryRays[i].origin + hits[i].t*primaryRays[i].direction + normal*1e-3f*hits[i].t;
+
+            float3 U = fabsf(normal.x) > fabsf(normal.y) ? normalize(make_float3(-normal.z, 0, normal.x)) :
+                normalize(make_float3(0, normal.z, -normal.y));
+            float3 V = cross(normal, U);
+            float phi = 2.f*M_PIf*getRandomFloat(randomState);
+            float r2 = getRandomFloat(randomState);
+            float r = sqrtf(r2);
+            Ray diffuse;
+            diffuse.origin = position;
+            diffuse.direction = normalize(r*cosf(phi)*U + r*sinf(phi)*V + sqrtf(1.f - r2)*normal);
+            diffuse.tMax = std::numeric_limits<float>::max();
+            diffuseRays.push_back(diffuse);
+
+            if(light != NULL)
+            {
+                float3 pointOnLight = light->position;
+                if(light->lightType == Light::AREA)
+                {
+                    pointOnLight += getRandomFloat(randomState)*light->v1 + getRandomFloat(randomState)*light->v2;
+                }
+                Ray shadow;
+                shadow.origin = position;
+                shadow.direction = pointOnLight - position;
+                shadow.tMax = length(shadow.direction)*0.999f;
+                shadow.direction = normalize(shadow.direction);
+                shadowRays.push_back(shadow);
+            }
+        }
+
+        unsigned int numDiffuseHits, numShadowHits;
+        double diffuse = traceRays(scheduler, bvh, diffuseRays, false, repeat, hits, isHit, numDiffuseHits);
+        double shadow = traceRays(scheduler, bvh, shadowRays, true, repeat, hits, isHit, numShadowHits);
+
+        printf("%-16s %10u %8u %10.2f %12.2f %12.2f %12.2f %9.1f%%\n", scene->getSceneName(), bvh.getNumTriangles(),
+            bvh.getNumNodes(), build*1000, primaryRays.size()/primary*1e-6,
+            diffuseRays.empty() ? 0.0 : diffuseRays.size()/diffuse*1e-6,
+            shadowRays.empty() ? 0.0 : shadowRays.size()/shadow*1e-6,
+            100.0*numPrimaryHits/primaryRays.size());
+        delete scene;
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "SyntheticPhotons.h"
+#include <cstring>
+#include <limits>
+
+using namespace optix;
+
+// xorshift32, good enough to scatter benchmark data and identical on every platform
+static inline float nextFloat(unsigned int & state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+static const float3 sphereCenter = make_float3(0.65f, 0.25f, 0.4f);
+static const float sphereRadius = 0.25f;
+
+void generateSyntheticPhotons( std::vector<Photon> & photons, unsigned int numPhotons, float invalidFraction, unsigned int seed )
+{
+    photons.resize(numPhotons);
+    unsigned int state = seed*2654435761u + 1;
+
+    for(unsigned int i = 0; i < numPhotons; i++)
+    {
+        Photon & photon = photons[i];
+        float u = nextFloat(state);
+        float v = nextFloat(state);
+        float w = nextFloat(state);
+        float select = nextFloat(state);
+
+        float3 normal;
+        if(select < 0.15f)
+        {
+            // Sphere
+            float z = 1.0f - 2.0f*u;
+            float r = sqrtf(fmaxf(0.0f, 1.0f - z*z));
+            float phi = 2.0f*M_PIf*v;
+            normal = make_float3(r*cosf(phi), r*sinf(phi), z);
+            photon.position = sphereCenter + sphereRadius*normal;
+        }
+        else
+        {
+            // One of the six walls
+            int wall = (int)(w*6.0f);
+            wall = wall > 5 ? 5 : wall;
+            int axis = wall >> 1;
+            float side = (float)(wall & 1);
+            if(axis == 0)
+            {
+                photon.position = make_float3(side, u, v);
+            }
+            else if(axis == 1)
+            {
+                photon.position = make_float3(u, side, v);
+            }
+            else
+            {
+                photon.position = make_float3(u, v, side);
+            }
+            normal = make_float3(0.0f);
+            (&normal.x)[axis] = side > 0.5f ? -1.0f : 1.0f;
+        }
+
+        photon.rayDirection = -normal;
+        photon.power = nextFloat(state) < invalidFraction ? make_float3(0.0f) : make_float3(0.5f + u, 0.5f + v, 0.5f + w) * 1e-6f;
+        photon.axis = 0;
+#if ENABLE_PARTICIPATING_MEDIA
+        photon.numDeposits = 0;
+#endif
+    }
+}
+
+void generateSyntheticHitpoints( std::vector<Hitpoint> & hitpoints, unsigned int width, unsigned int height )
+{
+    hitpoints.resize(width*height);
+
+    const float3 eye = make_float3(0.5f, 0.5f, 0.02f);
+    const float tanHalfFov = tanf(0.5f*60.0f*M_PIf/180.0f);
+    const float aspect = float(width)/float(height);
+
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            float3 direction = normalize(make_float3(
+                (2.0f*(x + 0.5f)/width - 1.0f)*tanHalfFov*aspect,
+                (1.0f - 2.0f*(y + 0.5f)/height)*tanHalfFov,
+                1.0f));
+
+            // Leave the box through the closest wall
+            float tWall = std::numeric_limits<float>::max();
+            int wallAxis = 0;
+            for(int axis = 0; axis < 3; axis++)
+            {
+                float d = (&direction.x)[axis];
+                float o = (&eye.x)[axis];
+                if(d != 0.0f)
+                {
+                    float t = ((d > 0.0f ? 1.0f : 0.0f) - o)/d;
+                    if(t < tWall)
+                    {
+                        tWall = t;
+                        wallAxis = axis;
+                    }
+                }
+            }
+
+            float3 position = eye + direction*tWall;
+            float3 normal = make_float3(0.0f);
+            (&normal.x)[wallAxis] = (&direction.x)[wallAxis] > 0.0f ? -1.0f : 1.0f;
+
+            // Unless the sphere is in front of it
+            float3 oc = eye - sphereCenter;
+            float b = dot(oc, direction);
+            float discriminant = b*b - (dot(oc, oc) - sphereRadius*sphereRadius);
+            if(discriminant > 0.0f)
+            {
+                float tSphere = -b - sqrtf(discriminant);
+                if(tSphere > 0.0f && tSphere < tWall)
+                {
+                    position = eye + direction*tSphere;
+                    normal = normalize(position - sphereCenter);
+                }
+            }
+
+            Hitpoint & rec = hitpoints[y*width + x];
+            memset(&rec, 0, sizeof(Hitpoint));
+            rec.position = position;
+            rec.normal = normal;
+            rec.attenuation = make_float3(1.0f);
+            rec.flags = PRD_HIT_NON_SPECULAR;
+        }
+    }
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <vector>
+#include <optixu/optixu_math_namespace.h>
+#include "renderer/ppm/Photon.h"
+#include "renderer/Hitpoint.h"
+
+/*
+Deterministic photon distribution resembling a photon map of the Cornell box: photons lie on the walls
+of the unit cube and on a sphere inside it, with a fraction of invalid (zero power) slots like the ones the
+photon pass leaves behind.
+*/
+
+void generateSyntheticPhotons(std::vector<Photon> & photons, unsigned int numPhotons, float invalidFraction = 0.0f, 
+                              unsigned int seed = 1);
+
+/*
+Hitpoints of a width x height pinhole camera looking into the same box from just inside its front wall, in scanline
+order like the output of the ray trace pass. All hitpoints are diffuse with unit attenuation.
+*/
+
+void generateSyntheticHitpoints(std::vector<Hitpoint> & hitpoints, unsigned int width, unsigned int height);
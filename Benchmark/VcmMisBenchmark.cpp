@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "Benchmarks.h"
+#include "BenchmarkChecks.h"
+#include "renderer/RandomState.h"
+#include "renderer/vcm/mis.h"
+
+using namespace optix;
+
+/*
+Host reference of the VCM MIS weights. A path x_0 (on a light) .. x_m (the camera) has the area pdfs lightPdf[i] of
+sampling x_i from the light side and cameraPdf[i] of sampling it from the camera side. It can be built by
+- connection VC_s, s = 0..m: x_0..x_{s-1} from the light, x_s..x_m from the camera, s = m is light tracing and is
+  done once for each of the N light subpaths,
+- merging VM_i, i = 1..m-1: x_i sampled from both sides, eta = nVM*PI*r^2 times more often than VC_i.
+The light and camera subpaths are traced through the MIS updates of the renderer (renderer/vcm/mis.h) on SubpathPRDs,
+the weights are those of renderer/vcm/vcm_shared.h, fed the pdfs the connections and merging of renderer/vcm/vcm.h
+pass them. They are compared with the balance heuristic over all techniques evaluated directly. All cosines and
+distances are 1, so solid angle and area pdfs are the same and the area pdfs of the path are the pdfs of the renderer.
+*/
+
+namespace
+{
+    struct Path
+    {
+        std::vector<float> lightPdf;
+        std::vector<float> cameraPdf;
+        float eta;
+        unsigned int numLightPaths;
+        unsigned int length() const { return (unsigned int)lightPdf.size(); } // m
+    };
+
+    // Pdfs log-uniform in [1/16, 16]
+    float getRandomPdf(RandomState* state)
+    {
+        return powf(2.f, 8.f*getRandomUniformFloat(state) - 4.f);
+    }
+
+    Path createPath(unsigned int length, RandomState* state)
+    {
+        Path path;
+        path.lightPdf.resize(length);
+        path.cameraPdf.resize(length);
+        for(unsigned int i = 0; i < length; i++)
+        {
+            path.lightPdf[i] = getRandomPdf(state);
+            path.cameraPdf[i] = getRandomPdf(state);
+        }
+        path.eta = getRandomPdf(state);
+        path.numLightPaths = 1024;
+        return path;
+    }
+
+    // Brute force: the pdf of every technique, VC_0..VC_m followed by VM_1..VM_{m-1}
+    std::vector<double> getTechniquePdfs(const Path & path)
+    {
+        const unsigned int m = path.length();
+        std::vector<double> pdfs;
+        for(unsigned int s = 0; s <= m; s++)
+        {
+            double pdf = s == m ? path.numLightPaths : 1.0;
+            for(unsigned int j = 0; j < m; j++)
+            {
+                pdf *= j < s ? path.lightPdf[j] : path.cameraPdf[j];
+            }
+            pdfs.push_back(pdf);
+        }
+        for(unsigned int i = 1; i < m; i++)
+        {
+            pdfs.push_back(path.eta*path.lightPdf[i]*pdfs[i]);
+        }
+        return pdfs;
+    }
+
+    // Light subpath emitted from x_0 with the pick and light sample pdf lightPdf[0] (directPdfW as well as the first
+    // factor of emissionPdfW), vertex k sampled with lightPdf[k]. The payload after the hit of x_k, k >= 1.
+    std::vector<SubpathPRD> traceLightSubpath(const Path & path)
+    {
+        Light light;
+        light.isDelta = false;
+        light.isFinite = true;
+        const float misVcWeightFactor = vcmMis(1.f/path.eta);
+        const float misVmWeightFactor = vcmMis(path.eta);
+
+        std::vector<SubpathPRD> vertices (path.length());
+        SubpathPRD prd;
+        initLightMisTerms(prd, light, 1.f, path.lightPdf[0], path.lightPdf[0]*path.lightPdf[1], misVcWeightFactor);
+        updateMisTermsOnHit(prd, 1.f, 1.f);
+        vertices[1] = prd;
+        for(unsigned int k = 2; k < path.length(); k++)
+        {
+            updateMisTermsOnScatter(prd, 1.f, path.lightPdf[k], path.cameraPdf[k-2], misVcWeightFactor,
+                misVmWeightFactor, BxDF::Diffuse);
+            updateMisTermsOnHit(prd, 1.f, 1.f);
+            vertices[k] = prd;
+        }
+        return vertices;
+    }
+
+    // Camera subpath, vertex k sampled with cameraPdf[k], the first one counts the light subpaths light tracing uses.
+    // The payload after the hit of x_k.
+    std::vector<SubpathPRD> traceCameraSubpath(const Path & path)
+    {
+        const unsigned int m = path.length();
+        const float misVcWeightFactor = vcmMis(1.f/path.eta);
+        const float misVmWeightFactor = vcmMis(path.eta);
+
+        std::vector<SubpathPRD> vertices (m);
+        SubpathPRD prd;
+        initCameraMisTerms(prd, path.cameraPdf[m-1], path.numLightPaths);
+        updateMisTermsOnHit(prd, 1.f, 1.f);
+        vertices[m-1] = prd;
+        for(int k = int(m) - 2; k >= 0; k--)
+        {
+            updateMisTermsOnScatter(prd, 1.f, path.cameraPdf[k], k+2 < int(m) ? path.lightPdf[k+2] : 0.f,
+                misVcWeightFactor, misVmWeightFactor, BxDF::Diffuse);
+            updateMisTermsOnHit(prd, 1.f, 1.f);
+            vertices[k] = prd;
+        }
+        return vertices;
+    }
+
+    // The weights of the renderer, in the order of getTechniquePdfs
+    std::vector<double> getRecursiveWeights(const Path & path)
+    {
+        const unsigned int m = path.length();
+        const float misVcWeightFactor = vcmMis(1.f/path.eta);
+        const float misVmWeightFactor = vcmMis(path.eta);
+        std::vector<SubpathPRD> light = traceLightSubpath(path);
+        std::vector<SubpathPRD> camera = traceCameraSubpath(path);
+        std::vector<double> weights;
+
+        // VC_0, camera subpath hits the light (connectLightSourceS0)
+        const float emissionPdfW = path.lightPdf[0]*path.lightPdf[1];
+        weights.push_back(vcmMisWeight(0.f,
+            vcmLightHitPartialMisWeight(path.lightPdf[0], emissionPdfW, camera[0].dVCM, camera[0].dVC)));
+
+        // VC_1, camera subpath connects to the light (connectLightSourceS1)
+        weights.push_back(vcmMisWeight(vcmLightSampleMisWeight(path.cameraPdf[0], path.lightPdf[0]),
+            vcmConnectionPartialMisWeight(emissionPdfW/path.lightPdf[0], camera[1].dVCM, camera[1].dVC,
+            m > 2 ? path.lightPdf[2] : 0.f, misVmWeightFactor)));
+
+        // VC_s, light vertex x_{s-1} connects to camera vertex x_s (connectVertices)
+        for(unsigned int s = 2; s < m; s++)
+        {
+            const float wLight = vcmConnectionPartialMisWeight(path.cameraPdf[s-1], light[s-1].dVCM, light[s-1].dVC,
+                path.cameraPdf[s-2], misVmWeightFactor);
+            const float wCamera = vcmConnectionPartialMisWeight(path.lightPdf[s], camera[s].dVCM, camera[s].dVC,
+                s+1 < m ? path.lightPdf[s+1] : 0.f, misVmWeightFactor);
+            weights.push_back(vcmMisWeight(wLight, wCamera));
+        }
+
+        // VC_m, light tracing (connectCameraT1)
+        weights.push_back(vcmMisWeight(vcmConnectionPartialMisWeight(path.cameraPdf[m-1]/path.numLightPaths,
+            light[m-1].dVCM, light[m-1].dVC, path.cameraPdf[m-2], misVmWeightFactor), 0.f));
+
+        // VM_i (mergeVertices)
+        for(unsigned int i = 1; i < m; i++)
+        {
+            weights.push_back(vcmMergingMisWeight(light[i].dVCM, light[i].dVM, camera[i].dVCM, camera[i].dVM,
+                path.cameraPdf[i-1], i+1 < m ? path.lightPdf[i+1] : 0.f, misVcWeightFactor));
+        }
+        return weights;
+    }
+}
+
+// Compares the recursive VCM MIS weights (connections and merging) with the balance heuristic evaluated over all
+// techniques, on --paths random paths of each length 2..--maxlength. Prints the largest relative error of a weight and
+// of the sum of the weights of a path per length. Returns 1 if a check fails.
+int runVcmMisBenchmark( const QStringList & arguments )
+{
+    unsigned int numPaths = 10000;
+    unsigned int maxLength = 10;
+    unsigned int seed = 1;
+    for(int i = 0; i+1 < arguments.size(); i++)
+    {
+        if(arguments[i] == "--paths")
+        {
+            numPaths = std::max(1u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--maxlength")
+        {
+            maxLength = std::max(2u, arguments[i+1].toUInt());
+        }
+        else if(arguments[i] == "--seed")
+        {
+            seed = arguments[i+1].toUInt();
+        }
+        else
+        {
+            continue;
+        }
+        i++;
+    }
+
+    printf("VCM MIS weights against the balance heuristic, %u paths of each length 2..%u\n", numPaths, maxLength);
+    printf("%-8s %12s %20s %20s\n", "length", "techniques", "max weight error", "max sum error");
+    double maxWeightError = 0, maxSumError = 0;
+    for(unsigned int length = 2; length <= maxLength; length++)
+    {
+        RandomState state = createRandomState(seed, length, 0, RandomStream::CAMERA);
+        double lengthWeightError = 0, lengthSumError = 0;
+        for(unsigned int p = 0; p < numPaths; p++)
+        {
+            Path path = createPath(length, &state);
+            std::vector<double> pdfs = getTechniquePdfs(path);
+            std::vector<double> weights = getRecursiveWeights(path);
+            double sumPdfs = 0, sumWeights = 0;
+            for(size_t t = 0; t < pdfs.size(); t++)
+            {
+                sumPdfs += pdfs[t];
+                sumWeights += weights[t];
+            }
+            for(size_t t = 0; t < pdfs.size(); t++)
+            {
+                double reference = pdfs[t]/sumPdfs;
+                lengthWeightError = std::max(lengthWeightError, fabs(weights[t] - reference)/std::max(reference, 1e-3));
+            }
+            lengthSumError = std::max(lengthSumError, fabs(sumWeights - 1));
+        }
+        printf("%-8u %12u %20.5g %20.5g\n", length, 2*length, lengthWeightError, lengthSumError);
+        maxWeightError = std::max(maxWeightError, lengthWeightError);
+        maxSumError = std::max(maxSumError, lengthSumError);
+    }
+
+    printCheckHeader();
+    bool passed = true;
+    passed &= check(maxWeightError < 1e-3, "max relative weight error", maxWeightError, 1e-3);
+    passed &= check(maxSumError < 1e-4, "max |sum of weights - 1|", maxSumError, 1e-4);
+
+    return printCheckResult(passed);
+}
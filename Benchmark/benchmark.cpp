@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cstdio>
+#include <exception>
+#include <QString>
+#include <QStringList>
+#include "Benchmarks.h"
+
+struct BenchmarkEntry
+{
+    const char* name;
+    const char* description;
+    int (*run)(const QStringList & arguments);
+};
+
+static const BenchmarkEntry benchmarks[] = 
+{
+    { "kdtree", "CPU photon kd-tree build [photons in millions ...] [--repeat N]", runPhotonKdTreeBenchmark },
+    { "gather", "Host photon gather for each acceleration structure [--photons millions] [--width W] [--height H] [--radius R] [--repeat N]", runPhotonGatherBenchmark },
+    { "ppm", "PPM iteration time of a scene for each acceleration structure, needs a CUDA device [--scene name] [--width W] [--height H] [--iterations N] [--warmup N] [--save-photons file] [--trace file]", runPpmIterationBenchmark },
+    { "gridlayout", "Linear vs Morton ordered uniform grid, gather time and simulated cache misses [--dump file] [--photons millions] [--width W] [--height H] [--radius R] [--repeat N]", runPhotonGridLayoutBenchmark },
+    { "packet", "Render result packet encodings, wire size, encode/decode throughput and checks of the error and of corrupt and truncated packets [--width W] [--height H] [--photons millions] [--repeat N]", runRenderResultPacketBenchmark },
+    { "bvh", "Host BVH build time and closest/any hit Mrays/s of primary, diffuse and shadow rays [--scene name ...] [--width W] [--height H] [--repeat N]", runSceneBvhBenchmark },
+    { "render", "Headless render of a scene for N iterations or T seconds, writes the image (.pfm or .ppm) and a JSON report [--scene name] [--method pt|ppm|vcm] [--structure grid|hashgrid|hash|kdtree] [--sampler random|sobol|halton] [--width W] [--height H] [--iterations N] [--seconds T] [--seed S] [--photons N] [--device index] [--image file] [--report file]", runBatchRender },
+    { "rng", "Known answers, statistical checks and throughput of the counter-based random numbers, --device compares them bit by bit with the CUDA device [--indices N] [--dimensions N] [--seed S] [--repeat N] [--device]", runRandomNumberBenchmark },
+    { "convergence", "RMSE against a reference image versus iterations and time for the random, Sobol and Halton samplers [--scene name ...] [--method pt|vcm] [--width W] [--height H] [--iterations N] [--reference N] [--target rmse] [--seed S] [--device index]", runSamplerConvergenceBenchmark },
+    { "radius", "Photons and cells visited per gather of the uniform and hashed grids as the PPM radius shrinks [--photons millions] [--width W] [--height H] [--radius R] [--alpha A] [--iterations N] [--repeat N]", runPhotonRadiusBenchmark },
+    { "lightselect", "Variance of uniform vs power-proportional (alias table) light selection and checks of the alias table [--lights N] [--brightness B] [--receivers N] [--samples N] [--seed S] [--repeat N]", runLightSelectionBenchmark },
+    { "vcmmis", "Checks the recursive VCM MIS weights of connections and merging against the balance heuristic over all techniques [--paths N] [--maxlength N] [--seed S]", runVcmMisBenchmark },
+    { "lightvertex", "Round trip checks, size and pack/unpack throughput of the compact VCM light vertex encoding [--vertices N] [--seed S] [--repeat N]", runLightVertexBenchmark },
+    { "bsdf", "Host BSDF evaluation throughput of the type flag BxDF dispatch used before against the tagged dispatch [--bsdfs N] [--seed S] [--repeat N]", runBsdfDispatchBenchmark },
+    { "photonpacking", "Round trip checks and pack/unpack throughput of the packed photon direction and power [--photons N] [--seed S] [--repeat N]", runPhotonPackingBenchmark },
+    { "rendertile", "Coverage, sample and radius checks of the render tile scheduler and tile round trips through QDataStream [--units N]", runRenderTileBenchmark },
+    { "backbuffer", "Checks of the client PPM back buffer with in order, reversed, shuffled, repeated, non sequential and wrongly sized packets [--iterations N] [--seed S]", runPPMBackBufferBenchmark },
+};
+
+static const int numBenchmarks = sizeof(benchmarks)/sizeof(BenchmarkEntry);
+
+static void printUsage()
+{
+    printf("Usage: Benchmark <name> [arguments]\n\nAvailable benchmarks:\n");
+    for(int i = 0; i < numBenchmarks; i++)
+    {
+        printf("  %-12s %s\n", benchmarks[i].name, benchmarks[i].description);
+    }
+}
+
+int main( int argc, char** argv )
+{
+    if(argc < 2)
+    {
+        printUsage();
+        return 1;
+    }
+
+    QString name = argv[1];
+    QStringList arguments;
+    for(int i = 2; i < argc; i++)
+    {
+        arguments << argv[i];
+    }
+
+    for(int i = 0; i < numBenchmarks; i++)
+    {
+        if(name == benchmarks[i].name)
+        {
+            try
+            {
+                return benchmarks[i].run(arguments);
+            }
+            catch(const std::exception & e)
+            {
+                printf("Benchmark %s failed: %s\n", benchmarks[i].name, e.what());
+                return -1;
+            }
+        }
+    }
+
+    printf("Unknown benchmark: %s\n\n", argv[1]);
+    printUsage();
+    return 1;
+}
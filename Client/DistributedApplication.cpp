@@ -28,6 +28,8 @@ DistributedApplication::DistributedApplication(QApplication & qApplication)
     m_lastSequenceNumber(0),
     m_totalPacketsPending(0),
     m_numPreviewedIterations(0),
+    m_numReceivedIterations(0),
+    m_numEmittedPhotons(0),
     m_totalPacketsPendingLimit(80)
 {
     m_renderResultPacketReceiverThread = new QThread(this);
@@ -46,8 +48,8 @@ DistributedApplication::DistributedApplication(QApplication & qApplication)
     connect(&m_renderResultPacketReceiver, SIGNAL(newFrameReadyForDisplay(const float*, unsigned long long)), 
             this, SLOT(onNewFrameReadyForDisplay(const float*, unsigned long long)));
 
-    connect(&m_renderResultPacketReceiver, SIGNAL(packetReceived(unsigned long long, unsigned int)), 
-        this, SLOT(onPacketReceived(unsigned long long, unsigned int)));
+    connect(&m_renderResultPacketReceiver, SIGNAL(packetReceived(unsigned long long, unsigned int, unsigned long long)), 
+        this, SLOT(onPacketReceived(unsigned long long, unsigned int, unsigned long long)));
 
     setRendererStatus(RendererStatus::RENDERING);
 }
@@ -93,7 +95,10 @@ const RenderServerConnections & DistributedApplication::getServerConnections() c
     return m_serverConnections;
 }
 
-RenderServerRenderRequest DistributedApplication::getNextRenderServerRenderRequest(unsigned int numIterations)
+// The photon budget is the one of the server the request goes to, see RenderServerConnection::updatePhotonBudget
+
+RenderServerRenderRequest DistributedApplication::getNextRenderServerRenderRequest(unsigned int numIterations,
+    unsigned int numEmittedPhotonsPerIteration)
 {
     QVector<unsigned long long> iterationNumbers;
     QVector<double> ppmRadii;
@@ -114,13 +119,49 @@ RenderServerRenderRequest DistributedApplication::getNextRenderServerRenderReque
     }
 
     QByteArray sceneName = QByteArray(getSceneManager().getScene()->getSceneName());
-    RenderServerRenderRequestDetails details (getCamera(), sceneName, getRenderMethod(), getOutputSettingsModel().getWidth(), getOutputSettingsModel().getHeight(), PPMAlpha);
+    RenderServerRenderRequestDetails details (getCamera(), sceneName, getRenderMethod(), getOutputSettingsModel().getWidth(), getOutputSettingsModel().getHeight(), PPMAlpha,
+        getPPMSettingsModel().getPhotonMapStructure());
+    details.setNumEmittedPhotonsPerIteration(numEmittedPhotonsPerIteration);
     RenderServerRenderRequest request (getSequenceNumber(), iterationNumbers, ppmRadii, details);
     m_totalPacketsPending++;
     m_mutex.unlock();
     return request;
 }
 
+bool DistributedApplication::rendersTiles() const
+{
+    return getRenderMethod() == RenderMethod::PATH_TRACING;
+}
+
+// A work unit of tiled rendering: the iteration numbers of the request are the sample numbers within the tile, and
+// the number of samples is sized to the speed of the server (pixel samples per second, 0 if not yet measured)
+
+RenderServerRenderRequest DistributedApplication::getNextRenderServerTileRequest(double serverPixelSamplesPerSecond)
+{
+    QVector<unsigned long long> sampleNumbers;
+    QVector<double> ppmRadii;
+
+    double PPMAlpha = 2.0/3.0;
+    unsigned int width = getOutputSettingsModel().getWidth();
+    unsigned int height = getOutputSettingsModel().getHeight();
+
+    m_mutex.lock();
+
+    if(!m_tileScheduler.isForFrame(width, height))
+    {
+        m_tileScheduler.reset(width, height, getPPMSettingsModel().getPPMInitialRadius());
+    }
+    RenderTile tile = m_tileScheduler.getNextTile(serverPixelSamplesPerSecond, PPMAlpha, sampleNumbers, ppmRadii);
+
+    QByteArray sceneName = QByteArray(getSceneManager().getScene()->getSceneName());
+    RenderServerRenderRequestDetails details (getCamera(), sceneName, getRenderMethod(), width, height, PPMAlpha,
+        getPPMSettingsModel().getPhotonMapStructure());
+    RenderServerRenderRequest request (getSequenceNumber(), sampleNumbers, ppmRadii, details, tile);
+    m_totalPacketsPending++;
+    m_mutex.unlock();
+    return request;
+}
+
 void DistributedApplication::onNewFrameReadyForDisplay(const float*, unsigned long long iterationNumber)
 {
     m_numPreviewedIterations++;
@@ -128,10 +169,13 @@ void DistributedApplication::onNewFrameReadyForDisplay(const float*, unsigned lo
     getRenderStatisticsModel().setCurrentPPMRadius(m_PPMRadius);
     getRenderStatisticsModel().setNumPreviewedIterations(m_numPreviewedIterations);
 
+    // The photon budget differs between the servers, so the photons are those the servers report for the iterations
+    // received so far
     if(getRenderMethod() == RenderMethod::PROGRESSIVE_PHOTON_MAPPING)
     {
-        getRenderStatisticsModel().setNumEmittedPhotonsPerIteration(OptixRenderer::EMITTED_PHOTONS_PER_ITERATION);
-        getRenderStatisticsModel().setNumEmittedPhotons(OptixRenderer::EMITTED_PHOTONS_PER_ITERATION*(iterationNumber+1));
+        getRenderStatisticsModel().setNumEmittedPhotonsPerIteration(m_numReceivedIterations > 0 ? 
+            m_numEmittedPhotons/m_numReceivedIterations : 0);
+        getRenderStatisticsModel().setNumEmittedPhotons(m_numEmittedPhotons);
     }
     else
     {
@@ -146,7 +190,10 @@ void DistributedApplication::onSequenceNumberIncremented()
     m_nextRenderServerRenderRequestIteration = 0;
     m_totalPacketsPending = 0;
     m_numPreviewedIterations = 0;
+    m_numReceivedIterations = 0;
+    m_numEmittedPhotons = 0;
     m_PPMRadius = getPPMSettingsModel().getPPMInitialRadius();
+    m_tileScheduler.reset(getOutputSettingsModel().getWidth(), getOutputSettingsModel().getHeight(), m_PPMRadius);
     m_mutex.unlock();
 }
 
@@ -175,10 +222,16 @@ unsigned int DistributedApplication::getTotalPacketsPending() const
     return m_totalPacketsPending;
 }
 
-void DistributedApplication::onPacketReceived( unsigned long long sequenceNumber, unsigned int numIterations )
+void DistributedApplication::onPacketReceived( unsigned long long sequenceNumber, unsigned int numIterations,
+    unsigned long long numEmittedPhotons )
 {
-    if(sequenceNumber == getSequenceNumber() && m_totalPacketsPending > 0)
+    if(sequenceNumber == getSequenceNumber())
     {
-        m_totalPacketsPending--;
+        m_numReceivedIterations += numIterations;
+        m_numEmittedPhotons += numEmittedPhotons;
+        if(m_totalPacketsPending > 0)
+        {
+            m_totalPacketsPending--;
+        }
     }
 }
@@ -13,6 +13,7 @@
 #include "client/RenderServerConnections.hxx"
 #include "clientserver/RenderServerRenderRequest.h"
 #include "client/RenderResultPacketReceiver.hxx"
+#include "client/RenderTileScheduler.h"
 #include <QMutex>
 
 class QApplication;
@@ -27,7 +28,10 @@ public:
     ~DistributedApplication(void);
     const RenderServerConnections & getServerConnections() const;
     void wait();
-    RenderServerRenderRequest getNextRenderServerRenderRequest(unsigned int numIterations);
+    RenderServerRenderRequest getNextRenderServerRenderRequest(unsigned int numIterations, unsigned int numEmittedPhotonsPerIteration);
+    // Path tracing is rendered in tiles (see RenderTileScheduler), PPM and VCM in full frames
+    bool rendersTiles() const;
+    RenderServerRenderRequest getNextRenderServerTileRequest(double serverPixelSamplesPerSecond);
     bool canIssueNewRenderRequests();
     unsigned int getBackBufferNumIterations();
     unsigned int getTotalPacketsPending() const;
@@ -42,15 +46,18 @@ private slots:
     void onNewServerConnectionSocket(QTcpSocket*);
     void onSequenceNumberIncremented();
     void onNewFrameReadyForDisplay(const float*, unsigned long long);
-    void onPacketReceived(unsigned long long sequenceNumber, unsigned int numIterations);
+    void onPacketReceived(unsigned long long sequenceNumber, unsigned int numIterations, unsigned long long numEmittedPhotons);
 private:
     double m_PPMRadius;
     RenderServerConnections m_serverConnections;
     unsigned long long m_nextRenderServerRenderRequestIteration;
     unsigned long long m_lastSequenceNumber;
     unsigned long long m_numPreviewedIterations;
+    unsigned long long m_numReceivedIterations;
+    unsigned long long m_numEmittedPhotons;
     unsigned long long m_totalPacketsPending;
     unsigned long long m_totalPacketsPendingLimit;
+    RenderTileScheduler m_tileScheduler;
     RenderResultPacketReceiver m_renderResultPacketReceiver;
     QThread* m_renderResultPacketReceiverThread;
     QMutex m_mutex;
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PPMBackBuffer.h"
+#include "util/TaskScheduler.h"
+#include <QtAlgorithms>
+#include <cstring>
+#include <xmmintrin.h>
+
+const unsigned int PPMBackBuffer::MAX_BUFFERS = 8;
+
+PPMBackBuffer::PPMBackBuffer()
+    : m_frontBuffer(NULL),
+      m_frameNumFloats(0),
+      m_nextExpectedIteration(0),
+      m_frontBufferNumIterations(0),
+      m_peakSizeBytes(0),
+      m_numIterations(0),
+      m_numBuffersInUse(0),
+      m_bufferNumFloats(0)
+{
+
+}
+
+PPMBackBuffer::~PPMBackBuffer()
+{
+    while(!m_pendingRunByFirstIteration.isEmpty())
+    {
+        releasePendingRun(m_pendingRunByFirstIteration.begin().value());
+    }
+    deleteBufferPool();
+}
+
+void PPMBackBuffer::reset(float* frontBuffer, unsigned int frameNumFloats)
+{
+    m_frontBuffer = frontBuffer;
+    m_frameNumFloats = frameNumFloats;
+    m_nextExpectedIteration = 0;
+    m_frontBufferNumIterations = 0;
+    while(!m_pendingRunByFirstIteration.isEmpty())
+    {
+        releasePendingRun(m_pendingRunByFirstIteration.begin().value());
+    }
+    m_iterationsAheadInFrontBuffer.clear();
+    if(frameNumFloats != m_bufferNumFloats)
+    {
+        deleteBufferPool();
+    }
+
+    m_mutex.lock();
+    m_numIterations = 0;
+    m_numBuffersInUse = 0;
+    m_bufferNumFloats = frameNumFloats;
+    m_mutex.unlock();
+    m_peakSizeBytes = 0;
+}
+
+bool PPMBackBuffer::addPacket(const float* output, unsigned int numFloats, QVector<unsigned long long> iterationNumbers)
+{
+    if(numFloats != m_frameNumFloats || m_frontBuffer == NULL || iterationNumbers.size() == 0)
+    {
+        return false;
+    }
+    qSort(iterationNumbers);
+    unsigned long long first = iterationNumbers.first();
+    unsigned long long last = iterationNumbers.last();
+    if(!iterationNumbersAreSequential(iterationNumbers) || isAlreadyReceived(first, last))
+    {
+        return false;
+    }
+
+    unsigned int numIterations = iterationNumbers.size();
+    if(first == m_nextExpectedIteration)
+    {
+        // In order: straight into the front buffer, followed by any runs it makes due
+        mergeBufferRunningAverage(output, numIterations, m_frontBuffer, m_frontBufferNumIterations, numFloats);
+        m_frontBufferNumIterations += numIterations;
+        m_nextExpectedIteration = last+1;
+        mergePendingRunsIntoFrontBuffer();
+        return true;
+    }
+
+    // Ahead: continue the run that ends right before or starts right after this packet. Otherwise start a new run,
+    // or pre-combine with the run farthest ahead if the back buffer pool is used up.
+    PendingRun* following = m_pendingRunByFirstIteration.value(last+1);
+    PendingRun* run = m_pendingRunByLastIteration.value(first-1);
+    if(run == NULL)
+    {
+        run = following;
+    }
+    if(run == NULL && m_freeBuffers.isEmpty() && (unsigned int)m_bufferPool.size() < MAX_BUFFERS)
+    {
+        m_bufferPool.append(new float[m_frameNumFloats]);
+        m_freeBuffers.append(m_bufferPool.last());
+    }
+    if(run == NULL && !m_freeBuffers.isEmpty())
+    {
+        run = new PendingRun();
+        run->buffer = m_freeBuffers.last();
+        run->numIterations = 0;
+        m_freeBuffers.pop_back();
+    }
+    if(run == NULL)
+    {
+        run = findFarthestPendingRun();
+    }
+
+    mergeBufferRunningAverage(output, numIterations, run->buffer, run->numIterations, numFloats);
+    run->numIterations += numIterations;
+    addPendingInterval(run, first, last);
+
+    // The packet closed the gap between two runs
+    if(following != NULL && following != run)
+    {
+        mergeBufferRunningAverage(following->buffer, following->numIterations, run->buffer, run->numIterations, numFloats);
+        run->numIterations += following->numIterations;
+        moveIntervalsOfPendingRun(following, run);
+        releasePendingRun(following);
+    }
+
+    updateCounters(numIterations);
+    return true;
+}
+
+// Check if this SORTED input vector consists of sequential iterations, i.e. 0 1 2
+
+bool PPMBackBuffer::iterationNumbersAreSequential(const QVector<unsigned long long> & iterationNumbersSorted)
+{
+    return (iterationNumbersSorted.first() + (unsigned long long)iterationNumbersSorted.size() == iterationNumbersSorted.last() + 1);
+}
+
+namespace
+{
+    // The intervals do not overlap, so only the last one starting at or before last can reach first
+    bool overlapsInterval(const QMap<unsigned long long, unsigned long long> & intervals, unsigned long long first,
+        unsigned long long last)
+    {
+        QMap<unsigned long long, unsigned long long>::const_iterator it = intervals.upperBound(last);
+        if(it == intervals.constBegin())
+        {
+            return false;
+        }
+        --it;
+        return it.value() >= first;
+    }
+}
+
+// A packet sent again after a lost one must not be averaged in twice. The pool holds at most MAX_BUFFERS runs, so
+// looking through each of them is fine.
+
+bool PPMBackBuffer::isAlreadyReceived(unsigned long long first, unsigned long long last) const
+{
+    if(first < m_nextExpectedIteration || overlapsInterval(m_iterationsAheadInFrontBuffer, first, last))
+    {
+        return true;
+    }
+    QHash<unsigned long long, PendingRun*>::const_iterator it;
+    for(it = m_pendingRunByFirstIteration.constBegin(); it != m_pendingRunByFirstIteration.constEnd(); ++it)
+    {
+        if(overlapsInterval(it.value()->intervals, first, last))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Average the runs that are due into the front buffer. Intervals of a pre-combined run other than the due one end up in
+// the front buffer ahead of time, and are skipped when the next expected iteration reaches them.
+
+void PPMBackBuffer::mergePendingRunsIntoFrontBuffer()
+{
+    while(true)
+    {
+        PendingRun* run = m_pendingRunByFirstIteration.value(m_nextExpectedIteration);
+        if(run != NULL)
+        {
+            mergeBufferRunningAverage(run->buffer, run->numIterations, m_frontBuffer, m_frontBufferNumIterations, m_frameNumFloats);
+            m_frontBufferNumIterations += run->numIterations;
+
+            QMap<unsigned long long, unsigned long long>::const_iterator it;
+            for(it = run->intervals.constBegin(); it != run->intervals.constEnd(); ++it)
+            {
+                if(it.key() != m_nextExpectedIteration)
+                {
+                    m_iterationsAheadInFrontBuffer.insert(it.key(), it.value());
+                }
+            }
+            m_nextExpectedIteration = run->intervals.value(m_nextExpectedIteration)+1;
+
+            int numIterations = (int)run->numIterations;
+            releasePendingRun(run);
+            updateCounters(-numIterations);
+        }
+        else if(m_iterationsAheadInFrontBuffer.contains(m_nextExpectedIteration))
+        {
+            m_nextExpectedIteration = m_iterationsAheadInFrontBuffer.take(m_nextExpectedIteration)+1;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+// The pool holds at most MAX_BUFFERS runs, so a linear search is fine
+
+PPMBackBuffer::PendingRun* PPMBackBuffer::findFarthestPendingRun() const
+{
+    PendingRun* farthest = NULL;
+    QHash<unsigned long long, PendingRun*>::const_iterator it;
+    for(it = m_pendingRunByFirstIteration.constBegin(); it != m_pendingRunByFirstIteration.constEnd(); ++it)
+    {
+        if(farthest == NULL || it.value()->intervals.constBegin().key() > farthest->intervals.constBegin().key())
+        {
+            farthest = it.value();
+        }
+    }
+    return farthest;
+}
+
+// Add the interval [first, last] to run, joined with the intervals of the run it touches
+
+void PPMBackBuffer::addPendingInterval(PendingRun* run, unsigned long long first, unsigned long long last)
+{
+    if(first > 0 && m_pendingRunByLastIteration.value(first-1) == run)
+    {
+        QMap<unsigned long long, unsigned long long>::iterator previous = run->intervals.lowerBound(first);
+        --previous;
+        m_pendingRunByLastIteration.remove(first-1);
+        first = previous.key();
+        run->intervals.erase(previous);
+    }
+    if(m_pendingRunByFirstIteration.value(last+1) == run)
+    {
+        m_pendingRunByFirstIteration.remove(last+1);
+        last = run->intervals.take(last+1);
+    }
+    run->intervals.insert(first, last);
+    m_pendingRunByFirstIteration.insert(first, run);
+    m_pendingRunByLastIteration.insert(last, run);
+}
+
+void PPMBackBuffer::moveIntervalsOfPendingRun(PendingRun* from, PendingRun* to)
+{
+    QMap<unsigned long long, unsigned long long> intervals = from->intervals;
+    QMap<unsigned long long, unsigned long long>::const_iterator it;
+    for(it = intervals.constBegin(); it != intervals.constEnd(); ++it)
+    {
+        m_pendingRunByFirstIteration.remove(it.key());
+        m_pendingRunByLastIteration.remove(it.value());
+        from->intervals.remove(it.key());
+        addPendingInterval(to, it.key(), it.value());
+    }
+}
+
+// Unindex the intervals of run and return its buffer to the pool
+
+void PPMBackBuffer::releasePendingRun(PendingRun* run)
+{
+    QMap<unsigned long long, unsigned long long>::const_iterator it;
+    for(it = run->intervals.constBegin(); it != run->intervals.constEnd(); ++it)
+    {
+        m_pendingRunByFirstIteration.remove(it.key());
+        m_pendingRunByLastIteration.remove(it.value());
+    }
+    m_freeBuffers.append(run->buffer);
+    delete run;
+}
+
+// Only called with all runs released, when every buffer of the pool is free
+
+void PPMBackBuffer::deleteBufferPool()
+{
+    for(int i = 0; i < m_bufferPool.size(); i++)
+    {
+        delete[] m_bufferPool.at(i);
+    }
+    m_bufferPool.clear();
+    m_freeBuffers.clear();
+}
+
+void PPMBackBuffer::updateCounters(int numIterationsAdded)
+{
+    m_mutex.lock();
+    m_numIterations += numIterationsAdded;
+    m_numBuffersInUse = m_bufferPool.size() - m_freeBuffers.size();
+    m_mutex.unlock();
+
+    if(getSizeBytes() > m_peakSizeBytes)
+    {
+        m_peakSizeBytes = getSizeBytes();
+    }
+}
+
+unsigned long long PPMBackBuffer::getNextExpectedIteration() const
+{
+    return m_nextExpectedIteration;
+}
+
+unsigned long long PPMBackBuffer::getFrontBufferNumIterations() const
+{
+    return m_frontBufferNumIterations;
+}
+
+unsigned int PPMBackBuffer::getNumIterations()
+{
+    m_mutex.lock();
+    unsigned int numIterations = m_numIterations;
+    m_mutex.unlock();
+    return numIterations;
+}
+
+// The buffers of the runs waiting, each holding one frame
+
+unsigned int PPMBackBuffer::getSizeBytes()
+{
+    m_mutex.lock();
+    unsigned int sizeBytes = m_numBuffersInUse*m_bufferNumFloats*sizeof(float);
+    m_mutex.unlock();
+    return sizeBytes;
+}
+
+unsigned int PPMBackBuffer::getPeakSizeBytes() const
+{
+    return m_peakSizeBytes;
+}
+
+static __inline float average(const float oldf, const float newf, const float newDivSum)
+{
+    return oldf + (newf-oldf)*newDivSum;
+}
+
+namespace
+{
+    const unsigned int RUNNING_AVERAGE_BLOCK_NUM_FLOATS = 16*1024;
+
+    // Running average of the floats of a block range, four floats at a time
+    class RunningAverage
+    {
+    public:
+        RunningAverage(const float* input, float* output, float inputWeight, unsigned int numFloats)
+            : m_input(input),
+              m_output(output),
+              m_inputWeight(inputWeight),
+              m_numFloats(numFloats)
+        {
+
+        }
+        void operator()(unsigned int fromBlock, unsigned int toBlock) const
+        {
+            unsigned int begin = fromBlock*RUNNING_AVERAGE_BLOCK_NUM_FLOATS;
+            unsigned int end = toBlock*RUNNING_AVERAGE_BLOCK_NUM_FLOATS < m_numFloats ? toBlock*RUNNING_AVERAGE_BLOCK_NUM_FLOATS : m_numFloats;
+            __m128 weight = _mm_set1_ps(m_inputWeight);
+            unsigned int i = begin;
+            for(; i + 4 <= end; i += 4)
+            {
+                __m128 out = _mm_loadu_ps(m_output + i);
+                __m128 in = _mm_loadu_ps(m_input + i);
+                _mm_storeu_ps(m_output + i, _mm_add_ps(out, _mm_mul_ps(_mm_sub_ps(in, out), weight)));
+            }
+            for(; i < end; i++)
+            {
+                m_output[i] = average(m_output[i], m_input[i], m_inputWeight);
+            }
+        }
+    private:
+        const float* m_input;
+        float* m_output;
+        float m_inputWeight;
+        unsigned int m_numFloats;
+    };
+}
+
+void mergeBufferRunningAverage( const float* inputBuffer, unsigned long long inputBufferNumIterations, float* outputBuffer,
+                                unsigned long long outputBufferNumIterations, unsigned int numFloats )
+{
+    if(outputBufferNumIterations == 0)
+    {
+        memcpy(outputBuffer, inputBuffer, numFloats*sizeof(float));
+    }
+    else
+    {
+        float inputWeight = float(double(inputBufferNumIterations)/double(outputBufferNumIterations+inputBufferNumIterations));
+        unsigned int numBlocks = (numFloats + RUNNING_AVERAGE_BLOCK_NUM_FLOATS - 1)/RUNNING_AVERAGE_BLOCK_NUM_FLOATS;
+        TaskScheduler::get().parallelFor(0, numBlocks, 1, RunningAverage(inputBuffer, outputBuffer, inputWeight, numFloats));
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QVector>
+#include <QMutex>
+#include <QHash>
+#include <QMap>
+
+/*
+PPM packets must be shown in iteration order, so packets that arrive ahead of the next expected iteration wait in the
+back buffer before they are averaged into the front buffer. The back buffer is a set of runs of iterations, each
+averaged into an accumulation buffer taken from a pool of at most MAX_BUFFERS frames. Runs are indexed by the first and
+last iteration of their intervals, so a packet finds the runs it continues in constant time and is averaged straight
+into them. When the pool is used up, a packet that continues no run is pre-combined into the run that is farthest
+ahead. Such a run holds several intervals and is averaged into the front buffer as soon as the first of them is due;
+its later intervals are then only skipped when the next expected iteration reaches them. Averaging is order
+independent, so the front buffer ends up the same.
+The pool buffers hold one frame of the size given to reset, and are reallocated only when the frame size changes.
+Packets of another size, of non sequential iterations, and repeating iterations that were already received are
+dropped.
+*/
+
+class PPMBackBuffer
+{
+public:
+    PPMBackBuffer();
+    ~PPMBackBuffer();
+    // Start over with the next expected iteration 0, averaging into frontBuffer of frameNumFloats floats
+    void reset(float* frontBuffer, unsigned int frameNumFloats);
+    // Average the output of a packet into the front buffer, or into the back buffer if it is ahead of the next expected
+    // iteration. Returns false if the packet is dropped: its iterations are not sequential, were already received, or
+    // its output is not of the frame size.
+    bool addPacket(const float* output, unsigned int numFloats, QVector<unsigned long long> iterationNumbers);
+    unsigned long long getNextExpectedIteration() const;
+    unsigned long long getFrontBufferNumIterations() const;
+    // The counters may be read from other threads
+    unsigned int getNumIterations();
+    unsigned int getSizeBytes();
+    unsigned int getPeakSizeBytes() const;
+    const static unsigned int MAX_BUFFERS;
+
+private:
+    // A run of iterations waiting in the back buffer, averaged in buffer. Pre-combined runs hold several intervals.
+    struct PendingRun
+    {
+        float* buffer;
+        unsigned long long numIterations;
+        QMap<unsigned long long, unsigned long long> intervals; // first -> last iteration
+    };
+
+    float* m_frontBuffer;
+    unsigned int m_frameNumFloats;
+    unsigned long long m_nextExpectedIteration;
+    unsigned long long m_frontBufferNumIterations;
+    unsigned int m_peakSizeBytes;
+
+    // Only the counters are read from other threads, the runs themselves are owned by the thread adding the packets
+    QMutex m_mutex;
+    unsigned int m_numIterations;
+    unsigned int m_numBuffersInUse;
+    unsigned int m_bufferNumFloats;
+    QVector<float*> m_bufferPool;
+    QVector<float*> m_freeBuffers;
+    QHash<unsigned long long, PendingRun*> m_pendingRunByFirstIteration;
+    QHash<unsigned long long, PendingRun*> m_pendingRunByLastIteration;
+    QMap<unsigned long long, unsigned long long> m_iterationsAheadInFrontBuffer; // first -> last iteration
+
+    static bool iterationNumbersAreSequential(const QVector<unsigned long long> & iterationNumbersSorted);
+    bool isAlreadyReceived(unsigned long long first, unsigned long long last) const;
+    void mergePendingRunsIntoFrontBuffer();
+    PendingRun* findFarthestPendingRun() const;
+    void addPendingInterval(PendingRun* run, unsigned long long first, unsigned long long last);
+    void moveIntervalsOfPendingRun(PendingRun* from, PendingRun* to);
+    void releasePendingRun(PendingRun* run);
+    void deleteBufferPool();
+    void updateCounters(int numIterationsAdded);
+};
+
+// Average inputBuffer of inputBufferNumIterations into outputBuffer of outputBufferNumIterations. Large buffers (full
+// frames) are averaged in blocks on all host threads, a single row of a tile stays on the calling thread.
+void mergeBufferRunningAverage(const float* inputBuffer, unsigned long long inputBufferNumIterations, float* outputBuffer,
+    unsigned long long outputBufferNumIterations, unsigned int numFloats);
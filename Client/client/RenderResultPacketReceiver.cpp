@@ -8,22 +8,27 @@
 #include "RenderServerConnection.hxx"
 #include "DistributedApplication.hxx"
 #include "renderer/OptixRenderer.h"
-#include <QtAlgorithms>
+#include <cstring>
+
+const static unsigned int MAX_FRAME_NUM_FLOATS = 2000*2000*3;
 
 RenderResultPacketReceiver::RenderResultPacketReceiver(const DistributedApplication & application)
     : m_application(application),
-      m_frontBuffer(NULL),
-      m_backBuffer(NULL),
-      m_PPMNextExpectedIteration(0),
+      m_iterationNumber(0),
       m_lastSequenceNumber(0),
-      m_peakBackBufferSizeBytes(0)
+      m_frontBuffer(NULL),
+      m_retiredFrontBuffer(NULL),
+      m_frontBufferCapacity(0),
+      m_frameNumFloats(0),
+      m_numTilePixelSamples(0)
 {
-    m_frontBuffer = new float[2000*2000*3];
+
 }
 
 RenderResultPacketReceiver::~RenderResultPacketReceiver(void)
 {
     delete[] m_frontBuffer;
+    delete[] m_retiredFrontBuffer;
 }
 
 // Take ownership of the RenderResultPacket object and merge in the result into
@@ -35,9 +40,9 @@ void RenderResultPacketReceiver::onRenderResultPacketReceived(RenderResultPacket
 
     if(result->getSequenceNumber() == m_application.getSequenceNumber())
     {
-        if(result->getSequenceNumber() > m_lastSequenceNumber)
+        if(result->getSequenceNumber() > m_lastSequenceNumber || m_frontBuffer == NULL)
         {
-            resetInternals();
+            resetInternals(result);
             m_lastSequenceNumber = result->getSequenceNumber();
         }
 
@@ -46,12 +51,19 @@ void RenderResultPacketReceiver::onRenderResultPacketReceived(RenderResultPacket
             
             mergeRenderResultPacketPhotonMapping(result);
         }
+        else if(!result->getTile().isFullFrame())
+        {
+            mergeRenderResultTile(result);
+        }
         else
         {
             mergeRenderResultPathTracing(result);
         }
 
-        emit newFrameReadyForDisplay(m_frontBuffer, m_iterationNumber);
+        if(m_frameNumFloats > 0)
+        {
+            emit newFrameReadyForDisplay(m_frontBuffer, m_iterationNumber);
+        }
     }
 
     // We take ownership of the result and make sure to delete it
@@ -66,85 +78,20 @@ void RenderResultPacketReceiver::onThreadStarted()
 
 void RenderResultPacketReceiver::mergeRenderResultPacketPhotonMapping(const RenderResultPacket* packet)
 {
-    QVector<unsigned long long> iterationsInPacket = packet->getIterationNumbersInPacket();
-    emit packetReceived(packet->getSequenceNumber(), iterationsInPacket.size());
-    
-    unsigned int numPixels = packet->getOutput().size()/sizeof(float);
-
-    m_backBufferMutex.lock();
-
-    m_backBuffer.append(*packet);
-    qSort(m_backBuffer);
-
-    // Try to combine any two sequential back buffers
-
-    QVector<RenderResultPacket>::iterator it;
-    while(true)
-    {
-        for(it = m_backBuffer.begin(); it < m_backBuffer.end()-1; it++)
-        {
-            if(it->getLastIterationNumber() + 1 == (it+1)->getFirstIterationNumber())
-            {
-                /*printf("%% Merge %d [", it->getFirstIterationNumber());
-                for(int i = 0; i < it->getNumIterationsInPacket(); i++)
-                {
-                    printf("%d ", it->getIterationNumbersInPacket().at(i));
-                }
-
-                printf("] with %d [", (it+1)->getFirstIterationNumber());
-
-                for(int i = 0; i < (it+1)->getNumIterationsInPacket(); i++)
-                {
-                    printf("%d ", (it+1)->getIterationNumbersInPacket().at(i));
-                } 
-                printf("] in backbuffer\n");*/
-
-                it->merge(*(it+1));
-                m_backBuffer.erase(it+1);
-                break;
-            }
-        }
-        if(it == m_backBuffer.end()-1)
-        {
-            break;
-        }
-    }
-
-    if(m_backBuffer.first().getFirstIterationNumber() == m_PPMNextExpectedIteration)
-    {
-        RenderResultPacket backBuffer = m_backBuffer.first();
-        /*printf("Merge backbuffer ", m_backBuffer.size());
-        for(int i = 0; i < backBuffer.getNumIterationsInPacket(); i++)
-        {
-            printf("%d ", backBuffer.getIterationNumbersInPacket().at(i));
-        }*/
-            
-        mergeBufferRunningAverage((const float*)backBuffer.getOutput().constData(), backBuffer.getNumIterationsInPacket(), 
-            m_frontBuffer, m_PPMNextExpectedIteration, numPixels );
-        m_PPMNextExpectedIteration = backBuffer.getLastIterationNumber()+1;
-        m_backBuffer.pop_front();
-        //printf(" into front. Next it: %d", m_PPMNextExpectedIteration);
-    }
-
-    /*printf("\nBackbuffer size: %d, expecting %d\n", m_backBuffer.size(), m_PPMNextExpectedIteration);
-    for(int i = 0; i < m_backBuffer.size(); i++)
-    {
-        printf("   %d: [", i);
-        for(int j= 0; j < m_backBuffer.at(i).getNumIterationsInPacket(); j++)
-        {
-            printf("%d ", m_backBuffer.at(i).getIterationNumbersInPacket().at(j));
-        }
-        printf("]\n");
-    }*/
+    const QVector<unsigned long long> & iterationsInPacket = packet->getIterationNumbersInPacket();
+    emit packetReceived(packet->getSequenceNumber(), iterationsInPacket.size(), packet->getNumEmittedPhotons());
 
-    m_backBufferMutex.unlock();
-
-    if(getBackBufferSizeBytes() > m_peakBackBufferSizeBytes)
+    const float* packetData = (const float*)packet->getOutput().constData();
+    unsigned int numFloats = packet->getOutput().size()/sizeof(float);
+    if(!m_backBuffer.addPacket(packetData, numFloats, iterationsInPacket))
     {
-        m_peakBackBufferSizeBytes = getBackBufferSizeBytes();
+        printf("Dropped PPM packet of %d iterations from %llu, non sequential, already received or of another frame size\n",
+            iterationsInPacket.size(), iterationsInPacket.size() > 0 ? packet->getFirstIterationNumber() : 0);
+        return;
     }
 
-    m_iterationNumber = m_PPMNextExpectedIteration > 0 ? m_PPMNextExpectedIteration-1 : 0;
+    unsigned long long nextExpectedIteration = m_backBuffer.getNextExpectedIteration();
+    m_iterationNumber = nextExpectedIteration > 0 ? nextExpectedIteration-1 : 0;
 }
 
 // In path tracing, we simply control a running average of the frames we have received.
@@ -155,49 +102,42 @@ void RenderResultPacketReceiver::mergeRenderResultPathTracing(const RenderResult
     const QByteArray & packetOutput = result->getOutput();
     float* packetDataFloat = (float*)packetOutput.data();
     unsigned int numElements = packetOutput.size()/sizeof(float);
+    if(numElements != m_frameNumFloats)
+    {
+        return;
+    }
     mergeBufferRunningAverage(packetDataFloat, result->getNumIterationsInPacket(), m_frontBuffer, m_iterationNumber, numElements);
     m_iterationNumber += result->getNumIterationsInPacket();
 }
 
-// 
+// In tiled rendering, each packet is averaged into its tile with the number of iterations the tile has received so far.
+// The iteration number shown is the average number of samples per pixel of the frame.
 
-static __inline float average(const float oldf, const float newf, const float newDivSum)
+void RenderResultPacketReceiver::mergeRenderResultTile(const RenderResultPacket* result )
 {
-    return oldf + (newf-oldf)*newDivSum;
-}
+    emit packetReceived(result->getSequenceNumber(), result->getNumIterationsInPacket(), result->getNumEmittedPhotons());
 
-void RenderResultPacketReceiver::mergeBufferRunningAverage( const float* inputBuffer, unsigned int inputBufferNumIterations, 
-                                                              float* outputBuffer, unsigned int outputBufferNumIterations, 
-                                                              unsigned int numPixels )
-{
-    //printf("\nMerge %d with %d\n", inputBufferNumIterations, outputBufferNumIterations);
-    if(outputBufferNumIterations == 0)
+    const RenderTile & tile = result->getTile();
+    const unsigned int frameWidth = m_application.getWidth();
+    const unsigned int frameHeight = m_application.getHeight();
+    if(frameWidth*frameHeight*3 != m_frameNumFloats || !tile.isInsideFrame(frameWidth, frameHeight)
+        || result->getOutput().size() != int(tile.getNumPixels()*3*sizeof(float)))
     {
-        for(unsigned int i = 0; i < numPixels; i += 3)
-        {
-            outputBuffer[i]   = inputBuffer[i];
-            outputBuffer[i+1] = inputBuffer[i+1];
-            outputBuffer[i+2] = inputBuffer[i+2];
-        }
+        return;
     }
-    else
-    {
-        float newNumIterationsInOutBuffer = float(outputBufferNumIterations+inputBufferNumIterations);
 
-        for(unsigned int i = 0; i < numPixels; i += 3)
-        {
-            outputBuffer[i] = average(outputBuffer[i], inputBuffer[i], inputBufferNumIterations/newNumIterationsInOutBuffer);
-            outputBuffer[i+1] = average(outputBuffer[i+1], inputBuffer[i+1], inputBufferNumIterations/newNumIterationsInOutBuffer);
-            outputBuffer[i+2] = average(outputBuffer[i+2], inputBuffer[i+2], inputBufferNumIterations/newNumIterationsInOutBuffer);
-        }
+    unsigned long long & tileNumIterations = m_tileNumIterations[qMakePair(tile.getX(), tile.getY())];
+    const float* tileData = (const float*)result->getOutput().constData();
+    for(unsigned int y = 0; y < tile.getHeight(); y++)
+    {
+        mergeBufferRunningAverage(tileData + y*tile.getWidth()*3, result->getNumIterationsInPacket(), 
+            m_frontBuffer + ((tile.getY() + y)*frameWidth + tile.getX())*3, tileNumIterations, tile.getWidth()*3);
     }
-}
-
-// Check if this SORTED input vector consists of sequential iterations, i.e. 0 1 2
+    tileNumIterations += result->getNumIterationsInPacket();
 
-bool RenderResultPacketReceiver::iterationNumbersAreSequential(const QVector<unsigned long long> iterationsInPacketSorted )
-{
-    return (iterationsInPacketSorted.first() + (unsigned long long)iterationsInPacketSorted.size() == iterationsInPacketSorted.last() + 1);
+    m_numTilePixelSamples += (unsigned long long)tile.getNumPixels()*result->getNumIterationsInPacket();
+    unsigned long long samplesPerPixel = m_numTilePixelSamples/((unsigned long long)frameWidth*frameHeight);
+    m_iterationNumber = samplesPerPixel > 0 ? samplesPerPixel-1 : 0;
 }
 
 unsigned long long RenderResultPacketReceiver::getIterationNumber() const
@@ -216,39 +156,50 @@ bool RenderResultPacketReceiver::backBufferIsNotFilled()
 
 unsigned int RenderResultPacketReceiver::getBackBufferNumIterations()
 {
-    m_backBufferMutex.lock();
-    unsigned int numIterations = 0;
-    for(int i = 0; i < m_backBuffer.size(); i++)
-    {
-        numIterations += m_backBuffer.at(i).getNumIterationsInPacket();
-    }
-    m_backBufferMutex.unlock();
-    return numIterations;
+    return m_backBuffer.getNumIterations();
 }
 
 unsigned int RenderResultPacketReceiver::getBackBufferSizeBytes()
 {
-    unsigned int sizeBytes = 0;
-    m_backBufferMutex.lock();
-    for(int i = 0; i < m_backBuffer.size(); i++)
-    {
-        sizeBytes += m_backBuffer.at(i).getOutput().size() + sizeof(RenderResultPacket);
-    }
-    m_backBufferMutex.unlock();
-    return sizeBytes;
+    return m_backBuffer.getSizeBytes();
 }
 
 unsigned int RenderResultPacketReceiver::getPeakBackBufferSizeBytes() const
 {
-    return m_peakBackBufferSizeBytes;
+    return m_backBuffer.getPeakSizeBytes();
 }
 
-void RenderResultPacketReceiver::resetInternals()
+// The frame size of a sequence number is that of its first packet: the full frame a packet holds, or the frame of the
+// application for a tile. Frames larger than MAX_FRAME_NUM_FLOATS are dropped.
+
+void RenderResultPacketReceiver::resetInternals(const RenderResultPacket* result)
 {
-    m_PPMNextExpectedIteration = 0;
+    unsigned int numFloats = result->getTile().isFullFrame() ? result->getOutput().size()/sizeof(float)
+        : m_application.getWidth()*m_application.getHeight()*3;
+    resizeFrontBuffer(numFloats <= MAX_FRAME_NUM_FLOATS ? numFloats : 0);
     m_iterationNumber = 0;
-    m_backBufferMutex.lock();
-    m_backBuffer.clear();
-    m_backBufferMutex.unlock();
-    m_peakBackBufferSizeBytes = 0;
+    m_backBuffer.reset(m_frontBuffer, m_frameNumFloats);
+
+    // Tiles are shown as they arrive, so clear the old frame first
+    m_tileNumIterations.clear();
+    m_numTilePixelSamples = 0;
+    if(m_application.rendersTiles())
+    {
+        memset(m_frontBuffer, 0, sizeof(float)*m_frameNumFloats);
+    }
+}
+
+// The front buffer is handed to the GUI thread with every frame, so it only grows, and the buffer it replaces is kept
+// until the next time it grows rather than deleted under a frame the GUI may still be drawing
+
+void RenderResultPacketReceiver::resizeFrontBuffer(unsigned int numFloats)
+{
+    if(numFloats > m_frontBufferCapacity || m_frontBuffer == NULL)
+    {
+        delete[] m_retiredFrontBuffer;
+        m_retiredFrontBuffer = m_frontBuffer;
+        m_frontBuffer = new float[numFloats > 0 ? numFloats : 1];
+        m_frontBufferCapacity = numFloats;
+    }
+    m_frameNumFloats = numFloats;
 }
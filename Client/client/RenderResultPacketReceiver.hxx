@@ -7,13 +7,21 @@
 #pragma once
 #include <QObject>
 #include <QVector>
-#include <QMutex>
+#include <QHash>
+#include <QPair>
+#include "PPMBackBuffer.h"
 
 /*
 This class will receive signals from RenderServerConnections each time the render server has produced a render (given as a 
 RenderResultPacket.
 This class will do the necessary average/merging of the different subcomputations into the final render, and emits a signal
 each time a new frame is ready to be displayed.
+Packets of tiled rendering (path tracing) are averaged into their tile of the frame, every tile keeps its own
+number of iterations.
+
+PPM packets must be shown in iteration order, and wait in the back buffer (PPMBackBuffer.h) until they are due.
+The front buffer is sized for the frame of the first packet of each sequence number, and packets of another frame
+size are dropped.
 */
 
 class RenderResultPacket;
@@ -33,7 +41,7 @@ public:
 
 signals:
     void newFrameReadyForDisplay(const float*, unsigned long long);
-    void packetReceived(unsigned long long sequenceNumber, unsigned int numIterations);
+    void packetReceived(unsigned long long sequenceNumber, unsigned int numIterations, unsigned long long numEmittedPhotons);
 
 public slots:
     void onThreadStarted();
@@ -43,20 +51,19 @@ private:
     const DistributedApplication & m_application;
     unsigned long long m_iterationNumber;
     unsigned long long m_lastSequenceNumber;
-    unsigned long long m_PPMNextExpectedIteration;
-    unsigned int m_peakBackBufferSizeBytes;
     float* m_frontBuffer;
-    void resetInternals();
-    //float* m_backBuffer;
-    //float* m_indirectPowerPerAreaBackBuffer;
-    //QVector<unsigned long long> m_backBufferIterationNumbers;
-    QMutex m_backBufferMutex;
-    QVector<RenderResultPacket> m_backBuffer;
+    float* m_retiredFrontBuffer;
+    unsigned int m_frontBufferCapacity;
+    unsigned int m_frameNumFloats;
+    PPMBackBuffer m_backBuffer;
+    void resetInternals(const RenderResultPacket* result);
+    void resizeFrontBuffer(unsigned int numFloats);
+
+    QHash<QPair<unsigned int, unsigned int>, unsigned long long> m_tileNumIterations;
+    unsigned long long m_numTilePixelSamples;
 
     void mergeRenderResultPathTracing(const RenderResultPacket* result );
+    void mergeRenderResultTile(const RenderResultPacket* result );
     void mergeRenderResultPacketPhotonMapping(const RenderResultPacket* result );
-    void mergeBufferRunningAverage( const float* inputBuffer, unsigned int inputBufferNumIterations, float* outputBuffer, 
-            unsigned int outputBufferNumIterations,  unsigned int numPixels );
-    bool iterationNumbersAreSequential(const QVector<unsigned long long> iterationsInPacketSorted);
 };
 
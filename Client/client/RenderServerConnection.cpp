@@ -7,7 +7,11 @@
 #include "RenderServerConnection.hxx"
 #include "commands/ServerCommand.h"
 #include "commands/GetServerDetailsCommand.h"
+#include "clientserver/RenderResultPacketEncoding.h"
+#include "renderer/OptixRenderer.h"
 #include <QTimer>
+#include <cmath>
+#include <exception>
 
 /*
 A RenderServerConnection represents a connection to a render server. Each RSC lives in its own thread. Thread managing is done by
@@ -27,16 +31,27 @@ RenderServerConnection::RenderServerConnection(DistributedApplication & applicat
     m_currentCommand(NULL),
     m_renderTimeSeconds(0.0f),
     m_computeDeviceName(computeDeviceName),
+    m_renderResultEncoding(RenderResultPacketEncoding::FLOAT),
     m_expectingSizeOfRenderCommandResult(0),
     m_numServerPendingIterations(0),
+    m_numServerPendingRequests(0),
+    m_pendingRequestsLimit(4),
     m_lastRenderCommandSequenceNumber(0),
     m_numSentRenderCommands(0),
     m_numIterationsReceived(0),
     m_bytesReceived(0),
     m_numPacketsReceived(0),
-    m_pendingIterationsLimit(30),
+    m_lastServerRenderTimeSeconds(0),
+    m_averagePacketRenderTime(0),
+    m_averageIterationRenderTime(0),
+    m_averageRequestOverheadTime(0),
+    m_averagePixelSamplesPerSecond(0),
+    m_averageSecondsPerPhoton(0),
+    m_averagePhotonIndependentIterationTime(0),
+    m_numEmittedPhotonsPerIteration(OptixRenderer::EMITTED_PHOTONS_PER_ITERATION),
     m_initialMaxIterationsPerPacket(4),
     m_averageRequestResponseTime(0),
+    m_numConsecutiveCorruptPackets(0),
     m_maxIterationsPerPacket(m_initialMaxIterationsPerPacket)
 {
     m_socketDataStream.setFloatingPointPrecision(QDataStream::SinglePrecision);
@@ -99,43 +114,176 @@ static int max(int a, int b)
 {
     return a > b ? a : b;
 }
+
+static float movingAverage(float average, float sample)
+{
+    return average > 0 ? average + (sample - average)*0.25f : sample;
+}
+
+// Targets of the request pipeline controller, see updateRequestPipeline
+static const float TARGET_PACKET_RENDER_SECONDS = 0.5f;
+static const unsigned int MAX_ITERATIONS_PER_PACKET = 16;
+static const unsigned int MIN_PENDING_REQUESTS = 2;
+static const unsigned int MAX_PENDING_REQUESTS = 16;
+
+// Corrupt packets in a row after which a server is disconnected, see onCorruptRenderCommandResult
+static const unsigned int MAX_CONSECUTIVE_CORRUPT_PACKETS = 3;
+
+// Target of the photon budget controller, see updatePhotonBudget. The photon passes only run in the iterations that
+// trace their photons, the elements of the photon tracing pass are the photons traced.
+static const float TARGET_PPM_ITERATION_SECONDS = 0.1f;
+static const char* const PHOTON_TRACING_PASS_NAME = "PPM photon pass";
+static const char* const PHOTON_PASS_NAMES[] = { "PPM photon pass", "Photon deposit count", "Stochastic hash initialization",
+    "Photon map build" };
+
 void RenderServerConnection::onTimeout()
 {
     if(getRenderServerState() == RenderServerState::NO_DEVICE_INFORMATION)
     {
-        GetServerDetailsCommand* command = new GetServerDetailsCommand();
+        GetServerDetailsCommand* command = new GetServerDetailsCommand(RenderResultPacketEncoding::DEFAULT_ENCODING);
         pushCommandAsync(command);
     }
-    // Keep sending RenderCommands to server until we have reached m_numPendingRenderFrames >= X. 
-    // Always send RenderCommand if we have increased sequence number. The RenderServer can then drop rendering of old frames with old sequenceNumber
+    // Requests are sent as soon as a response arrives, the timer only starts the pipeline and refills it 
+    // if we could not issue new requests at that time
     else
     {
-        bool applicationAndServerRunning = getRenderServerState() == RenderServerState::RENDERING 
-             && m_application.getRunningStatus() == RunningStatus::RUNNING;
+        sendRenderRequests();
+    }
+}
+
+// Keep sending RenderCommands to server until it has m_pendingRequestsLimit requests pending. 
+// Always send RenderCommand if we have increased sequence number. The RenderServer can then drop rendering of old frames with old sequenceNumber
+
+void RenderServerConnection::sendRenderRequests()
+{
+    bool applicationAndServerRunning = getRenderServerState() == RenderServerState::RENDERING 
+         && m_application.getRunningStatus() == RunningStatus::RUNNING;
+
+    if(!applicationAndServerRunning || !m_application.canIssueNewRenderRequests())
+    {
+        return;
+    }
+
+    if(m_application.getSequenceNumber() > m_lastRenderCommandSequenceNumber)
+    {
+        resetInternalStatistics();
+    }
+
+    while(m_numServerPendingRequests < m_pendingRequestsLimit && m_application.canIssueNewRenderRequests())
+    {
+        // In tiled rendering the work unit is sized to the speed of the server by the tile scheduler
+        RenderServerRenderRequest request = m_application.rendersTiles() 
+            ? m_application.getNextRenderServerTileRequest(getPixelSamplesPerSecond())
+            : m_application.getNextRenderServerRenderRequest((unsigned int)max(1, m_maxIterationsPerPacket),
+                m_numEmittedPhotonsPerIteration);
 
-        bool allowSendNewRequest = (m_numServerPendingIterations < m_pendingIterationsLimit || m_application.getSequenceNumber() > m_lastRenderCommandSequenceNumber );
-        if(applicationAndServerRunning && m_application.canIssueNewRenderRequests() && allowSendNewRequest)
+        if(request.getIterationNumbers().size() == 0)
         {
-            if(m_application.getSequenceNumber() > m_lastRenderCommandSequenceNumber)
-            {
-                resetInternalStatistics();
-            }
+            break;
+        }
+        sendRenderRequest(request);
+    }
+}
+
+void RenderServerConnection::sendRenderRequest( const RenderServerRenderRequest & request )
+{
+    m_socketDataStream << request;
+    m_lastRenderCommandSequenceNumber = request.getSequenceNumber();
+    m_numSentRenderCommands++;
 
-            unsigned int numIterationsInRequest = (unsigned int)max(1, m_maxIterationsPerPacket);
-            RenderServerRenderRequest request = m_application.getNextRenderServerRenderRequest(numIterationsInRequest);
+    PendingRenderRequest pending;
+    pending.request = request;
+    pending.sendTimeSeconds = getTotalTimeSeconds();
+    pending.numRequestsAhead = m_numServerPendingRequests;
+    m_pendingRequests.enqueue(pending);
+
+    m_numServerPendingIterations += request.getNumIterations();
+    m_numServerPendingRequests++;
+    emit stateUpdated();
+    m_socket->flush();
+}
 
-            if(request.getIterationNumbers().size() > 0)
+// Adapt the packet size and the number of requests in flight to the server and the connection. 
+// The render time of a packet is the increase of the render time the server reports, and the overhead of a request is the part
+// of its response time not spent rendering it or the requests queued before it on the server (transfer, encoding and waiting).
+// Packets are sized to render in about TARGET_PACKET_RENDER_SECONDS, and we keep enough requests in flight that a request 
+// sent when a response arrives reaches the server before it runs out of work.
+// The estimates are kept when the sequence number changes, since they describe the server rather than the frame.
+
+void RenderServerConnection::updateRequestPipeline( const RenderResultPacket & result, const PendingRenderRequest & request )
+{
+    float packetRenderTime = result.getRenderTimeSeconds() - m_lastServerRenderTimeSeconds;
+    m_lastServerRenderTimeSeconds = result.getRenderTimeSeconds();
+    if(packetRenderTime <= 0 || result.getNumIterationsInPacket() == 0)
+    {
+        return;
+    }
+
+    float responseTime = getTotalTimeSeconds() - request.sendTimeSeconds;
+    float overheadTime = responseTime - (request.numRequestsAhead + 1)*packetRenderTime;
+    unsigned long long pixelSamples = (result.getOutput().size()/(3*sizeof(float)))*(unsigned long long)result.getNumIterationsInPacket();
+
+    m_averagePacketRenderTime = movingAverage(m_averagePacketRenderTime, packetRenderTime);
+    m_averageIterationRenderTime = movingAverage(m_averageIterationRenderTime, packetRenderTime/result.getNumIterationsInPacket());
+    m_averageRequestOverheadTime = movingAverage(m_averageRequestOverheadTime, overheadTime > 0 ? overheadTime : 0.0f);
+    m_averagePixelSamplesPerSecond = movingAverage(m_averagePixelSamplesPerSecond, float(pixelSamples/packetRenderTime));
+
+    int iterationsPerPacket = (int)floorf(TARGET_PACKET_RENDER_SECONDS/m_averageIterationRenderTime + 0.5f);
+    m_maxIterationsPerPacket = (unsigned int)min(max(1, iterationsPerPacket), MAX_ITERATIONS_PER_PACKET);
+
+    int pendingRequests = 1 + (int)ceilf(m_averageRequestOverheadTime/m_averagePacketRenderTime);
+    m_pendingRequestsLimit = (unsigned int)min(max(MIN_PENDING_REQUESTS, pendingRequests), MAX_PENDING_REQUESTS);
+
+    if(result.getNumEmittedPhotons() > 0)
+    {
+        updatePhotonBudget(result, packetRenderTime);
+    }
+}
+
+// Size the photon budget of the PPM iterations so an iteration renders in about TARGET_PPM_ITERATION_SECONDS on this
+// server. Slow servers then trace fewer photons instead of holding up the ordered merge of the PPM iterations on the
+// client. The photon passes of the packet (from its trace summary) take time in proportion to the photons traced, the
+// rest of an iteration (ray tracing, photon map transfer and gathering) does not depend on them. Iterations whose
+// photon maps came from the photon map cache trace no photons, their time is only counted in the rest. Packets without
+// a traced photon are skipped, scaling the budget on them would change the photon map cache key and cause the misses.
+// The budget changes by at most a factor of two per packet and is kept when the sequence number changes.
+
+void RenderServerConnection::updatePhotonBudget( const RenderResultPacket & result, float packetRenderTime )
+{
+    double photonSeconds = 0;
+    unsigned long long numTracedPhotons = 0;
+    const QVector<RenderTraceSummary::Pass> & passes = result.getTraceSummary().getPasses();
+    for(int i = 0; i < passes.size(); i++)
+    {
+        if(passes[i].name == PHOTON_TRACING_PASS_NAME)
+        {
+            numTracedPhotons += passes[i].numElements;
+        }
+        for(size_t j = 0; j < sizeof(PHOTON_PASS_NAMES)/sizeof(PHOTON_PASS_NAMES[0]); j++)
+        {
+            if(passes[i].name == PHOTON_PASS_NAMES[j])
             {
-                m_socketDataStream << request;
-                m_lastRenderCommandSequenceNumber = request.getSequenceNumber();
-                m_numSentRenderCommands++;
-                m_numServerPendingIterations += request.getNumIterations();
-                m_pendingIterationSendTimes[request.getFirstIterationNumber()] = getTotalTimeSeconds();
-                emit stateUpdated();
-                m_socket->flush();
+                photonSeconds += passes[i].seconds;
             }
         }
     }
+    if(numTracedPhotons == 0 || photonSeconds <= 0)
+    {
+        return;
+    }
+
+    float otherSeconds = packetRenderTime - (float)photonSeconds;
+    m_averageSecondsPerPhoton = movingAverage(m_averageSecondsPerPhoton, float(photonSeconds/numTracedPhotons));
+    m_averagePhotonIndependentIterationTime = movingAverage(m_averagePhotonIndependentIterationTime,
+        (otherSeconds > 0 ? otherSeconds : 0.0f)/result.getNumIterationsInPacket());
+
+    float photonTime = TARGET_PPM_ITERATION_SECONDS - m_averagePhotonIndependentIterationTime;
+    float numPhotons = photonTime > 0 ? photonTime/m_averageSecondsPerPhoton : 0.0f;
+    float currentNumPhotons = float(m_numEmittedPhotonsPerIteration);
+    numPhotons = numPhotons < 0.5f*currentNumPhotons ? 0.5f*currentNumPhotons : numPhotons;
+    numPhotons = numPhotons > 2.0f*currentNumPhotons ? 2.0f*currentNumPhotons : numPhotons;
+    m_numEmittedPhotonsPerIteration = OptixRenderer::getEmittedPhotonsPerIteration(
+        numPhotons < float(OptixRenderer::EMITTED_PHOTONS_PER_ITERATION) ? (unsigned int)numPhotons : OptixRenderer::EMITTED_PHOTONS_PER_ITERATION);
 }
 
 void RenderServerConnection::setRenderServerState( RenderServerState::E renderServerState )
@@ -161,67 +309,93 @@ void RenderServerConnection::onSocketReadyRead()
     //qDebug() << "Port: " << m_serverPort << "Got " << m_socket->bytesAvailable() << "bytes!\n";
     if(m_currentCommand != NULL)
     {
+        // Wait for the rest of the response
+        if(!m_currentCommand->isResponseReady(*m_socket))
+        {
+            return;
+        }
         m_expectingSizeOfRenderCommandResult = 0;
         handleCommandResponse();
     }
         
     qint64 bytes_available = m_socket->bytesAvailable();
-    
-    if(bytes_available > 0)
+    bool receivedPacket = false;
+
+    // Digest all packets that have arrived completely
+    while(m_renderServerState == RenderServerState::RENDERING)
     {
-        if(m_renderServerState == RenderServerState::RENDERING)
+        if(m_expectingSizeOfRenderCommandResult == 0)
+        {
+            // Digest the first 64 bits which contain the expected size of the entire packet
+            if(bytes_available < (qint64)sizeof(m_expectingSizeOfRenderCommandResult))
+            {
+                break;
+            }
+            m_socketDataStream >> m_expectingSizeOfRenderCommandResult;
+            bytes_available -= sizeof(m_expectingSizeOfRenderCommandResult);
+        }
+
+        if(bytes_available < (qint64)m_expectingSizeOfRenderCommandResult)
+        {
+            break;
+        }
+
+        // The packet is read off the socket as a whole, so a packet that cannot be decoded is dropped without
+        // losing track of where the next one starts
+        QByteArray packetData = m_socket->read((qint64)m_expectingSizeOfRenderCommandResult);
+        bytes_available -= m_expectingSizeOfRenderCommandResult;
+        m_expectingSizeOfRenderCommandResult = 0;
+        RenderResultPacket* result = this->getArrivedRenderCommandResult(packetData);
+        if(result == NULL)
         {
-            if(m_expectingSizeOfRenderCommandResult == 0)
+            onCorruptRenderCommandResult(packetData);
+            continue;
+        }
+        m_numConsecutiveCorruptPackets = 0;
+
+        unsigned long sequenceNumber = result->getSequenceNumber();
+        int numIterationsInPacket = result->getNumIterationsInPacket();
+        if(result->getSequenceNumber() == m_application.getSequenceNumber())
+        {
+            m_bytesReceived += packetData.size();
+            m_numPacketsReceived += 1;
+            m_numIterationsReceived += result->getNumIterationsInPacket();
+            m_renderTimeSeconds = result->getRenderTimeSeconds();
+            m_traceSummaryMutex.lock();
+            m_lastTraceSummary = result->getTraceSummary();
+            m_traceSummaryMutex.unlock();
+
+            // The server renders the requests in the order we send them
+            if(!m_pendingRequests.isEmpty())
             {
-                // Digest the first 64 bits which contain the expected size of the entire packet
-                m_socketDataStream >> m_expectingSizeOfRenderCommandResult;
-                bytes_available -= sizeof(m_expectingSizeOfRenderCommandResult);
+                PendingRenderRequest request = m_pendingRequests.dequeue();
+                addToAverageRequestResponseTime(getTotalTimeSeconds() - request.sendTimeSeconds);
+                updateRequestPipeline(*result, request);
             }
+            emit renderResultPacketReceived(result);
+            receivedPacket = true;
+        }
+        else
+        {
+            delete result;
+        }
 
-            if(bytes_available >= m_expectingSizeOfRenderCommandResult)
+        if(sequenceNumber == m_application.getSequenceNumber())
+        {
+            m_numServerPendingIterations -= (unsigned int)numIterationsInPacket;
+            if(m_numServerPendingRequests > 0)
             {
-                RenderResultPacket* result = this->getArrivedRenderCommandResult();
-                unsigned long sequenceNumber = result->getSequenceNumber();
-                int numIterationsInPacket = result->getNumIterationsInPacket();
-                if(result->getSequenceNumber() == m_application.getSequenceNumber())
-                {
-                    m_bytesReceived += m_expectingSizeOfRenderCommandResult;
-                    m_numPacketsReceived += 1;
-                    m_numIterationsReceived += result->getNumIterationsInPacket();
-                    m_renderTimeSeconds = result->getRenderTimeSeconds();
-                    float timeSinceIterationSent = getTotalTimeSeconds() - m_pendingIterationSendTimes[result->getFirstIterationNumber()];
-                    addToAverageRequestResponseTime(timeSinceIterationSent);
-                    m_pendingIterationSendTimes.remove(result->getFirstIterationNumber());
-
-                    /*// Increase or decrease max iterations per packet based on performance
-                    if(timeSinceIterationSent > 5.0)
-                    {
-                        if(m_maxIterationsPerPacket < 8)
-                        {
-                            m_maxIterationsPerPacket++;
-                        }
-                    }
-                    else if(m_maxIterationsPerPacket > m_initialMaxIterationsPerPacket)
-                    {
-                        m_maxIterationsPerPacket--;
-                    }*/
-                    emit renderResultPacketReceived(result);
-                }
-                else
-                {
-                    delete result;
-                }
-                
-                m_expectingSizeOfRenderCommandResult = 0;
-
-                if(sequenceNumber == m_application.getSequenceNumber())
-                {
-                    m_numServerPendingIterations -= (unsigned int)numIterationsInPacket;
-                }
+                m_numServerPendingRequests--;
             }
         }
     }
 
+    // Refill the pipeline right away rather than on the next timer tick
+    if(receivedPacket)
+    {
+        sendRenderRequests();
+    }
+
     emit stateUpdated();
     //bytes_available = m_socket->bytesAvailable();
     //printf("\tBytes available after : %d\n", bytes_available);
@@ -240,25 +414,83 @@ void RenderServerConnection::handleCommandResponse()
     // else no pending command
 }
 
-RenderResultPacket* RenderServerConnection::getArrivedRenderCommandResult()
+// Decode a packet that has arrived completely, NULL if it is truncated or its output is corrupt. The decode errors
+// must not leave this slot, nothing on the way to the Qt event loop would catch them.
+
+RenderResultPacket* RenderServerConnection::getArrivedRenderCommandResult( const QByteArray & packetData )
 {
+    QDataStream stream (packetData);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
     RenderResultPacket* result = new RenderResultPacket();
-    m_socketDataStream >> *result;
+    try
+    {
+        stream >> *result;
+    }
+    catch(const std::exception & e)
+    {
+        printf("Dropped a render result packet from %s:%s: %s\n", m_serverIp.toLatin1().constData(),
+            m_serverPort.toLatin1().constData(), e.what());
+        delete result;
+        return NULL;
+    }
+    if(stream.status() != QDataStream::Ok)
+    {
+        printf("Dropped a truncated render result packet from %s:%s\n", m_serverIp.toLatin1().constData(),
+            m_serverPort.toLatin1().constData());
+        delete result;
+        return NULL;
+    }
     return result;
 }
 
+// A corrupt packet of the current sequence is replaced by sending its request again: the server answers the requests
+// in the order they were sent, so it is the oldest pending one. A server that keeps sending corrupt packets is
+// disconnected.
+
+void RenderServerConnection::onCorruptRenderCommandResult( const QByteArray & packetData )
+{
+    m_numConsecutiveCorruptPackets++;
+    if(m_numConsecutiveCorruptPackets >= MAX_CONSECUTIVE_CORRUPT_PACKETS)
+    {
+        printf("Disconnecting %s:%s after %u corrupt render result packets in a row\n", m_serverIp.toLatin1().constData(),
+            m_serverPort.toLatin1().constData(), m_numConsecutiveCorruptPackets);
+        m_socket->abort();
+        setRenderServerState(RenderServerState::ERROR_SOCKET);
+        return;
+    }
+
+    // The sequence number comes first in the packet and is still readable when the output is not
+    quint64 sequenceNumber = 0;
+    QDataStream stream (packetData);
+    stream >> sequenceNumber;
+    if(stream.status() != QDataStream::Ok || sequenceNumber != m_application.getSequenceNumber()
+        || m_pendingRequests.isEmpty())
+    {
+        return;
+    }
+
+    PendingRenderRequest pending = m_pendingRequests.dequeue();
+    m_numServerPendingIterations -= pending.request.getNumIterations();
+    if(m_numServerPendingRequests > 0)
+    {
+        m_numServerPendingRequests--;
+    }
+    sendRenderRequest(pending.request);
+}
+
 void RenderServerConnection::resetInternalStatistics()
 {
     m_numServerPendingIterations = 0;
+    m_numServerPendingRequests = 0;
     m_numIterationsReceived = 0;
     m_numPacketsReceived = 0;
     m_numSentRenderCommands = 0;
     m_bytesReceived = 0;
-    m_maxIterationsPerPacket = m_initialMaxIterationsPerPacket;
     m_totalTime.restart();
     m_renderTimeSeconds = 0;
+    m_lastServerRenderTimeSeconds = 0;
     m_averageRequestResponseTime = 0;
-    //m_pendingIterationSendTimes.clear();
+    m_pendingRequests.clear();
 }
 
 float RenderServerConnection::getRenderTimeSeconds() const
@@ -276,6 +508,12 @@ float RenderServerConnection::getServerEfficiency() const
     return getTotalTimeSeconds() > 0 ? m_renderTimeSeconds/getTotalTimeSeconds() : 0;
 }
 
+RenderTraceSummary RenderServerConnection::getLastTraceSummary() const
+{
+    QMutexLocker lock(&m_traceSummaryMutex);
+    return m_lastTraceSummary;
+}
+
 const QString & RenderServerConnection::getComputeDeviceName() const
 {
     return m_computeDeviceName;
@@ -291,6 +529,16 @@ void RenderServerConnection::setComputeDeviceName( QString name )
     m_computeDeviceName = name;
 }
 
+unsigned int RenderServerConnection::getRenderResultEncoding() const
+{
+    return m_renderResultEncoding;
+}
+
+void RenderServerConnection::setRenderResultEncoding( unsigned int encoding )
+{
+    m_renderResultEncoding = encoding;
+}
+
 unsigned int RenderServerConnection::getNumPendingIterations() const
 {
     return m_numServerPendingIterations;
@@ -336,9 +584,14 @@ unsigned long long RenderServerConnection::getNumIterationsReceived() const
     return m_numIterationsReceived;
 }
 
-unsigned int RenderServerConnection::getPendingIterationsLimit() const
+unsigned int RenderServerConnection::getNumPendingRequests() const
 {
-    return m_pendingIterationsLimit;
+    return m_numServerPendingRequests;
+}
+
+unsigned int RenderServerConnection::getPendingRequestsLimit() const
+{
+    return m_pendingRequestsLimit;
 }
 
 unsigned int RenderServerConnection::getMaxIterationsPerPacket() const
@@ -346,6 +599,11 @@ unsigned int RenderServerConnection::getMaxIterationsPerPacket() const
     return m_maxIterationsPerPacket;
 }
 
+unsigned int RenderServerConnection::getNumEmittedPhotonsPerIteration() const
+{
+    return m_numEmittedPhotonsPerIteration;
+}
+
 void RenderServerConnection::addToAverageRequestResponseTime( float latency )
 {
     m_averageRequestResponseTime = (m_averageRequestResponseTime*(m_numPacketsReceived-1) + latency)/m_numPacketsReceived; 
@@ -355,3 +613,18 @@ float RenderServerConnection::getAverageRequestResponseTime() const
 {
     return m_averageRequestResponseTime;
 }
+
+double RenderServerConnection::getPixelSamplesPerSecond() const
+{
+    return m_averagePixelSamplesPerSecond;
+}
+
+float RenderServerConnection::getAverageIterationRenderTime() const
+{
+    return m_averageIterationRenderTime;
+}
+
+float RenderServerConnection::getAverageRequestOverheadTime() const
+{
+    return m_averageRequestOverheadTime;
+}
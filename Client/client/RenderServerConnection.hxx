@@ -14,7 +14,7 @@
 #include <QMutex>
 #include <QDataStream>
 #include <QTime>
-#include <QMap>
+#include <QQueue>
 
 class ServerCommand;
 class DistributedApplication;
@@ -32,17 +32,28 @@ public:
     const QString getServerPort() const;
     const QString & getComputeDeviceName() const;
     void setComputeDeviceName(QString name);
+    unsigned int getRenderResultEncoding() const;
+    void setRenderResultEncoding(unsigned int encoding);
     const QString getConnectionState() const;
     unsigned long long getNumIterationsReceived() const;
     unsigned long long getBytesReceived() const;
     unsigned long long getNumPacketsReceived() const;
     unsigned int getNumPendingIterations() const;
-    unsigned int getPendingIterationsLimit() const;
+    unsigned int getNumPendingRequests() const;
+    unsigned int getPendingRequestsLimit() const;
     unsigned int getMaxIterationsPerPacket() const;
+    // Photon budget of the PPM iterations requested from the server, see updatePhotonBudget
+    unsigned int getNumEmittedPhotonsPerIteration() const;
     float getRenderTimeSeconds() const;
     float getTotalTimeSeconds() const;
     float getServerEfficiency() const;
     float getAverageRequestResponseTime() const;
+    float getAverageIterationRenderTime() const;
+    float getAverageRequestOverheadTime() const;
+    // Measured speed of the server in pixel samples per second of render time, 0 until the first packet arrives
+    double getPixelSamplesPerSecond() const;
+    // Pass timings the server reported with the last packet of the current sequence
+    RenderTraceSummary getLastTraceSummary() const;
 
     // Send a command and pass ownership of the command object
     void pushCommandAsync( ServerCommand* command );
@@ -69,16 +80,30 @@ private slots:
     void resetInternalStatistics();
 
 private:
+    struct PendingRenderRequest
+    {
+        RenderServerRenderRequest request;
+        float sendTimeSeconds;
+        unsigned int numRequestsAhead;
+    };
+
     void addToAverageRequestResponseTime(float);
+    void sendRenderRequests();
+    void sendRenderRequest(const RenderServerRenderRequest & request);
+    void updateRequestPipeline(const RenderResultPacket & result, const PendingRenderRequest & request);
+    void updatePhotonBudget(const RenderResultPacket & result, float packetRenderTime);
     QTime m_totalTime;
     DistributedApplication & m_application;
-    RenderResultPacket* getArrivedRenderCommandResult();
+    RenderResultPacket* getArrivedRenderCommandResult(const QByteArray & packetData);
+    void onCorruptRenderCommandResult(const QByteArray & packetData);
     void setRenderServerState(RenderServerState::E);
     ServerCommand* m_currentCommand;
-    QMap<unsigned long long, float> m_pendingIterationSendTimes;
+    QQueue<PendingRenderRequest> m_pendingRequests;
     QTcpSocket* m_socket;
     QDataStream m_socketDataStream;
     QMutex q_renderServerStateMutex;
+    mutable QMutex m_traceSummaryMutex;
+    RenderTraceSummary m_lastTraceSummary;
     QString m_serverIp;
     QString m_serverPort;
     RenderServerState::E m_renderServerState;
@@ -88,10 +113,12 @@ private:
     QByteArray receiveBuffer;
     quint64 m_expectingSizeOfRenderCommandResult;
     float m_averageRequestResponseTime;
+    unsigned int m_numConsecutiveCorruptPackets;
     unsigned long long m_numSentRenderCommands;
 
     unsigned int m_numServerPendingIterations;
-    unsigned int m_pendingIterationsLimit;
+    unsigned int m_numServerPendingRequests;
+    unsigned int m_pendingRequestsLimit;
     unsigned int m_maxIterationsPerPacket;
     const unsigned int m_initialMaxIterationsPerPacket;
 
@@ -102,6 +129,15 @@ private:
     unsigned long long m_numPacketsReceived;
 
     float m_renderTimeSeconds;
+    float m_lastServerRenderTimeSeconds;
+    float m_averagePacketRenderTime;
+    float m_averageIterationRenderTime;
+    float m_averageRequestOverheadTime;
+    float m_averagePixelSamplesPerSecond;
+    float m_averageSecondsPerPhoton;
+    float m_averagePhotonIndependentIterationTime;
+    unsigned int m_numEmittedPhotonsPerIteration;
     QString m_computeDeviceName;
+    unsigned int m_renderResultEncoding;
     QTimer* m_sendNewRenderCommandTimer;
 };
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderTileScheduler.h"
+#include <cmath>
+
+const unsigned int RenderTileScheduler::TILE_SIZE = 256;
+const double RenderTileScheduler::WORK_UNIT_SECONDS = 0.25;
+const unsigned int RenderTileScheduler::INITIAL_SAMPLES_PER_WORK_UNIT = 4;
+const unsigned int RenderTileScheduler::MAX_SAMPLES_PER_WORK_UNIT = 64;
+
+RenderTileScheduler::RenderTileScheduler()
+    : m_frameWidth(0),
+      m_frameHeight(0)
+{
+
+}
+
+void RenderTileScheduler::reset( unsigned int frameWidth, unsigned int frameHeight, double initialRadius )
+{
+    m_frameWidth = frameWidth;
+    m_frameHeight = frameHeight;
+    m_tiles.clear();
+    for(unsigned int y = 0; y < frameHeight; y += TILE_SIZE)
+    {
+        for(unsigned int x = 0; x < frameWidth; x += TILE_SIZE)
+        {
+            TileState state;
+            state.tile = RenderTile(x, y, qMin(TILE_SIZE, frameWidth - x), qMin(TILE_SIZE, frameHeight - y));
+            state.numSamples = 0;
+            state.radius = initialRadius;
+            m_tiles.push_back(state);
+        }
+    }
+}
+
+bool RenderTileScheduler::isForFrame( unsigned int frameWidth, unsigned int frameHeight ) const
+{
+    return m_frameWidth == frameWidth && m_frameHeight == frameHeight;
+}
+
+unsigned int RenderTileScheduler::getNumTiles() const
+{
+    return (unsigned int)m_tiles.size();
+}
+
+RenderTile RenderTileScheduler::getNextTile( double pixelSamplesPerSecond, double ppmAlpha, QVector<unsigned long long> & sampleNumbers,
+                                             QVector<double> & radii )
+{
+    if(m_tiles.size() == 0)
+    {
+        return RenderTile();
+    }
+
+    int next = 0;
+    for(int i = 1; i < m_tiles.size(); i++)
+    {
+        if(m_tiles[i].numSamples < m_tiles[next].numSamples)
+        {
+            next = i;
+        }
+    }
+
+    TileState & state = m_tiles[next];
+    unsigned int numSamples = getNumSamplesForWorkUnit(state.tile, pixelSamplesPerSecond);
+    for(unsigned int i = 0; i < numSamples; i++)
+    {
+        sampleNumbers.push_back(state.numSamples);
+        radii.push_back(state.radius);
+
+        double radiusSq = state.radius*state.radius;
+        double radiusSqNew = radiusSq*(state.numSamples+ppmAlpha)/(state.numSamples+1);
+        state.radius = sqrt(radiusSqNew);
+        state.numSamples++;
+    }
+    return state.tile;
+}
+
+unsigned int RenderTileScheduler::getNumSamplesForWorkUnit( const RenderTile & tile, double pixelSamplesPerSecond ) const
+{
+    if(pixelSamplesPerSecond <= 0)
+    {
+        return INITIAL_SAMPLES_PER_WORK_UNIT;
+    }
+    double numSamples = pixelSamplesPerSecond*WORK_UNIT_SECONDS/tile.getNumPixels();
+    return (unsigned int)qBound(1.0, floor(numSamples + 0.5), double(MAX_SAMPLES_PER_WORK_UNIT));
+}
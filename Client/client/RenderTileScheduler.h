@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QVector>
+#include "clientserver/RenderTile.h"
+
+/*
+The RenderTileScheduler hands out the work units of tiled rendering (path tracing). The frame is split into
+tiles of TILE_SIZE x TILE_SIZE pixels, and the next work unit is always the tile that has been given the fewest samples,
+so all tiles converge at the same rate. The number of samples of a work unit is chosen from the measured speed of the
+server it is for, so that every work unit takes about WORK_UNIT_SECONDS on its server: a fast server gets the same tile
+with more samples rather than a larger share of the frame.
+Every tile counts its own samples, and its radius is reduced per sample of the tile the same way the full frame radius
+is reduced per iteration.
+*/
+
+class RenderTileScheduler
+{
+public:
+    RenderTileScheduler();
+    void reset(unsigned int frameWidth, unsigned int frameHeight, double initialRadius);
+    bool isForFrame(unsigned int frameWidth, unsigned int frameHeight) const;
+    unsigned int getNumTiles() const;
+    // Pick the next tile for a server rendering pixelSamplesPerSecond (0 if not yet measured). The sample numbers of the
+    // work unit within the tile and the radius of each sample are appended to sampleNumbers and radii.
+    RenderTile getNextTile(double pixelSamplesPerSecond, double ppmAlpha, QVector<unsigned long long> & sampleNumbers,
+        QVector<double> & radii);
+
+    const static unsigned int TILE_SIZE;
+    const static double WORK_UNIT_SECONDS;
+    const static unsigned int INITIAL_SAMPLES_PER_WORK_UNIT;
+    const static unsigned int MAX_SAMPLES_PER_WORK_UNIT;
+
+private:
+    struct TileState
+    {
+        RenderTile tile;
+        unsigned long long numSamples;
+        double radius;
+    };
+    unsigned int getNumSamplesForWorkUnit(const RenderTile & tile, double pixelSamplesPerSecond) const;
+    unsigned int m_frameWidth;
+    unsigned int m_frameHeight;
+    QVector<TileState> m_tiles;
+};
@@ -7,8 +7,11 @@
 #include "GetServerDetailsCommand.h"
 #include "client/RenderServerConnection.hxx"
 #include <QTcpSocket>
+
+static const int MAX_DEVICE_NAME_LENGTH = 255;
  
-GetServerDetailsCommand::GetServerDetailsCommand()
+GetServerDetailsCommand::GetServerDetailsCommand(unsigned int requestedEncoding)
+    : m_requestedEncoding(requestedEncoding)
 {
 
 }
@@ -21,28 +24,54 @@ GetServerDetailsCommand::~GetServerDetailsCommand(void)
 void GetServerDetailsCommand::executeCommand( QTcpSocket & socket )
 {
     char command[256];
-    sprintf(command, "GET SERVER DETAILS\n");
+    sprintf(command, "GET SERVER DETAILS ENCODING %u\n", m_requestedEncoding);
     QByteArray a(command);
     socket.write(a);
 }
 
+// The response is the device name (a QString: its size in bytes as a quint32, 0xffffffff if null, and the UTF-16
+// characters) followed by the quint32 encoding of the render result packets, which may arrive in several pieces.
+// A name longer than a valid one is not waited for, onResponseReady rejects it.
+
+bool GetServerDetailsCommand::isResponseReady( QTcpSocket & socket ) const
+{
+    QByteArray sizeBytes = socket.peek(sizeof(quint32));
+    if(sizeBytes.size() < (int)sizeof(quint32))
+    {
+        return false;
+    }
+    quint32 nameSize;
+    QDataStream sizeStream(sizeBytes);
+    sizeStream >> nameSize;
+    if(nameSize != 0xffffffff && nameSize > MAX_DEVICE_NAME_LENGTH*sizeof(QChar))
+    {
+        return true;
+    }
+    qint64 responseSize = sizeof(quint32) + (nameSize == 0xffffffff ? 0 : (qint64)nameSize) + sizeof(quint32);
+    return socket.bytesAvailable() >= responseSize;
+}
+
 ServerCommandResult GetServerDetailsCommand::onResponseReady(RenderServerConnection & connection, QTcpSocket & socket )
 {
     QDataStream stream(&socket);
     QString computeDeviceName;
+    quint32 encoding;
     stream >> computeDeviceName;
+    stream >> encoding;
 
     if(stream.status() != QDataStream::Ok)
     {
         printf("In GetServerDetailsCommand::onResponseReady, stream.status() != QDataStream::Ok\n");
+        return ServerCommandResult(false, RenderServerState::ERROR_INVALID_CONFIRMATION);
     }
 
-    if(computeDeviceName.length() < 4 || computeDeviceName.length() > 255)
+    if(computeDeviceName.length() < 4 || computeDeviceName.length() > MAX_DEVICE_NAME_LENGTH)
     {
         return ServerCommandResult(false, RenderServerState::ERROR_INVALID_CONFIRMATION);
     }
 
     connection.setComputeDeviceName(computeDeviceName);
+    connection.setRenderResultEncoding(encoding);
 
     return ServerCommandResult(true, RenderServerState::RENDERING);
 }
@@ -10,10 +10,15 @@
 class GetServerDetailsCommand : public ServerCommand
 {
 public:
-    GetServerDetailsCommand();
+    // Asks the server to encode its render result packets with requestedEncoding (RenderResultPacketEncoding::E)
+    GetServerDetailsCommand(unsigned int requestedEncoding);
     virtual ~GetServerDetailsCommand(void);
     virtual void executeCommand( QTcpSocket & socket);
+    virtual bool isResponseReady(QTcpSocket & socket) const;
     virtual ServerCommandResult onResponseReady(RenderServerConnection & , QTcpSocket & socket);
     virtual RenderServerState::E getInitialRenderServerState() const;
+
+private:
+    unsigned int m_requestedEncoding;
 };
 
@@ -19,6 +19,10 @@ public:
     Execute a command and immediately return. Call onResponseReady() to wait for result.
     */
     virtual void executeCommand(QTcpSocket & m_socket) = 0;
+    /*
+    Whether the whole response has arrived on the socket, onResponseReady() is only called once it has.
+    */
+    virtual bool isResponseReady(QTcpSocket & socket) const = 0;
     virtual ServerCommandResult onResponseReady(RenderServerConnection & connection, QTcpSocket & socket) = 0;
     virtual RenderServerState::E getInitialRenderServerState() const = 0;
 };
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "ConnectedServersTableModel.hxx"
 #include "client/RenderServerConnections.hxx"
 #include "client/RenderServerConnection.hxx"
+#include "clientserver/RenderResultPacketEncoding.h"
 
 ConnectedServersTableModel::ConnectedServersTableModel(QObject* parent, const RenderServerConnections & serverConnections ) :
     QAbstractTableModel(parent), 
@@ -35,7 +36,10 @@ QVariant ConnectedServersTableModel::data( const QModelIndex &index, int role )
         case 5:
             return QString("%1/sec").arg(connection.getNumIterationsReceived()/connection.getTotalTimeSeconds(), 0, 'f', 2);
         case 6:
-            return QString("%1/%2").arg(connection.getNumPendingIterations()).arg(connection.getPendingIterationsLimit());
+            return QString("%1/%2 (%3 it.)")
+                .arg(connection.getNumPendingRequests())
+                .arg(connection.getPendingRequestsLimit())
+                .arg(connection.getNumPendingIterations());
         case 7:
             return QString("%1 %").arg(connection.getServerEfficiency()*100, 0, 'f', 1);
         case 8:
@@ -62,16 +66,35 @@ QVariant ConnectedServersTableModel::data( const QModelIndex &index, int role )
                 QString("%1 MB/packet").arg(connection.getBytesReceived()/float(1024*1024)/float(connection.getNumPacketsReceived()), 0, 'f', 1)
                 : "-";
         case 14:
+            return connection.getAverageIterationRenderTime() > 0 ?
+                QString("%1 ms").arg(connection.getAverageIterationRenderTime()*1000, 0, 'f', 1)
+                : "-";
+        case 15:
+            return connection.getAverageIterationRenderTime() > 0 ?
+                QString("%1 ms").arg(connection.getAverageRequestOverheadTime()*1000, 0, 'f', 1)
+                : "-";
+        case 16:
+            return QString("%1 M").arg(connection.getNumEmittedPhotonsPerIteration()/1E6, 0, 'f', 2);
+        case 17:
+            return renderResultPacketEncodingToString(connection.getRenderResultEncoding());
+        case 18:
             return renderServerStateEnumToString(connection.getRenderServerState());
         }
     }
+    else if(role == Qt::ToolTipRole)
+    {
+        // The pass timings of the server's last packet
+        const RenderServerConnection & connection = m_serverConnections.at(index.row());
+        RenderTraceSummary traceSummary = connection.getLastTraceSummary();
+        return traceSummary.isEmpty() ? QVariant() : QVariant(traceSummary.toString());
+    }
 
     return QVariant();
 }
 
 int ConnectedServersTableModel::columnCount( const QModelIndex &parent ) const
 {
-    return 15;
+    return 19;
 }
 
 int ConnectedServersTableModel::rowCount( const QModelIndex & parent ) const
@@ -101,7 +124,7 @@ QVariant ConnectedServersTableModel::headerData( int section, Qt::Orientation or
     case 3: return "Total Time";
     case 4: return "Iterations";
     case 5: return "Iterations/sec";
-    case 6: return "Pending ";
+    case 6: return "Pending packets";
     case 7: return "Render %";
     case 8: return "Received data";
     case 9: return "MB/second";
@@ -109,7 +132,11 @@ QVariant ConnectedServersTableModel::headerData( int section, Qt::Orientation or
     case 11: return "Avg Req-Resp time";
     case 12: return "Iterations/packet";
     case 13: return "MB/packet";
-    case 14: return "State";
+    case 14: return "Iteration render time";
+    case 15: return "Req-Resp overhead";
+    case 16: return "PPM photons/iteration";
+    case 17: return "Encoding";
+    case 18: return "State";
     }
     return "";
 }
@@ -106,6 +106,7 @@ MainWindowBase::MainWindowBase(Application& application)
 
     connect(&application, SIGNAL(runningStatusChanged()), this, SLOT(onRunningStatusChanged()));
     connect(&application, SIGNAL(renderMethodChanged()), this, SLOT(onRenderMethodChanged()));
+    connect(&application.getPPMSettingsModel(), SIGNAL(updated()), this, SLOT(onRenderMethodChanged()));
     connect(this, SIGNAL(renderRestart()), &m_application, SLOT(onRenderRestart()));
     connect(this, SIGNAL(renderStatusToggle()), &m_application, SLOT(onRenderStatusToggle()));
 
@@ -206,15 +207,20 @@ void MainWindowBase::onRenderMethodChanged()
     else if (rm == RenderMethod::PROGRESSIVE_PHOTON_MAPPING)
     {
         str = "Progressive Photon Mapping";
-        if(ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID)
+        PhotonMapStructure::E photonMapStructure = m_application.getPPMSettingsModel().getPhotonMapStructure();
+        if(photonMapStructure == PhotonMapStructure::UNIFORM_GRID)
         {
             str += " (Sorted uniform grid)";
         }
-        else if(ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU)
+        else if(photonMapStructure == PhotonMapStructure::HASHED_GRID)
+        {
+            str += " (Sparse hashed grid)";
+        }
+        else if(photonMapStructure == PhotonMapStructure::KD_TREE_CPU)
         {
             str += " (CPU k-d tree)";
         }
-        else if(ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH)
+        else if(photonMapStructure == PhotonMapStructure::STOCHASTIC_HASH)
         {
             str += " (Stochastic hash)";
         }
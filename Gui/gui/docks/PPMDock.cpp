@@ -18,6 +18,10 @@ PPMDock::PPMDock(QWidget *parent, const Application & application, PPMSettingsMo
 {
     ui->setupUi(this);
     this->setAllowedAreas(Qt::LeftDockWidgetArea|Qt::RightDockWidgetArea);
+    ui->photonMapStructureCombo->addItem("Sparse hashed grid", int(PhotonMapStructure::HASHED_GRID));
+    ui->photonMapStructureCombo->addItem("Sorted uniform grid", int(PhotonMapStructure::UNIFORM_GRID));
+    ui->photonMapStructureCombo->addItem("Stochastic hash", int(PhotonMapStructure::STOCHASTIC_HASH));
+    ui->photonMapStructureCombo->addItem("CPU k-d tree", int(PhotonMapStructure::KD_TREE_CPU));
     connect(ui->updateSettingsButton, SIGNAL(pressed()), this, SLOT(onFormSubmitted()));
     connect(&PPMSettingsModel, SIGNAL(updated()), this, SLOT(onModelUpdated()));
     connect(&m_application.getRenderStatisticsModel(), SIGNAL(updated()), this, SLOT(onRenderStatisticsUpdated()));
@@ -32,6 +36,8 @@ PPMDock::~PPMDock()
 void PPMDock::onFormSubmitted()
 {
     m_PPMSettingsModel.setPPMInitialRadius(ui->ppmInitialRadiusEdit->value());
+    m_PPMSettingsModel.setPhotonMapStructure(PhotonMapStructure::E(
+        ui->photonMapStructureCombo->itemData(ui->photonMapStructureCombo->currentIndex()).toInt()));
 }
 
 void PPMDock::onRenderStatisticsUpdated()
@@ -53,4 +59,6 @@ void PPMDock::onRenderStatisticsUpdated()
 void PPMDock::onModelUpdated()
 {
     ui->ppmInitialRadiusEdit->setValue(m_PPMSettingsModel.getPPMInitialRadius());
+    ui->photonMapStructureCombo->setCurrentIndex(
+        ui->photonMapStructureCombo->findData(int(m_PPMSettingsModel.getPhotonMapStructure())));
 }
@@ -7,7 +7,8 @@
 #include "PPMSettingsModel.hxx"
 
 PPMSettingsModel::PPMSettingsModel(void)
-    : m_PPMInitialRadius(0.0f)
+    : m_PPMInitialRadius(0.0f),
+      m_photonMapStructure(PhotonMapStructure::E(DEFAULT_ACCELERATION_STRUCTURE))
 {
 }
 
@@ -25,3 +26,14 @@ void PPMSettingsModel::setPPMInitialRadius( double PPMInitialRadius )
     m_PPMInitialRadius = PPMInitialRadius;
     emit updated();
 }
+
+PhotonMapStructure::E PPMSettingsModel::getPhotonMapStructure() const
+{
+    return m_photonMapStructure;
+}
+
+void PPMSettingsModel::setPhotonMapStructure( PhotonMapStructure::E photonMapStructure )
+{
+    m_photonMapStructure = photonMapStructure;
+    emit updated();
+}
@@ -7,6 +7,7 @@
 #pragma once
 #include <QObject>
 #include "gui_export_api.h"
+#include "renderer/ppm/PhotonMapStructure.h"
 class PPMSettingsModel : public QObject
 {
     Q_OBJECT;
@@ -16,11 +17,14 @@ public:
     GUI_EXPORT_API ~PPMSettingsModel(void);
     GUI_EXPORT_API double getPPMInitialRadius() const;
     GUI_EXPORT_API void setPPMInitialRadius(double PPMInitialRadius);
+    GUI_EXPORT_API PhotonMapStructure::E getPhotonMapStructure() const;
+    GUI_EXPORT_API void setPhotonMapStructure(PhotonMapStructure::E photonMapStructure);
 
 signals:
     void updated();
 
 private:
     double m_PPMInitialRadius;
+    PhotonMapStructure::E m_photonMapStructure;
 };
 
@@ -8,10 +8,12 @@
 #include "cuda_runtime_api.h"
 #include <cstring>
 #include <cstdio>
+#include "util/TaskScheduler.h"
 
 ComputeDevice::ComputeDevice()
 {
     m_enabled = true;
+    m_isHost = false;
 }
 
 ComputeDevice ComputeDevice::fromCudaDeviceProperties(const cudaDeviceProp& devProp, int cudaDeviceId )
@@ -48,6 +50,23 @@ ComputeDevice ComputeDevice::fromCudaDeviceProperties(const cudaDeviceProp& devP
     return q;
 }
 
+ComputeDevice ComputeDevice::host()
+{
+    ComputeDevice q;
+    memset(&q, 0, sizeof(ComputeDevice));
+    q.m_enabled = true;
+    q.m_isHost = true;
+    q.m_deviceId = -1;
+    q.m_PCIBusId = -1;
+    q.m_PCIDeviceId = -1;
+    q.m_PCIDomainId = -1;
+    q.m_multiProcessorCount = TaskScheduler::get().getNumThreads();
+    q.m_maxThreadsPerMultiProcessor = 1;
+    strncpy_s(q.m_name, "Host CPU", 95);
+    strncpy_s(q.m_computeCapability, "CPU", 4);
+    return q;
+}
+
 unsigned int ComputeDevice::getGlobalMemoryKB()  const
 {
     return m_globalMemoryKB;
@@ -192,3 +211,8 @@ bool ComputeDevice::getUnifiedAddressing() const
 {
     return m_unifiedAddressing;
 }
+
+bool ComputeDevice::isHost() const
+{
+    return m_isHost;
+}
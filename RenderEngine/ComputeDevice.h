@@ -14,6 +14,9 @@ class ComputeDevice
 public:
     ComputeDevice();
     static ComputeDevice fromCudaDeviceProperties(const cudaDeviceProp& devProp, int );
+    // The CPU of this machine, rendering path tracing with all host threads (HostPathTracer)
+    static ComputeDevice host();
+    RENDER_ENGINE_EXPORT_API bool isHost() const;
     RENDER_ENGINE_EXPORT_API unsigned int getGlobalMemoryKB() const;
     RENDER_ENGINE_EXPORT_API unsigned int getConstantMemoryKB() const;
     RENDER_ENGINE_EXPORT_API unsigned int getMemoryClockFrequencyKHz() const;
@@ -73,4 +76,5 @@ private:
     bool m_unifiedAddressing;
     char m_name[100];
     char m_computeCapability[5];
+    bool m_isHost;
 };
\ No newline at end of file
@@ -20,6 +20,9 @@ ComputeDeviceRepository::ComputeDeviceRepository(void)
         ComputeDevice device = ComputeDevice::fromCudaDeviceProperties(devProp, i);
         this->m_computeDevices.push_back(device);
     }
+
+    // The host device comes last so a CUDA device is the default wherever one exists
+    this->m_computeDevices.push_back(ComputeDevice::host());
 }
 
 ComputeDeviceRepository::~ComputeDeviceRepository(void)
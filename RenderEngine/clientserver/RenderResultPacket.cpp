@@ -5,10 +5,13 @@
 */
 
 #include "RenderResultPacket.h"
+#include "RenderResultPacketEncoding.h"
 #include <QDataStream>
 #include <QVector>
 
 RenderResultPacket::RenderResultPacket()
+    : m_encoding(RenderResultPacketEncoding::FLOAT),
+      m_numEmittedPhotons(0)
 {
 
 }
@@ -20,7 +23,9 @@ RenderResultPacket::RenderResultPacket(unsigned long long sequenceNumber, QVecto
     m_iterationNumbersInPacket(iterationNumbersInPacket),
     m_output(output),
     m_renderTimeSeconds(0),
-    m_totalTimeSeconds(0)
+    m_totalTimeSeconds(0),
+    m_encoding(RenderResultPacketEncoding::FLOAT),
+    m_numEmittedPhotons(0)
 {
 
 }
@@ -60,6 +65,46 @@ const QByteArray & RenderResultPacket::getOutput() const
     return m_output;
 }
 
+unsigned int RenderResultPacket::getEncoding() const
+{
+    return m_encoding;
+}
+
+void RenderResultPacket::setEncoding( unsigned int encoding )
+{
+    m_encoding = encoding;
+}
+
+const RenderTile & RenderResultPacket::getTile() const
+{
+    return m_tile;
+}
+
+void RenderResultPacket::setTile( const RenderTile & tile )
+{
+    m_tile = tile;
+}
+
+const RenderTraceSummary & RenderResultPacket::getTraceSummary() const
+{
+    return m_traceSummary;
+}
+
+void RenderResultPacket::setTraceSummary( const RenderTraceSummary & traceSummary )
+{
+    m_traceSummary = traceSummary;
+}
+
+unsigned long long RenderResultPacket::getNumEmittedPhotons() const
+{
+    return m_numEmittedPhotons;
+}
+
+void RenderResultPacket::setNumEmittedPhotons( unsigned long long numEmittedPhotons )
+{
+    m_numEmittedPhotons = numEmittedPhotons;
+}
+
 // Return a list of iteration numbers in packet which is sorted
 const QVector<unsigned long long> & RenderResultPacket::getIterationNumbersInPacket() const
 {
@@ -86,7 +131,7 @@ unsigned long long RenderResultPacket::getLastIterationNumber() const
     return m_iterationNumbersInPacket.last();
 }
 
-// Merge other into this render result packet
+// Merge other into this render result packet, both must hold the same tile
 
 void RenderResultPacket::merge( const RenderResultPacket & other )
 {
@@ -103,29 +148,40 @@ void RenderResultPacket::merge( const RenderResultPacket & other )
         outputData[i+2] = (thisIterations*outputData[i+2] + otherIterations*inputData[i+2]) * scale;
     }
     m_iterationNumbersInPacket += other.getIterationNumbersInPacket();
+    m_traceSummary.merge(other.getTraceSummary());
+    m_numEmittedPhotons += other.getNumEmittedPhotons();
 }
 
 QDataStream & operator<<( QDataStream & out, const RenderResultPacket & results )
 {
-    QByteArray output = results.getOutput();
+    QByteArray output = encodeRenderResultOutput(results.getOutput(), results.getEncoding());
     QVector<unsigned long long> iterationNumbersInPacket = results.getIterationNumbersInPacket();
     qSort(iterationNumbersInPacket);
 
+    QByteArray traceSummary;
+    QDataStream traceSummaryStream(&traceSummary, QIODevice::WriteOnly);
+    traceSummaryStream << results.getTraceSummary();
+
     // Send size of packet as the first 64 bits so that receiver knows how much data to expect
     // The size of the different values are listed in http://qt-project.org/doc/qt-4.8/datastreamformat.html
 
     quint64 sizeOutputBuffer = (quint64)(output.size() + sizeof(quint32));
     quint64 sizeIterationNumbersInPacketVector = (quint64)(iterationNumbersInPacket.size()*sizeof(unsigned long long) + sizeof(quint32));
 
-    quint64 size = sizeOutputBuffer + sizeIterationNumbersInPacketVector;
-    size += (quint64)sizeof(quint64) + 2*(quint64)sizeof(float);
+    quint64 sizeTraceSummary = (quint64)(traceSummary.size() + sizeof(quint32));
+
+    quint64 size = sizeOutputBuffer + sizeIterationNumbersInPacketVector + sizeTraceSummary;
+    size += 2*(quint64)sizeof(quint64) + 2*(quint64)sizeof(float) + 4*(quint64)sizeof(quint32);
 
     out << size 
         << (quint64)results.getSequenceNumber()
         << iterationNumbersInPacket
         << results.getRenderTimeSeconds() 
         << results.getTotalTimeSeconds()
-        << output;
+        << results.getTile()
+        << output
+        << traceSummary
+        << (quint64)results.getNumEmittedPhotons();
     return out;
 }
 
@@ -136,15 +192,28 @@ QDataStream & operator>>( QDataStream & in, RenderResultPacket & results )
     QByteArray output;
     float renderTimeSeconds;
     float totalTimeSeconds;
+    RenderTile tile;
+    QByteArray traceSummaryData;
+    quint64 numEmittedPhotons;
 
     in >> (quint64)sequenceNumber;
     in >> iterationNumbersInPacket;
     in >> renderTimeSeconds;
     in >> totalTimeSeconds;
+    in >> tile;
     in >> output;
+    in >> traceSummaryData;
+    in >> numEmittedPhotons;
+
+    RenderTraceSummary traceSummary;
+    QDataStream traceSummaryStream(traceSummaryData);
+    traceSummaryStream >> traceSummary;
     
-    results = RenderResultPacket(sequenceNumber, iterationNumbersInPacket, output);
+    results = RenderResultPacket(sequenceNumber, iterationNumbersInPacket, decodeRenderResultOutput(output));
     results.setRenderTimeSeconds(renderTimeSeconds);
     results.setTotalTimeSeconds(totalTimeSeconds);
+    results.setTile(tile);
+    results.setTraceSummary(traceSummary);
+    results.setNumEmittedPhotons(numEmittedPhotons);
     return in;
 }
@@ -8,11 +8,18 @@
 #include "render_engine_export_api.h"
 #include <QByteArray>
 #include <QVector>
+#include "RenderTile.h"
+#include "util/RenderTrace.h"
 
 /*
 A RenderResultPacket is what we send from server to client with the rendered image.
 A packet can consist of several iterations of the algorithm combined in a single image/frame to save space.
 There is a vector of iteration numbers in each packet which says what this packet contains.
+The output is encoded on the wire with the encoding set on the packet (RenderResultPacketEncoding.h) and always holds
+the decoded float3 frame in memory.
+A packet of a tiled render request (RenderTile.h) holds the pixels of the tile only, row by row.
+The trace summary holds the pass timings of the server for the iterations in the packet (RenderTrace.h).
+PPM packets count the photons their iterations emitted, which varies with the photon budget of the requests.
 */
 
 class RenderResultPacket
@@ -33,6 +40,14 @@ public:
     RENDER_ENGINE_EXPORT_API unsigned long long getFirstIterationNumber() const;
     RENDER_ENGINE_EXPORT_API unsigned long long getLastIterationNumber() const;
     RENDER_ENGINE_EXPORT_API const QByteArray & getOutput() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getEncoding() const;
+    RENDER_ENGINE_EXPORT_API void setEncoding(unsigned int encoding);
+    RENDER_ENGINE_EXPORT_API const RenderTile & getTile() const;
+    RENDER_ENGINE_EXPORT_API void setTile(const RenderTile & tile);
+    RENDER_ENGINE_EXPORT_API const RenderTraceSummary & getTraceSummary() const;
+    RENDER_ENGINE_EXPORT_API void setTraceSummary(const RenderTraceSummary & traceSummary);
+    RENDER_ENGINE_EXPORT_API unsigned long long getNumEmittedPhotons() const;
+    RENDER_ENGINE_EXPORT_API void setNumEmittedPhotons(unsigned long long numEmittedPhotons);
     RENDER_ENGINE_EXPORT_API void merge(const RenderResultPacket & other);
     RENDER_ENGINE_EXPORT_API bool operator < (const RenderResultPacket & other) const;
 
@@ -42,6 +57,10 @@ private:
     QByteArray m_output;
     float m_renderTimeSeconds;
     float m_totalTimeSeconds;
+    unsigned int m_encoding;
+    RenderTile m_tile;
+    RenderTraceSummary m_traceSummary;
+    unsigned long long m_numEmittedPhotons;
 };
 
 class QDataStream;
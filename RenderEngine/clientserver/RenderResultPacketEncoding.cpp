@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderResultPacketEncoding.h"
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <optixu/optixu_math_namespace.h>
+#include "renderer/ppm/PhotonPacking.h"
+#include "util/TaskScheduler.h"
+
+namespace
+{
+    const unsigned int ENCODING_BLOCK_PIXELS = 64*1024;
+    const int COMPRESSION_LEVEL = 1;
+    // Largest frame the decoder accepts, so the decoded frame size fits a QByteArray
+    const unsigned int MAX_DECODED_PIXELS = 0x7fffffff/(3*sizeof(float));
+
+    // Encoded frame: header, the size of each encoded block, the blocks
+    struct EncodedFrameHeader
+    {
+        unsigned int encoding;
+        unsigned int numPixels;
+        unsigned int numBlocks;
+    };
+
+    unsigned short floatToHalf(float value)
+    {
+        unsigned int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        unsigned int sign = (bits >> 16) & 0x8000;
+        int exponent = int((bits >> 23) & 0xff);
+        unsigned int mantissa = bits & 0x7fffff;
+        if(exponent == 0xff)
+        {
+            return (unsigned short)(sign | (mantissa ? 0x7e00 : 0x7c00));
+        }
+
+        // Round to nearest even, values beyond the half range are clamped to the largest half instead of infinity
+        int halfExponent = exponent - 127 + 15;
+        if(halfExponent >= 31)
+        {
+            return (unsigned short)(sign | 0x7bff);
+        }
+        unsigned int shift = 13;
+        unsigned int half;
+        if(halfExponent <= 0)
+        {
+            if(halfExponent < -10)
+            {
+                return (unsigned short)sign;
+            }
+            mantissa |= 0x800000;
+            shift = 14 - halfExponent;
+            half = mantissa >> shift;
+        }
+        else
+        {
+            half = (halfExponent << 10) | (mantissa >> shift);
+        }
+        unsigned int remainder = mantissa & ((1u << shift) - 1);
+        unsigned int halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half & 1)))
+        {
+            half++;
+        }
+        return (unsigned short)(sign | (half < 0x7c00 ? half : 0x7bff));
+    }
+
+    float halfToFloat(unsigned short half)
+    {
+        unsigned int sign = (half & 0x8000) << 16;
+        unsigned int exponent = (half >> 10) & 0x1f;
+        unsigned int mantissa = half & 0x3ff;
+        if(exponent == 0)
+        {
+            float value = ldexpf(float(mantissa), -24);
+            return sign ? -value : value;
+        }
+        unsigned int bits = sign | (exponent == 31 ? 0x7f800000 : (exponent + 112) << 23) | (mantissa << 13);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    unsigned int getValueSize(unsigned int encoding)
+    {
+        return (encoding & RenderResultPacketEncoding::FORMAT_MASK) == RenderResultPacketEncoding::HALF ? 2 : 4;
+    }
+
+    unsigned int getPixelSize(unsigned int encoding)
+    {
+        switch(encoding & RenderResultPacketEncoding::FORMAT_MASK)
+        {
+        case RenderResultPacketEncoding::HALF: return 3*2;
+        case RenderResultPacketEncoding::RGB9E5: return 4;
+        }
+        return 3*4;
+    }
+
+    // Byte n of value i goes to plane n, and back
+    void shuffleBytes(const unsigned char* input, unsigned int numValues, unsigned int valueSize, unsigned char* output)
+    {
+        for(unsigned int b = 0; b < valueSize; b++)
+        {
+            unsigned char* plane = output + b*numValues;
+            for(unsigned int i = 0; i < numValues; i++)
+            {
+                plane[i] = input[i*valueSize + b];
+            }
+        }
+    }
+
+    void unshuffleBytes(const unsigned char* input, unsigned int numValues, unsigned int valueSize, unsigned char* output)
+    {
+        for(unsigned int b = 0; b < valueSize; b++)
+        {
+            const unsigned char* plane = input + b*numValues;
+            for(unsigned int i = 0; i < numValues; i++)
+            {
+                output[i*valueSize + b] = plane[i];
+            }
+        }
+    }
+
+    class EncodeBlocks
+    {
+    public:
+        EncodeBlocks(const float* pixels, unsigned int numPixels, unsigned int encoding, QByteArray* blocks)
+            : m_pixels(pixels), m_numPixels(numPixels), m_encoding(encoding), m_blocks(blocks)
+        {
+
+        }
+
+        void operator()(unsigned int fromBlock, unsigned int toBlock) const
+        {
+            for(unsigned int block = fromBlock; block < toBlock; block++)
+            {
+                const unsigned int from = block*ENCODING_BLOCK_PIXELS;
+                const unsigned int to = from + ENCODING_BLOCK_PIXELS < m_numPixels ? from + ENCODING_BLOCK_PIXELS : m_numPixels;
+                const float* pixels = m_pixels + from*3;
+                const unsigned int numPixels = to - from;
+
+                QByteArray values (numPixels*getPixelSize(m_encoding), Qt::Uninitialized);
+                switch(m_encoding & RenderResultPacketEncoding::FORMAT_MASK)
+                {
+                case RenderResultPacketEncoding::HALF:
+                    {
+                        unsigned short* halfs = reinterpret_cast<unsigned short*>(values.data());
+                        for(unsigned int i = 0; i < numPixels*3; i++)
+                        {
+                            halfs[i] = floatToHalf(pixels[i]);
+                        }
+                        break;
+                    }
+                case RenderResultPacketEncoding::RGB9E5:
+                    {
+                        unsigned int* packed = reinterpret_cast<unsigned int*>(values.data());
+                        for(unsigned int i = 0; i < numPixels; i++)
+                        {
+                            packed[i] = packRGB9E5(optix::make_float3(pixels[3*i], pixels[3*i+1], pixels[3*i+2]));
+                        }
+                        break;
+                    }
+                default:
+                    memcpy(values.data(), pixels, values.size());
+                }
+
+                if(m_encoding & RenderResultPacketEncoding::BYTE_SHUFFLE)
+                {
+                    QByteArray shuffled (values.size(), Qt::Uninitialized);
+                    const unsigned int valueSize = getValueSize(m_encoding);
+                    shuffleBytes(reinterpret_cast<const unsigned char*>(values.constData()), values.size()/valueSize, valueSize,
+                        reinterpret_cast<unsigned char*>(shuffled.data()));
+                    values = shuffled;
+                }
+
+                if(m_encoding & RenderResultPacketEncoding::COMPRESS)
+                {
+                    values = qCompress(values, COMPRESSION_LEVEL);
+                }
+                m_blocks[block] = values;
+            }
+        }
+
+    private:
+        const float* m_pixels;
+        unsigned int m_numPixels;
+        unsigned int m_encoding;
+        QByteArray* m_blocks;
+    };
+
+    class DecodeBlocks
+    {
+    public:
+        DecodeBlocks(const char* blocks, const unsigned int* blockOffsets, unsigned int numPixels, unsigned int encoding, float* pixels,
+                char* blockIsCorrupt)
+            : m_blocks(blocks), m_blockOffsets(blockOffsets), m_numPixels(numPixels), m_encoding(encoding), m_pixels(pixels),
+              m_blockIsCorrupt(blockIsCorrupt)
+        {
+
+        }
+
+        void operator()(unsigned int fromBlock, unsigned int toBlock) const
+        {
+            for(unsigned int block = fromBlock; block < toBlock; block++)
+            {
+                const unsigned int from = block*ENCODING_BLOCK_PIXELS;
+                const unsigned int to = from + ENCODING_BLOCK_PIXELS < m_numPixels ? from + ENCODING_BLOCK_PIXELS : m_numPixels;
+                float* pixels = m_pixels + from*3;
+                const unsigned int numPixels = to - from;
+
+                const unsigned int expectedSize = numPixels*getPixelSize(m_encoding);
+                QByteArray values = QByteArray::fromRawData(m_blocks + m_blockOffsets[block], m_blockOffsets[block+1] - m_blockOffsets[block]);
+                if(m_encoding & RenderResultPacketEncoding::COMPRESS)
+                {
+                    // qCompress data starts with the uncompressed size (big endian), checked before qUncompress
+                    // allocates it
+                    const unsigned char* data = reinterpret_cast<const unsigned char*>(values.constData());
+                    unsigned int uncompressedSize = values.size() < 4 ? 0
+                        : (unsigned int)data[0] << 24 | (unsigned int)data[1] << 16 | (unsigned int)data[2] << 8 | data[3];
+                    values = uncompressedSize == expectedSize ? qUncompress(values) : QByteArray();
+                }
+                // A corrupt block makes the whole frame corrupt, see decodeRenderResultOutput
+                if(values.size() != int(expectedSize))
+                {
+                    m_blockIsCorrupt[block] = 1;
+                    continue;
+                }
+
+                if(m_encoding & RenderResultPacketEncoding::BYTE_SHUFFLE)
+                {
+                    QByteArray unshuffled (values.size(), Qt::Uninitialized);
+                    const unsigned int valueSize = getValueSize(m_encoding);
+                    unshuffleBytes(reinterpret_cast<const unsigned char*>(values.constData()), values.size()/valueSize, valueSize,
+                        reinterpret_cast<unsigned char*>(unshuffled.data()));
+                    values = unshuffled;
+                }
+
+                switch(m_encoding & RenderResultPacketEncoding::FORMAT_MASK)
+                {
+                case RenderResultPacketEncoding::HALF:
+                    {
+                        const unsigned short* halfs = reinterpret_cast<const unsigned short*>(values.constData());
+                        for(unsigned int i = 0; i < numPixels*3; i++)
+                        {
+                            pixels[i] = halfToFloat(halfs[i]);
+                        }
+                        break;
+                    }
+                case RenderResultPacketEncoding::RGB9E5:
+                    {
+                        const unsigned int* packed = reinterpret_cast<const unsigned int*>(values.constData());
+                        for(unsigned int i = 0; i < numPixels; i++)
+                        {
+                            optix::float3 pixel = unpackRGB9E5(packed[i]);
+                            pixels[3*i] = pixel.x;
+                            pixels[3*i+1] = pixel.y;
+                            pixels[3*i+2] = pixel.z;
+                        }
+                        break;
+                    }
+                default:
+                    memcpy(pixels, values.constData(), values.size());
+                }
+            }
+        }
+
+    private:
+        const char* m_blocks;
+        const unsigned int* m_blockOffsets;
+        unsigned int m_numPixels;
+        unsigned int m_encoding;
+        float* m_pixels;
+        char* m_blockIsCorrupt;
+    };
+}
+
+unsigned int negotiateRenderResultPacketEncoding( unsigned int requestedEncoding )
+{
+    unsigned int format = requestedEncoding & RenderResultPacketEncoding::FORMAT_MASK;
+    if(format != RenderResultPacketEncoding::HALF && format != RenderResultPacketEncoding::RGB9E5)
+    {
+        format = RenderResultPacketEncoding::FLOAT;
+    }
+    return format | (requestedEncoding & (RenderResultPacketEncoding::BYTE_SHUFFLE | RenderResultPacketEncoding::COMPRESS));
+}
+
+QString renderResultPacketEncodingToString( unsigned int encoding )
+{
+    QString string;
+    switch(encoding & RenderResultPacketEncoding::FORMAT_MASK)
+    {
+    case RenderResultPacketEncoding::HALF: string = "Half"; break;
+    case RenderResultPacketEncoding::RGB9E5: string = "RGB9E5"; break;
+    default: string = "Float";
+    }
+    if(encoding & RenderResultPacketEncoding::BYTE_SHUFFLE)
+    {
+        string += " shuffled";
+    }
+    if(encoding & RenderResultPacketEncoding::COMPRESS)
+    {
+        string += " deflated";
+    }
+    return string;
+}
+
+QByteArray encodeRenderResultOutput( const QByteArray & output, unsigned int encoding, TaskScheduler & scheduler )
+{
+    EncodedFrameHeader header;
+    header.encoding = negotiateRenderResultPacketEncoding(encoding);
+    header.numPixels = output.size()/(3*sizeof(float));
+    header.numBlocks = (header.numPixels + ENCODING_BLOCK_PIXELS - 1)/ENCODING_BLOCK_PIXELS;
+
+    std::vector<QByteArray> blocks(header.numBlocks);
+    if(header.numBlocks > 0)
+    {
+        scheduler.parallelFor(0, header.numBlocks, 1,
+            EncodeBlocks(reinterpret_cast<const float*>(output.constData()), header.numPixels, header.encoding, &blocks[0]));
+    }
+
+    std::vector<unsigned int> blockSizes(header.numBlocks);
+    int size = sizeof(header) + header.numBlocks*sizeof(unsigned int);
+    for(unsigned int block = 0; block < header.numBlocks; block++)
+    {
+        blockSizes[block] = blocks[block].size();
+        size += blocks[block].size();
+    }
+
+    QByteArray encoded;
+    encoded.reserve(size);
+    encoded.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    if(header.numBlocks > 0)
+    {
+        encoded.append(reinterpret_cast<const char*>(&blockSizes[0]), header.numBlocks*sizeof(unsigned int));
+    }
+    for(unsigned int block = 0; block < header.numBlocks; block++)
+    {
+        encoded.append(blocks[block]);
+    }
+    return encoded;
+}
+
+QByteArray encodeRenderResultOutput( const QByteArray & output, unsigned int encoding )
+{
+    return encodeRenderResultOutput(output, encoding, TaskScheduler::get());
+}
+
+QByteArray decodeRenderResultOutput( const QByteArray & encoded, TaskScheduler & scheduler )
+{
+    EncodedFrameHeader header;
+    if(encoded.size() < int(sizeof(header)))
+    {
+        throw std::exception("The render result packet output is truncated.");
+    }
+    memcpy(&header, encoded.constData(), sizeof(header));
+    if(header.numPixels > MAX_DECODED_PIXELS
+        || header.numBlocks != (header.numPixels + ENCODING_BLOCK_PIXELS - 1)/ENCODING_BLOCK_PIXELS
+        || encoded.size() < int(sizeof(header) + header.numBlocks*sizeof(unsigned int)))
+    {
+        throw std::exception("The render result packet output is corrupt.");
+    }
+
+    // Offsets of the blocks, relative to the first one
+    const char* blockSizes = encoded.constData() + sizeof(header);
+    std::vector<unsigned int> blockOffsets(header.numBlocks+1);
+    unsigned long long offset = 0;
+    for(unsigned int block = 0; block < header.numBlocks; block++)
+    {
+        unsigned int blockSize;
+        memcpy(&blockSize, blockSizes + block*sizeof(unsigned int), sizeof(blockSize));
+        blockOffsets[block] = (unsigned int)offset;
+        offset += blockSize;
+    }
+    blockOffsets[header.numBlocks] = (unsigned int)offset;
+    const char* blocks = blockSizes + header.numBlocks*sizeof(unsigned int);
+    if(offset != (unsigned long long)(encoded.constData() + encoded.size() - blocks))
+    {
+        throw std::exception("The render result packet output is corrupt.");
+    }
+
+    // A frame with a corrupt block is rejected as a whole rather than averaged into the image with a hole in it
+    QByteArray output (header.numPixels*3*sizeof(float), Qt::Uninitialized);
+    if(header.numBlocks > 0)
+    {
+        std::vector<char> blockIsCorrupt(header.numBlocks, 0);
+        scheduler.parallelFor(0, header.numBlocks, 1, DecodeBlocks(blocks, &blockOffsets[0], header.numPixels,
+            negotiateRenderResultPacketEncoding(header.encoding), reinterpret_cast<float*>(output.data()), &blockIsCorrupt[0]));
+        if(std::find(blockIsCorrupt.begin(), blockIsCorrupt.end(), 1) != blockIsCorrupt.end())
+        {
+            throw std::exception("The render result packet output has a corrupt block.");
+        }
+    }
+    return output;
+}
+
+QByteArray decodeRenderResultOutput( const QByteArray & encoded )
+{
+    return decodeRenderResultOutput(encoded, TaskScheduler::get());
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include <QByteArray>
+#include <QString>
+
+class TaskScheduler;
+
+/*
+Wire encoding of the float3 frame of a RenderResultPacket. The client asks for an encoding in the GET SERVER DETAILS
+handshake, the server answers with the one it will use (negotiateRenderResultPacketEncoding) and every packet names
+the encoding of its payload, so the decoder needs no other state.
+
+An encoding is a value format combined with optional stages:
+- FLOAT keeps the 32 bit floats (lossless), HALF stores 16 bit floats (relative error below 2^-11, clamped to
+  65504) and RGB9E5 stores the pixel in the shared exponent format (error below 1/511 of the largest channel).
+- BYTE_SHUFFLE groups byte n of every value of a block together, so the exponent bytes form long similar runs.
+- COMPRESS deflates each block (qCompress at the fastest level).
+
+The frame is cut into blocks of pixels that are encoded and decoded independently on all host threads.
+*/
+
+namespace RenderResultPacketEncoding
+{
+    enum E
+    {
+        FLOAT = 0,
+        HALF = 1,
+        RGB9E5 = 2,
+        FORMAT_MASK = 0x3,
+        BYTE_SHUFFLE = 0x4,
+        COMPRESS = 0x8,
+        DEFAULT_ENCODING = HALF | BYTE_SHUFFLE | COMPRESS
+    };
+}
+
+// The encoding the server uses for a client asking for requestedEncoding: unknown formats and flags fall back to FLOAT
+RENDER_ENGINE_EXPORT_API unsigned int negotiateRenderResultPacketEncoding(unsigned int requestedEncoding);
+RENDER_ENGINE_EXPORT_API QString renderResultPacketEncodingToString(unsigned int encoding);
+
+RENDER_ENGINE_EXPORT_API QByteArray encodeRenderResultOutput(const QByteArray & output, unsigned int encoding,
+    TaskScheduler & scheduler);
+RENDER_ENGINE_EXPORT_API QByteArray encodeRenderResultOutput(const QByteArray & output, unsigned int encoding);
+
+// Throws std::exception if encoded is not a valid encoded frame: truncated, a corrupt header or any corrupt block
+RENDER_ENGINE_EXPORT_API QByteArray decodeRenderResultOutput(const QByteArray & encoded, TaskScheduler & scheduler);
+RENDER_ENGINE_EXPORT_API QByteArray decodeRenderResultOutput(const QByteArray & encoded);
@@ -8,11 +8,13 @@
 #include <QDataStream>
 
 RenderServerRenderRequest::RenderServerRenderRequest(unsigned long long sequenceNumber, const QVector<unsigned long long> & iterationNumbers,
-                                                     const QVector<double> & ppmRadii, const RenderServerRenderRequestDetails & details)
+                                                     const QVector<double> & ppmRadii, const RenderServerRenderRequestDetails & details,
+                                                     const RenderTile & tile)
     : m_sequenceNumber(sequenceNumber),
       m_iterationNumbers(iterationNumbers), 
       m_ppmRadii(ppmRadii),
-      m_details(details)
+      m_details(details),
+      m_tile(tile)
 {
 
 }
@@ -48,6 +50,11 @@ const RenderServerRenderRequestDetails & RenderServerRenderRequest::getDetails()
     return m_details;
 }
 
+const RenderTile & RenderServerRenderRequest::getTile() const
+{
+    return m_tile;
+}
+
 unsigned long long RenderServerRenderRequest::getSequenceNumber() const
 {
     return m_sequenceNumber;
@@ -65,7 +72,8 @@ QDataStream & operator<<( QDataStream & out, const RenderServerRenderRequest & r
     str << (quint64)renderRequest.getSequenceNumber()
         << renderRequest.getIterationNumbers()
         << renderRequest.getPPMRadii() 
-        << renderRequest.getDetails();
+        << renderRequest.getDetails()
+        << renderRequest.getTile();
 
     out << (int)(array.size()+2*sizeof(int)) << array;
     return out;
@@ -81,14 +89,16 @@ QDataStream & operator>>( QDataStream & in, RenderServerRenderRequest & renderRe
     QVector<unsigned long long> iterationNumbers;
     QVector<double> ppmRadii;
     RenderServerRenderRequestDetails details;
+    RenderTile tile;
 
     arrayStream >> sequenceNumber 
                 >> iterationNumbers
                 >> ppmRadii 
-                >> details;
+                >> details
+                >> tile;
 
     renderRequest = RenderServerRenderRequest((unsigned long long)sequenceNumber, iterationNumbers, 
-                        ppmRadii, details);
+                        ppmRadii, details, tile);
 
     if(in.status() != QDataStream::Ok)
     {
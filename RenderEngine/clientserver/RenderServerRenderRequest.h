@@ -8,13 +8,15 @@
 #include "render_engine_export_api.h"
 #include <QVector>
 #include "RenderServerRenderRequestDetails.h"
+#include "RenderTile.h"
 
 class RenderServerRenderRequest
 {
 public:
     RENDER_ENGINE_EXPORT_API RenderServerRenderRequest();
     RENDER_ENGINE_EXPORT_API RenderServerRenderRequest(unsigned long long sequenceNumber, const QVector<unsigned long long> & iterationNumbers,
-                                                      const QVector<double> & ppmRadii, const RenderServerRenderRequestDetails & details);
+                                                      const QVector<double> & ppmRadii, const RenderServerRenderRequestDetails & details,
+                                                      const RenderTile & tile = RenderTile());
 
     RENDER_ENGINE_EXPORT_API ~RenderServerRenderRequest(void);
     RENDER_ENGINE_EXPORT_API const QVector<double> & getPPMRadii() const;
@@ -23,12 +25,15 @@ public:
     RENDER_ENGINE_EXPORT_API unsigned long long getFirstIterationNumber() const;
     RENDER_ENGINE_EXPORT_API unsigned int getNumIterations() const;
     RENDER_ENGINE_EXPORT_API const RenderServerRenderRequestDetails & getDetails() const;
+    // The part of the frame to render, each iteration of the request is one sample per pixel of the tile
+    RENDER_ENGINE_EXPORT_API const RenderTile & getTile() const;
 
 private:
     unsigned long long m_sequenceNumber;
     QVector<unsigned long long> m_iterationNumbers;
     QVector<double> m_ppmRadii;
     RenderServerRenderRequestDetails m_details;
+    RenderTile m_tile;
 };
 
 class QDataStream;
@@ -8,13 +8,17 @@
 #include <QDataStream>
 
 RenderServerRenderRequestDetails::RenderServerRenderRequestDetails()
+    : m_photonMapStructure(PhotonMapStructure::E(DEFAULT_ACCELERATION_STRUCTURE)),
+      m_numEmittedPhotonsPerIteration(0)
 {
 
 }
 
 RenderServerRenderRequestDetails::RenderServerRenderRequestDetails( const Camera & camera, QByteArray sceneName, RenderMethod::E renderMethod, 
-                                                                    unsigned int width, unsigned int height, double ppmAlpha ) :
-  m_camera(camera), m_sceneName(sceneName), m_renderMethod(renderMethod), m_width(width), m_height(height), m_ppmAlpha(ppmAlpha)
+                                                                    unsigned int width, unsigned int height, double ppmAlpha,
+                                                                    PhotonMapStructure::E photonMapStructure ) :
+  m_camera(camera), m_sceneName(sceneName), m_renderMethod(renderMethod), m_width(width), m_height(height), m_ppmAlpha(ppmAlpha),
+  m_photonMapStructure(photonMapStructure), m_numEmittedPhotonsPerIteration(0)
 {
 
 }
@@ -34,6 +38,21 @@ const RenderMethod::E RenderServerRenderRequestDetails::getRenderMethod() const
     return m_renderMethod;
 }
 
+PhotonMapStructure::E RenderServerRenderRequestDetails::getPhotonMapStructure() const
+{
+    return m_photonMapStructure;
+}
+
+unsigned int RenderServerRenderRequestDetails::getNumEmittedPhotonsPerIteration() const
+{
+    return m_numEmittedPhotonsPerIteration;
+}
+
+void RenderServerRenderRequestDetails::setNumEmittedPhotonsPerIteration( unsigned int numEmittedPhotons )
+{
+    m_numEmittedPhotonsPerIteration = numEmittedPhotons;
+}
+
 unsigned int RenderServerRenderRequestDetails::getWidth() const
 {
     return m_width;
@@ -59,7 +78,9 @@ QDataStream & operator<<( QDataStream & out, const RenderServerRenderRequestDeta
         << (quint32)details.getRenderMethod()
         << (quint32)details.getWidth() 
         << (quint32)details.getHeight()
-        << (double)details.getPPMAlpha();
+        << (double)details.getPPMAlpha()
+        << (quint32)details.getPhotonMapStructure()
+        << (quint32)details.getNumEmittedPhotonsPerIteration();
 
     out << array;
     return out;
@@ -76,6 +97,8 @@ QDataStream & operator>>( QDataStream & in, RenderServerRenderRequestDetails & d
     quint32 renderMethod;
     quint32 width, height;
     double ppmAlpha;
+    quint32 photonMapStructure;
+    quint32 numEmittedPhotonsPerIteration;
 
     arrayStream 
         >> camera 
@@ -83,9 +106,13 @@ QDataStream & operator>>( QDataStream & in, RenderServerRenderRequestDetails & d
         >> renderMethod 
         >> width 
         >> height
-        >> ppmAlpha;
+        >> ppmAlpha
+        >> photonMapStructure
+        >> numEmittedPhotonsPerIteration;
 
-    details = RenderServerRenderRequestDetails(camera, sceneName, (RenderMethod::E)renderMethod, width, height, ppmAlpha);
+    details = RenderServerRenderRequestDetails(camera, sceneName, (RenderMethod::E)renderMethod, width, height, ppmAlpha,
+        (PhotonMapStructure::E)photonMapStructure);
+    details.setNumEmittedPhotonsPerIteration(numEmittedPhotonsPerIteration);
 
     if(in.status() != QDataStream::Ok)
     {
@@ -9,6 +9,7 @@
 #include "render_engine_export_api.h"
 #include "renderer/Camera.h"
 #include "renderer/RenderMethod.h"
+#include "renderer/ppm/PhotonMapStructure.h"
 #include <QString>
 #include <QByteArray>
 
@@ -16,19 +17,27 @@ class RenderServerRenderRequestDetails
 {
 public:
     RENDER_ENGINE_EXPORT_API RenderServerRenderRequestDetails();
-    RENDER_ENGINE_EXPORT_API RenderServerRenderRequestDetails(const Camera & camera, QByteArray sceneName, RenderMethod::E renderMethod, unsigned int width, unsigned int height, double ppmAlpha);
+    RENDER_ENGINE_EXPORT_API RenderServerRenderRequestDetails(const Camera & camera, QByteArray sceneName, RenderMethod::E renderMethod, unsigned int width, unsigned int height, double ppmAlpha,
+        PhotonMapStructure::E photonMapStructure);
     RENDER_ENGINE_EXPORT_API unsigned int getWidth() const;
     RENDER_ENGINE_EXPORT_API unsigned int getHeight() const;
     RENDER_ENGINE_EXPORT_API double getPPMAlpha() const;
     RENDER_ENGINE_EXPORT_API const Camera & getCamera() const;
     RENDER_ENGINE_EXPORT_API const QByteArray & getSceneName() const;
     RENDER_ENGINE_EXPORT_API const RenderMethod::E getRenderMethod() const;
+    RENDER_ENGINE_EXPORT_API PhotonMapStructure::E getPhotonMapStructure() const;
+    // Photons each PPM iteration emits, 0 (the default) leaves it to the renderer, see
+    // OptixRenderer::getEmittedPhotonsPerIteration
+    RENDER_ENGINE_EXPORT_API unsigned int getNumEmittedPhotonsPerIteration() const;
+    RENDER_ENGINE_EXPORT_API void setNumEmittedPhotonsPerIteration(unsigned int numEmittedPhotons);
 private:
     Camera m_camera;
     RenderMethod::E m_renderMethod;
     unsigned int m_width;
     unsigned int m_height;
     double m_ppmAlpha;
+    PhotonMapStructure::E m_photonMapStructure;
+    unsigned int m_numEmittedPhotonsPerIteration;
     QByteArray m_sceneName;
 };
 
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderTile.h"
+#include <QDataStream>
+
+RenderTile::RenderTile()
+    : m_x(0),
+      m_y(0),
+      m_width(0),
+      m_height(0)
+{
+
+}
+
+RenderTile::RenderTile( unsigned int x, unsigned int y, unsigned int width, unsigned int height )
+    : m_x(x),
+      m_y(y),
+      m_width(width),
+      m_height(height)
+{
+
+}
+
+unsigned int RenderTile::getX() const
+{
+    return m_x;
+}
+
+unsigned int RenderTile::getY() const
+{
+    return m_y;
+}
+
+unsigned int RenderTile::getWidth() const
+{
+    return m_width;
+}
+
+unsigned int RenderTile::getHeight() const
+{
+    return m_height;
+}
+
+unsigned int RenderTile::getNumPixels() const
+{
+    return m_width*m_height;
+}
+
+bool RenderTile::isFullFrame() const
+{
+    return m_width == 0 || m_height == 0;
+}
+
+bool RenderTile::isInsideFrame( unsigned int frameWidth, unsigned int frameHeight ) const
+{
+    return m_x < frameWidth && m_y < frameHeight && m_width <= frameWidth - m_x && m_height <= frameHeight - m_y;
+}
+
+bool RenderTile::operator==( const RenderTile & other ) const
+{
+    return m_x == other.m_x && m_y == other.m_y && m_width == other.m_width && m_height == other.m_height;
+}
+
+QDataStream & operator<<( QDataStream & out, const RenderTile & tile )
+{
+    out << (quint32)tile.getX()
+        << (quint32)tile.getY()
+        << (quint32)tile.getWidth()
+        << (quint32)tile.getHeight();
+    return out;
+}
+
+QDataStream & operator>>( QDataStream & in, RenderTile & tile )
+{
+    quint32 x, y, width, height;
+    in >> x >> y >> width >> height;
+    tile = RenderTile(x, y, width, height);
+    return in;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+
+/*
+A RenderTile is the rectangle of the frame a RenderServerRenderRequest asks for and a RenderResultPacket holds, in pixels
+with the origin in the first pixel of the output buffer. The default (empty) tile stands for the full frame.
+Tiles are used for path tracing, whose pixels are independent of each other. PPM and VCM always render full frames:
+their photon and light passes cover the whole frame and would be repeated for every tile.
+*/
+
+class RenderTile
+{
+public:
+    RENDER_ENGINE_EXPORT_API RenderTile();
+    RENDER_ENGINE_EXPORT_API RenderTile(unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+    RENDER_ENGINE_EXPORT_API unsigned int getX() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getY() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getWidth() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getHeight() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getNumPixels() const;
+    RENDER_ENGINE_EXPORT_API bool isFullFrame() const;
+    // True if the tile lies within a frame of frameWidth x frameHeight pixels
+    RENDER_ENGINE_EXPORT_API bool isInsideFrame(unsigned int frameWidth, unsigned int frameHeight) const;
+    RENDER_ENGINE_EXPORT_API bool operator == (const RenderTile & other) const;
+
+private:
+    unsigned int m_x;
+    unsigned int m_y;
+    unsigned int m_width;
+    unsigned int m_height;
+};
+
+class QDataStream;
+RENDER_ENGINE_EXPORT_API QDataStream & operator << (QDataStream & out, const RenderTile & tile);
+RENDER_ENGINE_EXPORT_API QDataStream & operator >> (QDataStream & in, RenderTile & tile);
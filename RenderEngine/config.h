@@ -18,13 +18,26 @@
 #define ACCELERATION_STRUCTURE_UNIFORM_GRID 0
 #define ACCELERATION_STRUCTURE_KD_TREE_CPU 1
 #define ACCELERATION_STRUCTURE_STOCHASTIC_HASH 2
-#define ACCELERATION_STRUCTURE (ACCELERATION_STRUCTURE_UNIFORM_GRID)
+#define ACCELERATION_STRUCTURE_HASHED_GRID 3
+// All photon maps are compiled in and picked per render request, this one is used by default. The hashed grid stays an
+// option until its device gather has been checked against HostPhotonGather.
+#define DEFAULT_ACCELERATION_STRUCTURE (ACCELERATION_STRUCTURE_UNIFORM_GRID)
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
-#define MAX_PHOTONS_DEPOSITS_PER_EMITTED 1
-#else
 #define MAX_PHOTONS_DEPOSITS_PER_EMITTED 4
-#endif
+
+#define SAMPLER_RANDOM 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_HALTON 2
+// Sampler of the path tracing and VCM subpaths unless OptixRenderer::setSampler picks another (Sampler.h)
+#define DEFAULT_SAMPLER (SAMPLER_SOBOL)
+
+// Number the uniform grid photon map cells in Z-order (Morton) instead of x-major order (getPhotonGridIndex1D)
+#define ENABLE_MORTON_ORDERED_PHOTON_GRID 0
+
+// Store the photon pass output as separate position, packed direction and packed power arrays (PhotonBuffer.h)
+// instead of an array of Photon, halving the photon memory and the bytes read by the gather. Off until its device
+// photon pass and gather have been checked against HostPhotonGather.
+#define ENABLE_PHOTON_SOA_LAYOUT 0
 
 #define ENABLE_PARTICIPATING_MEDIA 0
 #define ENABLE_RENDER_DEBUG_EXCEPTIONS 0
@@ -36,8 +49,6 @@
 #define PHOTON_TRACING_RR_START_DEPTH 3
 #define PATH_TRACING_RR_START_DEPTH 3
 
-#define USE_CHEAP_RANDOM 0
-
 #define RAY_LEN_MIN 0.0001f
 #define EPS_COSINE 1e-6f
 #define EPS_RAY    1e-3f
@@ -47,4 +58,4 @@
 #define MAX_OUTPUT_X 2000
 #define MAX_OUTPUT_Y 2000
 
-//#define DEBUG_RANDOM_SEED 1645301512
+//#define DEBUG_RANDOM_SEED 1645301512
@@ -48,4 +48,10 @@ optix::Material Diffuse::getOptixMaterial(optix::Context & context)
 void Diffuse::registerGeometryInstanceValues(optix::GeometryInstance & instance )
 {
     instance["Kd"]->setFloat(this->Kd);
-}
\ No newline at end of file
+}
+HostMaterial Diffuse::getHostMaterial() const
+{
+    HostMaterial material (HostMaterialType::DIFFUSE);
+    material.Kd = this->Kd;
+    return material;
+}
@@ -50,19 +50,18 @@ rtDeclareVariable(float, tHit, rtIntersectionDistance, );
 rtDeclareVariable(float3, geometricNormal, attribute geometricNormal, ); 
 rtDeclareVariable(float3, shadingNormal, attribute shadingNormal, ); 
 
-rtBuffer<Photon, 1> photons;
 rtBuffer<Hitpoint, 2> raytracePassOutputBuffer;
 rtDeclareVariable(rtObject, sceneRootObject, , );
 rtDeclareVariable(uint, maxPhotonDepositsPerEmitted, , );
 rtDeclareVariable(float3, Kd, , );
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
+rtDeclareVariable(uint, photonMapStructure, , );
 rtDeclareVariable(uint3, photonsGridSize, , );
 rtDeclareVariable(float3, photonsWorldOrigo, ,);
 rtDeclareVariable(float, photonsGridCellSize, ,);
 rtDeclareVariable(unsigned int, photonsSize,,);
 rtBuffer<unsigned int, 1> photonsHashTableCount;
-#endif
+rtBuffer<unsigned int, 1> photonDepositCounter;
 
 
 /*
@@ -124,10 +123,8 @@ RT_PROGRAM void closestHitPhoton()
         return;
     }
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID || ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
-    if(photonPrd.numStoredPhotons >= maxPhotonDepositsPerEmitted)
+    if(PHOTON_DEPOSITS_FULL())
         return;
-#endif
 
     newPhotonDirection = sampleUnitHemisphereCos(worldShadingNormal, getRandomUniformFloat2(&photonPrd.randomState));
     optix::Ray newRay( hitPoint, newPhotonDirection, RayType::PHOTON, 0.0001 );
@@ -155,6 +152,7 @@ rtBuffer<uint, 2>      lightSubpathLengthBuffer;
 rtDeclareVariable(int, lightVertexBufferId, , );            // rtBufferId<LightVertex>
 rtDeclareVariable(int, lightVertexBufferIndexBufferId, , ); // rtBufferId<uint>
 rtDeclareVariable(int, lightSubpathVertexCountBufferId, , );// rtBufferId<uint, 2>
+rtDeclareVariable(int, lightSubpathVertexOffsetBufferId, , );// rtBufferId<uint>
 rtDeclareVariable(int, outputBufferId, , );                 // rtBufferId<float3, 2>
 
 #if !VCM_UNIFORM_VERTEX_SAMPLING
@@ -178,7 +176,7 @@ RT_PROGRAM void vcmClosestHitLight()
     
     rtBufferId<float3, 2>      _outputBufferId                  = rtBufferId<float3, 2>(outputBufferId);
     rtBufferId<LightVertex, 1> _lightVertexBufferId             = rtBufferId<LightVertex, 1>(lightVertexBufferId);
-    rtBufferId<uint, 1>        _lightVertexBufferIndexBufferId  = rtBufferId<uint, 1>(lightVertexBufferIndexBufferId);
+    rtBufferId<uint, 1>        _lightSubpathVertexOffsetBufferId = rtBufferId<uint, 1>(lightSubpathVertexOffsetBufferId);
     rtBufferId<uint, 1>        _lightSubpathVertexCountBufferId = rtBufferId<uint, 1>(lightSubpathVertexCountBufferId);
 #if !VCM_UNIFORM_VERTEX_SAMPLING
     rtBufferId<uint, 2>        _lightSubpathVertexIndexBufferId = rtBufferId<uint, 2>(lightSubpathVertexIndexBufferId);
@@ -193,7 +191,7 @@ RT_PROGRAM void vcmClosestHitLight()
     lightHit(sceneRootObject, subpathPrd, hitPoint, worldGeometricNormal, lightBsdf, ray.direction, tHit, maxPathLen,
              lightVertexCountEstimatePass, lightSubpathCount, misVcWeightFactor, misVmWeightFactor,
              camera, pixelSizeFactor,
-             _outputBufferId, _lightVertexBufferId, _lightVertexBufferIndexBufferId, _lightSubpathVertexCountBufferId,
+             _outputBufferId, _lightVertexBufferId, _lightSubpathVertexOffsetBufferId, _lightSubpathVertexCountBufferId,
 #if !VCM_UNIFORM_VERTEX_SAMPLING
              _lightSubpathVertexIndexBufferId
 #else
@@ -207,6 +205,9 @@ RT_PROGRAM void vcmClosestHitLight()
 rtDeclareVariable(Sphere, sceneBoundingSphere, , );
 rtDeclareVariable(float,  averageLightSubpathLength, , );
 rtDeclareVariable(int,    lightsBufferId, , );                 // rtBufferId<uint, 1>
+rtDeclareVariable(int,    lightAliasTableBufferId, , );        // rtBufferId<LightAliasEntry, 1>
+rtDeclareVariable(LightVertexGrid, lightVertexGrid, , );
+rtDeclareVariable(float,  vmNormalizationFactor, , );
 
  // Camra subpath program
 RT_PROGRAM void vcmClosestHitCamera()
@@ -223,6 +224,7 @@ RT_PROGRAM void vcmClosestHitCamera()
     OPTIX_PRINTFID(launchIndex, subpathPrd.depth, "Hit C - diffuse hit Kd  % 14f % 14f % 14f\n", Kd.x, Kd.y, Kd.z);
 
     rtBufferId<Light, 1>       _lightsBufferId                  = rtBufferId<Light, 1>(lightsBufferId);
+    rtBufferId<LightAliasEntry, 1> _lightAliasTableBufferId     = rtBufferId<LightAliasEntry, 1>(lightAliasTableBufferId);
     rtBufferId<LightVertex, 1> _lightVertexBufferId             = rtBufferId<LightVertex, 1>(lightVertexBufferId);
     rtBufferId<uint, 1>        _lightVertexBufferIndexBufferId  = rtBufferId<uint, 1>(lightVertexBufferIndexBufferId);
     rtBufferId<uint, 1>        _lightSubpathVertexCountBufferId = rtBufferId<uint, 1>(lightSubpathVertexCountBufferId);
@@ -231,8 +233,9 @@ RT_PROGRAM void vcmClosestHitCamera()
 #endif
 
     cameraHit(sceneRootObject, sceneBoundingSphere, subpathPrd, hitPoint, worldGeometricNormal, cameraBsdf, ray.direction, tHit, maxPathLen,
-              lightSubpathCount, misVcWeightFactor, misVmWeightFactor, 
-              _lightsBufferId, _lightVertexBufferId, _lightVertexBufferIndexBufferId, _lightSubpathVertexCountBufferId,
+              lightSubpathCount, misVcWeightFactor, misVmWeightFactor, vmNormalizationFactor,
+              _lightsBufferId, _lightAliasTableBufferId, _lightVertexBufferId, _lightVertexBufferIndexBufferId, _lightSubpathVertexCountBufferId,
+              lightVertexGrid,
 #if !VCM_UNIFORM_VERTEX_SAMPLING
               _lightSubpathVertexIndexBufferId
 #else
@@ -21,4 +21,5 @@ public:
     Diffuse(const Vector3 & Kd);
     virtual optix::Material getOptixMaterial(optix::Context & context);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
+    virtual HostMaterial getHostMaterial() const;
 };
\ No newline at end of file
@@ -72,3 +72,11 @@ void DiffuseEmitter::setInverseArea( float inverseArea )
 {
     m_inverseArea = inverseArea;
 }
+
+HostMaterial DiffuseEmitter::getHostMaterial() const
+{
+    HostMaterial material (HostMaterialType::DIFFUSE_EMITTER);
+    material.Kd = m_Kd;
+    material.powerPerArea = m_power * m_inverseArea;
+    return material;
+}
@@ -21,6 +21,7 @@
 #include "renderer/vcm/config_vcm.h"
 #include "renderer/vcm/vcm.h"
 #include "renderer/helpers/helpers.h"
+#include "renderer/LightAliasTable.h"
 
 using namespace optix;
 
@@ -87,8 +88,10 @@ RT_PROGRAM void vcmClosestHitLight()
 
 rtDeclareVariable(float3, Lemit, , );
 rtDeclareVariable(float, inverseArea, , );
+rtDeclareVariable(float3, power, , );
 rtDeclareVariable(rtObject, sceneRootObject, , );
 rtBuffer<Light, 1> lights;
+rtDeclareVariable(float, lightSelectionTotalWeight, , );
 rtDeclareVariable(int, vcmUseVC, , );
 rtDeclareVariable(int, vcmUseVM, , );
 
@@ -111,7 +114,9 @@ RT_PROGRAM void vcmClosestHitCamera()
     if (dot(worldGeometricNormal, -ray.direction) < 0.f)
         return;
 
-    float lightPickProb = 1.f / lights.size();
+    // Probability the light passes had picked this emitter, its light has the same power
+    float lightPickProb = 0.f < lightSelectionTotalWeight ? getLightSelectionWeight(power) / lightSelectionTotalWeight
+        : 1.f / lights.size();
 
     float directPdfA = inverseArea;
     float emissionPdfW = CosHemispherePdfW(worldGeometricNormal, -ray.direction) * inverseArea;
@@ -20,6 +20,7 @@ public:
     DiffuseEmitter(const Vector3 & power, const Vector3 & Kd);
     virtual optix::Material getOptixMaterial(optix::Context & context);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
+    virtual HostMaterial getHostMaterial() const;
     Vector3 getPower() const;
     void setInverseArea(float inverseArea);
 };
\ No newline at end of file
@@ -62,3 +62,11 @@ void Glass::registerGeometryInstanceValues(optix::GeometryInstance & instance )
     instance["Kr"]->setFloat(this->Kr);
     instance["Kt"]->setFloat(this->Kt);
 }
+
+HostMaterial Glass::getHostMaterial() const
+{
+    HostMaterial material (HostMaterialType::GLASS);
+    material.Kr = this->Kr;
+    material.indexOfRefraction = this->indexOfRefraction;
+    return material;
+}
@@ -23,4 +23,5 @@ public:
     Glass(float indexOfRefraction, const Vector3 & Kr, const Vector3 & Kt);
     virtual optix::Material getOptixMaterial(optix::Context & context);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
+    virtual HostMaterial getHostMaterial() const;
 };
\ No newline at end of file
@@ -63,4 +63,13 @@ void Glossy::registerGeometryInstanceValues(optix::GeometryInstance & instance )
     instance["Kd"]->setFloat(this->m_Kd);
     instance["Ks"]->setFloat(this->m_Ks);
     instance["exponent"]->setFloat(this->m_exponent);
-}
\ No newline at end of file
+}
+
+// Path tracing only samples the diffuse part of Glossy
+
+HostMaterial Glossy::getHostMaterial() const
+{
+    HostMaterial material (HostMaterialType::DIFFUSE);
+    material.Kd = this->m_Kd;
+    return material;
+}
@@ -23,4 +23,5 @@ public:
     Glossy(const Vector3 & Kd, const Vector3 & Ks, const float exponent);
     virtual optix::Material getOptixMaterial(optix::Context & context);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
+    virtual HostMaterial getHostMaterial() const;
 };
\ No newline at end of file
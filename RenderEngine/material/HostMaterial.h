@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+
+class Image;
+
+/*
+The parameters of a Material as used by the host renderers (HostPathTracer). Every host material mirrors the path
+tracing closest hit program of its OptiX material: Glossy is traced as its diffuse part, like in the OptiX programs.
+*/
+
+namespace HostMaterialType
+{
+    enum E
+    {
+        DIFFUSE,
+        DIFFUSE_EMITTER,
+        MIRROR,
+        GLASS,
+        PARTICIPATING_MEDIUM
+    };
+}
+
+struct HostMaterial
+{
+    HostMaterial(HostMaterialType::E type = HostMaterialType::DIFFUSE)
+        : type(type),
+          Kd(optix::make_float3(0.f)),
+          Kr(optix::make_float3(0.f)),
+          powerPerArea(optix::make_float3(0.f)),
+          indexOfRefraction(1.f),
+          diffuseImage(NULL)
+    {
+
+    }
+
+    HostMaterialType::E type;
+    optix::float3 Kd;
+    optix::float3 Kr;
+    optix::float3 powerPerArea;     // DIFFUSE_EMITTER
+    float indexOfRefraction;        // GLASS
+    const Image* diffuseImage;      // Textured DIFFUSE, owned by the Texture material
+};
@@ -6,6 +6,7 @@
 
 #pragma once
 #include <optixu/optixpp_namespace.h>
+#include "HostMaterial.h"
 class Material
 {
 public:
@@ -13,6 +14,7 @@ public:
     virtual ~Material();
     virtual optix::Material getOptixMaterial(optix::Context & context) = 0;
     virtual void registerGeometryInstanceValues( optix::GeometryInstance & instance ) = 0;
+    virtual HostMaterial getHostMaterial() const = 0;
 protected:
     static void registerMaterialWithShadowProgram(optix::Context & context, optix::Material & material);
 private:
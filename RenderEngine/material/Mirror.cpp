@@ -42,4 +42,10 @@ optix::Material Mirror::getOptixMaterial(optix::Context & context)
 void Mirror::registerGeometryInstanceValues(optix::GeometryInstance & instance )
 {
     instance["Kr"]->setFloat(this->Kr);
-}
\ No newline at end of file
+}
+HostMaterial Mirror::getHostMaterial() const
+{
+    HostMaterial material (HostMaterialType::MIRROR);
+    material.Kr = this->Kr;
+    return material;
+}
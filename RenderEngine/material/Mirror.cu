@@ -99,6 +99,7 @@ rtBuffer<uint, 2>      lightSubpathVertexCountBuffer;
 rtDeclareVariable(int, lightVertexBufferId, , );            // rtBufferId<LightVertex>
 rtDeclareVariable(int, lightVertexBufferIndexBufferId, , ); // rtBufferId<uint>
 rtDeclareVariable(int, lightSubpathVertexCountBufferId, , );// rtBufferId<uint, 2>
+rtDeclareVariable(int, lightSubpathVertexOffsetBufferId, , );// rtBufferId<uint>
 rtDeclareVariable(int, outputBufferId, , );                 // rtBufferId<float3, 2>
 
 #if !VCM_UNIFORM_VERTEX_SAMPLING
@@ -122,7 +123,7 @@ RT_PROGRAM void vcmClosestHitLight()
     
     rtBufferId<float3, 2>      _outputBufferId                  = rtBufferId<float3, 2>(outputBufferId);
     rtBufferId<LightVertex, 1> _lightVertexBufferId             = rtBufferId<LightVertex, 1>(lightVertexBufferId);
-    rtBufferId<uint, 1>        _lightVertexBufferIndexBufferId  = rtBufferId<uint, 1>(lightVertexBufferIndexBufferId);
+    rtBufferId<uint, 1>        _lightSubpathVertexOffsetBufferId = rtBufferId<uint, 1>(lightSubpathVertexOffsetBufferId);
     rtBufferId<uint, 1>        _lightSubpathVertexCountBufferId = rtBufferId<uint, 1>(lightSubpathVertexCountBufferId);
 #if !VCM_UNIFORM_VERTEX_SAMPLING
     rtBufferId<uint, 2>        _lightSubpathVertexIndexBufferId = rtBufferId<uint, 2>(lightSubpathVertexIndexBufferId);
@@ -139,7 +140,7 @@ RT_PROGRAM void vcmClosestHitLight()
     lightHit(sceneRootObject, subpathPrd, hitPoint, worldGeometricNormal, lightBsdf, ray.direction, tHit, maxPathLen,
              lightVertexCountEstimatePass, lightSubpathCount, misVcWeightFactor, misVmWeightFactor,
              camera, pixelSizeFactor,
-             _outputBufferId, _lightVertexBufferId, _lightVertexBufferIndexBufferId, _lightSubpathVertexCountBufferId,
+             _outputBufferId, _lightVertexBufferId, _lightSubpathVertexOffsetBufferId, _lightSubpathVertexCountBufferId,
 #if !VCM_UNIFORM_VERTEX_SAMPLING
              _lightSubpathVertexIndexBufferId
 #else
@@ -153,6 +154,9 @@ RT_PROGRAM void vcmClosestHitLight()
 rtDeclareVariable(Sphere, sceneBoundingSphere, , );
 rtDeclareVariable(float,  averageLightSubpathLength, , );
 rtDeclareVariable(int,    lightsBufferId, , );                 // rtBufferId<uint, 1>
+rtDeclareVariable(int,    lightAliasTableBufferId, , );        // rtBufferId<LightAliasEntry, 1>
+rtDeclareVariable(LightVertexGrid, lightVertexGrid, , );
+rtDeclareVariable(float,  vmNormalizationFactor, , );
 
  // Camra subpath program
 RT_PROGRAM void vcmClosestHitCamera()
@@ -161,6 +165,7 @@ RT_PROGRAM void vcmClosestHitCamera()
     float3 hitPoint = ray.origin + tHit*ray.direction;
 
     rtBufferId<Light, 1>       _lightsBufferId                  = rtBufferId<Light, 1>(lightsBufferId);
+    rtBufferId<LightAliasEntry, 1> _lightAliasTableBufferId     = rtBufferId<LightAliasEntry, 1>(lightAliasTableBufferId);
     rtBufferId<LightVertex, 1> _lightVertexBufferId             = rtBufferId<LightVertex, 1>(lightVertexBufferId);
     rtBufferId<uint, 1>        _lightVertexBufferIndexBufferId  = rtBufferId<uint, 1>(lightVertexBufferIndexBufferId);
     rtBufferId<uint, 1>        _lightSubpathVertexCountBufferId = rtBufferId<uint, 1>(lightSubpathVertexCountBufferId);
@@ -177,8 +182,9 @@ RT_PROGRAM void vcmClosestHitCamera()
     cameraBsdf.AddBxDF(&reflection);
 
     cameraHit(sceneRootObject, sceneBoundingSphere, subpathPrd, hitPoint, worldGeometricNormal, cameraBsdf, ray.direction, tHit, maxPathLen,
-              lightSubpathCount, misVcWeightFactor, misVmWeightFactor, 
-              _lightsBufferId, _lightVertexBufferId, _lightVertexBufferIndexBufferId, _lightSubpathVertexCountBufferId,
+              lightSubpathCount, misVcWeightFactor, misVmWeightFactor, vmNormalizationFactor,
+              _lightsBufferId, _lightAliasTableBufferId, _lightVertexBufferId, _lightVertexBufferIndexBufferId, _lightSubpathVertexCountBufferId,
+              lightVertexGrid,
 #if !VCM_UNIFORM_VERTEX_SAMPLING
               _lightSubpathVertexIndexBufferId
 #else
@@ -40,7 +40,6 @@ rtDeclareVariable(float3, geometricNormal, attribute geometricNormal, );
 rtDeclareVariable(float3, shadingNormal, attribute shadingNormal, ); 
 
 #if ENABLE_PARTICIPATING_MEDIA
-rtBuffer<Photon, 1> photons;
 rtBuffer<Photon, 1> volumetricPhotons;
 rtDeclareVariable(float, sigma_a, , );
 rtDeclareVariable(float, sigma_s, , );
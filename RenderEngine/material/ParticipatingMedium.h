@@ -13,6 +13,7 @@ public:
     ParticipatingMedium(float sigma_s, float sigma_a);
     virtual optix::Material getOptixMaterial(optix::Context & context);
     virtual void registerGeometryInstanceValues(optix::GeometryInstance & instance);
+    virtual HostMaterial getHostMaterial() const;
 private:
     //float indexOfRefraction;
     static bool m_optixMaterialIsCreated;
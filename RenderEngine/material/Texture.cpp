@@ -128,4 +128,13 @@ optix::Buffer Texture::createBufferFromImage(optix::Context & context, const Ima
     memcpy(buffer_Host, image.constData(), image.getWidth()*image.getHeight()*4*sizeof(unsigned char));
     buffer->unmap();
     return buffer;
-}
\ No newline at end of file
+}
+// The host renderers sample the diffuse image only, the normal map is not used
+
+HostMaterial Texture::getHostMaterial() const
+{
+    HostMaterial material (HostMaterialType::DIFFUSE);
+    material.Kd = optix::make_float3(1.f);
+    material.diffuseImage = m_diffuseImage;
+    return material;
+}
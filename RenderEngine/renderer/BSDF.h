@@ -62,20 +62,22 @@
 #define OPTIX_PRINTFID_ENABLED 0
 #define OPTIX_PRINTFC_ENABLED 0
 
-// [Update 21.10.14]: Cuda does support virtual functions, so this macro should be removed (Programming Guide - C/C++ Language Support)
+// Calls the function of the type of a BxDF with a switch over its tag, one case per type of BxDFTypes (BxDF.h). Tags
+// are set by the BxDF constructors, the last case is the default so the switch needs no range check.
 #define CALL_BXDF_CONST_VIRTUAL_FUNCTION(lvalue, op, bxdf, function, ...) \
-    if (bxdf->type() & BxDF::Lambertian) \
-        lvalue op reinterpret_cast<const Lambertian *>(bxdf)->function(__VA_ARGS__); \
-    else if (bxdf->type() & BxDF::SpecularReflection) \
-        lvalue op reinterpret_cast<const SpecularReflection *>(bxdf)->function(__VA_ARGS__); \
-    else if (bxdf->type() & BxDF::SpecularTransmission) \
-        lvalue op reinterpret_cast<const SpecularTransmission *>(bxdf)->function(__VA_ARGS__); \
-    else if (bxdf->type() & BxDF::Phong) \
-        lvalue op reinterpret_cast<const Phong *>(bxdf)->function(__VA_ARGS__);
-
-//#define CAST_BXDF_TO_SUBTYPE(pointerVariable, bxdf) \
-//    if (bxdf->type() & BxDF::Lambertian) \
-//        Lambertian pointerVariable = reinterpret_cast<const Lambertian *>(bxdf)->function(__VA_ARGS__);
+    switch ((bxdf)->tag()) \
+    { \
+    case 0: \
+        lvalue op static_cast<const BxDFTypeAt<0>::Type *>(bxdf)->function(__VA_ARGS__); break; \
+    case 1: \
+        lvalue op static_cast<const BxDFTypeAt<1>::Type *>(bxdf)->function(__VA_ARGS__); break; \
+    case 2: \
+        lvalue op static_cast<const BxDFTypeAt<2>::Type *>(bxdf)->function(__VA_ARGS__); break; \
+    default: \
+        lvalue op static_cast<const BxDFTypeAt<3>::Type *>(bxdf)->function(__VA_ARGS__); break; \
+    }
+
+static_assert(BxDFTypeCount<BxDFTypes>::value == 4, "CALL_BXDF_CONST_VIRTUAL_FUNCTION needs a case per BxDF type");
 
 class BSDF 
 {
@@ -89,9 +91,9 @@ protected:
     char                  _bxdfList [MAX_N_BXDFS * MAX_BXDF_SIZE];
 
 public:
-    RT_FUNCTION BSDF() {  }
-    RT_FUNCTION BSDF( const DifferentialGeometry aDiffGeomShading,
-                      const optix::float3      & aWorldGeometricNormal )
+    __host__ RT_FUNCTION BSDF() {  }
+    __host__ RT_FUNCTION BSDF( const DifferentialGeometry aDiffGeomShading,
+                               const optix::float3      & aWorldGeometricNormal )
     {
         _geometricNormal = aWorldGeometricNormal;
         _diffGemetry = aDiffGeomShading;
@@ -100,7 +102,7 @@ public:
     }
 
     // generates tangent and bitangent
-    RT_FUNCTION BSDF( const optix::float3 & aWorldNormal )
+    __host__ RT_FUNCTION BSDF( const optix::float3 & aWorldNormal )
     {
         _diffGemetry.SetFromNormal(aWorldNormal);
         _geometricNormal = aWorldNormal;
@@ -108,11 +110,11 @@ public:
         memset(_bxdfList, 0, MAX_N_BXDFS * MAX_BXDF_SIZE);
     }
 
-    RT_FUNCTION unsigned int nBxDFs() const { return _nBxDFs; }
+    __host__ RT_FUNCTION unsigned int nBxDFs() const { return _nBxDFs; }
 
-    RT_FUNCTION const DifferentialGeometry & differentialGeometry() const { return _diffGemetry; }
+    __host__ RT_FUNCTION const DifferentialGeometry & differentialGeometry() const { return _diffGemetry; }
 
-    RT_FUNCTION unsigned int nBxDFs(BxDF::Type aType) const
+    __host__ RT_FUNCTION unsigned int nBxDFs(BxDF::Type aType) const
     {
         unsigned int count = 0;
         for (unsigned int i = 0; i < _nBxDFs; ++i)
@@ -123,25 +125,25 @@ public:
         return count;
     }
 
-    // Add BxDF. Returns 0 if failed, e.g. MAX_N_BXDFS reached
-    RT_FUNCTION int AddBxDF(const BxDF * bxdf)
+    // Add BxDF of one of the BxDFTypes. Returns 0 if failed, e.g. MAX_N_BXDFS reached
+    template<typename T>
+    __host__ RT_FUNCTION int AddBxDF(const T * bxdf)
     {
+        static_assert(BxDFTag<T>::value < BxDFTypeCount<BxDFTypes>::value, "AddBxDF takes one of the BxDFTypes");
         if (_nBxDFs == MAX_N_BXDFS) return 0;
         
         // get BxDF list address and copy data
-        // don't care if copy too much, extra bytes won't be used by target type anyway
-        BxDF *pBxDF = reinterpret_cast<BxDF *>(&_bxdfList[_nBxDFs * MAX_BXDF_SIZE]);
-        memcpy(pBxDF, bxdf, MAX_BXDF_SIZE); // don't care if copy too much, extra bytes won't be used by target type anyway
+        memcpy(&_bxdfList[_nBxDFs * MAX_BXDF_SIZE], bxdf, sizeof(T));
         _nBxDFs++;
         return 1;
     }
 
-    RT_FUNCTION const BxDF * bxdfAt(const optix::uint & aIndex) const
+    __host__ RT_FUNCTION const BxDF * bxdfAt(const optix::uint & aIndex) const
     {
         return reinterpret_cast<const BxDF *>(&_bxdfList[aIndex * MAX_BXDF_SIZE]);
     }
 
-    RT_FUNCTION const BxDF * bxdfAt(const optix::uint & aIndex, BxDF::Type aType) const
+    __host__ RT_FUNCTION const BxDF * bxdfAt(const optix::uint & aIndex, BxDF::Type aType) const
     {
         optix::uint count = aIndex;
         for (unsigned int i = 0; i < _nBxDFs; ++i) 
@@ -157,7 +159,7 @@ public:
         return NULL;
     }
 
-    RT_FUNCTION bool isSpecular() const
+    __host__ RT_FUNCTION bool isSpecular() const
     {
         return (nBxDFs(BxDF::Type(BxDF::All & ~BxDF::Specular)) == 0);
     }
@@ -165,10 +167,10 @@ public:
     // Return bsdf factor for directions oWorldWi and aWorldWi
     // Following typical conventions Wo corresponds to light outgoing direction, 
     // Wi is incident direction. Returns pdf if oPdf not NULL
-    RT_FUNCTION optix::float3 f( const optix::float3 & aWorldWo,
-                                 const optix::float3 & aWorldWi, 
-                                 BxDF::Type            aSampleType = BxDF::All,
-                                 float               * oPdf = NULL) const
+    __host__ RT_FUNCTION optix::float3 f( const optix::float3 & aWorldWo,
+                                          const optix::float3 & aWorldWi, 
+                                          BxDF::Type            aSampleType = BxDF::All,
+                                          float               * oPdf = NULL) const
     {
         optix::float3 wo = _diffGemetry.ToLocal(aWorldWo);
         optix::float3 wi = _diffGemetry.ToLocal(aWorldWi);
@@ -209,14 +211,14 @@ public:
     //
     // Last parameter aRadianceFromCamera used for VCM to handle specular transmission, since in that
     // case radiance "flows" from camera and light particle weights/importance from light source
-    RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWorldWo,
-                                       optix::float3       * oWorldWi, 
-                                       const optix::float3 & aSample,
-                                       float               * oPdfW,
-                                       float               * oCosThetaWi = NULL,
-                                       BxDF::Type            aSampleType = BxDF::All,
-                                       BxDF::Type          * oSampledType = NULL,
-                                       const bool            aRadianceFromCamera = false ) const
+    __host__ RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWorldWo,
+                                                optix::float3       * oWorldWi, 
+                                                const optix::float3 & aSample,
+                                                float               * oPdfW,
+                                                float               * oCosThetaWi = NULL,
+                                                BxDF::Type            aSampleType = BxDF::All,
+                                                BxDF::Type          * oSampledType = NULL,
+                                                const bool            aRadianceFromCamera = false ) const
     {
         // Count matched components.
         unsigned int nMatched = nBxDFs(aSampleType);
@@ -311,12 +313,12 @@ private:
     optix::float3 _localDirFix;    // following convention in SmallVCM, "fix" is corresponds to fixed incident dir stored 
                                    // at hit point opposed to "gen" for generated
 public:
-    RT_FUNCTION VcmBSDF() : BSDF() { }
+    __host__ RT_FUNCTION VcmBSDF() : BSDF() { }
 
-    RT_FUNCTION VcmBSDF( const DifferentialGeometry aDiffGeomShading,
-                         const optix::float3      & aWorldGeometricNormal,
-                         const optix::float3      & aIncidentDir,
-                         const bool                 aIncidentDirIsLight ) : 
+    __host__ RT_FUNCTION VcmBSDF( const DifferentialGeometry aDiffGeomShading,
+                                  const optix::float3      & aWorldGeometricNormal,
+                                  const optix::float3      & aIncidentDir,
+                                  const bool                 aIncidentDirIsLight ) : 
                 BSDF( aDiffGeomShading, aWorldGeometricNormal ) , _dirFixIsLight(aIncidentDirIsLight)
     {
         _localDirFix = _diffGemetry.ToLocal(aIncidentDir);
@@ -325,52 +327,52 @@ public:
     }
 
     // generates tangent and bitangent
-    RT_FUNCTION VcmBSDF( const optix::float3 & aWorldGeometricNormal,
-                         const optix::float3 & aIncidentDir,
-                         const bool            aIncidentDirIsLight  ) : BSDF(aWorldGeometricNormal) , _dirFixIsLight(aIncidentDirIsLight)
+    __host__ RT_FUNCTION VcmBSDF( const optix::float3 & aWorldGeometricNormal,
+                                  const optix::float3 & aIncidentDir,
+                                  const bool            aIncidentDirIsLight  ) : BSDF(aWorldGeometricNormal) , _dirFixIsLight(aIncidentDirIsLight)
     {
         _localDirFix = _diffGemetry.ToLocal(aIncidentDir);
         memset(_bxdfPickProb, 0, MAX_N_BXDFS * sizeof(float));
         _continuationProb = 0.f;
     }
 
-    RT_FUNCTION int isValid() const { return EPS_COSINE < _localDirFix.z; }
+    __host__ RT_FUNCTION int isValid() const { return EPS_COSINE < _localDirFix.z; }
 
-    RT_FUNCTION bool dirFixIsLight() const { return _dirFixIsLight; }
+    __host__ RT_FUNCTION bool dirFixIsLight() const { return _dirFixIsLight; }
 
-    RT_FUNCTION optix::float3 localDirFix() const { return _localDirFix; }
+    __host__ RT_FUNCTION optix::float3 localDirFix() const { return _localDirFix; }
+
+    __host__ RT_FUNCTION optix::float3 worldDirFix() const { return _diffGemetry.ToWorld(_localDirFix); }
 
     // Continuation probability for Russian roulette
-    RT_FUNCTION float continuationProb() const { return _continuationProb; }
+    __host__ RT_FUNCTION float continuationProb() const { return _continuationProb; }
 
-    // Add BxDF. Returns 0 if failed, e.g. MAX_N_BXDFS reached
-    RT_FUNCTION int AddBxDF(const BxDF * bxdf)//, uint2 * launchIndex = NULL)
+    // Add BxDF of one of the BxDFTypes. Returns 0 if failed, e.g. MAX_N_BXDFS reached
+    template<typename T>
+    __host__ RT_FUNCTION int AddBxDF(const T * bxdf)//, uint2 * launchIndex = NULL)
     {
+        static_assert(BxDFTag<T>::value < BxDFTypeCount<BxDFTypes>::value, "AddBxDF takes one of the BxDFTypes");
         if (_nBxDFs == MAX_N_BXDFS) return 0;
 
         // get BxDF list address and copy data
-        // don't care if copy too much, extra bytes won't be used by target type anyway
-        BxDF *pBxDF = reinterpret_cast<BxDF *>(&_bxdfList[_nBxDFs * MAX_BXDF_SIZE]);
-        memcpy(pBxDF, bxdf, MAX_BXDF_SIZE); 
+        memcpy(&_bxdfList[_nBxDFs * MAX_BXDF_SIZE], bxdf, sizeof(T));
 
-        float rrContProb = 0.f;
-        CALL_BXDF_CONST_VIRTUAL_FUNCTION(rrContProb, +=, pBxDF, continuationProb, _localDirFix);
+        // the type is known here, no dispatch needed
+        float rrContProb = bxdf->continuationProb(_localDirFix);
 
         // Setting continuation probability explicitly (instead of using arbitrary values) for russian roulette 
         // to make sure the weight of sample never rise
         _continuationProb = optix::fminf(1.f, _continuationProb + rrContProb);
 
         // setting pick probability unweighted by other BxDFs, weighted during sampling based sampled BxDF types
-        float albedo = 0.f;
-        CALL_BXDF_CONST_VIRTUAL_FUNCTION(albedo, +=, pBxDF, albedo, _localDirFix);
-        _bxdfPickProb[_nBxDFs] = albedo;
+        _bxdfPickProb[_nBxDFs] = bxdf->albedo(_localDirFix);
 
         _nBxDFs++;
         return 1;
     }
 
 protected:
-    RT_FUNCTION unsigned int sampleBxDF(float sample, BxDF::Type aType, unsigned int & oBxdfIndex, float & oMatchedPickProbSum) const
+    __host__ RT_FUNCTION unsigned int sampleBxDF(float sample, BxDF::Type aType, unsigned int & oBxdfIndex, float & oMatchedPickProbSum) const
     {
         unsigned int nMatched = nBxDFs(aType);
         if (nMatched == 0) return 0;
@@ -396,7 +398,7 @@ protected:
     }
 
 
-    RT_FUNCTION float sumPickProb(BxDF::Type aType) const
+    __host__ RT_FUNCTION float sumPickProb(BxDF::Type aType) const
     {
         float contProb = 0.f;
         for (unsigned int i = 0; i < _nBxDFs; ++i)
@@ -411,7 +413,7 @@ protected:
 
 public:
     // Evaulates pdf for given direction, returns reverse pdf if aEvalRevPdf == true
-    RT_FUNCTION float pdf( optix::float3 & oWorldDirGen, BxDF::Type aSampleType = BxDF::All, bool aEvalRevPdf = false ) const
+    __host__ RT_FUNCTION float pdf( optix::float3 & oWorldDirGen, BxDF::Type aSampleType = BxDF::All, bool aEvalRevPdf = false ) const
     {      
         optix::float3 wi = _diffGemetry.ToLocal(oWorldDirGen);
 
@@ -437,12 +439,12 @@ public:
     // Return bsdf factor for sampled direction oWorldWi. Returns pdf in and sampled BxDF.
     // Following typical conventions Wo corresponds to light outgoing direction, 
     // Wi is sampled incident direction
-    RT_FUNCTION optix::float3 vcmSampleF( optix::float3       * oWorldDirGen,
-                                          const optix::float3 & aSample,
-                                          float               * oPdfW,
-                                          float               * oCosThetaOut, //= NULL,
-                                          BxDF::Type            aSampleType = BxDF::All,
-                                          BxDF::Type          * oSampledType = NULL ) const
+    __host__ RT_FUNCTION optix::float3 vcmSampleF( optix::float3       * oWorldDirGen,
+                                                   const optix::float3 & aSample,
+                                                   float               * oPdfW,
+                                                   float               * oCosThetaOut, //= NULL,
+                                                   BxDF::Type            aSampleType = BxDF::All,
+                                                   BxDF::Type          * oSampledType = NULL ) const
     {
         return sampleF(_diffGemetry.ToWorld(_localDirFix), oWorldDirGen, aSample, 
             oPdfW, oCosThetaOut, aSampleType, oSampledType, _dirFixIsLight);
@@ -460,14 +462,14 @@ protected:
     //
     // Last parameter aRadianceFromCamera used for VCM to handle specular transmission, since in that
     // case radiance "flows" from camera and light particle weights/importance from light source
-    RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWorldWo,
-                                       optix::float3       * oWorldWi, 
-                                       const optix::float3 & aSample,
-                                       float               * oPdfW,
-                                       float               * oCosThetaWi = NULL,
-                                       BxDF::Type            aSampleType = BxDF::All,
-                                       BxDF::Type          * oSampledType = NULL,
-                                       const bool            aRadianceFromCamera = false ) const
+    __host__ RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWorldWo,
+                                                optix::float3       * oWorldWi, 
+                                                const optix::float3 & aSample,
+                                                float               * oPdfW,
+                                                float               * oCosThetaWi = NULL,
+                                                BxDF::Type            aSampleType = BxDF::All,
+                                                BxDF::Type          * oSampledType = NULL,
+                                                const bool            aRadianceFromCamera = false ) const
     {
         // Count matched components.
         //unsigned int nMatched = nBxDFs(aSampleType);
@@ -574,12 +576,12 @@ public:
     // generated incident direction.
     // For VCM evaluation the stored direction localDirFix is used as Wo, generated direction aWorldDirGen as Wi,
     // either when tracing from light or camera. Similarly directPdf corresponds sampling from Wo->Wi, reverse to Wi->Wo
-    RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWorldDirGen,
-                                    float               & oCosThetaGen,
-                                    float               * oDirectPdfW,// = NULL,
-                                    float               * oReversePdfW,// = NULL,
-                                    const optix::uint2  * dbgLaunchIndex = NULL,
-                                    BxDF::Type            aSampleType = BxDF::All ) const
+    __host__ RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWorldDirGen,
+                                             float               & oCosThetaGen,
+                                             float               * oDirectPdfW,// = NULL,
+                                             float               * oReversePdfW,// = NULL,
+                                             const optix::uint2  * dbgLaunchIndex = NULL,
+                                             BxDF::Type            aSampleType = BxDF::All ) const
     {
         using namespace optix;
         
@@ -57,6 +57,96 @@
     lvalue op reinterpret_cast<const FresnelDielectric *>(fresnel)->function(__VA_ARGS__);
 
 
+class Lambertian;
+class Phong;
+class SpecularReflection;
+class SpecularTransmission;
+
+// Compile time list of the BxDF types. Each BxDF stores the index of its type in BxDFTypes as a one byte tag, set by
+// its own constructor, and BSDF calls the "virtual" functions with a switch over the tag and a static_cast to the
+// type (CALL_BXDF_CONST_VIRTUAL_FUNCTION in BSDF.h). BxDFTag is only defined for the types of the list, a BSDF does
+// not compile with a BxDF of any other type.
+struct BxDFTypeListEnd { };
+
+template<typename H, typename T>
+struct BxDFTypeList
+{
+    typedef H Head;
+    typedef T Tail;
+};
+
+typedef BxDFTypeList<Lambertian,
+        BxDFTypeList<Phong,
+        BxDFTypeList<SpecularReflection,
+        BxDFTypeList<SpecularTransmission, BxDFTypeListEnd> > > > BxDFTypes;
+
+// Index of T in the list
+template<typename T, typename List>
+struct BxDFTypeIndex;
+
+template<typename T, typename Tail>
+struct BxDFTypeIndex<T, BxDFTypeList<T, Tail> >
+{
+    enum { value = 0 };
+};
+
+template<typename T, typename Head, typename Tail>
+struct BxDFTypeIndex<T, BxDFTypeList<Head, Tail> >
+{
+    enum { value = 1 + BxDFTypeIndex<T, Tail>::value };
+};
+
+// Type at index I of the list
+template<typename List, unsigned int I>
+struct BxDFTypeAtIndex
+{
+    typedef typename BxDFTypeAtIndex<typename List::Tail, I - 1>::Type Type;
+};
+
+template<typename List>
+struct BxDFTypeAtIndex<List, 0>
+{
+    typedef typename List::Head Type;
+};
+
+template<typename List>
+struct BxDFTypeCount
+{
+    enum { value = 1 + BxDFTypeCount<typename List::Tail>::value };
+};
+
+template<>
+struct BxDFTypeCount<BxDFTypeListEnd>
+{
+    enum { value = 0 };
+};
+
+template<typename List>
+struct BxDFTypeMaxSize
+{
+    enum { tailSize = BxDFTypeMaxSize<typename List::Tail>::value };
+    enum { value = sizeof(typename List::Head) > tailSize ? sizeof(typename List::Head) : tailSize };
+};
+
+template<>
+struct BxDFTypeMaxSize<BxDFTypeListEnd>
+{
+    enum { value = 0 };
+};
+
+template<typename T>
+struct BxDFTag
+{
+    enum { value = BxDFTypeIndex<T, BxDFTypes>::value };
+};
+
+template<unsigned int Tag>
+struct BxDFTypeAt
+{
+    typedef typename BxDFTypeAtIndex<BxDFTypes, Tag>::Type Type;
+};
+
+
 class BxDF 
 {
 public:
@@ -81,84 +171,87 @@ public:
     };
 
 private:
-    Type  _type;
+    Type           _type;
+    unsigned char  _tag;    // index of the type in BxDFTypes
 
 public:
-    RT_FUNCTION BxDF(Type type) : _type(type) {  }
+    __host__ RT_FUNCTION BxDF(Type type, unsigned int tag) : _type(type), _tag(tag) {  }
 
-    RT_FUNCTION Type type() const { return _type; }
+    __host__ RT_FUNCTION Type type() const { return _type; }
+
+    __host__ RT_FUNCTION unsigned int tag() const { return _tag; }
 
     // Because we compress the basic types and BxDF types in a single _type variable, it is necessary to AND All first.
-    RT_FUNCTION bool matchFlags(Type type) const
+    __host__ RT_FUNCTION bool matchFlags(Type type) const
     {
         return (_type & All & type) == (_type & All);
     }
 
-    static RT_FUNCTION bool matchFlags(Type flagsToCheck, Type flagsToCheckFor)
+    static __host__ RT_FUNCTION bool matchFlags(Type flagsToCheck, Type flagsToCheckFor)
     {
         return (flagsToCheck & All & flagsToCheckFor) == (flagsToCheck & All);
     }
 
     // Evaluates brdf, returns pdf if oPdf is not NULL
-    RT_FUNCTION optix::float3 f( const optix::float3 & aWo,
-                                 const optix::float3 & aWi,
-                                 float               * oPdf = NULL ) const
+    __host__ RT_FUNCTION optix::float3 f( const optix::float3 & aWo,
+                                          const optix::float3 & aWi,
+                                          float               * oPdf = NULL ) const
     {
         if (*oPdf != NULL) *oPdf = 0.f;
         return optix::make_float3(0.0f);
     }
 
-    RT_FUNCTION float pdf( const optix::float3 & aWo, const optix::float3 & aWi, const bool aEvalReverse = false ) const
+    __host__ RT_FUNCTION float pdf( const optix::float3 & aWo, const optix::float3 & aWi, const bool aEvalReverse = false ) const
     {
         return 0.0f;
     }
 
 
-    RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
-                                       optix::float3       * oWi,
-                                       const optix::float2 & aSample,
-                                       float               * oPdf,
-                                       const bool            aComputeAdjoint = false ) const
+    __host__ RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
+                                                optix::float3       * oWi,
+                                                const optix::float2 & aSample,
+                                                float               * oPdf,
+                                                const bool            aComputeAdjoint = false ) const
     {
         *oWi = localReflect(aWo);
         *oPdf = 0.f;
         return optix::make_float3(0.0f);
     }
 
-    RT_FUNCTION optix::float3 rho( unsigned int  aNSamples,
-                                   const float * aSamples1, 
-                                   const float * aSamples2 ) const
+    __host__ RT_FUNCTION optix::float3 rho( unsigned int  aNSamples,
+                                            const float * aSamples1, 
+                                            const float * aSamples2 ) const
     {
         return optix::make_float3(0.0f);
     }
 
     // for Russian Roulette continuation prob computation
-    RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
     {
         return 0.f;
     }
 
     // for bxdf sampling probability
-    RT_FUNCTION float albedo( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float albedo( const optix::float3 & aWo ) const
     {
         return 0.f;
     }
 
     // Evaluation for VCM returning also reverse pdfs, default implementation of "virtual" functions
-    RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
-                                    const optix::float3 & aWi,
-                                    float               * oDirectPdf = NULL,
-                                    float               * oReversePdf = NULL ) const
+    __host__ RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
+                                             const optix::float3 & aWi,
+                                             float               * oDirectPdf = NULL,
+                                             float               * oReversePdf = NULL ) const
     {
         if (*oDirectPdf != NULL) *oDirectPdf = 0.f;
         if (*oReversePdf != NULL) *oReversePdf = 0.f;
         return optix::make_float3(0.0f);
     }
 
-    RT_FUNCTION void vcmPdf( const optix::float3 & aWo,
-                             const optix::float3 & aWi,
-                             float * oDirectPdf = NULL,
-                             float * oReversePdf = NULL) const
+    __host__ RT_FUNCTION void vcmPdf( const optix::float3 & aWo,
+                                      const optix::float3 & aWi,
+                                      float * oDirectPdf = NULL,
+                                      float * oReversePdf = NULL) const
     {
         if (*oDirectPdf != NULL) *oDirectPdf = 0.f;
         if (*oReversePdf != NULL) *oReversePdf = 0.f;
@@ -175,22 +268,22 @@ public:
     optix::float3  _reflectance;
 
 public:
-    RT_FUNCTION Lambertian( const optix::float3 & aReflectance ) :
-        BxDF(BxDF::Type(BxDF::Lambertian | BxDF::Reflection | BxDF::Diffuse)),
+    __host__ RT_FUNCTION Lambertian( const optix::float3 & aReflectance ) :
+        BxDF(BxDF::Type(BxDF::Lambertian | BxDF::Reflection | BxDF::Diffuse), BxDFTag<Lambertian>::value),
         _reflectance(aReflectance) {  }
 
     // Evaluates brdf, returns pdf if oPdf is not NULL
-    RT_FUNCTION optix::float3 f( const optix::float3 & aWo,
-                                 const optix::float3 & aWi,
-                                 float * oPdfW = NULL  ) const
+    __host__ RT_FUNCTION optix::float3 f( const optix::float3 & aWo,
+                                          const optix::float3 & aWi,
+                                          float * oPdfW = NULL  ) const
     {
         if (*oPdfW != NULL) *oPdfW = pdf(aWo, aWi);
         return _reflectance * M_1_PIf;
     }
 
-    RT_FUNCTION float pdf( const optix::float3 & aWo,
-                           const optix::float3 & aWi,
-                           const bool            aEvalReverse = false ) const
+    __host__ RT_FUNCTION float pdf( const optix::float3 & aWo,
+                                    const optix::float3 & aWi,
+                                    const bool            aEvalReverse = false ) const
     {
         if (localIsSameHemisphere(aWo, aWi))
         {
@@ -202,11 +295,11 @@ public:
         return 0.f;
     }
 
-    RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
-                                       optix::float3       * oWi,
-                                       const optix::float2 & aSample,
-                                       float               * oPdfW,
-                                       const bool            aComputeAdjoint = false ) const
+    __host__ RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
+                                                optix::float3       * oWi,
+                                                const optix::float2 & aSample,
+                                                float               * oPdfW,
+                                                const bool            aComputeAdjoint = false ) const
     {
         if (aWo.z < EPS_COSINE)
         {
@@ -222,30 +315,30 @@ public:
         return f(aWo, *oWi);
     }
 
-    RT_FUNCTION optix::float3 rho( unsigned int  aNSamples,
-                                   const float * aSamples1,
-                                   const float * aSamples2 ) const
+    __host__ RT_FUNCTION optix::float3 rho( unsigned int  aNSamples,
+                                            const float * aSamples1,
+                                            const float * aSamples2 ) const
     {
         return _reflectance;
     }
 
     // for Russian Roulette continuation prob computation
-    RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
     {
         return optix::fmaxf(_reflectance.x, maxf(_reflectance.y, _reflectance.z));
     }
 
     // for bxdf sampling probability
-    RT_FUNCTION float albedo( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float albedo( const optix::float3 & aWo ) const
     {
         return optix::luminanceCIE(_reflectance);
     }
 
     // Evaluation for VCM returning also reverse pdfs, localDirFix in VcmBSDF should be passed as aWo 
-    RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
-                                    const optix::float3 & aWi,
-                                    float               * oDirectPdfW = NULL,
-                                    float               * oReversePdfW = NULL) const
+    __host__ RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
+                                             const optix::float3 & aWi,
+                                             float               * oDirectPdfW = NULL,
+                                             float               * oReversePdfW = NULL) const
     {
         using namespace optix;
         if(aWo.z < EPS_COSINE || aWi.z < EPS_COSINE)
@@ -273,26 +366,26 @@ public:
     float          _exponent;
 
 public:
-    RT_FUNCTION Phong( const optix::float3 & aReflectance, const float aExponent ) :
-        BxDF(BxDF::Type( BxDF::Phong | BxDF::Reflection | BxDF::Glossy )),
+    __host__ RT_FUNCTION Phong( const optix::float3 & aReflectance, const float aExponent ) :
+        BxDF(BxDF::Type( BxDF::Phong | BxDF::Reflection | BxDF::Glossy ), BxDFTag<Phong>::value),
         _reflectance(aReflectance), _exponent(aExponent) {  }
 
     // for Russian Roulette continuation prob computation
-    RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
     {
         return optix::fmaxf(_reflectance.x, maxf(_reflectance.y, _reflectance.z));
     }
 
     // for bxdf sampling probability
-    RT_FUNCTION float albedo( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float albedo( const optix::float3 & aWo ) const
     {
         return optix::luminanceCIE(_reflectance);
     }
 
     // Evaluates brdf, returns pdf if oPdf is not NULL
-    RT_FUNCTION optix::float3 f( const optix::float3 & aWo,
-                                 const optix::float3 & aWi,
-                                 float * oPdfW = NULL  ) const
+    __host__ RT_FUNCTION optix::float3 f( const optix::float3 & aWo,
+                                          const optix::float3 & aWi,
+                                          float * oPdfW = NULL  ) const
     {
         using namespace optix;
 
@@ -318,9 +411,9 @@ public:
         return rho * powf(dot_R_Wi, _exponent);
     }
 
-    RT_FUNCTION float pdf( const optix::float3 & aWo, // dirFix for VCN
-                           const optix::float3 & aWi, // dirGen
-                           const bool            aEvalReverse = false ) const
+    __host__ RT_FUNCTION float pdf( const optix::float3 & aWo, // dirFix for VCN
+                                    const optix::float3 & aWi, // dirGen
+                                    const bool            aEvalReverse = false ) const
     {
         using namespace optix;
         const float3 reflLocalDirIn = localReflect(aWo);
@@ -332,11 +425,11 @@ public:
         return powerCosHemispherePdfW(reflLocalDirIn, aWi, _exponent);
     }
 
-    RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
-                                       optix::float3       * oWi,
-                                       const optix::float2 & aSample,
-                                       float               * oPdfW,
-                                       const bool            aComputeAdjoint = false ) const
+    __host__ RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
+                                                optix::float3       * oWi,
+                                                const optix::float2 & aSample,
+                                                float               * oPdfW,
+                                                const bool            aComputeAdjoint = false ) const
     {
         using namespace optix;
 
@@ -373,19 +466,19 @@ public:
         return rho * powf(dot_R_Wi, _exponent);
     }
 
-    RT_FUNCTION optix::float3 rho( unsigned int  aNSamples,
-                                   const float * aSamples1,
-                                   const float * aSamples2 ) const
+    __host__ RT_FUNCTION optix::float3 rho( unsigned int  aNSamples,
+                                            const float * aSamples1,
+                                            const float * aSamples2 ) const
     {
         return _reflectance * (_exponent + 2.f) * 0.5f * M_1_PIf;
     }
 
 
     // Evaluation for VCM returning also reverse pdfs, localDirFix in VcmBSDF should be passed as aWo 
-    RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
-                                    const optix::float3 & aWi,
-                                    float               * oDirectPdfW = NULL,
-                                    float               * oReversePdfW = NULL ) const
+    __host__ RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
+                                             const optix::float3 & aWi,
+                                             float               * oDirectPdfW = NULL,
+                                             float               * oReversePdfW = NULL ) const
     {
         float pdf = 0.f;
         float3 f = this->f(aWo, aWi, &pdf);        
@@ -404,8 +497,9 @@ private:
     char           _fresnel[MAX_FRESNEL_SIZE];
 
 public:
-    RT_FUNCTION SpecularReflection(const optix::float3 & aReflectance, Fresnel * aFresnel) :
-        BxDF(BxDF::Type(BxDF::SpecularReflection | BxDF::Reflection | BxDF::Specular)),
+    __host__ RT_FUNCTION SpecularReflection(const optix::float3 & aReflectance, Fresnel * aFresnel) :
+        BxDF(BxDF::Type(BxDF::SpecularReflection | BxDF::Reflection | BxDF::Specular),
+             BxDFTag<SpecularReflection>::value),
         _reflectance(aReflectance) 
     {
         Fresnel *fresnel = reinterpret_cast<Fresnel *>(&_fresnel);
@@ -413,18 +507,18 @@ public:
     }
 
 public:
-    RT_FUNCTION Fresnel * fresnel() 
+    __host__ RT_FUNCTION Fresnel * fresnel() 
     {
         return reinterpret_cast<Fresnel *>(_fresnel);
     }
 
-    RT_FUNCTION const Fresnel * fresnel() const
+    __host__ RT_FUNCTION const Fresnel * fresnel() const
     {
         return reinterpret_cast<const Fresnel *>(_fresnel);
     }
 
     // for Russian Roulette continuation prob computation
-    RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
     {
         float R;
         CALL_FRESNEL_CONST_VIRTUAL_FUNCTION(R, =, fresnel(), evaluate, localCosTheta(aWo));
@@ -432,28 +526,28 @@ public:
     }
 
     // for bxdf sampling probability
-    RT_FUNCTION float albedo( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float albedo( const optix::float3 & aWo ) const
     {
         float R;
         CALL_FRESNEL_CONST_VIRTUAL_FUNCTION(R, =, fresnel(), evaluate, localCosTheta(aWo));
         return R * optix::luminanceCIE(_reflectance);
     }
 
-    RT_FUNCTION optix::float3 f( const optix::float3 & /* wo */, const optix::float3 & /* wi */, float * oPdfW = NULL) const
+    __host__ RT_FUNCTION optix::float3 f( const optix::float3 & /* wo */, const optix::float3 & /* wi */, float * oPdfW = NULL) const
     {
         return optix::make_float3(0.0f);
     }
 
-    RT_FUNCTION float pdf(const optix::float3 & wo, const optix::float3 & wi, const bool aEvalReverse = false ) const
+    __host__ RT_FUNCTION float pdf(const optix::float3 & wo, const optix::float3 & wi, const bool aEvalReverse = false ) const
     {
         return 0.0f;
     }
 
-    RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
-                                       optix::float3       * oWi,
-                                       const optix::float2 & aSample,
-                                       float               * oPdfW,
-                                       const bool            aComputeAdjoint = false ) const
+    __host__ RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
+                                                optix::float3       * oWi,
+                                                const optix::float2 & aSample,
+                                                float               * oPdfW,
+                                                const bool            aComputeAdjoint = false ) const
     {
         *oWi = optix::make_float3(-aWo.x, -aWo.y, aWo.z);
         *oPdfW = 1.0f;
@@ -466,10 +560,10 @@ public:
     }
 
     // Evaluation for VCM returning also reverse pdfs, localDirFix in VcmBSDF should be passed as aWo 
-    RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
-                                    const optix::float3 & aWi,
-                                    float               * oDirectPdfW = NULL,
-                                    float               * oReversePdfW = NULL ) const
+    __host__ RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
+                                             const optix::float3 & aWi,
+                                             float               * oDirectPdfW = NULL,
+                                             float               * oReversePdfW = NULL ) const
     {
         float pdf = 0.f;      
         if (oDirectPdfW)  *oDirectPdfW = pdf;
@@ -488,27 +582,28 @@ private:
     FresnelDielectric  _fresnel;
 
 public:
-    RT_FUNCTION SpecularTransmission(const optix::float3 & transmittance, float ei, float et) :
-        BxDF(BxDF::Type(BxDF::SpecularTransmission | BxDF::Transmission | BxDF::Specular)),
+    __host__ RT_FUNCTION SpecularTransmission(const optix::float3 & transmittance, float ei, float et) :
+        BxDF(BxDF::Type(BxDF::SpecularTransmission | BxDF::Transmission | BxDF::Specular),
+             BxDFTag<SpecularTransmission>::value),
         _transmittance(transmittance), _fresnel(ei, et) {  }
 
 public:
-    RT_FUNCTION FresnelDielectric * fresnel() { return &_fresnel; }
-    RT_FUNCTION const FresnelDielectric * fresnel() const { return &_fresnel; }
+    __host__ RT_FUNCTION FresnelDielectric * fresnel() { return &_fresnel; }
+    __host__ RT_FUNCTION const FresnelDielectric * fresnel() const { return &_fresnel; }
 
 public:
-    RT_FUNCTION optix::float3 f( const optix::float3 & wo , const optix::float3 &  wi, float * oPdfW = NULL ) const
+    __host__ RT_FUNCTION optix::float3 f( const optix::float3 & wo , const optix::float3 &  wi, float * oPdfW = NULL ) const
     {
         return optix::make_float3(0.0f);
     }
 
-    RT_FUNCTION float pdf( const optix::float3 & wo, const optix::float3 & wi, const bool aEvalReverse = false ) const
+    __host__ RT_FUNCTION float pdf( const optix::float3 & wo, const optix::float3 & wi, const bool aEvalReverse = false ) const
     {
         return 0.0f;
     }
 
     // for Russian Roulette continuation prob computation
-    RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float continuationProb( const optix::float3 & aWo ) const
     {
         float R;
         CALL_FRESNEL_CONST_VIRTUAL_FUNCTION(R, =, fresnel(), evaluate, localCosTheta(aWo));
@@ -516,18 +611,18 @@ public:
     }
 
     // for bxdf sampling probability
-    RT_FUNCTION float albedo( const optix::float3 & aWo ) const
+    __host__ RT_FUNCTION float albedo( const optix::float3 & aWo ) const
     {
         float R;
         CALL_FRESNEL_CONST_VIRTUAL_FUNCTION(R, =, fresnel(), evaluate, localCosTheta(aWo));
         return (1.f - R) * optix::luminanceCIE(_transmittance);
     }
 
-    RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
-                                       optix::float3       * oWi,
-                                       const optix::float2 & aSample,
-                                       float               * oPdfW,
-                                       const bool            aComputeAdjoint = false ) const
+    __host__ RT_FUNCTION optix::float3 sampleF( const optix::float3 & aWo,
+                                                optix::float3       * oWi,
+                                                const optix::float2 & aSample,
+                                                float               * oPdfW,
+                                                const bool            aComputeAdjoint = false ) const
     {
         using namespace optix;
         
@@ -564,10 +659,10 @@ public:
     }
 
     // Evaluation for VCM returning also reverse pdfs, localDirFix in VcmBSDF should be passed as aWo 
-    RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
-                                    const optix::float3 & aWi,
-                                    float               * oDirectPdfW = NULL,
-                                    float               * oReversePdfW = NULL ) const
+    __host__ RT_FUNCTION optix::float3 vcmF( const optix::float3 & aWo,
+                                             const optix::float3 & aWi,
+                                             float               * oDirectPdfW = NULL,
+                                             float               * oReversePdfW = NULL ) const
     {
         float pdf = 0.f;      
         if (oDirectPdfW)  *oDirectPdfW = pdf;
@@ -577,4 +672,4 @@ public:
 };
 
 
-static const unsigned int  MAX_BXDF_SIZE  = sizeof(SpecularReflection);
\ No newline at end of file
+static const unsigned int  MAX_BXDF_SIZE  = BxDFTypeMaxSize<BxDFTypes>::value;
\ No newline at end of file
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "LightAliasTable.h"
+#include <vector>
+
+// Vose's method: slots under the average weight are filled up by one slot over it, which becomes their alias
+void buildLightAliasTable(const Light* lights, unsigned int numLights, LightAliasEntry* table)
+{
+    if(numLights == 0)
+    {
+        return;
+    }
+
+    double totalWeight = 0;
+    for(unsigned int i = 0; i < numLights; i++)
+    {
+        totalWeight += getLightSelectionWeight(lights[i].power);
+    }
+
+    std::vector<double> scaledWeights (numLights);
+    std::vector<unsigned int> small, large;
+    for(unsigned int i = 0; i < numLights; i++)
+    {
+        double pdf = totalWeight > 0 ? getLightSelectionWeight(lights[i].power)/totalWeight : 1.0/numLights;
+        table[i].pdf = float(pdf);
+        table[i].probability = 1.f;
+        table[i].alias = i;
+        scaledWeights[i] = pdf*numLights;
+        if(scaledWeights[i] < 1)
+        {
+            small.push_back(i);
+        }
+        else
+        {
+            large.push_back(i);
+        }
+    }
+
+    while(!small.empty() && !large.empty())
+    {
+        unsigned int lower = small.back();
+        small.pop_back();
+        unsigned int upper = large.back();
+        table[lower].probability = float(scaledWeights[lower]);
+        table[lower].alias = upper;
+        scaledWeights[upper] -= 1 - scaledWeights[lower];
+        if(scaledWeights[upper] < 1)
+        {
+            large.pop_back();
+            small.push_back(upper);
+        }
+    }
+
+    // Whatever is left is 1 up to rounding and keeps its own light
+    for(size_t i = 0; i < small.size(); i++)
+    {
+        table[small[i]].probability = 1.f;
+    }
+    for(size_t i = 0; i < large.size(); i++)
+    {
+        table[large[i]].probability = 1.f;
+    }
+}
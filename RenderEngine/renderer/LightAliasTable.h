@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include "renderer/device_common.h"
+#include "renderer/Light.h"
+#include "render_engine_export_api.h"
+
+/*
+Alias table (Walker, Vose) over the lights of the scene, so photon emission, the VCM light pass and next event estimation
+pick a light with probability proportional to its emitted power in O(1). Slot i of the table is chosen uniformly and
+keeps its own light with the given probability, otherwise it gives its alias.
+
+Light::power is already the total flux of a light (area lights derive Lemit from it and the area), so the weight is
+the average of its channels. pdf is the probability to pick the light of the slot, the pick pdf in the MIS terms. A
+table of lights without power picks them uniformly.
+*/
+
+struct LightAliasEntry
+{
+    float probability;
+    unsigned int alias;
+    float pdf;
+};
+
+static __host__ RT_FUNCTION float getLightSelectionWeight(const optix::float3 & power)
+{
+    return optix::fmaxf(0.f, (power.x + power.y + power.z)*(1.f/3.f));
+}
+
+// Picks a light with one uniform sample in [0,1), works on an rtBufferId on the device and a std::vector on the host
+template<typename Table>
+static __host__ RT_FUNCTION unsigned int sampleLightAliasTable(const Table & table, float sample, float & pdf)
+{
+    const unsigned int size = (unsigned int)table.size();
+    float scaledSample = sample*size;
+    unsigned int slot = (unsigned int)scaledSample < size ? (unsigned int)scaledSample : size - 1;
+    LightAliasEntry entry = table[slot];
+    unsigned int index = (scaledSample - slot) < entry.probability ? slot : entry.alias;
+    pdf = index == slot ? entry.pdf : table[index].pdf;
+    return index;
+}
+
+#ifndef __CUDACC__
+RENDER_ENGINE_EXPORT_API void buildLightAliasTable(const Light* lights, unsigned int numLights, LightAliasEntry* table);
+#endif
@@ -24,9 +24,7 @@ namespace OptixEntryPoint
 #if ENABLE_PARTICIPATING_MEDIA
         PPM_CLEAR_VOLUMETRIC_PHOTONS_PASS,
 #endif
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
         PPM_CLEAR_PHOTONS_UNIFORM_GRID_PASS,
-#endif
         NUM_PASSES
     };
 }
\ No newline at end of file
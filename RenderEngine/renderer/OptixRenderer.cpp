@@ -8,38 +8,37 @@
 */
 
 #include <cuda.h>
-#include <curand_kernel.h>
 #include "OptixRenderer.h"
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <limits>
+#include <ctime>
 #include "config.h"
-#include "RandomState.h"
 #include "renderer/OptixEntryPoint.h"
 #include "renderer/Hitpoint.h"
 #include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PhotonDump.h"
+#include "renderer/ppm/PackedPhotons.h"
 #include "Camera.h"
 #include <QThread>
 #include "renderer/RayType.h"
+#include "renderer/LightAliasTable.h"
 #include "ComputeDevice.h"
 #include "clientserver/RenderServerRenderRequest.h"
 #include <exception>
 #include "util/sutil.h"
 #include "scene/IScene.h"
-#include "renderer/helpers/nsight.h"
 #include "renderer/helpers/samplers.h"
 #include "renderer/vcm/LightVertex.h"
+#include "renderer/vcm/LightVertexGrid.h"
 #include "renderer/vcm/config_vcm.h"
 #include "renderer/vcm/vcm_shared.h"
 #include "util/logging.h"
+#include "renderer/pt/HostPathTracer.h"
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
 const unsigned int OptixRenderer::PHOTON_GRID_MAX_SIZE = 100*100*100;
-#else
-const unsigned int OptixRenderer::PHOTON_GRID_MAX_SIZE = 0;
-#endif
 
 const unsigned int OptixRenderer::MAX_PHOTON_COUNT = MAX_PHOTONS_DEPOSITS_PER_EMITTED;
 const unsigned int OptixRenderer::PHOTON_LAUNCH_WIDTH = 1024;
@@ -48,6 +47,7 @@ const unsigned int OptixRenderer::PHOTON_LAUNCH_HEIGHT = 1024;
 
 const unsigned int OptixRenderer::EMITTED_PHOTONS_PER_ITERATION = OptixRenderer::PHOTON_LAUNCH_WIDTH*OptixRenderer::PHOTON_LAUNCH_HEIGHT;
 const unsigned int OptixRenderer::NUM_PHOTONS = OptixRenderer::EMITTED_PHOTONS_PER_ITERATION*OptixRenderer::MAX_PHOTON_COUNT;
+const unsigned int OptixRenderer::MIN_EMITTED_PHOTONS_PER_ITERATION = OptixRenderer::PHOTON_LAUNCH_WIDTH*16;
 
 // VCM
 const unsigned int OptixRenderer::VCM_MAX_PATH_LENGTH = 10u;
@@ -62,27 +62,63 @@ const unsigned int OptixRenderer::VCM_NUM_LIGHT_PATH_CONNECTIONS = 1u;
 
 using namespace optix;
 
-inline unsigned int pow2roundup(unsigned int x)
+inline float max(float a, float b)
 {
-    --x;
-    x |= x >> 1;
-    x |= x >> 2;
-    x |= x >> 4;
-    x |= x >> 8;
-    x |= x >> 16;
-    return x+1;
+  return a > b ? a : b;
 }
 
-inline float max(float a, float b)
+static unsigned int createRandomSeed(unsigned int fixedSeed)
 {
-  return a > b ? a : b;
+    unsigned int seed = fixedSeed;
+    if(seed == 0)
+    {
+        seed = 574133*(unsigned int)clock() + 47844152748*(unsigned int)time(NULL);
+    }
+#ifdef DEBUG_RANDOM_SEED
+    seed = DEBUG_RANDOM_SEED;
+#endif
+    printf("Seeding on %u\n", seed);
+    return seed;
 }
 
 OptixRenderer::OptixRenderer() : 
     m_initialized(false),
-    m_lightVertexCountEstimated(false),
+    m_randomSeed(createRandomSeed(0)),
+    m_sampler(Sampler::E(DEFAULT_SAMPLER)),
+    m_photonsCompacted(NULL),
+    m_photonBufferSize(0),
+    m_numPhotonDeposits(0),
+    m_numEmittedPhotonsPerIteration(EMITTED_PHOTONS_PER_ITERATION),
+    m_photonKdTreeSize(0),
+    m_photonPowerScale(1.f),
+    m_numberOfPhotonsLastFrame(0),
+    m_spatialHashMapNumCells(0),
+    m_photonMapStructure(PhotonMapStructure::E(DEFAULT_ACCELERATION_STRUCTURE)),
+    m_lightPassBuffersSized(false),
+    m_lightVertexCount(0),
+    m_lightVertexBufferSize(0),
+    m_hostPathTracer(NULL),
     m_width(10),
     m_height(10)
+{
+
+}
+
+OptixRenderer::~OptixRenderer()
+{
+    delete m_hostPathTracer;
+    delete[] m_photonsCompacted;
+    if(m_context)
+    {
+        printf("Context Destroy\n");
+        m_context->destroy();
+        cudaDeviceReset();
+    }
+}
+
+// The OptiX context is created for the device, so machines without a CUDA device can render on the host device
+
+void OptixRenderer::createContext()
 {
     try
     {
@@ -103,13 +139,6 @@ OptixRenderer::OptixRenderer() :
     }
 }
 
-OptixRenderer::~OptixRenderer()
-{
-    printf("Context Destroy\n");
-    m_context->destroy();
-    cudaDeviceReset();
-}
-
 void OptixRenderer::initialize(const ComputeDevice & device)
 {
     if(m_initialized)
@@ -117,6 +146,14 @@ void OptixRenderer::initialize(const ComputeDevice & device)
         throw std::exception("ERROR: Multiple OptixRenderer::initialize!\n");
     }
 
+    if(device.isHost())
+    {
+        m_hostPathTracer = new HostPathTracer();
+        m_initialized = true;
+        return;
+    }
+
+    createContext();
     initDevice(device);
 
     m_context->setRayTypeCount(RayType::NUM_RAY_TYPES);
@@ -124,10 +161,15 @@ void OptixRenderer::initialize(const ComputeDevice & device)
     m_context->setStackSize(ENABLE_PARTICIPATING_MEDIA ? 3000 : 1596);
 
     m_context["maxPhotonDepositsPerEmitted"]->setUint(MAX_PHOTON_COUNT);
+    m_context["photonMapStructure"]->setUint(m_photonMapStructure);
     m_context["ppmAlpha"]->setFloat(0);
     m_context["totalEmitted"]->setFloat(0.0f);
     m_context["iterationNumber"]->setFloat(0.0f);
     m_context["localIterationNumber"]->setUint(0);
+    m_context["randomSeed"]->setUint(m_randomSeed);
+    m_context["randomIterationNumber"]->setUint(0);
+    m_context["sampler"]->setUint(m_sampler);
+    m_context["renderTileOrigin"]->setUint(0, 0);
     m_context["ppmRadius"]->setFloat(0.f);
     m_context["ppmRadiusSquared"]->setFloat(0.f);
     m_context["ppmRadiusSquaredNew"]->setFloat(0.f);
@@ -181,50 +223,68 @@ void OptixRenderer::initialize(const ComputeDevice & device)
         m_context->setExceptionProgram(OptixEntryPoint::PPM_PHOTON_PASS, exceptionProgram);
     }
 
+    // The photon buffers are sized by resizePhotonBuffers() below
+#if ENABLE_PHOTON_SOA_LAYOUT
+    m_photonPositions = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_FLOAT3);
+    m_context["photonPositions"]->set( m_photonPositions );
+    m_photonDirections = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT);
+    m_context["photonDirections"]->set( m_photonDirections );
+    m_photonPowers = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT);
+    m_context["photonPowers"]->set( m_photonPowers );
+    m_context["photonPowerScale"]->setFloat( m_photonPowerScale );
+#else
     m_photons = m_context->createBuffer(RT_BUFFER_OUTPUT);
     m_photons->setFormat( RT_FORMAT_USER );
     m_photons->setElementSize( sizeof( Photon ) );
-    m_photons->setSize( NUM_PHOTONS );
     m_context["photons"]->set( m_photons );
-    m_context["photonsSize"]->setUint( NUM_PHOTONS );
+#endif
+    m_photonDepositCounter = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+    m_context["photonDepositCounter"]->set( m_photonDepositCounter );
 
 #pragma region Acceleration structure
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
+    // All photon maps are set up, each render request picks the one it uses
 
-    optix::Buffer photonsHashTableCount = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, NUM_PHOTONS);
+    // Stochastic hash
+    optix::Buffer photonsHashTableCount = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT);
     m_context["photonsHashTableCount"]->set(photonsHashTableCount);
     {
         Program program = m_context->createProgramFromPTXFile( "UniformGridPhotonInitialize.cu.ptx", "kernel" );
         m_context->setRayGenerationProgram(OptixEntryPoint::PPM_CLEAR_PHOTONS_UNIFORM_GRID_PASS, program );
     }
-    m_context["photonsGridCellSize"]->setFloat(0.0f);
-    m_context["photonsGridCellSize"]->setFloat(0.0f);
-    m_context["photonsGridSize"]->setUint(0,0,0);
-    m_context["photonsWorldOrigo"]->setFloat(make_float3(0));
-
-#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
 
-    m_photonKdTreeSize = pow2roundup( NUM_PHOTONS + 1 ) - 1;
+    // Kd-tree, sized by createPhotonKdTreeOnCPU() when it is first used
     m_photonKdTree = m_context->createBuffer( RT_BUFFER_INPUT );
     m_photonKdTree->setFormat( RT_FORMAT_USER );
     m_photonKdTree->setElementSize( sizeof( Photon ) );
-    m_photonKdTree->setSize( m_photonKdTreeSize );
+    m_photonKdTree->setSize( 1 );
     m_context["photonKdTree"]->set( m_photonKdTree );
 
-#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
-
+    // Uniform grid
     m_context["photonsGridCellSize"]->setFloat(0.0f);
     m_context["photonsGridSize"]->setUint(0,0,0);
+    m_context["photonsGridMortonMasks"]->setUint(0,0,0);
     m_context["photonsWorldOrigo"]->setFloat(make_float3(0));
     m_photonsHashCells = m_context->createBuffer(RT_BUFFER_OUTPUT);
     m_photonsHashCells->setFormat( RT_FORMAT_UNSIGNED_INT );
-    m_photonsHashCells->setSize( NUM_PHOTONS );
     m_hashmapOffsetTable = m_context->createBuffer(RT_BUFFER_OUTPUT);
     m_hashmapOffsetTable->setFormat( RT_FORMAT_UNSIGNED_INT );
     m_hashmapOffsetTable->setSize( PHOTON_GRID_MAX_SIZE+1 );
     m_context["hashmapOffsetTable"]->set( m_hashmapOffsetTable );
 
-#endif
+    // Hashed grid, the uniform grid offset table holds its cell offsets. The buffers grow with the photons and cells
+    // of the iterations that use it.
+    m_photonsHashedGridKeys = m_context->createBuffer(RT_BUFFER_OUTPUT);
+    m_photonsHashedGridKeys->setFormat( RT_FORMAT_USER );
+    m_photonsHashedGridKeys->setElementSize( sizeof( unsigned long long ) );
+    m_photonsHashedGridKeys->setSize( 1 );
+    m_hashedGridCellKeys = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT2, 1);
+    m_context["hashedGridCellKeysBufferId"]->setInt( m_hashedGridCellKeys->getId() );
+    m_hashedGridTable = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+    m_context["hashedGridTableBufferId"]->setInt( m_hashedGridTable->getId() );
+    m_context["hashedGridTableMask"]->setUint(0);
+
+    // Start with room for one photon per emitted photon, most paths store fewer than MAX_PHOTON_COUNT
+    resizePhotonBuffers(EMITTED_PHOTONS_PER_ITERATION);
 #pragma endregion
 
     // Volumetric Photon Spheres buffer
@@ -298,7 +358,7 @@ void OptixRenderer::initialize(const ComputeDevice & device)
 
     // VCM initialization
     m_vcmUseVC = true;
-    m_vcmUseVM = false;
+    m_vcmUseVM = true;
     m_context["vcmUseVC"]->setInt(m_vcmUseVC);
     m_context["vcmUseVM"]->setInt(m_vcmUseVM);
     
@@ -313,11 +373,13 @@ void OptixRenderer::initialize(const ComputeDevice & device)
     m_lightPassLaunchHeight = m_height;
 #endif
 
-    // light vertex buffer
+    // light vertex buffer of compact light vertices (LightVertex.h)
+    static_assert(sizeof(LightVertex) == 60, "LightVertex is expected to be 15 words");
     m_lightVertexBuffer = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT);
     m_lightVertexBuffer->setFormat( RT_FORMAT_USER );
     m_lightVertexBuffer->setElementSize( sizeof( LightVertex ) );
     m_lightVertexBuffer->setSize( 1u );
+    m_lightVertexBufferSize = 1;
     m_context["lightVertexBuffer"]->set(m_lightVertexBuffer);
     m_context["lightVertexBufferId"]->setInt(m_lightVertexBuffer->getId());
     m_context["lightSubpathCount"]->setUint(m_lightPassLaunchWidth * m_lightPassLaunchHeight);
@@ -331,10 +393,32 @@ void OptixRenderer::initialize(const ComputeDevice & device)
     memset(bufferHost, 0, sizeof(optix::uint));
     m_lightVertexBufferIndexBuffer->unmap();
 
-    // Size is set in light pass length estimate pass
+    // Light vertex grid for vertex merging, rebuilt after each light pass. The buffers grow with the light vertex cache.
+    m_lightVertexGridKeys = m_context->createBuffer(RT_BUFFER_OUTPUT);
+    m_lightVertexGridKeys->setFormat( RT_FORMAT_USER );
+    m_lightVertexGridKeys->setElementSize( sizeof( unsigned long long ) );
+    m_lightVertexGridKeys->setSize( 1 );
+    m_lightVertexGridIndices = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+    m_lightVertexGridCellKeys = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT2, 1);
+    m_lightVertexGridCellOffsets = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+    m_lightVertexGridTable = m_context->createBuffer(RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1);
+    {
+        LightVertexGrid grid;
+        memset(&grid, 0, sizeof(LightVertexGrid));
+        grid.vertexIndexBufferId = m_lightVertexGridIndices->getId();
+        grid.cellKeyBufferId = m_lightVertexGridCellKeys->getId();
+        grid.cellOffsetBufferId = m_lightVertexGridCellOffsets->getId();
+        grid.tableBufferId = m_lightVertexGridTable->getId();
+        m_context["lightVertexGrid"]->setUserData(sizeof(LightVertexGrid), &grid);
+    }
+
+    // Sizes are set for the light pass launch on the first VCM iteration. The offsets of the subpaths in the light vertex
+    // buffer are the exclusive scan of the vertex counts of the count pass, plus the total.
     m_lightSubpathVertexCountBuffer = m_context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, 0u );
     m_context["lightSubpathVertexCountBuffer"]->set(m_lightSubpathVertexCountBuffer);
     m_context["lightSubpathVertexCountBufferId"]->setInt(m_lightSubpathVertexCountBuffer->getId());
+    m_lightSubpathVertexOffsetBuffer = m_context->createBuffer( RT_BUFFER_OUTPUT, RT_FORMAT_UNSIGNED_INT, 1u );
+    m_context["lightSubpathVertexOffsetBufferId"]->setInt(m_lightSubpathVertexOffsetBuffer->getId());
 
     m_context["lightVertexCountEstimatePass"]->setUint(1u);
     m_context["vcmNumlightVertexConnections"]->setUint(VCM_NUM_LIGHT_PATH_CONNECTIONS);
@@ -365,13 +449,6 @@ void OptixRenderer::initialize(const ComputeDevice & device)
         m_context->setMissProgram(RayType::CAMERA_VCM, missProgram);
     }
 
-    // Random state buffer (must be large enough to give states to both photons and image pixels)
-    m_randomStatesBuffer = m_context->createBuffer(RT_BUFFER_INPUT_OUTPUT|RT_BUFFER_GPU_LOCAL);
-    m_randomStatesBuffer->setFormat( RT_FORMAT_USER );
-    m_randomStatesBuffer->setElementSize( sizeof( RandomState ) );
-    m_randomStatesBuffer->setSize( std::max(PHOTON_LAUNCH_WIDTH, m_width), std::max(PHOTON_LAUNCH_HEIGHT, m_height) );
-    m_context["randomStates"]->set(m_randomStatesBuffer);
-    
     // Light sources buffer
     m_lightBuffer = m_context->createBuffer(RT_BUFFER_INPUT);
     m_lightBuffer->setFormat(RT_FORMAT_USER);
@@ -380,6 +457,14 @@ void OptixRenderer::initialize(const ComputeDevice & device)
     m_context["lights"]->set( m_lightBuffer );
     m_context["lightsBufferId"]->setInt(m_lightBuffer->getId());
 
+    // Power-proportional light selection, one alias table entry per light
+    m_lightAliasTableBuffer = m_context->createBuffer(RT_BUFFER_INPUT);
+    m_lightAliasTableBuffer->setFormat(RT_FORMAT_USER);
+    m_lightAliasTableBuffer->setElementSize(sizeof(LightAliasEntry));
+    m_lightAliasTableBuffer->setSize(1);
+    m_context["lightAliasTableBufferId"]->setInt(m_lightAliasTableBuffer->getId());
+    m_context["lightSelectionTotalWeight"]->setFloat(0.f);
+
     // Debug buffers
     createGpuDebugBuffers();
 
@@ -446,6 +531,13 @@ void OptixRenderer::initScene( IScene & scene )
         throw std::exception("No lights exists in this scene.");
     }
 
+    if(m_hostPathTracer != NULL)
+    {
+        m_hostPathTracer->initScene(scene);
+        m_sceneAABB = scene.getSceneAABB();
+        return;
+    }
+
 #if ENABLE_MESH_HITS_COUNTING
     int sceneNMeshes = scene.getNumMeshes();
     m_context["sceneNMeshes"]->setInt(sceneNMeshes);
@@ -458,7 +550,8 @@ void OptixRenderer::initScene( IScene & scene )
 
     try
     {
-        m_lightVertexCountEstimated = false;
+        m_lightPassBuffersSized = false;
+        m_photonMapCache.clear();
 
         m_sceneRootGroup = scene.getSceneRootGroup(m_context);
         m_context["sceneRootObject"]->set(m_sceneRootGroup);
@@ -473,6 +566,21 @@ void OptixRenderer::initScene( IScene & scene )
         memcpy(lights_host, scene.getSceneLights().constData(), sizeof(Light)*lights.size());
         m_lightBuffer->unmap();
 
+        m_lightAliasTableBuffer->setSize(lights.size());
+        LightAliasEntry* lightAliasTable_host = (LightAliasEntry*)m_lightAliasTableBuffer->map();
+        buildLightAliasTable(scene.getSceneLights().constData(), lights.size(), lightAliasTable_host);
+        m_photonPowerScale = getPhotonPowerScale(scene.getSceneLights().constData(), lightAliasTable_host, lights.size());
+        m_lightAliasTableBuffer->unmap();
+#if ENABLE_PHOTON_SOA_LAYOUT
+        m_context["photonPowerScale"]->setFloat(m_photonPowerScale);
+#endif
+        float lightSelectionTotalWeight = 0;
+        for(int i = 0; i < lights.size(); i++)
+        {
+            lightSelectionTotalWeight += getLightSelectionWeight(lights[i].power);
+        }
+        m_context["lightSelectionTotalWeight"]->setFloat(lightSelectionTotalWeight);
+
         compile();
 
     }
@@ -505,7 +613,8 @@ void OptixRenderer::compile()
 
 
 void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsigned long long localIterationNumber,
-                                        float PPMRadius, bool createOutput, const RenderServerRenderRequestDetails & details)
+                                        float PPMRadius, bool createOutput, const RenderServerRenderRequestDetails & details,
+                                        const RenderTile & tile)
 {
 #if ENABLE_RENDER_DEBUG_OUTPUT
     printf("----------------------- %d Local: %d\n", iterationNumber, localIterationNumber);
@@ -515,9 +624,24 @@ void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsi
         throw std::exception("Traced before OptixRenderer was initialized.");
     }
 
-    char buffer[40];
-    sprintf(buffer, "OptixRenderer::Trace Iteration %d", iterationNumber);
-    nvtx::ScopedRange r(buffer);
+    m_trace.setIterationNumber(iterationNumber);
+
+    if(m_hostPathTracer != NULL)
+    {
+        if(details.getRenderMethod() != RenderMethod::PATH_TRACING)
+        {
+            throw std::exception("Only path tracing can be rendered on the host device.");
+        }
+        RenderTrace::ScopedEvent event(m_trace, "Host path tracing", tile.isFullFrame() ?
+            details.getWidth()*details.getHeight() : tile.getNumPixels());
+        m_hostPathTracer->renderNextIteration(iterationNumber, localIterationNumber, details.getCamera(),
+            details.getWidth(), details.getHeight(), tile, m_randomSeed, m_sampler);
+        m_width = details.getWidth();
+        m_height = details.getHeight();
+        return;
+    }
+
+    RenderTrace::ScopedEvent iterationEvent(m_trace, "Iteration");
 
 #if ENABLE_MESH_HITS_COUNTING
     // print scene meshes count
@@ -547,36 +671,37 @@ void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsi
         const Camera & camera = details.getCamera();
         const RenderMethod::E renderMethod = details.getRenderMethod();
 
-        double traceStartTime;
-        sutilCurrentTime(&traceStartTime);
-    
-        double t0, t1;
+        // The camera rays of path tracing and VCM are launched over the tile only, the launch index is offset by
+        // renderTileOrigin to get the pixel
+        RenderTile launchTile = tile.isFullFrame() ? RenderTile(0, 0, m_width, m_height) : tile;
+        if(!launchTile.isInsideFrame(m_width, m_height))
+        {
+            throw std::exception("The render tile is outside of the frame.");
+        }
+        m_context["renderTileOrigin"]->setUint(launchTile.getX(), launchTile.getY());
 
         m_context["camera"]->setUserData( sizeof(Camera), &camera );
         m_context["iterationNumber"]->setFloat( static_cast<float>(iterationNumber));
         m_context["localIterationNumber"]->setUint((unsigned int)localIterationNumber);
+        m_context["randomIterationNumber"]->setUint((unsigned int)iterationNumber);
 
         if (renderMethod == RenderMethod::PATH_TRACING)
         {
             m_context["ptDirectLightSampling"]->setInt(1);
-            nvtx::ScopedRange r("OptixEntryPoint::PT_RAYTRACE_PASS");
-            sutilCurrentTime( &t0 );
+            RenderTrace::ScopedEvent event(m_trace, "PT raytrace pass", launchTile.getNumPixels());
             m_context->launch( OptixEntryPoint::PT_RAYTRACE_PASS,
-                static_cast<unsigned int>(m_width),
-                static_cast<unsigned int>(m_height) );
-            sutilCurrentTime( &t1 );
+                static_cast<unsigned int>(launchTile.getWidth()),
+                static_cast<unsigned int>(launchTile.getHeight()) );
         }
         else if (renderMethod == RenderMethod::PROGRESSIVE_PHOTON_MAPPING)
         {          
 #pragma region PROGRESSIVE PHOTON MAPPING
             // Trace viewing rays
             {
-                nvtx::ScopedRange r("OptixEntryPoint::RAYTRACE_PASS");
-                sutilCurrentTime( &t0 );
+                RenderTrace::ScopedEvent event(m_trace, "PPM raytrace pass", m_width*m_height);
                 m_context->launch( OptixEntryPoint::PPM_RAYTRACE_PASS,
                     static_cast<unsigned int>(m_width),
                     static_cast<unsigned int>(m_height) );
-                sutilCurrentTime( &t1 );
             }
 
             // Update PPM Radius for next photon tracing pass
@@ -594,44 +719,91 @@ void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsi
             
             // Clear volume photons
             {
-                nvtx::ScopedRange r( "OptixEntryPoint::PPM_CLEAR_VOLUMETRIC_PHOTONS_PASS" );
+                RenderTrace::ScopedEvent event(m_trace, "PPM clear volumetric photons pass", NUM_VOLUMETRIC_PHOTONS);
                 m_context->launch( OptixEntryPoint::PPM_CLEAR_VOLUMETRIC_PHOTONS_PASS, NUM_VOLUMETRIC_PHOTONS);
             }
 #endif
-            // Set up the uniform grid bounds
-            #if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
+            m_photonMapStructure = details.getPhotonMapStructure();
+            m_context["photonMapStructure"]->setUint(m_photonMapStructure);
+
+            // The photon budget of the request, the radiance estimate divides by the photons emitted this iteration
+            m_numEmittedPhotonsPerIteration = getEmittedPhotonsPerIteration(details.getNumEmittedPhotonsPerIteration());
+            m_context["emittedPhotonsPerIteration"]->setUint(m_numEmittedPhotonsPerIteration);
+            m_context["emittedPhotonsPerIterationFloat"]->setFloat(float(m_numEmittedPhotonsPerIteration));
+
+            // The stochastic hash table is the photon buffers, it has a slot for every photon the pass can store
+            if(m_photonMapStructure == PhotonMapStructure::STOCHASTIC_HASH && m_photonBufferSize < NUM_PHOTONS)
             {
-                nvtx::ScopedRange r("initializeStochasticHashPhotonMap()");
-                initializeStochasticHashPhotonMap(PPMRadius);
+                resizePhotonBuffers(NUM_PHOTONS);
             }
-            #endif
 
-            // Photon Tracing
+            // The photon map of an iteration does not depend on the camera, after a camera move it is replayed from
+            // the cache. Volumetric photons are not cached.
+            PhotonMapCache::Key photonMapKey;
+            photonMapKey.iterationNumber = iterationNumber;
+            photonMapKey.randomSeed = m_randomSeed;
+            photonMapKey.structure = m_photonMapStructure;
+            photonMapKey.ppmRadius = PPMRadius;
+            photonMapKey.numEmittedPhotons = m_numEmittedPhotonsPerIteration;
+            const PhotonMapCache::PhotonMap* cachedPhotonMap = ENABLE_PARTICIPATING_MEDIA ? NULL : m_photonMapCache.find(photonMapKey);
+
+            if(cachedPhotonMap != NULL)
             {
-                nvtx::ScopedRange r( "OptixEntryPoint::PHOTON_PASS" );
-                m_context->launch( OptixEntryPoint::PPM_PHOTON_PASS,
-                    static_cast<unsigned int>(PHOTON_LAUNCH_WIDTH),
-                    static_cast<unsigned int>(PHOTON_LAUNCH_HEIGHT) );
-
-                float totalEmitted = (iterationNumber+1)*EMITTED_PHOTONS_PER_ITERATION;
-                m_context["totalEmitted"]->setFloat( static_cast<float>(totalEmitted));
+                restorePhotonMap(*cachedPhotonMap, m_photonMapStructure);
+#if ENABLE_RENDER_DEBUG_OUTPUT
+                printf("Photon map of iteration %llu from cache (%llu hits, %.0f ms saved)\n", iterationNumber,
+                    m_photonMapCache.getNumHits(), m_photonMapCache.getSavedMilliseconds());
+#endif
             }
+            else
+            {
+                const qint64 photonMapStartTime = m_trace.getNanoseconds();
 
-            debugOutputPhotonTracing();
+                // Set up the uniform grid bounds
+                if(m_photonMapStructure == PhotonMapStructure::STOCHASTIC_HASH)
+                {
+                    RenderTrace::ScopedEvent event(m_trace, "Stochastic hash initialization", m_photonBufferSize);
+                    initializeStochasticHashPhotonMap(PPMRadius);
+                }
 
-            // Create Photon Map
-            {
-                nvtx::ScopedRange r( "Creating photon map" );
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
-                createPhotonKdTreeOnCPU();
-#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
-                createUniformGridPhotonMap(PPMRadius);
-#endif
+                // Photon Tracing
+                tracePhotons();
+
+                debugOutputPhotonTracing();
+
+                // Create Photon Map
+                {
+                    RenderTrace::ScopedEvent event(m_trace, "Photon map build");
+                    if(m_photonMapStructure == PhotonMapStructure::KD_TREE_CPU)
+                    {
+                        createPhotonKdTreeOnCPU();
+                        event.setNumElements(m_numberOfPhotonsLastFrame);
+                    }
+                    else if(m_photonMapStructure == PhotonMapStructure::UNIFORM_GRID)
+                    {
+                        createUniformGridPhotonMap(PPMRadius);
+                        event.setNumElements(m_numberOfPhotonsLastFrame);
+                    }
+                    else if(m_photonMapStructure == PhotonMapStructure::HASHED_GRID)
+                    {
+                        createHashedGridPhotonMap(PPMRadius);
+                        event.setNumElements(m_numberOfPhotonsLastFrame);
+                    }
+                }
+
+                if(!ENABLE_PARTICIPATING_MEDIA)
+                {
+                    storePhotonMap(photonMapKey, (m_trace.getNanoseconds() - photonMapStartTime)*1e-6);
+                }
             }
 
+            float totalEmitted = (iterationNumber+1)*float(m_numEmittedPhotonsPerIteration);
+            m_context["totalEmitted"]->setFloat( static_cast<float>(totalEmitted));
+
 #if ENABLE_PARTICIPATING_MEDIA
             // Rebuild the volumetric photons BVH
             {
+                RenderTrace::ScopedEvent event(m_trace, "Volumetric photons BVH build", NUM_VOLUMETRIC_PHOTONS);
                 double t0, t1;
                 sutilCurrentTime( &t0 );
                 m_volumetricPhotonsRoot->getAcceleration()->markDirty();
@@ -646,27 +818,27 @@ void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsi
 
             // Transfer any data from the photon acceleration structure build to the GPU (trigger an empty launch)
             {
-                nvtx::ScopedRange r("Transfer photon map to GPU");
+                RenderTrace::ScopedEvent event(m_trace, "Photon map transfer");
                 m_context->launch(OptixEntryPoint::PPM_INDIRECT_RADIANCE_ESTIMATION_PASS,
                     0, 0);
             }
     
             // PPM Indirect Estimation (using the photon map)
             {
-                nvtx::ScopedRange r("OptixEntryPoint::INDIRECT_RADIANCE_ESTIMATION");
+                RenderTrace::ScopedEvent event(m_trace, "PPM indirect radiance estimation pass", m_width*m_height);
                 m_context->launch(OptixEntryPoint::PPM_INDIRECT_RADIANCE_ESTIMATION_PASS,
                     m_width, m_height);
             }
 
             // Direct Radiance Estimation
             {
-                nvtx::ScopedRange r("OptixEntryPoint::PPM_DIRECT_RADIANCE_ESTIMATION_PASS");
+                RenderTrace::ScopedEvent event(m_trace, "PPM direct radiance estimation pass", m_width*m_height);
                 m_context->launch(OptixEntryPoint::PPM_DIRECT_RADIANCE_ESTIMATION_PASS,
                     m_width, m_height);
             }
 
             // Combine indirect and direct buffers in the output buffer
-            nvtx::ScopedRange r("OptixEntryPoint::PPM_OUTPUT_PASS");
+            RenderTrace::ScopedEvent event(m_trace, "PPM output pass", m_width*m_height);
             m_context->launch(OptixEntryPoint::PPM_OUTPUT_PASS,
                 m_width, m_height);
 #pragma endregion PROGRESSIVE PHOTON MAPPING
@@ -695,60 +867,18 @@ void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsi
             m_context["misVmWeightFactor"]->setFloat(misVmWeightFactor);
             m_context["misVcWeightFactor"]->setFloat(misVcWeightFactor);
 
-            // Estimate average light subpath length and initialize vertex buffer with appropriate size
-            if (!m_lightVertexCountEstimated)
+            // Size the per subpath buffers for the light pass launch
+            if (!m_lightPassBuffersSized)
             {
-                unsigned int estimateWidth = m_lightPassLaunchWidth;
-                unsigned int estimateHeight = m_lightPassLaunchHeight;
-
-                m_lightSubpathVertexCountBuffer->setSize(estimateWidth * estimateHeight);
+                m_lightSubpathVertexCountBuffer->setSize(lightSubPathCount);
+                m_lightSubpathVertexOffsetBuffer->setSize(lightSubPathCount + 1);
+                m_context["maxPathLen"]->setUint(VCM_MAX_PATH_LENGTH);
 
                 // Transfer any data to the GPU (trigger an empty launch)
                 dbgPrintf("VCM: init empty launch\n");
                 m_context->launch( OptixEntryPoint::VCM_LIGHT_PASS, 0u, 0u);
                 dbgPrintf("Available device memory MB %f\n", m_context->getAvailableDeviceMemory(0u) / 1000000.f);
 
-                // Estimate light subpath length to initialize light vertex cache (LVC)
-                {
-                    dbgPrintf("OptixEntryPoint::VCM_LIGHT_PASS subpath length estimate launch dim %u x %u\n", estimateWidth, estimateHeight);
-                    m_context["maxPathLen"]->setUint(VCM_MAX_PATH_LENGTH);
-                    m_context["lightVertexCountEstimatePass"]->setUint(1u);
-                    nvtx::ScopedRange r("OptixEntryPoint::VCM_LIGHT_PASS");
-                    sutilCurrentTime( &t0 );
-                    m_context->launch( OptixEntryPoint::VCM_LIGHT_PASS, estimateWidth, estimateHeight );
-                    sutilCurrentTime( &t1 );
-                    dbgPrintf("LVC size estimate launch time: %.4f.\n", t1-t0);
-                }
-
-                // get average stored vertex count
-                optix::uint* buffer_Host = static_cast<optix::uint*>(m_lightSubpathVertexCountBuffer->map());
-                const unsigned int subpathEstimateCount = estimateWidth * estimateHeight;
-                unsigned long long sumStoredVerts = 0;
-                unsigned int maxPathVerts = 0;
-
-                for(int i = 0; i < subpathEstimateCount ; i++)
-                {
-                    unsigned int count = buffer_Host[i];
-                    if (maxPathVerts < count) maxPathVerts = count;
-                    if (0 < count) sumStoredVerts += count;
-                }
-                m_lightSubpathVertexCountBuffer->unmap();
-
-                float avgSubpathVerts = float(sumStoredVerts) / subpathEstimateCount;
-                dbgPrintf("LVC estimate. paths: %u  vertices: %llu  avgStoredVertices: %f  maxPathVertices: %u\n",
-                    subpathEstimateCount, sumStoredVerts, avgSubpathVerts, maxPathVerts);
-
-                // Init light vertex buffer based on average length.
-                // Estimate currently is inaccurate in case when with distance light source so add big safety margin,
-                // if it happens to be bigger than allowed length then just use that one instead
-                avgSubpathVerts = std::min(avgSubpathVerts / 0.5f, float(VCM_MAX_PATH_LENGTH-1));
-                const unsigned int vertBufSize = (lightSubPathCount * avgSubpathVerts);
-                m_lightVertexBuffer->setSize(vertBufSize);
-                dbgPrintf("Vertex buffer size set to: %u \n", vertBufSize);
-                
-                // Resize vertex count buffer for regular light pass
-                m_lightSubpathVertexCountBuffer->setSize(m_lightPassLaunchWidth * m_lightPassLaunchHeight);
-
 #if !VCM_UNIFORM_VERTEX_SAMPLING
                 m_lightSubpathVertexIndexBuffer->setSize(m_lightPassLaunchWidth * m_lightPassLaunchHeight, VCM_MAX_PATH_LENGTH-1);
                 //m_context["maxPathLen"]->setUint(VCM_MAX_PATH_LENGTH); increase?
@@ -759,8 +889,7 @@ void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsi
                 m_context["vertexPickPdf"]->setFloat(vertexPickPdf);
                 m_context["averageLightSubpathLength"]->setFloat(avgSubpathLength);
 #endif                
-                m_lightVertexCountEstimated = true;
-                m_context["lightVertexCountEstimatePass"]->setUint(0u);
+                m_lightPassBuffersSized = true;
 
                 dbgPrintf("VCM: cameraSubPathCount     %u \n", cameraSubPathCount);
                 dbgPrintf("VCM: lightSubpathsMerged    %u \n", lightSubpathsMerged);
@@ -772,34 +901,54 @@ void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsi
                 dbgPrintf("VCM: vmNormalizationFactor  %.10f \n", vmNormalizationFactor);
             }
 
-            // Reset buffer index counter (not used it length estimate pass)
+            // Count pass, the light subpaths are traced without storing or connecting anything. The light pass traces
+            // the same subpaths again (same random numbers) and stores them packed at the offsets from the counts.
+            {
+                m_context["lightVertexCountEstimatePass"]->setUint(1u);
+                RenderTrace::ScopedEvent event(m_trace, "VCM light vertex count pass", lightSubPathCount);
+                m_context->launch( OptixEntryPoint::VCM_LIGHT_PASS, m_lightPassLaunchWidth, m_lightPassLaunchHeight );
+            }
+            {
+                RenderTrace::ScopedEvent event(m_trace, "VCM light vertex offsets", lightSubPathCount, sizeof(unsigned int));
+                m_lightVertexCount = createLightSubpathVertexOffsets();
+            }
+
+            // The cache only grows, with some headroom since the count varies between iterations
+            if (m_lightVertexBufferSize < m_lightVertexCount)
+            {
+                m_lightVertexBufferSize = m_lightVertexCount + m_lightVertexCount/16;
+                m_lightVertexBuffer->setSize(m_lightVertexBufferSize);
+#if ENABLE_RENDER_DEBUG_OUTPUT
+                printf("VCM light vertex cache grows to %u vertices\n", m_lightVertexBufferSize);
+#endif
+            }
+
+            // The number of stored vertices, uniform vertex sampling picks among them
             optix::uint* bufferHost = static_cast<optix::uint*>(m_lightVertexBufferIndexBuffer->map());
-            memset(bufferHost, 0, sizeof(optix::uint));
+            bufferHost[0] = m_lightVertexCount;
             m_lightVertexBufferIndexBuffer->unmap();
+            m_context["lightVertexCountEstimatePass"]->setUint(0u);
 
             // Light pass
             { 
-                nvtx::ScopedRange r("OptixEntryPoint::VCM_LIGHT_PASS");
-                sutilCurrentTime( &t0 );
+                RenderTrace::ScopedEvent event(m_trace, "VCM light pass", lightSubPathCount);
                 m_context->launch( OptixEntryPoint::VCM_LIGHT_PASS, m_lightPassLaunchWidth, m_lightPassLaunchHeight );
-                sutilCurrentTime( &t1 );
-                dbgPrintf("Light pass launch time: %.4f.\n", t1-t0);
+            }
+
+            // Light vertex grid, merging uses the PPM radius of the iteration
+            if (m_vcmUseVM)
+            {
+                RenderTrace::ScopedEvent event(m_trace, "VCM light vertex grid build", lightSubPathCount);
+                createLightVertexGrid(PPMRadius);
             }
 
             // Camera pass
             { 
-                nvtx::ScopedRange r("OptixEntryPoint::VCM_CAMERA_PASS");
-                sutilCurrentTime( &t0 );
-                m_context->launch( OptixEntryPoint::VCM_CAMERA_PASS, m_width, m_height );
-                sutilCurrentTime( &t1 );
-                dbgPrintf("Camera pass launch time: %.4f.\n", t1-t0);
+                RenderTrace::ScopedEvent event(m_trace, "VCM camera pass", launchTile.getNumPixels());
+                m_context->launch( OptixEntryPoint::VCM_CAMERA_PASS, launchTile.getWidth(), launchTile.getHeight() );
             }
         }
 
-        double end;
-        sutilCurrentTime( &end );
-        double traceTime = end-traceStartTime;
-
 #if ENABLE_MESH_HITS_COUNTING
         // print scene meshes count
         int sceneNMeshes = m_context["sceneNMeshes"]->getInt();
@@ -820,19 +969,12 @@ void OptixRenderer::renderNextIteration(unsigned long long iterationNumber, unsi
     }
 }
 
-static inline unsigned int max(unsigned int a, unsigned int b)
-{
-    return a > b ? a : b;
-}
-
 void OptixRenderer::resizeBuffers(unsigned int width, unsigned int height)
 {
     m_outputBuffer->setSize( width, height );
     m_raytracePassOutputBuffer->setSize( width, height );
     m_directRadianceBuffer->setSize( width, height );
     m_indirectRadianceBuffer->setSize( width, height );
-    m_randomStatesBuffer->setSize(max(PHOTON_LAUNCH_WIDTH, (unsigned int)width), max(PHOTON_LAUNCH_HEIGHT,  (unsigned int)height));
-    initializeRandomStates();
     m_width = width;
     m_height = height;
 
@@ -844,7 +986,7 @@ void OptixRenderer::resizeBuffers(unsigned int width, unsigned int height)
 #endif
     // used to scale camera_u and camera_v for VCM
     m_context["pixelSizeFactor"]->setFloat(1.0f / width, 1.0f / height);
-    m_lightVertexCountEstimated = false;
+    m_lightPassBuffersSized = false;
 }
 
 unsigned int OptixRenderer::getWidth() const
@@ -859,16 +1001,216 @@ unsigned int OptixRenderer::getHeight() const
 
 void OptixRenderer::getOutputBuffer( void* data )
 {
+    RenderTrace::ScopedEvent event(m_trace, "Output readback", m_width*m_height, getScreenBufferSizeBytes());
+    if(m_hostPathTracer != NULL)
+    {
+        m_hostPathTracer->getOutputBuffer(data);
+        return;
+    }
+
     void* buffer = reinterpret_cast<void*>( m_outputBuffer->map() );
     memcpy(data, buffer, getScreenBufferSizeBytes());
     m_outputBuffer->unmap();
 }
 
+void OptixRenderer::getOutputBuffer( void* data, const RenderTile & tile )
+{
+    if(tile.isFullFrame())
+    {
+        getOutputBuffer(data);
+        return;
+    }
+
+    RenderTrace::ScopedEvent event(m_trace, "Output readback", tile.getNumPixels(), tile.getNumPixels()*sizeof(optix::float3));
+    if(m_hostPathTracer != NULL)
+    {
+        m_hostPathTracer->getOutputBuffer(data, tile);
+        return;
+    }
+
+    const optix::float3* buffer = reinterpret_cast<const optix::float3*>( m_outputBuffer->map() );
+    optix::float3* tileData = reinterpret_cast<optix::float3*>(data);
+    for(unsigned int y = 0; y < tile.getHeight(); y++)
+    {
+        memcpy(tileData + y*tile.getWidth(), buffer + (tile.getY() + y)*m_width + tile.getX(), tile.getWidth()*sizeof(optix::float3));
+    }
+    m_outputBuffer->unmap();
+}
+
+void OptixRenderer::savePhotonDump( const QString & fileName, float PPMRadius )
+{
+    if(m_hostPathTracer != NULL)
+    {
+        throw std::exception("The host device has no photons to dump.");
+    }
+
+    PhotonDump dump;
+    dump.width = m_width;
+    dump.height = m_height;
+    dump.ppmRadius = PPMRadius;
+    dump.emittedPhotonsPerIteration = float(m_numEmittedPhotonsPerIteration);
+
+    // The stochastic hash table is the whole photon buffers, the other structures use the photons appended to them
+    const unsigned int numPhotons = m_photonMapStructure == PhotonMapStructure::STOCHASTIC_HASH ? m_photonBufferSize : m_numPhotonDeposits;
+    dump.photons.resize(std::max(numPhotons, 1u));
+#if ENABLE_PHOTON_SOA_LAYOUT
+    unpackPhotons(static_cast<const optix::float3*>(m_photonPositions->map()), static_cast<const unsigned int*>(m_photonDirections->map()),
+        static_cast<const unsigned int*>(m_photonPowers->map()), numPhotons, m_photonPowerScale, &dump.photons[0]);
+    m_photonPowers->unmap();
+    m_photonDirections->unmap();
+    m_photonPositions->unmap();
+#else
+    memcpy(&dump.photons[0], m_photons->map(), numPhotons*sizeof(Photon));
+    m_photons->unmap();
+#endif
+
+    dump.hitpoints.resize(m_width*m_height);
+    memcpy(&dump.hitpoints[0], m_raytracePassOutputBuffer->map(), m_width*m_height*sizeof(Hitpoint));
+    m_raytracePassOutputBuffer->unmap();
+
+    ::savePhotonDump(fileName, dump);
+}
+
 unsigned int OptixRenderer::getScreenBufferSizeBytes() const
 {
     return m_width*m_height*sizeof(optix::float3);
 }
 
+RenderTrace & OptixRenderer::getRenderTrace()
+{
+    return m_trace;
+}
+
+void OptixRenderer::setRandomSeed(unsigned int seed)
+{
+    m_randomSeed = createRandomSeed(seed);
+    if(m_context)
+    {
+        m_context["randomSeed"]->setUint(m_randomSeed);
+    }
+}
+
+void OptixRenderer::setSampler(Sampler::E sampler)
+{
+    m_sampler = sampler;
+    if(m_context)
+    {
+        m_context["sampler"]->setUint(m_sampler);
+    }
+}
+
+Sampler::E OptixRenderer::getSampler() const
+{
+    return m_sampler;
+}
+
+unsigned long long OptixRenderer::getAvailableDeviceMemoryBytes() const
+{
+    if(m_hostPathTracer != NULL || !m_context)
+    {
+        return 0;
+    }
+    return m_context->getAvailableDeviceMemory(0u);
+}
+
+unsigned int OptixRenderer::getNumPhotonDeposits() const
+{
+    return m_numPhotonDeposits;
+}
+
+unsigned int OptixRenderer::getPhotonBufferSize() const
+{
+    return m_photonBufferSize;
+}
+
+unsigned int OptixRenderer::getNumEmittedPhotonsPerIteration() const
+{
+    return m_numEmittedPhotonsPerIteration;
+}
+
+unsigned long long OptixRenderer::getLightVertexCacheBytesUsed() const
+{
+    return (unsigned long long)m_lightVertexCount*sizeof(LightVertex);
+}
+
+unsigned long long OptixRenderer::getLightVertexCacheBytesAllocated() const
+{
+    return (unsigned long long)m_lightVertexBufferSize*sizeof(LightVertex);
+}
+
+// Photons are emitted in whole rows of the photon launch, the random numbers of a photon depend on its launch index
+unsigned int OptixRenderer::getEmittedPhotonsPerIteration(unsigned int requestedPhotons)
+{
+    if(requestedPhotons == 0)
+    {
+        return EMITTED_PHOTONS_PER_ITERATION;
+    }
+    unsigned int numRows = (requestedPhotons + PHOTON_LAUNCH_WIDTH/2)/PHOTON_LAUNCH_WIDTH;
+    unsigned int numPhotons = numRows*PHOTON_LAUNCH_WIDTH;
+    return std::max(MIN_EMITTED_PHOTONS_PER_ITERATION, std::min(EMITTED_PHOTONS_PER_ITERATION, numPhotons));
+}
+
+// The photon pass appends the photons of the uniform grid and kd-tree to the photon buffers and counts them in
+// photonDepositCounter, also those that did not fit. Then the buffers grow to a quarter more than the count and the
+// pass is traced again, it draws the same random numbers (RandomState.h) so it stores the same photons. The buffers
+// never need more than the MAX_PHOTON_COUNT deposits per emitted photon a path can store, so this happens at most
+// once per size increase.
+void OptixRenderer::tracePhotons()
+{
+    for(;;)
+    {
+        {
+            RenderTrace::ScopedEvent event(m_trace, "PPM photon pass", m_numEmittedPhotonsPerIteration);
+            *static_cast<unsigned int*>(m_photonDepositCounter->map()) = 0;
+            m_photonDepositCounter->unmap();
+            m_context->launch( OptixEntryPoint::PPM_PHOTON_PASS,
+                static_cast<unsigned int>(PHOTON_LAUNCH_WIDTH),
+                static_cast<unsigned int>(m_numEmittedPhotonsPerIteration/PHOTON_LAUNCH_WIDTH) );
+        }
+
+        // The stochastic hash stores the photons in its table slots and does not count them
+        if(m_photonMapStructure == PhotonMapStructure::STOCHASTIC_HASH)
+        {
+            m_numPhotonDeposits = 0;
+            return;
+        }
+
+        {
+            RenderTrace::ScopedEvent event(m_trace, "Photon deposit count", 0, sizeof(unsigned int));
+            m_numPhotonDeposits = *static_cast<const unsigned int*>(m_photonDepositCounter->map());
+            m_photonDepositCounter->unmap();
+            event.setNumElements(m_numPhotonDeposits);
+        }
+
+        if(m_numPhotonDeposits <= m_photonBufferSize)
+        {
+            return;
+        }
+        unsigned int numPhotons = std::min(NUM_PHOTONS, m_numPhotonDeposits + m_numPhotonDeposits/4);
+#if ENABLE_RENDER_DEBUG_OUTPUT
+        printf("Photon buffers grow from %u to %u photons\n", m_photonBufferSize, numPhotons);
+#endif
+        resizePhotonBuffers(numPhotons);
+    }
+}
+
+// Resizing a buffer discards its contents, the photons have to be traced again
+void OptixRenderer::resizePhotonBuffers(unsigned int numPhotons)
+{
+#if ENABLE_PHOTON_SOA_LAYOUT
+    m_photonPositions->setSize(numPhotons);
+    m_photonDirections->setSize(numPhotons);
+    m_photonPowers->setSize(numPhotons);
+#else
+    m_photons->setSize(numPhotons);
+#endif
+    m_photonsHashCells->setSize(numPhotons);
+    m_context["photonsHashTableCount"]->getBuffer()->setSize(numPhotons);
+    m_context["photonsSize"]->setUint(numPhotons);
+    m_photonBufferSize = numPhotons;
+    m_numPhotonDeposits = 0;
+}
+
 void OptixRenderer::debugOutputPhotonTracing()
 {
 #if ENABLE_RENDER_DEBUG_OUTPUT
@@ -878,7 +1220,7 @@ void OptixRenderer::debugOutputPhotonTracing()
         unsigned int* buffer_Host = (unsigned int*)buffer->map();
         unsigned long long sumPaths = 0;
         unsigned int numZero = 0;
-        for(int i = 0; i < PHOTON_LAUNCH_WIDTH*PHOTON_LAUNCH_HEIGHT; i++)
+        for(unsigned int i = 0; i < m_numEmittedPhotonsPerIteration; i++)
         {
             sumPaths += buffer_Host[i];
             if(buffer_Host[i] == 0)
@@ -887,8 +1229,8 @@ void OptixRenderer::debugOutputPhotonTracing()
             }
         }
         buffer->unmap();
-        double averagePathLength = double(sumPaths)/(PHOTON_LAUNCH_WIDTH*PHOTON_LAUNCH_HEIGHT);
-        double percentageZero = 100*double(numZero)/(PHOTON_LAUNCH_WIDTH*PHOTON_LAUNCH_HEIGHT);
+        double averagePathLength = double(sumPaths)/m_numEmittedPhotonsPerIteration;
+        double percentageZero = 100*double(numZero)/m_numEmittedPhotonsPerIteration;
         printf("  Average photonprd path length: %.4f (Paths with 0: %.4f%%)\n", averagePathLength, percentageZero);
     }
 
@@ -928,9 +1270,9 @@ void OptixRenderer::debugOutputPhotonTracing()
         printf("  Average photons visited during indirect estimation (per pixel): %.4f\n", visitedAvg);
     }
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
+    if(m_photonMapStructure == PhotonMapStructure::STOCHASTIC_HASH)
     {
-        const unsigned int hashTableSize = NUM_PHOTONS;
+        const unsigned int hashTableSize = m_photonBufferSize;
         optix::Buffer buffer = m_context["photonsHashTableCount"]->getBuffer();
         unsigned int* buffer_Host = (unsigned int*)buffer->map();
         unsigned int numFilled = 0;
@@ -949,7 +1291,6 @@ void OptixRenderer::debugOutputPhotonTracing()
         printf("  Table size %d Filled: %d fill%%: %.4f\n  Uniform grid collisions (in filled cells): %.4f\n", hashTableSize, numFilled, fillRate, averageCollisions);
     }
 #endif
-#endif
 }
 
 void OptixRenderer::createGpuDebugBuffers()
@@ -13,10 +13,18 @@
 #include <optixu/optixu_aabb_namespace.h>
 #include "render_engine_export_api.h"
 #include "math/AAB.h"
+#include "renderer/ppm/PhotonMapStructure.h"
+#include "renderer/ppm/PhotonMapCache.h"
+#include "renderer/Sampler.h"
+#include "util/RenderTrace.h"
+#include "clientserver/RenderTile.h"
 
 class ComputeDevice;
 class RenderServerRenderRequestDetails;
 class IScene;
+class QString;
+struct Photon;
+class HostPathTracer;
 
 class OptixRenderer
 {
@@ -26,55 +34,115 @@ public:
     RENDER_ENGINE_EXPORT_API ~OptixRenderer();
 
     RENDER_ENGINE_EXPORT_API void initScene(IScene & scene);
+    // The host device (ComputeDevice::isHost) renders path tracing only
     RENDER_ENGINE_EXPORT_API void initialize(const ComputeDevice & device);
 
     void createGpuDebugBuffers();
 
+    // Path tracing and the VCM camera pass only trace the pixels of tile (default is the full frame), PPM ignores it.
+    // The VCM light pass always covers the whole frame, so the render server asks for full VCM frames.
     RENDER_ENGINE_EXPORT_API void renderNextIteration(unsigned long long iterationNumber, unsigned long long localIterationNumber, 
-        float PPMRadius, bool createOutput, const RenderServerRenderRequestDetails & details);
+        float PPMRadius, bool createOutput, const RenderServerRenderRequestDetails & details, const RenderTile & tile = RenderTile());
     RENDER_ENGINE_EXPORT_API void getOutputBuffer(void* data);
+    // Copy the pixels of tile, row by row, to data (tile.getNumPixels() float3)
+    RENDER_ENGINE_EXPORT_API void getOutputBuffer(void* data, const RenderTile & tile);
+    // Save the photons and hitpoints of the last PPM iteration, see PhotonDump.h
+    RENDER_ENGINE_EXPORT_API void savePhotonDump(const QString & fileName, float PPMRadius);
     RENDER_ENGINE_EXPORT_API unsigned int getWidth() const;
     RENDER_ENGINE_EXPORT_API unsigned int getHeight() const;
     RENDER_ENGINE_EXPORT_API unsigned int getScreenBufferSizeBytes() const;
+    // Photon maps of past PPM iterations, replayed after camera moves
+    RENDER_ENGINE_EXPORT_API PhotonMapCache & getPhotonMapCache();
+    // Timings of the passes of the iterations rendered and of the output readbacks
+    RENDER_ENGINE_EXPORT_API RenderTrace & getRenderTrace();
+    // Seed of the random numbers, 0 (the default) seeds from the clock. With the same seed an iteration gets the
+    // same random numbers on every device and server, see RandomState.h.
+    RENDER_ENGINE_EXPORT_API void setRandomSeed(unsigned int seed);
+    // Sequence the path tracing and VCM samples of each pixel are drawn from over the iterations
+    RENDER_ENGINE_EXPORT_API void setSampler(Sampler::E sampler);
+    RENDER_ENGINE_EXPORT_API Sampler::E getSampler() const;
+    // Free memory of the CUDA device, 0 on the host device
+    RENDER_ENGINE_EXPORT_API unsigned long long getAvailableDeviceMemoryBytes() const;
+    // Photons stored by the last PPM photon pass and the number the photon buffers hold, which grows with it
+    RENDER_ENGINE_EXPORT_API unsigned int getNumPhotonDeposits() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getPhotonBufferSize() const;
+    // Photons emitted by the photon pass of the last PPM iteration
+    RENDER_ENGINE_EXPORT_API unsigned int getNumEmittedPhotonsPerIteration() const;
+    // The photons a PPM iteration emits for a requested budget (RenderServerRenderRequestDetails): whole rows of the
+    // photon launch between MIN_EMITTED_PHOTONS_PER_ITERATION and EMITTED_PHOTONS_PER_ITERATION, which is also what a
+    // budget of 0 gets
+    RENDER_ENGINE_EXPORT_API static unsigned int getEmittedPhotonsPerIteration(unsigned int requestedPhotons);
+    // Bytes of the VCM light vertex cache the last light pass stored vertices in and the bytes allocated for it
+    RENDER_ENGINE_EXPORT_API unsigned long long getLightVertexCacheBytesUsed() const;
+    RENDER_ENGINE_EXPORT_API unsigned long long getLightVertexCacheBytesAllocated() const;
 
     const static unsigned int NUM_PHOTONS;
     const static float PPM_INITIAL_RADIUS;
     const static unsigned int PHOTON_GRID_MAX_SIZE;
     RENDER_ENGINE_EXPORT_API const static unsigned int EMITTED_PHOTONS_PER_ITERATION;
+    RENDER_ENGINE_EXPORT_API const static unsigned int MIN_EMITTED_PHOTONS_PER_ITERATION;
 
 private:
+    void createContext();
     void initDevice(const ComputeDevice & device);
     void compile();
     void loadObjGeometry( const std::string& filename, optix::Aabb& bbox );
-    void initializeRandomStates();
     void createUniformGridPhotonMap(float ppmRadius);
+    void createHashedGridPhotonMap(float ppmRadius);
     void initializeStochasticHashPhotonMap(float ppmRadius);
+    void createLightVertexGrid(float vcmRadius);
+    unsigned int createLightSubpathVertexOffsets();
+    void tracePhotons();
+    void resizePhotonBuffers(unsigned int numPhotons);
     void createPhotonKdTreeOnCPU();
+    void storePhotonMap(const PhotonMapCache::Key & key, double buildMilliseconds);
+    void restorePhotonMap(const PhotonMapCache::PhotonMap & photonMap, PhotonMapStructure::E photonMapStructure);
+    QVector<optix::Buffer> getPhotonBuffers() const;
 
     optix::Buffer m_outputBuffer;
+#if ENABLE_PHOTON_SOA_LAYOUT
+    optix::Buffer m_photonPositions;
+    optix::Buffer m_photonDirections;
+    optix::Buffer m_photonPowers;
+#else
     optix::Buffer m_photons;
+#endif
+    optix::Buffer m_photonDepositCounter;
     optix::Buffer m_photonKdTree;
     optix::Buffer m_hashmapOffsetTable;
     optix::Buffer m_photonsHashCells;
+    optix::Buffer m_photonsHashedGridKeys;
+    optix::Buffer m_hashedGridCellKeys;
+    optix::Buffer m_hashedGridTable;
     optix::Buffer m_raytracePassOutputBuffer;
     optix::Buffer m_directRadianceBuffer;
     optix::Buffer m_indirectRadianceBuffer;
     optix::Group m_sceneRootGroup;
     optix::Buffer m_volumetricPhotonsBuffer;
     optix::Buffer m_lightBuffer;
-    optix::Buffer m_randomStatesBuffer;
+    optix::Buffer m_lightAliasTableBuffer;
 
+    PhotonMapStructure::E m_photonMapStructure; // photon map of the current iteration
+    unsigned int m_photonBufferSize;
+    unsigned int m_numPhotonDeposits;
+    unsigned int m_numEmittedPhotonsPerIteration;
     unsigned int m_photonKdTreeSize;
+    float m_photonPowerScale;       // packed photon powers are relative to it, set with the lights of the scene
+    Photon* m_photonsCompacted;     // host copy of the valid photons the kd-tree is built from
     unsigned long long m_numberOfPhotonsLastFrame;
     float m_spatialHashMapCellSize;
     AAB m_sceneAABB;
     optix::uint3 m_gridSize;
     unsigned int m_spatialHashMapNumCells;
+    PhotonMapCache m_photonMapCache;
+    RenderTrace m_trace;
 
     unsigned int m_width;
     unsigned int m_height;
 
     bool m_initialized;
+    unsigned int m_randomSeed;
+    Sampler::E m_sampler;
 
     const static unsigned int MAX_BOUNCES;
     const static unsigned int MAX_PHOTON_COUNT;
@@ -85,6 +153,7 @@ private:
     void debugOutputPhotonTracing();
     optix::Context m_context;
     int m_optixDeviceOrdinal;
+    HostPathTracer* m_hostPathTracer;
 
     // Volumetric
     optix::GeometryGroup m_volumetricPhotonsRoot;
@@ -106,10 +175,17 @@ private:
     optix::Buffer m_lightVertexBufferIndexBuffer;   // indices for m_lightVertexBuffer
     optix::Buffer m_lightSubpathVertexCountBuffer;         // light subpath stored vertex count (can be smaller that subpath length since do not store on specular surfaces)
     optix::Buffer m_lightSubpathVertexIndexBuffer;         // light subpath indices for m_lightVertexBufferIndexBuffer
+    optix::Buffer m_lightSubpathVertexOffsetBuffer;        // first light vertex of each subpath, numSubpaths+1 entries
+    optix::Buffer m_lightVertexGridKeys;            // cell key of each light vertex, sorted with the indices
+    optix::Buffer m_lightVertexGridIndices;         // light vertex indices sorted by cell
+    optix::Buffer m_lightVertexGridCellKeys;
+    optix::Buffer m_lightVertexGridCellOffsets;
+    optix::Buffer m_lightVertexGridTable;
 
     bool m_vcmUseVM;
     bool m_vcmUseVC;
 
-    bool m_lightVertexCountEstimated;
-    unsigned int m_lightVertexCount;
+    bool m_lightPassBuffersSized;
+    unsigned int m_lightVertexCount;        // vertices stored by the last light pass
+    unsigned int m_lightVertexBufferSize;
 };
\ No newline at end of file
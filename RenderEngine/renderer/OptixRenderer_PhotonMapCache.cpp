@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cuda_runtime.h>
+#include <cstring>
+#include <algorithm>
+#include "OptixRenderer.h"
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PhotonGrid.h"
+
+/*
+// Store and restore the photon map of an iteration in the PhotonMapCache. An entry holds the buffers the gather of
+// its structure reads:
+//   UNIFORM_GRID     the photon buffers up to the last valid photon (they are sorted by cell, the invalid ones last),
+//                    then the cell offset table
+//   STOCHASTIC_HASH  the photon buffers, which are the hash table
+//   HASHED_GRID      the photon buffers up to the last valid photon, the cell offsets, the cell keys and the table
+//   KD_TREE_CPU      the tree nodes in use
+// The photon buffers and the offset table are written on the device, they are copied with CUDA like the uniform grid
+// build accesses them.
+*/
+
+static char* getDevicePointer(optix::Buffer & buffer)
+{
+    CUdeviceptr devicePointer;
+    buffer->getDevicePointer(0, &devicePointer);
+    return reinterpret_cast<char*>(devicePointer);
+}
+
+static void copyFromDevice(optix::Buffer & buffer, RTsize numElements, QByteArray & data)
+{
+    data.resize(int(numElements*buffer->getElementSize()));
+    cudaMemcpy(data.data(), getDevicePointer(buffer), data.size(), cudaMemcpyDeviceToHost);
+}
+
+// Writes data to the front of buffer and clears the rest of its first numElements
+static void copyToDevice(optix::Buffer & buffer, const QByteArray & data, RTsize numElements)
+{
+    char* devicePointer = getDevicePointer(buffer);
+    cudaMemcpy(devicePointer, data.constData(), data.size(), cudaMemcpyHostToDevice);
+    RTsize sizeBytes = numElements*buffer->getElementSize();
+    if(sizeBytes > RTsize(data.size()))
+    {
+        cudaMemset(devicePointer + data.size(), 0, sizeBytes - data.size());
+    }
+}
+
+static void ensureBufferSize(optix::Buffer & buffer, RTsize size)
+{
+    RTsize currentSize;
+    buffer->getSize(currentSize);
+    if(currentSize < size)
+    {
+        buffer->setSize(size);
+    }
+}
+
+// A balanced tree of numPhotons photons only uses the nodes below the next power of two
+static RTsize getNumKdTreeNodes(unsigned long long numPhotons, unsigned int kdTreeSize)
+{
+    RTsize numNodes = 1;
+    while(numNodes < numPhotons + 1)
+    {
+        numNodes <<= 1;
+    }
+    return std::min(numNodes - 1, RTsize(kdTreeSize));
+}
+
+QVector<optix::Buffer> OptixRenderer::getPhotonBuffers() const
+{
+    QVector<optix::Buffer> buffers;
+#if ENABLE_PHOTON_SOA_LAYOUT
+    buffers.push_back(m_photonPositions);
+    buffers.push_back(m_photonDirections);
+    buffers.push_back(m_photonPowers);
+#else
+    buffers.push_back(m_photons);
+#endif
+    return buffers;
+}
+
+void OptixRenderer::storePhotonMap(const PhotonMapCache::Key & key, double buildMilliseconds)
+{
+    QVector<optix::Buffer> photonBuffers = getPhotonBuffers();
+    RTsize photonSizeBytes = 0;
+    for(int i = 0; i < photonBuffers.size(); i++)
+    {
+        photonSizeBytes += photonBuffers[i]->getElementSize();
+    }
+
+    const bool isGrid = key.structure == PhotonMapStructure::UNIFORM_GRID || key.structure == PhotonMapStructure::HASHED_GRID;
+    RTsize numPhotons = isGrid ? RTsize(m_numberOfPhotonsLastFrame) : m_photonBufferSize;
+    RTsize sizeBytes;
+    if(key.structure == PhotonMapStructure::KD_TREE_CPU)
+    {
+        sizeBytes = getNumKdTreeNodes(m_numberOfPhotonsLastFrame, m_photonKdTreeSize)*sizeof(Photon);
+    }
+    else
+    {
+        sizeBytes = numPhotons*photonSizeBytes;
+        if(isGrid)
+        {
+            sizeBytes += (m_spatialHashMapNumCells+1)*sizeof(unsigned int);
+        }
+        if(key.structure == PhotonMapStructure::HASHED_GRID)
+        {
+            sizeBytes += m_spatialHashMapNumCells*sizeof(optix::uint2) + getHashedGridTableSize(m_spatialHashMapNumCells)*sizeof(unsigned int);
+        }
+    }
+
+    // Most iterations are not kept once the cache is full, skip copying them off the device
+    if(!m_photonMapCache.isWorthInserting(key, sizeBytes))
+    {
+        return;
+    }
+
+    RenderTrace::ScopedEvent event(m_trace, "Photon map cache store", numPhotons, sizeBytes);
+    PhotonMapCache::PhotonMap photonMap;
+    photonMap.numPhotons = m_numberOfPhotonsLastFrame;
+    photonMap.gridSize = m_gridSize;
+    photonMap.gridMortonMasks = m_context["photonsGridMortonMasks"]->getUint3();
+    photonMap.gridOrigin = m_context["photonsWorldOrigo"]->getFloat3();
+    photonMap.gridCellSize = m_context["photonsGridCellSize"]->getFloat();
+    photonMap.gridNumCells = m_spatialHashMapNumCells;
+    photonMap.buildMilliseconds = buildMilliseconds;
+
+    if(key.structure == PhotonMapStructure::KD_TREE_CPU)
+    {
+        photonMap.buffers.resize(1);
+        RTsize numNodes = getNumKdTreeNodes(m_numberOfPhotonsLastFrame, m_photonKdTreeSize);
+        photonMap.buffers[0] = QByteArray(reinterpret_cast<const char*>(m_photonKdTree->map()), int(numNodes*sizeof(Photon)));
+        m_photonKdTree->unmap();
+    }
+    else
+    {
+        photonMap.buffers.resize(photonBuffers.size());
+        for(int i = 0; i < photonBuffers.size(); i++)
+        {
+            copyFromDevice(photonBuffers[i], numPhotons, photonMap.buffers[i]);
+        }
+        if(isGrid)
+        {
+            photonMap.buffers.push_back(QByteArray());
+            copyFromDevice(m_hashmapOffsetTable, m_spatialHashMapNumCells+1, photonMap.buffers.back());
+        }
+        if(key.structure == PhotonMapStructure::HASHED_GRID)
+        {
+            photonMap.buffers.push_back(QByteArray());
+            copyFromDevice(m_hashedGridCellKeys, m_spatialHashMapNumCells, photonMap.buffers.back());
+            photonMap.buffers.push_back(QByteArray());
+            copyFromDevice(m_hashedGridTable, getHashedGridTableSize(m_spatialHashMapNumCells), photonMap.buffers.back());
+        }
+    }
+
+    m_photonMapCache.insert(key, photonMap);
+}
+
+void OptixRenderer::restorePhotonMap(const PhotonMapCache::PhotonMap & photonMap, PhotonMapStructure::E photonMapStructure)
+{
+    RenderTrace::ScopedEvent event(m_trace, "Photon map cache restore", photonMap.numPhotons, photonMap.getSizeBytes());
+    if(photonMapStructure == PhotonMapStructure::KD_TREE_CPU)
+    {
+        memcpy(m_photonKdTree->map(), photonMap.buffers[0].constData(), photonMap.buffers[0].size());
+        m_photonKdTree->unmap();
+    }
+    else
+    {
+        QVector<optix::Buffer> photonBuffers = getPhotonBuffers();
+        for(int i = 0; i < photonBuffers.size(); i++)
+        {
+            copyToDevice(photonBuffers[i], photonMap.buffers[i], m_photonBufferSize);
+        }
+        if(photonMapStructure == PhotonMapStructure::UNIFORM_GRID || photonMapStructure == PhotonMapStructure::HASHED_GRID)
+        {
+            const unsigned int tableSize = getHashedGridTableSize(photonMap.gridNumCells);
+            ensureBufferSize(m_hashmapOffsetTable, photonMap.gridNumCells+1);
+            copyToDevice(m_hashmapOffsetTable, photonMap.buffers[photonBuffers.size()], photonMap.gridNumCells+1);
+            if(photonMapStructure == PhotonMapStructure::HASHED_GRID)
+            {
+                ensureBufferSize(m_hashedGridCellKeys, photonMap.gridNumCells);
+                copyToDevice(m_hashedGridCellKeys, photonMap.buffers[photonBuffers.size()+1], photonMap.gridNumCells);
+                ensureBufferSize(m_hashedGridTable, tableSize);
+                copyToDevice(m_hashedGridTable, photonMap.buffers[photonBuffers.size()+2], tableSize);
+                m_context["hashedGridTableMask"]->setUint(tableSize-1);
+            }
+            m_numPhotonDeposits = (unsigned int)photonMap.numPhotons;
+        }
+        cudaDeviceSynchronize();
+    }
+
+    m_numberOfPhotonsLastFrame = photonMap.numPhotons;
+    m_gridSize = photonMap.gridSize;
+    m_spatialHashMapCellSize = photonMap.gridCellSize;
+    m_spatialHashMapNumCells = photonMap.gridNumCells;
+    m_context["photonsGridCellSize"]->setFloat(photonMap.gridCellSize);
+    m_context["photonsGridSize"]->setUint(photonMap.gridSize);
+    m_context["photonsGridMortonMasks"]->setUint(photonMap.gridMortonMasks);
+    m_context["photonsWorldOrigo"]->setFloat(photonMap.gridOrigin);
+}
+
+PhotonMapCache & OptixRenderer::getPhotonMapCache()
+{
+    return m_photonMapCache;
+}
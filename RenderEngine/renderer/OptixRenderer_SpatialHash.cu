@@ -7,7 +7,7 @@
 #include "config.h"
 #include <cuda.h>
 #include <optix_world.h>
-#include "renderer/helpers/random.h" // Cuda 6 issue: "cuda_kernel.h" needs must included before thrust stuff http://stackoverflow.com/questions/23352122/including-thrust-sort-h-before-curand-kernel-h-gives-compilation-error
+#include "renderer/helpers/random.h"
 #include <thrust/reduce.h>
 #include <thrust/pair.h>
 #include <thrust/device_vector.h>
@@ -16,11 +16,17 @@
 #include <thrust/partition.h>
 #include <thrust/scan.h>
 #include <thrust/adjacent_difference.h>
+#include <thrust/sort.h>
+#include <thrust/unique.h>
+#include <thrust/iterator/zip_iterator.h>
+#include <thrust/iterator/counting_iterator.h>
 #include "renderer/ppm/Photon.h"
 #include <cstdio>
 #include <cmath>
 #include "renderer/ppm/PhotonGrid.h"
 #include "renderer/Hitpoint.h"
+#include "renderer/vcm/LightVertex.h"
+#include "renderer/vcm/LightVertexGrid.h"
 #include "renderer/OptixRenderer.h"
 #include "util/sutil.h"
 #include "renderer/OptixEntryPoint.h"
@@ -70,10 +76,8 @@ static float getSmallestPossibleCellSize(const Vector3 & sceneExtent, const unsi
     return fmaxf(radiusEachAxis);
 }
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
-
 /*
-// Construct acceleration structure.
+// Construct uniform grid acceleration structure.
 */
 
 // Reduction type
@@ -110,6 +114,40 @@ struct AABBReducer : public thrust::binary_function<AABB, AABB, AABB>
     }
 };
 
+#if ENABLE_PHOTON_SOA_LAYOUT
+
+// The photon buffers of the structure of arrays layout, see PhotonBuffer.h
+struct PhotonBuffers
+{
+    thrust::device_ptr<float3> positions;
+    thrust::device_ptr<unsigned int> directions;
+    thrust::device_ptr<unsigned int> powers;
+};
+
+typedef thrust::tuple<float3, unsigned int> PhotonPositionAndPower;
+
+// convert a photon position and packed power to a AABB containing that photon
+struct PhotonToAABBConverter : public thrust::unary_function<PhotonPositionAndPower, AABB>
+{
+    __host__ __device__ AABB operator()(PhotonPositionAndPower photon)
+    {
+        float3 position = thrust::get<0>(photon);
+        bool valid = thrust::get<1>(photon) != 0;
+        AABB a (position, position, valid, valid ? 1 : 0);
+        return a;
+    }
+};
+
+static AABB getPhotonsBoundingBox(PhotonBuffers & photons, unsigned int numValidPhotons)
+{
+    AABB init (make_float3(0.0f), make_float3(0.0f), false, 0);
+    return thrust::transform_reduce(thrust::make_zip_iterator(thrust::make_tuple(photons.positions, photons.powers)),
+        thrust::make_zip_iterator(thrust::make_tuple(photons.positions+numValidPhotons, photons.powers+numValidPhotons)),
+        PhotonToAABBConverter(), init, AABBReducer());
+}
+
+#else
+
 // convert a photon to a AABB containing that photon
 struct PhotonToAABBConverter : public thrust::unary_function<Photon, AABB>
 {
@@ -122,11 +160,12 @@ struct PhotonToAABBConverter : public thrust::unary_function<Photon, AABB>
 
 static AABB getPhotonsBoundingBox(thrust::device_ptr<Photon> & photons, unsigned int numValidPhotons)
 {
-    Photon photon = photons[0];
-    AABB init = AABB(photon.position, photon.position, fmaxf(photon.power) > 0, fmaxf(photon.power) > 0 ? 1 : 0);
+    AABB init (make_float3(0.0f), make_float3(0.0f), false, 0);
     return thrust::transform_reduce(photons, photons+numValidPhotons, PhotonToAABBConverter(), init, AABBReducer());
 }
 
+#endif
+
 /*
 // Add padding to AABB so that in the final hash table, we will have empty grid cells on the surface of the volume
 // (to avoid clamping)
@@ -149,19 +188,36 @@ optix::float3 getSceneExtent(const AABB & aabb)
     return aabb.second - aabb.first;
 }
 
+#if ENABLE_PHOTON_SOA_LAYOUT
+__global__ void calculateHashCellsKernel(const float3* photonPositions, const unsigned int* photonPowers, unsigned int* photonsHashCell,
+                                         unsigned int* hashCellHistogram, unsigned int numPhotons, const uint3 gridSize, const uint3 mortonMasks,
+                                         const Vector3 sceneOrigo, const float cellSize, const unsigned int invalidHashCell )
+#else
 __global__ void calculateHashCellsKernel(Photon* photons, unsigned int* photonsHashCell, unsigned int* hashCellHistogram,
-                                         unsigned int numPhotons, const uint3 gridSize, 
+                                         unsigned int numPhotons, const uint3 gridSize, const uint3 mortonMasks,
                                          const Vector3 sceneOrigo, const float cellSize, const unsigned int invalidHashCell )
+#endif
 {
     unsigned int index = blockIdx.x*blockDim.x + threadIdx.x;
     if(index < numPhotons)
     {
+#if ENABLE_PHOTON_SOA_LAYOUT
+        float3 position = photonPositions[index];
+        bool valid = photonPowers[index] != 0;
+#else
         Photon & photon = photons[index];
+        float3 position = photon.position;
+        bool valid = fmaxf(photon.power) > 0;
+#endif
         unsigned int hashCell;
-        if(fmaxf(photon.power) > 0)
+        if(valid)
         {
-            optix::uint3 hashGridPos = getPhotonGridIndex(photon.position, sceneOrigo, cellSize);
+            optix::uint3 hashGridPos = getPhotonGridIndex(position, sceneOrigo, cellSize);
+#if ENABLE_MORTON_ORDERED_PHOTON_GRID
+            hashCell = getPhotonGridIndexMorton(hashGridPos, mortonMasks);
+#else
             hashCell = getPhotonGridIndex1D(hashGridPos, gridSize);
+#endif
             atomicAdd(hashCellHistogram+hashCell, 1);
         }
         else
@@ -172,28 +228,51 @@ __global__ void calculateHashCellsKernel(Photon* photons, unsigned int* photonsH
     }
 }
 
+#if ENABLE_PHOTON_SOA_LAYOUT
+static void calculateHashCells(PhotonBuffers & photons, thrust::device_ptr<unsigned int> & photonsHashCell, thrust::device_ptr<unsigned int> & hashCellHistogram,
+#else
 static void calculateHashCells(thrust::device_ptr<Photon> & photons, thrust::device_ptr<unsigned int> & photonsHashCell, thrust::device_ptr<unsigned int> & hashCellHistogram,
-                                unsigned int numPhotons, const optix::uint3 & gridSize, 
+#endif
+                                unsigned int numPhotons, const optix::uint3 & gridSize, const optix::uint3 & mortonMasks,
                                 const Vector3 & sceneOrigo, const float radius, const unsigned int invalidHashCell )
 {
     const unsigned int blockSize = 512;
     unsigned int numBlocks = numPhotons/blockSize + (numPhotons%blockSize == 0 ? 0 : 1);
-    Photon* photonsPtr = thrust::raw_pointer_cast(&photons[0]);
     unsigned int* photonsHashCellPtr = thrust::raw_pointer_cast(&photonsHashCell[0]);
     unsigned int* hashCellHistogramPtr = thrust::raw_pointer_cast(&hashCellHistogram[0]);
 
+#if ENABLE_PHOTON_SOA_LAYOUT
+    float3* photonPositionsPtr = thrust::raw_pointer_cast(&photons.positions[0]);
+    unsigned int* photonPowersPtr = thrust::raw_pointer_cast(&photons.powers[0]);
+    calculateHashCellsKernel<<<numBlocks, blockSize>>> (photonPositionsPtr, photonPowersPtr, photonsHashCellPtr, hashCellHistogramPtr,
+                                                        numPhotons, gridSize, mortonMasks, sceneOrigo, radius, invalidHashCell);
+#else
+    Photon* photonsPtr = thrust::raw_pointer_cast(&photons[0]);
     calculateHashCellsKernel<<<numBlocks, blockSize>>> (photonsPtr, photonsHashCellPtr, hashCellHistogramPtr, 
-                                                        numPhotons, gridSize, sceneOrigo, radius, invalidHashCell);
+                                                        numPhotons, gridSize, mortonMasks, sceneOrigo, radius, invalidHashCell);
+#endif
 }
 
 /*
 // Sort photons
 */
 
-static void sortPhotonsByHash(thrust::device_ptr<Photon> & photons, thrust::device_ptr<unsigned int> & photonsHashCell, unsigned int numValidPhotons)
+// The key is the cell index of the uniform grid or the cell key of the hashed grid
+#if ENABLE_PHOTON_SOA_LAYOUT
+template<typename Key>
+static void sortPhotonsByHash(PhotonBuffers & photons, thrust::device_ptr<Key> & photonsHashCell, unsigned int numValidPhotons)
+{
+    // The three arrays are permuted together
+    thrust::sort_by_key(photonsHashCell, photonsHashCell+numValidPhotons,
+        thrust::make_zip_iterator(thrust::make_tuple(photons.positions, photons.directions, photons.powers)), thrust::less<Key>());
+}
+#else
+template<typename Key>
+static void sortPhotonsByHash(thrust::device_ptr<Photon> & photons, thrust::device_ptr<Key> & photonsHashCell, unsigned int numValidPhotons)
 {
-    thrust::sort_by_key(photonsHashCell, photonsHashCell+numValidPhotons, photons, thrust::less<unsigned int>());
+    thrust::sort_by_key(photonsHashCell, photonsHashCell+numValidPhotons, photons, thrust::less<Key>());
 }
+#endif
 
 /*
 Create photon offset table
@@ -212,11 +291,18 @@ void OptixRenderer::createUniformGridPhotonMap(float ppmRadius)
     int deviceNumber = 0;
     cudaSetDevice(m_optixDeviceOrdinal);
 
-    // Get a device_ptr to our photon list
+    // Get a device_ptr to our photon list, the photon pass appended m_numPhotonDeposits photons to it
+#if ENABLE_PHOTON_SOA_LAYOUT
+    PhotonBuffers photons;
+    photons.positions = getThrustDevicePtr<float3>(m_photonPositions, deviceNumber);
+    photons.directions = getThrustDevicePtr<unsigned int>(m_photonDirections, deviceNumber);
+    photons.powers = getThrustDevicePtr<unsigned int>(m_photonPowers, deviceNumber);
+#else
     thrust::device_ptr<Photon> photons = getThrustDevicePtr<Photon>(m_photons, deviceNumber);
+#endif
 
     // Get the AABB that contains all valid scene photons
-    AABB scene = getPhotonsBoundingBox(photons, NUM_PHOTONS);
+    AABB scene = getPhotonsBoundingBox(photons, m_numPhotonDeposits);
     AABB extendedScene = padAABB(scene);
     optix::float3 sceneWorldOrigo = extendedScene.first;
     cudaDeviceSynchronize();
@@ -236,7 +322,6 @@ void OptixRenderer::createUniformGridPhotonMap(float ppmRadius)
     // Calculate hashes for photons
     
     unsigned int numHashCells = m_gridSize.x * m_gridSize.y * m_gridSize.z;
-    m_spatialHashMapNumCells = numHashCells;
 
     //printf("# CellSize %.3f, %d hash values, smallestPossibleCellSize: %.3f\n", cellSize, numHashCells, smallestPossibleCellSize);
     //printf("# GridSize %d %d %d\n", gridSize.x, gridSize.y, gridSize.z);
@@ -247,6 +332,19 @@ void OptixRenderer::createUniformGridPhotonMap(float ppmRadius)
         exit(1);
     }
 
+    // The Morton numbering leaves gaps, up to 8 indices per cell. The offset table grows to fit it.
+    optix::uint3 mortonMasks = getPhotonGridMortonMasks(m_gridSize);
+#if ENABLE_MORTON_ORDERED_PHOTON_GRID
+    numHashCells = getPhotonGridMortonSize(mortonMasks);
+    RTsize offsetTableSize;
+    m_hashmapOffsetTable->getSize(offsetTableSize);
+    if(offsetTableSize < numHashCells+1)
+    {
+        m_hashmapOffsetTable->setSize(numHashCells+1);
+    }
+#endif
+    m_spatialHashMapNumCells = numHashCells;
+
     // Calculate hash values for each photon and build the histogram
     unsigned int invalidHashCellValue = numHashCells+1;
 
@@ -254,14 +352,14 @@ void OptixRenderer::createUniformGridPhotonMap(float ppmRadius)
     thrust::device_ptr<unsigned int> hashmapOffsetTable = getThrustDevicePtr<unsigned int>(m_hashmapOffsetTable, deviceNumber);
     thrust::fill(hashmapOffsetTable, hashmapOffsetTable+numHashCells, 0);
     thrust::device_ptr<unsigned int> photonsHashCell = getThrustDevicePtr<unsigned int>(m_photonsHashCells, deviceNumber);
-    calculateHashCells(photons, photonsHashCell, hashmapOffsetTable, NUM_PHOTONS, m_gridSize, sceneWorldOrigo, cellSize, invalidHashCellValue);
+    calculateHashCells(photons, photonsHashCell, hashmapOffsetTable, m_numPhotonDeposits, m_gridSize, mortonMasks, sceneWorldOrigo, cellSize, invalidHashCellValue);
     cudaDeviceSynchronize();
     nvtxRangePop();
 
     // Sort the photons by their hash value
 
     nvtxRangePushA("Sort photons by hash");
-    sortPhotonsByHash(photons, photonsHashCell, NUM_PHOTONS);
+    sortPhotonsByHash(photons, photonsHashCell, m_numPhotonDeposits);
     nvtxRangePop();
 
     // Calculate the offset table from the histogram
@@ -277,11 +375,160 @@ void OptixRenderer::createUniformGridPhotonMap(float ppmRadius)
 
     m_context["photonsGridCellSize"]->setFloat(cellSize);
     m_context["photonsGridSize"]->setUint(m_gridSize);
+    m_context["photonsGridMortonMasks"]->setUint(mortonMasks);
     m_context["photonsWorldOrigo"]->setFloat(sceneWorldOrigo);
 
 }
 
-#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
+/*
+// Construct the sparse hashed grid. The photons are sorted by the key of their cell, the first photon of each distinct
+// key gives the cell its offset and the cells are inserted into the table. Nothing depends on the number of cells the
+// bounding box of the photons would have, so the cells stay one radius wide however far the radius shrinks.
+*/
+
+#if ENABLE_PHOTON_SOA_LAYOUT
+__global__ void calculateHashedGridKeysKernel(const float3* photonPositions, const unsigned int* photonPowers, unsigned long long* photonKeys,
+                                              unsigned int numPhotons, const optix::float3 worldOrigo, const float cellSize)
+#else
+__global__ void calculateHashedGridKeysKernel(const Photon* photons, unsigned long long* photonKeys, unsigned int numPhotons,
+                                              const optix::float3 worldOrigo, const float cellSize)
+#endif
+{
+    unsigned int index = blockIdx.x*blockDim.x + threadIdx.x;
+    if(index < numPhotons)
+    {
+#if ENABLE_PHOTON_SOA_LAYOUT
+        float3 position = photonPositions[index];
+        bool valid = photonPowers[index] != 0;
+#else
+        const Photon & photon = photons[index];
+        float3 position = photon.position;
+        bool valid = fmaxf(photon.power) > 0;
+#endif
+        // Invalid photons sort last
+        unsigned long long key = ~0ull;
+        if(valid)
+        {
+            optix::uint2 cellKey = getHashedGridCellKey(getPhotonGridIndex(position, worldOrigo, cellSize));
+            key = ((unsigned long long)cellKey.y << 32) | cellKey.x;
+        }
+        photonKeys[index] = key;
+    }
+}
+
+__global__ void insertHashedGridCellsKernel(const unsigned long long* cellKeys, unsigned int* table, unsigned int numCells,
+                                            unsigned int tableMask)
+{
+    unsigned int index = blockIdx.x*blockDim.x + threadIdx.x;
+    if(index < numCells)
+    {
+        unsigned long long key = cellKeys[index];
+        unsigned int slot = getHashedGridSlot(optix::make_uint2((unsigned int)key, (unsigned int)(key >> 32)), tableMask);
+        while(atomicCAS(table+slot, PHOTON_HASHED_GRID_EMPTY_SLOT, index) != PHOTON_HASHED_GRID_EMPTY_SLOT)
+        {
+            slot = (slot + 1) & tableMask;
+        }
+    }
+}
+
+static void ensureBufferSize(optix::Buffer & buffer, RTsize size)
+{
+    RTsize currentSize;
+    buffer->getSize(currentSize);
+    if(currentSize < size)
+    {
+        buffer->setSize(size);
+    }
+}
+
+void OptixRenderer::createHashedGridPhotonMap(float ppmRadius)
+{
+    int deviceNumber = 0;
+    cudaSetDevice(m_optixDeviceOrdinal);
+    const unsigned int numPhotons = m_numPhotonDeposits;
+
+    // The per photon keys, cell keys and cell offsets never need more entries than there are photons. Buffers are
+    // resized before their device pointers are taken.
+    ensureBufferSize(m_photonsHashedGridKeys, numPhotons);
+    ensureBufferSize(m_hashedGridCellKeys, numPhotons);
+    ensureBufferSize(m_hashmapOffsetTable, numPhotons+1);
+
+#if ENABLE_PHOTON_SOA_LAYOUT
+    PhotonBuffers photons;
+    photons.positions = getThrustDevicePtr<float3>(m_photonPositions, deviceNumber);
+    photons.directions = getThrustDevicePtr<unsigned int>(m_photonDirections, deviceNumber);
+    photons.powers = getThrustDevicePtr<unsigned int>(m_photonPowers, deviceNumber);
+#else
+    thrust::device_ptr<Photon> photons = getThrustDevicePtr<Photon>(m_photons, deviceNumber);
+#endif
+
+    nvtxRangePushA("Get photon AABB");
+    AABB scene = getPhotonsBoundingBox(photons, numPhotons);
+    AABB extendedScene = padAABB(scene);
+    optix::float3 sceneWorldOrigo = extendedScene.first;
+    const float cellSize = ppmRadius;
+    m_gridSize = calculateGridSize(getSceneExtent(extendedScene), cellSize);
+    nvtxRangePop();
+
+    if(m_gridSize.x > PHOTON_HASHED_GRID_MAX_AXIS_CELLS || m_gridSize.y > PHOTON_HASHED_GRID_MAX_AXIS_CELLS
+        || m_gridSize.z > PHOTON_HASHED_GRID_MAX_AXIS_CELLS)
+    {
+        throw std::exception("Too many cells along an axis of the hashed grid, the PPM radius is too small for the scene.");
+    }
+
+    nvtxRangePushA("Calculate hashed grid keys");
+    thrust::device_ptr<unsigned long long> photonKeys = getThrustDevicePtr<unsigned long long>(m_photonsHashedGridKeys, deviceNumber);
+    const unsigned int blockSize = 512;
+    unsigned int numBlocks = numPhotons/blockSize + (numPhotons%blockSize == 0 ? 0 : 1);
+    if(numBlocks > 0)
+    {
+#if ENABLE_PHOTON_SOA_LAYOUT
+        calculateHashedGridKeysKernel<<<numBlocks, blockSize>>>(thrust::raw_pointer_cast(&photons.positions[0]),
+            thrust::raw_pointer_cast(&photons.powers[0]), thrust::raw_pointer_cast(&photonKeys[0]), numPhotons, sceneWorldOrigo, cellSize);
+#else
+        calculateHashedGridKeysKernel<<<numBlocks, blockSize>>>(thrust::raw_pointer_cast(&photons[0]),
+            thrust::raw_pointer_cast(&photonKeys[0]), numPhotons, sceneWorldOrigo, cellSize);
+#endif
+    }
+    nvtxRangePop();
+
+    nvtxRangePushA("Sort photons by hashed grid key");
+    sortPhotonsByHash(photons, photonKeys, numPhotons);
+    nvtxRangePop();
+
+    // The valid photons come first, each distinct key among them starts a cell
+    nvtxRangePushA("Create hashed grid cells");
+    const unsigned int numValidPhotons = scene.numPhotons;
+    thrust::device_ptr<unsigned long long> cellKeys = getThrustDevicePtr<unsigned long long>(m_hashedGridCellKeys, deviceNumber);
+    thrust::device_ptr<unsigned int> cellOffsets = getThrustDevicePtr<unsigned int>(m_hashmapOffsetTable, deviceNumber);
+    unsigned int numCells = (unsigned int)(thrust::unique_by_key_copy(photonKeys, photonKeys+numValidPhotons,
+        thrust::counting_iterator<unsigned int>(0), cellKeys, cellOffsets).first - cellKeys);
+    cellOffsets[numCells] = numValidPhotons;
+    nvtxRangePop();
+
+    nvtxRangePushA("Insert hashed grid cells");
+    const unsigned int tableSize = getHashedGridTableSize(numCells);
+    ensureBufferSize(m_hashedGridTable, tableSize);
+    thrust::device_ptr<unsigned int> table = getThrustDevicePtr<unsigned int>(m_hashedGridTable, deviceNumber);
+    thrust::fill(table, table+tableSize, PHOTON_HASHED_GRID_EMPTY_SLOT);
+    numBlocks = numCells/blockSize + (numCells%blockSize == 0 ? 0 : 1);
+    if(numBlocks > 0)
+    {
+        insertHashedGridCellsKernel<<<numBlocks, blockSize>>>(thrust::raw_pointer_cast(&cellKeys[0]),
+            thrust::raw_pointer_cast(&table[0]), numCells, tableSize-1);
+    }
+    cudaDeviceSynchronize();
+    nvtxRangePop();
+
+    m_spatialHashMapCellSize = cellSize;
+    m_spatialHashMapNumCells = numCells;
+    m_numberOfPhotonsLastFrame = numValidPhotons;
+
+    m_context["photonsGridCellSize"]->setFloat(cellSize);
+    m_context["photonsGridSize"]->setUint(m_gridSize);
+    m_context["photonsWorldOrigo"]->setFloat(sceneWorldOrigo);
+    m_context["hashedGridTableMask"]->setUint(tableSize-1);
+}
 
 void OptixRenderer::initializeStochasticHashPhotonMap(float ppmRadius)
 {
@@ -297,51 +544,118 @@ void OptixRenderer::initializeStochasticHashPhotonMap(float ppmRadius)
     // Clear photons
     {
         nvtx::ScopedRange r( "OptixEntryPoint::PPM_CLEAR_PHOTONS_UNIFORM_GRID_PASS" );
-        m_context->launch( OptixEntryPoint::PPM_CLEAR_PHOTONS_UNIFORM_GRID_PASS, NUM_PHOTONS);
+        m_context->launch( OptixEntryPoint::PPM_CLEAR_PHOTONS_UNIFORM_GRID_PASS, m_photonBufferSize);
     }
 }
 
-#endif
+/*
+// Offsets of the VCM light subpaths in the packed light vertex cache, the exclusive scan of the vertex counts of the
+// count pass. The entry after the last subpath holds the total, which is returned.
+*/
+
+unsigned int OptixRenderer::createLightSubpathVertexOffsets()
+{
+    int deviceNumber = 0;
+    cudaSetDevice(m_optixDeviceOrdinal);
+    const unsigned int numSubpaths = m_lightPassLaunchWidth*m_lightPassLaunchHeight;
+
+    thrust::device_ptr<unsigned int> counts = getThrustDevicePtr<unsigned int>(m_lightSubpathVertexCountBuffer, deviceNumber);
+    thrust::device_ptr<unsigned int> offsets = getThrustDevicePtr<unsigned int>(m_lightSubpathVertexOffsetBuffer, deviceNumber);
+    thrust::exclusive_scan(counts, counts+numSubpaths, offsets, 0u);
+    const unsigned int numVertices = numSubpaths > 0 ? offsets[numSubpaths-1] + counts[numSubpaths-1] : 0;
+    offsets[numSubpaths] = numVertices;
+    return numVertices;
+}
 
 /*
-// Initialize random state buffer
+// Construct the hashed grid over the VCM light vertex cache (LightVertexGrid.h). Same cells, keys and table as the photon
+// hashed grid, but the light vertices are much larger than photons so only their indices are sorted. The grid covers
+// the padded scene bounding box, which holds every vertex, so no reduction over the vertices is needed.
 */
 
-static void __global__ initRandomStateBuffer(RandomState* states, unsigned int seed, unsigned int num)
+__global__ void calculateLightVertexGridKeysKernel(const LightVertex* vertices, unsigned long long* keys, unsigned int* indices,
+                                                   unsigned int numVertices, const optix::float3 worldOrigo, const float cellSize)
 {
     unsigned int index = blockIdx.x*blockDim.x + threadIdx.x;
-    if(index < num)
+    if(index < numVertices)
     {
-        initializeRandomState(&states[index], seed, index);
+        optix::uint2 cellKey = getHashedGridCellKey(getPhotonGridIndex(vertices[index].hitPoint, worldOrigo, cellSize));
+        keys[index] = ((unsigned long long)cellKey.y << 32) | cellKey.x;
+        indices[index] = index;
     }
 }
 
-static void initializeRandomStateBuffer(optix::Buffer & buffer, int numStates)
+void OptixRenderer::createLightVertexGrid(float vcmRadius)
 {
-    // vmarz TODO fix cast long to int ?
-    unsigned int seed = 574133*(unsigned int)clock() + 47844152748*(unsigned int)time(NULL);
-#ifdef DEBUG_RANDOM_SEED
-    seed = DEBUG_RANDOM_SEED;
-#endif
+    int deviceNumber = 0;
+    cudaSetDevice(m_optixDeviceOrdinal);
 
-    printf("Seeding on %u clock: %d time: %d \n", seed, (unsigned int)clock(), (unsigned int)time(NULL));
+    // The light vertex cache is packed, the light pass stored exactly the counted vertices
+    const unsigned int numVertices = m_lightVertexCount;
 
-    RandomState* states = getDevicePtr<RandomState>(buffer, 0);
-    const int blockSize = 256;
-    int numBlocks = numStates/blockSize + (numStates % blockSize == 0 ? 0 : 1);
-    initRandomStateBuffer<<<numBlocks, blockSize>>>(states, seed, numStates);
-    cudaDeviceSynchronize();
-}
+    AAB aabb = m_sceneAABB;
+    aabb.addPadding(vcmRadius+0.0001);
+    const float cellSize = vcmRadius;
+    optix::uint3 gridSize = calculateGridSize(aabb.getExtent(), cellSize);
+    if(gridSize.x > PHOTON_HASHED_GRID_MAX_AXIS_CELLS || gridSize.y > PHOTON_HASHED_GRID_MAX_AXIS_CELLS
+        || gridSize.z > PHOTON_HASHED_GRID_MAX_AXIS_CELLS)
+    {
+        throw std::exception("Too many cells along an axis of the light vertex grid, the VCM radius is too small for the scene.");
+    }
 
-void OptixRenderer::initializeRandomStates()
-{
-    double t0, t1;
-    sutilCurrentTime( &t0);
-
-    RTsize size[2];
-    m_randomStatesBuffer->getSize(size[0], size[1]);
-    int num = size[0]*size[1];
-    initializeRandomStateBuffer(m_randomStatesBuffer, num);
-    sutilCurrentTime( &t1 );
-    printf("Init random states in %.3f sec.\n", t1-t0);
-}
\ No newline at end of file
+    ensureBufferSize(m_lightVertexGridKeys, numVertices);
+    ensureBufferSize(m_lightVertexGridIndices, numVertices);
+    ensureBufferSize(m_lightVertexGridCellKeys, numVertices);
+    ensureBufferSize(m_lightVertexGridCellOffsets, numVertices+1);
+
+    unsigned int numCells = 0;
+    unsigned int tableSize = 1;
+    if(numVertices > 0)
+    {
+        nvtxRangePushA("Calculate light vertex grid keys");
+        thrust::device_ptr<LightVertex> vertices = getThrustDevicePtr<LightVertex>(m_lightVertexBuffer, deviceNumber);
+        thrust::device_ptr<unsigned long long> keys = getThrustDevicePtr<unsigned long long>(m_lightVertexGridKeys, deviceNumber);
+        thrust::device_ptr<unsigned int> indices = getThrustDevicePtr<unsigned int>(m_lightVertexGridIndices, deviceNumber);
+        const unsigned int blockSize = 512;
+        unsigned int numBlocks = numVertices/blockSize + (numVertices%blockSize == 0 ? 0 : 1);
+        calculateLightVertexGridKeysKernel<<<numBlocks, blockSize>>>(thrust::raw_pointer_cast(&vertices[0]),
+            thrust::raw_pointer_cast(&keys[0]), thrust::raw_pointer_cast(&indices[0]), numVertices, aabb.min, cellSize);
+        nvtxRangePop();
+
+        nvtxRangePushA("Sort light vertex indices by grid key");
+        thrust::sort_by_key(keys, keys+numVertices, indices, thrust::less<unsigned long long>());
+        nvtxRangePop();
+
+        nvtxRangePushA("Create light vertex grid cells");
+        thrust::device_ptr<unsigned long long> cellKeys = getThrustDevicePtr<unsigned long long>(m_lightVertexGridCellKeys, deviceNumber);
+        thrust::device_ptr<unsigned int> cellOffsets = getThrustDevicePtr<unsigned int>(m_lightVertexGridCellOffsets, deviceNumber);
+        numCells = (unsigned int)(thrust::unique_by_key_copy(keys, keys+numVertices,
+            thrust::counting_iterator<unsigned int>(0), cellKeys, cellOffsets).first - cellKeys);
+        cellOffsets[numCells] = numVertices;
+        nvtxRangePop();
+
+        nvtxRangePushA("Insert light vertex grid cells");
+        tableSize = getHashedGridTableSize(numCells);
+        ensureBufferSize(m_lightVertexGridTable, tableSize);
+        thrust::device_ptr<unsigned int> table = getThrustDevicePtr<unsigned int>(m_lightVertexGridTable, deviceNumber);
+        thrust::fill(table, table+tableSize, PHOTON_HASHED_GRID_EMPTY_SLOT);
+        numBlocks = numCells/blockSize + (numCells%blockSize == 0 ? 0 : 1);
+        insertHashedGridCellsKernel<<<numBlocks, blockSize>>>(thrust::raw_pointer_cast(&cellKeys[0]),
+            thrust::raw_pointer_cast(&table[0]), numCells, tableSize-1);
+        cudaDeviceSynchronize();
+        nvtxRangePop();
+    }
+
+    LightVertexGrid grid;
+    grid.vertexIndexBufferId = m_lightVertexGridIndices->getId();
+    grid.cellKeyBufferId = m_lightVertexGridCellKeys->getId();
+    grid.cellOffsetBufferId = m_lightVertexGridCellOffsets->getId();
+    grid.tableBufferId = m_lightVertexGridTable->getId();
+    grid.tableMask = tableSize-1;
+    grid.numCells = numCells;
+    grid.gridSize = gridSize;
+    grid.worldOrigo = aabb.min;
+    grid.cellSize = cellSize;
+    grid.radiusSquared = vcmRadius*vcmRadius;
+    m_context["lightVertexGrid"]->setUserData(sizeof(LightVertexGrid), &grid);
+}
@@ -5,12 +5,202 @@
 */
 
 #pragma once
-#include "config.h"
+#include <optixu/optixu_math_namespace.h>
+#include "renderer/device_common.h"
+#include "renderer/Sampler.h"
 
-#if USE_CHEAP_RANDOM
-#include <stdint.h>
-typedef uint32_t RandomState;
+/*
+Counter-based random numbers: the n-th number of a sample is Philox2x32-10 (Salmon et al., "Parallel random numbers:
+as easy as 1, 2, 3") of the counter (n, iteration) under a key made from the seed and the pixel or photon index. Nothing
+is stored between launches, a program creates its state from its index and the iteration number and the same sample
+gets the same numbers on the device and on the host (HostPathTracer), on any server and in any render tile.
+
+Passes that run on the same launch index in one iteration start at different dimensions (RandomStream) so they do not
+draw the same numbers.
+
+States created with the Sobol or Halton sampler draw the iteration number-th point of a low-discrepancy sequence
+instead, so the samples of a pixel are stratified over the iterations. Sobol draws come from the 2D Sobol (0,2)
+sequence, a pair of dimensions per getRandomUniformFloat2, with the sample order and the points Owen scrambled by a
+hash of the pixel and the dimension (Burley, "Practical Hash-based Owen Scrambling"). Halton draws are radical
+inverses in the prime bases of the dimension, Owen scrambled the same way. Neither needs tables, and the scrambling
+decorrelates the pixels and the dimensions past the sequence.
+*/
+
+namespace RandomStream
+{
+    enum E
+    {
+        CAMERA,
+        DIRECT_LIGHT,
+        PHOTON,
+        VCM_LIGHT,
+        VCM_CAMERA
+    };
+}
+
+struct RandomState
+{
+    unsigned int key;
+    unsigned int iterationNumber;
+    unsigned int dimension;
+    unsigned int sampler;
+};
+
+static __host__ RT_FUNCTION unsigned int randomHash(unsigned int seed)
+{
+    seed = (seed ^ 61) ^ (seed >> 16);
+    seed *= 9;
+    seed = seed ^ (seed >> 4);
+    seed *= 0x27d4eb2d;
+    seed = seed ^ (seed >> 15);
+    return seed;
+}
+
+static __host__ RT_FUNCTION unsigned int mulhilo32(unsigned int a, unsigned int b, unsigned int & hi)
+{
+#ifdef __CUDA_ARCH__
+    hi = __umulhi(a, b);
+    return a*b;
+#else
+    unsigned long long product = (unsigned long long)a*b;
+    hi = (unsigned int)(product >> 32);
+    return (unsigned int)product;
+#endif
+}
+
+static __host__ RT_FUNCTION optix::uint2 philox2x32(optix::uint2 counter, unsigned int key)
+{
+    for(int round = 0; round < 10; round++)
+    {
+        unsigned int hi;
+        unsigned int lo = mulhilo32(0xD256D193u, counter.x, hi);
+        counter = optix::make_uint2(hi ^ key ^ counter.y, lo);
+        key += 0x9E3779B9u;
+    }
+    return counter;
+}
+
+static __host__ RT_FUNCTION unsigned int reverseBits(unsigned int x)
+{
+#ifdef __CUDA_ARCH__
+    return __brev(x);
 #else
-#include <curand_kernel.h>
-typedef curandState RandomState;
-#endif
\ No newline at end of file
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+#endif
+}
+
+// Owen scrambling of the bits of x, from the highest bit down (Laine-Karras permutation with Burley's constants)
+static __host__ RT_FUNCTION unsigned int nestedUniformScramble(unsigned int x, unsigned int seed)
+{
+    x = reverseBits(x);
+    x ^= x*0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x*0x05526c56u;
+    x ^= x*0x53a22864u;
+    return reverseBits(x);
+}
+
+// Second dimension of the Sobol sequence, the first is reverseBits(index)
+static __host__ RT_FUNCTION unsigned int getSobolDimension1(unsigned int index)
+{
+    unsigned int result = 0;
+    for(unsigned int v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+    {
+        if(index & 1)
+        {
+            result ^= v;
+        }
+    }
+    return result;
+}
+
+// Owen scrambled radical inverse of index in a prime base as 32 bit fixed point. Each digit goes through a random
+// affine permutation seeded by the digits below it. The integer arithmetic gives the same bits on the host and the
+// device.
+static __host__ RT_FUNCTION unsigned int getScrambledRadicalInverse(unsigned int index, unsigned int base, unsigned int seed)
+{
+    const unsigned int originalIndex = index;
+    unsigned int reversedDigits = 0;
+    unsigned int baseProduct = 1;
+    unsigned int lowDigits = 0;
+    while(baseProduct < (1u << 24))
+    {
+        unsigned int hash = randomHash(seed ^ randomHash(lowDigits + baseProduct));
+        unsigned int digit = ((index % base)*(1 + (hash >> 16) % (base - 1)) + (hash & 0xFFFF) % base) % base;
+        reversedDigits = reversedDigits*base + digit;
+        baseProduct *= base;
+        index /= base;
+        lowDigits = originalIndex % baseProduct;
+    }
+    return (unsigned int)(((unsigned long long)reversedDigits << 32)/baseProduct);
+}
+
+static __host__ RT_FUNCTION unsigned int getHaltonBase(unsigned int dimension)
+{
+    const unsigned int primes[32] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79,
+        83, 89, 97, 101, 103, 107, 109, 113, 127, 131 };
+    return primes[dimension % 32];
+}
+
+static __host__ RT_FUNCTION RandomState createRandomState(unsigned int seed, unsigned long long iterationNumber,
+    unsigned int index, RandomStream::E stream, unsigned int sampler = Sampler::RANDOM)
+{
+    RandomState state;
+    state.key = randomHash(randomHash(seed) + index);
+    state.iterationNumber = (unsigned int)iterationNumber;
+    state.dimension = (unsigned int)stream << 24;
+    state.sampler = sampler;
+    return state;
+}
+
+// The next draw as 32 bit fixed point, x only or x and y
+static __host__ RT_FUNCTION optix::uint2 getRandomUint2(RandomState* state, bool needsY)
+{
+    const unsigned int dimension = state->dimension++;
+    if(state->sampler == Sampler::SOBOL)
+    {
+        unsigned int seed = randomHash(state->key ^ randomHash(dimension));
+        unsigned int index = nestedUniformScramble(state->iterationNumber, seed);
+        unsigned int x = nestedUniformScramble(reverseBits(index), randomHash(seed + 1));
+        unsigned int y = needsY ? nestedUniformScramble(getSobolDimension1(index), randomHash(seed + 2)) : 0;
+        return optix::make_uint2(x, y);
+    }
+    else if(state->sampler == Sampler::HALTON)
+    {
+        unsigned int seed = randomHash(state->key ^ randomHash(dimension));
+        unsigned int haltonDimension = 2*(dimension & 0xFFFFFF);
+        unsigned int x = getScrambledRadicalInverse(state->iterationNumber, getHaltonBase(haltonDimension), seed);
+        unsigned int y = needsY ? getScrambledRadicalInverse(state->iterationNumber, getHaltonBase(haltonDimension + 1),
+            randomHash(seed + 1)) : 0;
+        return optix::make_uint2(x, y);
+    }
+    return philox2x32(optix::make_uint2(dimension, state->iterationNumber), state->key);
+}
+
+// Return a float in range [0,1), the upper 24 bits so the conversion is exact on host and device
+static __host__ RT_FUNCTION float toUniformFloat(unsigned int bits)
+{
+    return float(bits >> 8)*(1.f/16777216.f);
+}
+
+static __host__ RT_FUNCTION float getRandomUniformFloat(RandomState* state)
+{
+    return toUniformFloat(getRandomUint2(state, false).x);
+}
+
+static __host__ RT_FUNCTION optix::float2 getRandomUniformFloat2(RandomState* state)
+{
+    optix::uint2 bits = getRandomUint2(state, true);
+    return optix::make_float2(toUniformFloat(bits.x), toUniformFloat(bits.y));
+}
+
+static __host__ RT_FUNCTION optix::float3 getRandomUniformFloat3(RandomState* state)
+{
+    optix::uint2 bits = getRandomUint2(state, true);
+    return optix::make_float3(toUniformFloat(bits.x), toUniformFloat(bits.y), getRandomUniformFloat(state));
+}
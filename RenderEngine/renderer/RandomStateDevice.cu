@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include <cuda.h>
+#include <cuda_runtime.h>
+#include <exception>
+#include "renderer/RandomStateDevice.h"
+
+static void __global__ generateRandomUniformFloats(unsigned int seed, unsigned long long iterationNumber,
+    RandomStream::E stream, Sampler::E sampler, unsigned int numIndices, unsigned int numDimensions, float* values)
+{
+    unsigned int index = blockIdx.x*blockDim.x + threadIdx.x;
+    if(index < numIndices)
+    {
+        RandomState state = createRandomState(seed, iterationNumber, index, stream, sampler);
+        for(unsigned int i = 0; i < numDimensions; i++)
+        {
+            values[index*numDimensions + i] = getRandomUniformFloat(&state);
+        }
+    }
+}
+
+void generateRandomUniformFloatsOnDevice(unsigned int seed, unsigned long long iterationNumber, RandomStream::E stream,
+    Sampler::E sampler, unsigned int numIndices, unsigned int numDimensions, float* values)
+{
+    size_t sizeBytes = size_t(numIndices)*numDimensions*sizeof(float);
+    float* deviceValues = NULL;
+    if(cudaMalloc(&deviceValues, sizeBytes) != cudaSuccess)
+    {
+        throw std::exception("Could not allocate the device random numbers.");
+    }
+
+    const unsigned int blockSize = 256;
+    unsigned int numBlocks = numIndices/blockSize + (numIndices % blockSize == 0 ? 0 : 1);
+    generateRandomUniformFloats<<<numBlocks, blockSize>>>(seed, iterationNumber, stream, sampler, numIndices,
+        numDimensions, deviceValues);
+    cudaError_t error = cudaMemcpy(values, deviceValues, sizeBytes, cudaMemcpyDeviceToHost);
+    cudaFree(deviceValues);
+    if(error != cudaSuccess)
+    {
+        throw std::exception(cudaGetErrorString(error));
+    }
+}
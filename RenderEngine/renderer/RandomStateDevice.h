@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "render_engine_export_api.h"
+#include "renderer/RandomState.h"
+
+// Fill values (numIndices*numDimensions floats, index major) with getRandomUniformFloat of the random states
+// createRandomState(seed, iterationNumber, index, stream, sampler) on the current CUDA device, for checking that the
+// host draws the same numbers. Throws std::exception on CUDA errors.
+RENDER_ENGINE_EXPORT_API void generateRandomUniformFloatsOnDevice(unsigned int seed, unsigned long long iterationNumber,
+    RandomStream::E stream, Sampler::E sampler, unsigned int numIndices, unsigned int numDimensions, float* values);
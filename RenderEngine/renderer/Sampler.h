@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "config.h"
+
+// Sequences the path tracing and VCM samples are drawn from, see RandomState.h. The values are the SAMPLER_*
+// constants of config.h, which the device programs get in the sampler variable.
+
+namespace Sampler
+{
+    enum E
+    {
+        RANDOM = SAMPLER_RANDOM,
+        SOBOL = SAMPLER_SOBOL,
+        HALTON = SAMPLER_HALTON
+    };
+}
@@ -161,7 +161,7 @@ static RT_FUNCTION float favgf(const optix::float3 & v )
 }
 
 template<typename T>
-RT_FUNCTION T sqr(const T& a) { return a*a; }
+__host__ RT_FUNCTION T sqr(const T& a) { return a*a; }
 
 
 static RT_FUNCTION bool isZero(const optix::float3 & v )
@@ -228,7 +228,7 @@ RT_FUNCTION bool isInf(optix::float3 v)
 #endif
 
 template<typename T>
-RT_FUNCTION void swap(T & t1, T & t2)
+__host__ RT_FUNCTION void swap(T & t1, T & t2)
 {
     T tmp = t1;
     t1 = t2;
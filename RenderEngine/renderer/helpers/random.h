@@ -9,87 +9,12 @@
 
 #pragma once 
 
+// getRandomUniformFloat and the counter-based random state are in RandomState.h, this adds the generators of
+// the Optix SDK samples
 #include "config.h"
 #include "renderer/RandomState.h"
 #include "renderer/device_common.h"
 #include "renderer/helpers/helpers.h"
-#include <stdint.h>
-#include <float.h>
-
-#if USE_CHEAP_RANDOM
-
-/*
-The fast/cheap random generation scheme courtesy of 
-http://www.reedbeta.com/blog/2013/01/12/quick-and-easy-gpu-random-numbers-in-d3d11/
-*/
-
-static uint32_t __host__ __device__ rand_xorshift(uint32_t& state)
-{
-    state ^= (state << 13);
-    state ^= (state >> 17);
-    state ^= (state << 5);
-    return state;
-}
-
-static uint32_t  __host__ __device__ wang_hash(uint32_t seed)
-{
-    seed = (seed ^ 61) ^ (seed >> 16);
-    seed *= 9;
-    seed = seed ^ (seed >> 4);
-    seed *= 0x27d4eb2d;
-    seed = seed ^ (seed >> 15);
-    return seed;
-}
-
-static void __host__ __device__ initializeRandomState(RandomState* state, uint32_t seed, uint32_t index)
-{
-    state[0] = wang_hash(seed+index);
-}
-
-// Return a float from [0,1)
-static __device__ __inline__ float getRandomUniformFloat( RandomState* state )
-{
-    float scale = float(0xFFFFFFFF);
-    // Clear the last bit to be strictly less than 1
-    return float(rand_xorshift(*state) & ~1)/scale;
-}
-
-#else
-
-static void __device__ initializeRandomState(RandomState* state, unsigned int seed, unsigned int index)
-{
-    curand_init(seed+index, 0, 0, state);
-}
-
-// Return a float in range [0,1)
-static RT_FUNCTION float getRandomUniformFloat( RandomState* state )
-{
-    // Currand generates values in range (0,1]
-    return maxf(curand_uniform(state) - FLT_EPSILON, 0.0f);
-}
-
-#endif
-
-// Return a float in range [0,1)
-static RT_FUNCTION optix::float2 getRandomUniformFloat2( RandomState* state )
-{
-    // Currand generates values in range (0,1]
-    optix::float2 sample;
-    sample.x = getRandomUniformFloat(state);
-    sample.y = getRandomUniformFloat(state);
-    return sample;
-}
-
-// Return a float in range [0,1)
-static RT_FUNCTION optix::float3 getRandomUniformFloat3( RandomState* state )
-{
-    // Currand generates values in range (0,1]
-    optix::float3 sample;
-    sample.x = getRandomUniformFloat(state);
-    sample.y = getRandomUniformFloat(state);
-    sample.z = getRandomUniformFloat(state);
-    return sample;
-}
 
 // <Random number generation used in Optix SDK>
 // Generate random unsigned int in [0, 2^24)
@@ -95,18 +95,18 @@ RT_FUNCTION float CosHemispherePdfW(const optix::float3  &aNormal, const optix::
 }
 
 
-RT_FUNCTION float powerCosHemispherePdfW( const optix::float3 & aNormal,
-                                          const optix::float3 & aDirection,
-                                          const float           aPower )
+__host__ RT_FUNCTION float powerCosHemispherePdfW( const optix::float3 & aNormal,
+                                                   const optix::float3 & aDirection,
+                                                   const float           aPower )
 {
     const float cosTheta = optix::fmaxf(0.f, optix::dot(aNormal, aDirection));
     return (aPower + 1.f) * powf(cosTheta, aPower) * (M_1_PIf * 0.5f);
 }
 
 // Details in "Using the modified Phong reflectance model for Physically based rendering" by Lafortune
-RT_FUNCTION optix::float3 samplePowerCosHemisphereW( const optix::float2 & aSamples,
-                                                     const float           aPower,
-                                                     float               * oPdfW = NULL )
+__host__ RT_FUNCTION optix::float3 samplePowerCosHemisphereW( const optix::float2 & aSamples,
+                                                              const float           aPower,
+                                                              float               * oPdfW = NULL )
 {
     using namespace optix;
     const float phi = 2.f * M_PIf * aSamples.x;
@@ -6,19 +6,32 @@
 
 #pragma once
 #include "renderer/ppm/PhotonGrid.h"
+#include "renderer/ppm/PhotonBuffer.h"
 
 // Unfortunately, we need a macro for photon storing code
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID || ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
-#define STORE_PHOTON(photon) \
-    photons[photonPrd.pm_index + photonPrd.numStoredPhotons] = photon; \
-    photonPrd.numStoredPhotons++;
-#else
+// The uniform grid and kd-tree append each photon to the photon buffers, photonDepositCounter counts all photons
+// stored including those past the end of the buffers, the renderer grows the buffers and traces the pass again when
+// they did not fit. The stochastic hash stores each photon in the slot of its grid cell. photonMapStructure is the
+// PhotonMapStructure::E of the current iteration.
 #define STORE_PHOTON(photon) \
+    if(photonMapStructure == ACCELERATION_STRUCTURE_STOCHASTIC_HASH) \
     { \
     uint3 gridLoc = getPhotonGridIndex(photon.position, photonsWorldOrigo, photonsGridCellSize); \
     uint hash = getHashValue(gridLoc, photonsGridSize, photonsSize); \
-    photons[hash] = photon; \
+    writePhoton(hash, photon); \
     atomicAdd(&photonsHashTableCount[hash], 1); \
+    } \
+    else \
+    { \
+    uint depositIndex = atomicAdd(&photonDepositCounter[0], 1); \
+    if(depositIndex < photonsSize) \
+    { \
+    writePhoton(depositIndex, photon); \
+    } \
+    photonPrd.numStoredPhotons++; \
     }
-#endif
\ No newline at end of file
+
+// The appended photons are limited to maxPhotonDepositsPerEmitted per path
+#define PHOTON_DEPOSITS_FULL() \
+    (photonMapStructure != ACCELERATION_STRUCTURE_STOCHASTIC_HASH && photonPrd.numStoredPhotons >= maxPhotonDepositsPerEmitted)
\ No newline at end of file
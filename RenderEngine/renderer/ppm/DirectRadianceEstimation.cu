@@ -5,7 +5,6 @@
 */
 #include <cuda.h>
 #include <optix_device.h>
-#include <curand_kernel.h>
 #include <optix.h>
 #include <optixu/optixu_math_namespace.h>
 #include "config.h"
@@ -21,7 +20,8 @@ using namespace optix;
 rtDeclareVariable(rtObject, sceneRootObject, , );
 rtBuffer<Hitpoint, 2> raytracePassOutputBuffer;
 rtBuffer<float3, 2> directRadianceBuffer;
-rtBuffer<RandomState, 2> randomStates;
+rtDeclareVariable(uint, randomSeed, , );
+rtDeclareVariable(uint, randomIterationNumber, , );
 rtBuffer<Light, 1> lights;
 rtDeclareVariable(uint2, launchIndex, rtLaunchIndex, );
 rtDeclareVariable(ShadowPRD, shadowPrd, rtPayload, );
@@ -56,14 +56,16 @@ RT_PROGRAM void kernel()
     if(numShadowSamples > 0)
     {
         float3 avgLightRadiance = make_float3(0.f);
+        RandomState randomState = createRandomState(randomSeed, randomIterationNumber,
+            launchIndex.y*raytracePassOutputBuffer.size().x + launchIndex.x, RandomStream::DIRECT_LIGHT);
 
         for(int shadowSample = 0; shadowSample < numShadowSamples; shadowSample++)
         {
-            float sample = getRandomUniformFloat(&randomStates[launchIndex]);
+            float sample = getRandomUniformFloat(&randomState);
             int randomLightIndex = intmin(int(sample*numLights), int(lights.size()-1));
             Light & light = lights[randomLightIndex];
             float scale = numLights;
-            float3 lightContrib = getLightContribution(light, rec.position, rec.normal, sceneRootObject, randomStates[launchIndex]);
+            float3 lightContrib = getLightContribution(light, rec.position, rec.normal, sceneRootObject, randomState);
             avgLightRadiance += scale * lightContrib;
             // vmarz: scaled by number of lights because picking one light to sample in each iteration
             // Should scale by MIS here
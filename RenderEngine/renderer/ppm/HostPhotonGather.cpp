@@ -0,0 +1,773 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "HostPhotonGather.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <exception>
+#include <xmmintrin.h>
+#include "renderer/Hitpoint.h"
+#include "renderer/ppm/PhotonGrid.h"
+#include "renderer/ppm/PhotonCompaction.h"
+#include "renderer/ppm/PhotonKdTreeBuilder.h"
+#include "renderer/ppm/PhotonRadixSort.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+// Same limit as OptixRenderer::PHOTON_GRID_MAX_SIZE
+const unsigned int HostPhotonGather::GRID_MAX_SIZE = 100*100*100;
+
+namespace
+{
+    const unsigned int PACKET_SIZE = 4;
+    const unsigned int GATHER_GRAIN_PACKETS = 64;
+    const unsigned int KD_TREE_MAX_DEPTH = 64;
+
+    unsigned int pow2roundup(unsigned int x)
+    {
+        --x;
+        x |= x >> 1;
+        x |= x >> 2;
+        x |= x >> 4;
+        x |= x >> 8;
+        x |= x >> 16;
+        return x+1;
+    }
+
+    // Grid sizing of OptixRenderer_SpatialHash.cu
+
+    uint3 calculateGridSize(const float3 & sceneExtent, float cellSize)
+    {
+        uint3 result;
+        result.x = std::max(1u, (unsigned int)ceil(sceneExtent.x/cellSize));
+        result.y = std::max(1u, (unsigned int)ceil(sceneExtent.y/cellSize));
+        result.z = std::max(1u, (unsigned int)ceil(sceneExtent.z/cellSize));
+        return result;
+    }
+
+    float getSmallestPossibleCellSize(const float3 & sceneExtent, unsigned int maxGridSize)
+    {
+        float sceneVolume = sceneExtent.x*sceneExtent.y*sceneExtent.z;
+        float minVolumePerCell = sceneVolume/maxGridSize;
+        float smallestPossibleRadiusC = powf(minVolumePerCell, 1.0f/3.0f);
+        uint3 numCells = floor3f(sceneExtent/smallestPossibleRadiusC);
+        return fmaxf(make_float3(sceneExtent.x/numCells.x, sceneExtent.y/numCells.y, sceneExtent.z/numCells.z));
+    }
+
+    // The gaussian filter of photonPower() in IndirectRadianceEstimation.cu
+    inline float filterWeight(float distance2, float radius2)
+    {
+        const float alpha = 1.818f;
+        const float beta = 1.953f;
+        const float expNegativeBeta = 0.141847f;
+        return alpha*(1 - (1-expf(-beta*distance2/(2*radius2)))/(1-expNegativeBeta));
+    }
+
+    // Four hitpoints in SoA layout. Lanes past the end of the hitpoint array and specular hitpoints are inactive.
+    struct HitpointPacket
+    {
+        __m128 positionX, positionY, positionZ;
+        __m128 normalX, normalY, normalZ;
+        float3 position[PACKET_SIZE];
+        int activeMask;
+    };
+
+    // One photon per lane. The power is scaled by the number of photons it represents.
+    struct PhotonPacket
+    {
+        __m128 positionX, positionY, positionZ;
+        __m128 directionX, directionY, directionZ;
+        __m128 powerX, powerY, powerZ;
+    };
+
+    struct PacketAccumulator
+    {
+        __m128 powerX, powerY, powerZ;
+        unsigned int photonsVisited[PACKET_SIZE];
+        unsigned int cellsVisited[PACKET_SIZE];
+    };
+
+    void loadPhoton(PhotonPacket & packet, const Photon & photon)
+    {
+        packet.positionX = _mm_set1_ps(photon.position.x);
+        packet.positionY = _mm_set1_ps(photon.position.y);
+        packet.positionZ = _mm_set1_ps(photon.position.z);
+        packet.directionX = _mm_set1_ps(photon.rayDirection.x);
+        packet.directionY = _mm_set1_ps(photon.rayDirection.y);
+        packet.directionZ = _mm_set1_ps(photon.rayDirection.z);
+        packet.powerX = _mm_set1_ps(photon.power.x);
+        packet.powerY = _mm_set1_ps(photon.power.y);
+        packet.powerZ = _mm_set1_ps(photon.power.z);
+    }
+
+    void addVisits(unsigned int* counts, int laneMask, unsigned int num)
+    {
+        for(unsigned int lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            if(laneMask & (1 << lane))
+            {
+                counts[lane] += num;
+            }
+        }
+    }
+
+    // validPhoton() and photonPower() of IndirectRadianceEstimation.cu for the lanes in laneMask. The distance and
+    // orientation tests run on all lanes at once, the filter weight is only evaluated for the photons that pass.
+    inline void accumulate(const HitpointPacket & hits, int laneMask, const PhotonPacket & photons, const __m128 & radius2,
+        float radius2Scalar, PacketAccumulator & acc)
+    {
+        __m128 diffX = _mm_sub_ps(hits.positionX, photons.positionX);
+        __m128 diffY = _mm_sub_ps(hits.positionY, photons.positionY);
+        __m128 diffZ = _mm_sub_ps(hits.positionZ, photons.positionZ);
+        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(diffX, diffX), _mm_mul_ps(diffY, diffY)), _mm_mul_ps(diffZ, diffZ));
+        __m128 cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(photons.directionX, hits.normalX),
+            _mm_mul_ps(photons.directionY, hits.normalY)), _mm_mul_ps(photons.directionZ, hits.normalZ));
+
+        // dot(-photon.rayDirection, hitNormal) >= 0
+        __m128 valid = _mm_and_ps(_mm_cmple_ps(distance2, radius2), _mm_cmple_ps(cosine, _mm_setzero_ps()));
+        int validMask = _mm_movemask_ps(valid) & laneMask;
+        if(validMask == 0)
+        {
+            return;
+        }
+
+        float distance2Lanes[PACKET_SIZE];
+        float weights[PACKET_SIZE] = {0, 0, 0, 0};
+        _mm_storeu_ps(distance2Lanes, distance2);
+        for(unsigned int lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            if(validMask & (1 << lane))
+            {
+                weights[lane] = filterWeight(distance2Lanes[lane], radius2Scalar);
+            }
+        }
+        __m128 weight = _mm_loadu_ps(weights);
+        acc.powerX = _mm_add_ps(acc.powerX, _mm_mul_ps(photons.powerX, weight));
+        acc.powerY = _mm_add_ps(acc.powerY, _mm_mul_ps(photons.powerY, weight));
+        acc.powerZ = _mm_add_ps(acc.powerZ, _mm_mul_ps(photons.powerZ, weight));
+    }
+}
+
+class HostPhotonGather::GatherPackets
+{
+public:
+    GatherPackets(const HostPhotonGather & photonMap, const Hitpoint* hitpoints, unsigned int numHitpoints, float ppmRadius,
+        float emittedPhotonsPerIteration, float3* indirectRadiance, unsigned int* photonsVisited, unsigned int* cellsVisited)
+        : m_photonMap(photonMap), m_hitpoints(hitpoints), m_numHitpoints(numHitpoints), m_radius(ppmRadius),
+          m_radius2(ppmRadius*ppmRadius), m_emittedPhotonsPerIteration(emittedPhotonsPerIteration),
+          m_indirectRadiance(indirectRadiance), m_photonsVisited(photonsVisited), m_cellsVisited(cellsVisited)
+    {
+
+    }
+
+    void operator()(unsigned int fromPacket, unsigned int toPacket) const
+    {
+        for(unsigned int packet = fromPacket; packet < toPacket; packet++)
+        {
+            gatherPacket(packet*PACKET_SIZE);
+        }
+    }
+
+private:
+    void gatherPacket(unsigned int first) const
+    {
+        HitpointPacket hits;
+        loadHitpoints(first, hits);
+
+        PacketAccumulator acc;
+        acc.powerX = acc.powerY = acc.powerZ = _mm_setzero_ps();
+        for(unsigned int lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            acc.photonsVisited[lane] = 0;
+            acc.cellsVisited[lane] = 0;
+        }
+
+        if(hits.activeMask && m_photonMap.m_numPhotons > 0)
+        {
+            switch(m_photonMap.m_structure)
+            {
+            case PhotonMapStructure::UNIFORM_GRID:
+            case PhotonMapStructure::HASHED_GRID:
+                gatherUniformGrid(hits, acc);
+                break;
+            case PhotonMapStructure::STOCHASTIC_HASH:
+                gatherStochasticHash(hits, acc);
+                break;
+            case PhotonMapStructure::KD_TREE_CPU:
+                gatherKdTree(hits, hits.activeMask, acc);
+                break;
+            }
+        }
+
+        float powerX[PACKET_SIZE], powerY[PACKET_SIZE], powerZ[PACKET_SIZE];
+        _mm_storeu_ps(powerX, acc.powerX);
+        _mm_storeu_ps(powerY, acc.powerY);
+        _mm_storeu_ps(powerZ, acc.powerZ);
+
+        const float scale = (1.0f/(M_PIf*m_radius2)) * (1.0f/m_emittedPhotonsPerIteration);
+        for(unsigned int lane = 0; lane < PACKET_SIZE && first + lane < m_numHitpoints; lane++)
+        {
+            const Hitpoint & rec = m_hitpoints[first + lane];
+            float3 indirectRadiance = make_float3(powerX[lane], powerY[lane], powerZ[lane]) * rec.attenuation * scale;
+#if ENABLE_PARTICIPATING_MEDIA
+            indirectRadiance += rec.volumetricRadiance / m_emittedPhotonsPerIteration;
+#endif
+            m_indirectRadiance[first + lane] = indirectRadiance;
+            if(m_photonsVisited)
+            {
+                m_photonsVisited[first + lane] = acc.photonsVisited[lane];
+            }
+            if(m_cellsVisited)
+            {
+                m_cellsVisited[first + lane] = acc.cellsVisited[lane];
+            }
+        }
+    }
+
+    void loadHitpoints(unsigned int first, HitpointPacket & hits) const
+    {
+        float position[3][PACKET_SIZE];
+        float normal[3][PACKET_SIZE];
+        hits.activeMask = 0;
+        for(unsigned int lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            // Lanes past the end repeat the first hitpoint so every lane holds valid data
+            const unsigned int index = first + lane < m_numHitpoints ? first + lane : first;
+            const Hitpoint & rec = m_hitpoints[index];
+            hits.position[lane] = rec.position;
+            position[0][lane] = rec.position.x;
+            position[1][lane] = rec.position.y;
+            position[2][lane] = rec.position.z;
+            normal[0][lane] = rec.normal.x;
+            normal[1][lane] = rec.normal.y;
+            normal[2][lane] = rec.normal.z;
+            if(first + lane < m_numHitpoints && (rec.flags & PRD_HIT_NON_SPECULAR))
+            {
+                hits.activeMask |= 1 << lane;
+            }
+        }
+        hits.positionX = _mm_loadu_ps(position[0]);
+        hits.positionY = _mm_loadu_ps(position[1]);
+        hits.positionZ = _mm_loadu_ps(position[2]);
+        hits.normalX = _mm_loadu_ps(normal[0]);
+        hits.normalY = _mm_loadu_ps(normal[1]);
+        hits.normalZ = _mm_loadu_ps(normal[2]);
+    }
+
+    // Cell range overlapped by the radius around position, clamped to the grid as in the kernel.
+    // Returns false when the range is empty.
+    bool getCellRange(const float3 & position, uint3 & lo, uint3 & hi) const
+    {
+        const uint3 & gridSize = m_photonMap.m_gridSize;
+        float invCellSize = 1.f/m_photonMap.m_cellSize;
+        float3 normalizedPosition = position - m_photonMap.m_worldOrigo;
+        lo.x = (unsigned int)std::max(0, (int)((normalizedPosition.x - m_radius) * invCellSize));
+        lo.y = (unsigned int)std::max(0, (int)((normalizedPosition.y - m_radius) * invCellSize));
+        lo.z = (unsigned int)std::max(0, (int)((normalizedPosition.z - m_radius) * invCellSize));
+        hi.x = std::min(gridSize.x-1, (unsigned int)((normalizedPosition.x + m_radius) * invCellSize));
+        hi.y = std::min(gridSize.y-1, (unsigned int)((normalizedPosition.y + m_radius) * invCellSize));
+        hi.z = std::min(gridSize.z-1, (unsigned int)((normalizedPosition.z + m_radius) * invCellSize));
+        return lo.x <= hi.x;
+    }
+
+    void gatherUniformGrid(const HitpointPacket & hits, PacketAccumulator & acc) const
+    {
+        uint3 lo[PACKET_SIZE], hi[PACKET_SIZE];
+        uint3 unionLo = make_uint3(std::numeric_limits<unsigned int>::max());
+        uint3 unionHi = make_uint3(0);
+        int laneMask = 0;
+        unsigned long long numCells = 0;
+        for(unsigned int lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            if((hits.activeMask & (1 << lane)) && getCellRange(hits.position[lane], lo[lane], hi[lane]))
+            {
+                laneMask |= 1 << lane;
+                numCells += (unsigned long long)(hi[lane].x-lo[lane].x+1)*(hi[lane].y-lo[lane].y+1)*(hi[lane].z-lo[lane].z+1);
+                unionLo = make_uint3(std::min(unionLo.x, lo[lane].x), std::min(unionLo.y, lo[lane].y), std::min(unionLo.z, lo[lane].z));
+                unionHi = make_uint3(std::max(unionHi.x, hi[lane].x), std::max(unionHi.y, hi[lane].y), std::max(unionHi.z, hi[lane].z));
+            }
+        }
+        if(laneMask == 0)
+        {
+            return;
+        }
+
+        // Neighbouring hitpoints share most of their cells. When they do not (silhouettes, grazing angles) the union
+        // box gets larger than the ranges together and each hitpoint walks its own range.
+        unsigned long long numUnionCells = (unsigned long long)(unionHi.x-unionLo.x+1)*(unionHi.y-unionLo.y+1)*(unionHi.z-unionLo.z+1);
+        if(numUnionCells <= numCells)
+        {
+            gatherCells(hits, laneMask, unionLo, unionHi, acc);
+            return;
+        }
+        for(unsigned int lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            if(laneMask & (1 << lane))
+            {
+                gatherCells(hits, 1 << lane, lo[lane], hi[lane], acc);
+            }
+        }
+    }
+
+    void gatherCells(const HitpointPacket & hits, int laneMask, const uint3 & lo, const uint3 & hi, PacketAccumulator & acc) const
+    {
+        const unsigned int* offsets = &m_photonMap.m_cellOffsets[0];
+
+        for(unsigned int z = lo.z; z <= hi.z; z++)
+        {
+            for(unsigned int y = lo.y; y <= hi.y; y++)
+            {
+                if(m_photonMap.m_structure == PhotonMapStructure::HASHED_GRID)
+                {
+                    // The occupied cells of a row are consecutive, the first and the last one bound its photons
+                    const std::vector<unsigned int> & table = m_photonMap.m_hashedGridTable;
+                    unsigned int first, last;
+                    if(findHashedGridRowCells(table, m_photonMap.m_cellKeys, (unsigned int)table.size() - 1, lo.x, hi.x,
+                        y, z, first, last))
+                    {
+                        gatherCellRange(hits, laneMask, offsets[first], offsets[last+1], acc);
+                    }
+                    continue;
+                }
+
+                if(m_photonMap.m_gridLayout == PhotonGridLayout::LINEAR)
+                {
+                    // Cells along x are consecutive, so each row is one range of sorted photons
+                    unsigned int from = getPhotonGridIndex1D(make_uint3(lo.x, y, z), m_photonMap.m_gridSize);
+                    gatherCellRange(hits, laneMask, offsets[from], offsets[from + (hi.x-lo.x) + 1], acc);
+                    continue;
+                }
+
+                // Step along x in Morton order and merge the cells whose indices follow each other
+                const unsigned int axisMask = m_photonMap.m_mortonMasks.x;
+                unsigned int cell = getPhotonGridIndexMorton(make_uint3(lo.x, y, z), m_photonMap.m_mortonMasks);
+                unsigned int from = cell;
+                for(unsigned int x = lo.x; x <= hi.x; x++)
+                {
+                    unsigned int next = incrementPhotonGridIndexMorton(cell, axisMask);
+                    if(x == hi.x || next != cell+1)
+                    {
+                        gatherCellRange(hits, laneMask, offsets[from], offsets[cell+1], acc);
+                        from = next;
+                    }
+                    cell = next;
+                }
+            }
+        }
+    }
+
+    void gatherCellRange(const HitpointPacket & hits, int laneMask, unsigned int offset, unsigned int offsetTo,
+        PacketAccumulator & acc) const
+    {
+        const __m128 radius2 = _mm_set1_ps(m_radius2);
+        const Photon* photons = &m_photonMap.m_photons[0];
+        PhotonPacket photonPacket;
+
+        addVisits(acc.cellsVisited, laneMask, 1);
+        addVisits(acc.photonsVisited, laneMask, offsetTo-offset);
+
+        for(unsigned int i = offset; i < offsetTo; i++)
+        {
+            loadPhoton(photonPacket, photons[i]);
+            accumulate(hits, laneMask, photonPacket, radius2, m_radius2, acc);
+        }
+    }
+
+    void gatherStochasticHash(const HitpointPacket & hits, PacketAccumulator & acc) const
+    {
+        const __m128 radius2 = _mm_set1_ps(m_radius2);
+        const Photon* photons = &m_photonMap.m_photons[0];
+        const unsigned int* counts = &m_photonMap.m_hashTableCount[0];
+        const unsigned int tableSize = (unsigned int)m_photonMap.m_photons.size();
+
+        uint3 hitCell[PACKET_SIZE];
+        for(unsigned int lane = 0; lane < PACKET_SIZE; lane++)
+        {
+            hitCell[lane] = getPhotonGridIndex(hits.position[lane], m_photonMap.m_worldOrigo, m_photonMap.m_cellSize);
+        }
+
+        float slot[9][PACKET_SIZE];
+        PhotonPacket photonPacket;
+        for(int dz = -1; dz <= 1; dz++)
+        {
+            for(int dy = -1; dy <= 1; dy++)
+            {
+                for(int dx = -1; dx <= 1; dx++)
+                {
+                    // Each lane reads its own slot, transpose them into SoA
+                    for(unsigned int lane = 0; lane < PACKET_SIZE; lane++)
+                    {
+                        uint3 cell = make_uint3(hitCell[lane].x+dx, hitCell[lane].y+dy, hitCell[lane].z+dz);
+                        unsigned int hash = getHashValue(cell, m_photonMap.m_gridSize, tableSize);
+                        const Photon & photon = photons[hash];
+                        float count = float(counts[hash]);
+                        slot[0][lane] = photon.position.x;
+                        slot[1][lane] = photon.position.y;
+                        slot[2][lane] = photon.position.z;
+                        slot[3][lane] = photon.rayDirection.x;
+                        slot[4][lane] = photon.rayDirection.y;
+                        slot[5][lane] = photon.rayDirection.z;
+                        slot[6][lane] = photon.power.x*count;
+                        slot[7][lane] = photon.power.y*count;
+                        slot[8][lane] = photon.power.z*count;
+                    }
+                    photonPacket.positionX = _mm_loadu_ps(slot[0]);
+                    photonPacket.positionY = _mm_loadu_ps(slot[1]);
+                    photonPacket.positionZ = _mm_loadu_ps(slot[2]);
+                    photonPacket.directionX = _mm_loadu_ps(slot[3]);
+                    photonPacket.directionY = _mm_loadu_ps(slot[4]);
+                    photonPacket.directionZ = _mm_loadu_ps(slot[5]);
+                    photonPacket.powerX = _mm_loadu_ps(slot[6]);
+                    photonPacket.powerY = _mm_loadu_ps(slot[7]);
+                    photonPacket.powerZ = _mm_loadu_ps(slot[8]);
+
+                    addVisits(acc.cellsVisited, hits.activeMask, 1);
+                    addVisits(acc.photonsVisited, hits.activeMask, 1);
+                    accumulate(hits, hits.activeMask, photonPacket, radius2, m_radius2, acc);
+                }
+            }
+        }
+    }
+
+    // Packet version of the kd-tree walk of the kernel. A subtree is entered with the lanes that overlap it; a lane
+    // visits exactly the nodes the kernel would visit for it.
+    void gatherKdTree(const HitpointPacket & hits, int laneMask, PacketAccumulator & acc) const
+    {
+        const __m128 radius2 = _mm_set1_ps(m_radius2);
+        const Photon* kdTree = &m_photonMap.m_photons[0];
+        PhotonPacket photonPacket;
+
+        unsigned int stackNode[KD_TREE_MAX_DEPTH];
+        int stackMask[KD_TREE_MAX_DEPTH];
+        unsigned int stackCurrent = 0;
+        unsigned int node = 0;
+        int mask = laneMask;
+
+        for(;;)
+        {
+            const Photon & photon = kdTree[node];
+            const unsigned int axis = photon.axis;
+            addVisits(acc.photonsVisited, mask, 1);
+
+            int leftMask = 0;
+            int rightMask = 0;
+            if(!(axis & PPM_NULL))
+            {
+                loadPhoton(photonPacket, photon);
+                accumulate(hits, mask, photonPacket, radius2, m_radius2, acc);
+
+                if(!(axis & PPM_LEAF))
+                {
+                    __m128 d;
+                    if      ( axis & PPM_X ) d = _mm_sub_ps(hits.positionX, photonPacket.positionX);
+                    else if ( axis & PPM_Y ) d = _mm_sub_ps(hits.positionY, photonPacket.positionY);
+                    else                     d = _mm_sub_ps(hits.positionZ, photonPacket.positionZ);
+                    int left = _mm_movemask_ps(_mm_cmplt_ps(d, _mm_setzero_ps()));
+                    int overlaps = _mm_movemask_ps(_mm_cmplt_ps(_mm_mul_ps(d, d), radius2));
+                    leftMask = mask & (left | overlaps);
+                    rightMask = mask & (~left | overlaps);
+                }
+            }
+
+            if(leftMask && rightMask)
+            {
+                stackNode[stackCurrent] = 2*node+2;
+                stackMask[stackCurrent] = rightMask;
+                stackCurrent++;
+                node = 2*node+1;
+                mask = leftMask;
+            }
+            else if(leftMask || rightMask)
+            {
+                node = leftMask ? 2*node+1 : 2*node+2;
+                mask = leftMask | rightMask;
+            }
+            else if(stackCurrent > 0)
+            {
+                stackCurrent--;
+                node = stackNode[stackCurrent];
+                mask = stackMask[stackCurrent];
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    const HostPhotonGather & m_photonMap;
+    const Hitpoint* m_hitpoints;
+    unsigned int m_numHitpoints;
+    float m_radius;
+    float m_radius2;
+    float m_emittedPhotonsPerIteration;
+    float3* m_indirectRadiance;
+    unsigned int* m_photonsVisited;
+    unsigned int* m_cellsVisited;
+};
+
+namespace
+{
+    class CalculatePhotonCells
+    {
+    public:
+        CalculatePhotonCells(const HostPhotonGather & photonMap, const Photon* photons, const float3 & worldOrigo, float cellSize,
+            unsigned int* photonCells)
+            : m_photonMap(photonMap), m_photons(photons), m_worldOrigo(worldOrigo), m_cellSize(cellSize), m_photonCells(photonCells)
+        {
+
+        }
+
+        void operator()(unsigned int from, unsigned int to) const
+        {
+            for(unsigned int i = from; i < to; i++)
+            {
+                m_photonCells[i] = m_photonMap.getCellIndex(getPhotonGridIndex(m_photons[i].position, m_worldOrigo, m_cellSize));
+            }
+        }
+
+    private:
+        const HostPhotonGather & m_photonMap;
+        const Photon* m_photons;
+        float3 m_worldOrigo;
+        float m_cellSize;
+        unsigned int* m_photonCells;
+    };
+}
+
+HostPhotonGather::HostPhotonGather()
+    : m_scheduler(TaskScheduler::get()),
+      m_structure(PhotonMapStructure::UNIFORM_GRID),
+      m_gridLayout(ENABLE_MORTON_ORDERED_PHOTON_GRID ? PhotonGridLayout::MORTON : PhotonGridLayout::LINEAR),
+      m_numPhotons(0),
+      m_gridSize(make_uint3(1)),
+      m_mortonMasks(make_uint3(0)),
+      m_worldOrigo(make_float3(0)),
+      m_cellSize(1.0f)
+{
+
+}
+
+HostPhotonGather::HostPhotonGather( TaskScheduler & scheduler )
+    : m_scheduler(scheduler),
+      m_structure(PhotonMapStructure::UNIFORM_GRID),
+      m_gridLayout(ENABLE_MORTON_ORDERED_PHOTON_GRID ? PhotonGridLayout::MORTON : PhotonGridLayout::LINEAR),
+      m_numPhotons(0),
+      m_gridSize(make_uint3(1)),
+      m_mortonMasks(make_uint3(0)),
+      m_worldOrigo(make_float3(0)),
+      m_cellSize(1.0f)
+{
+
+}
+
+void HostPhotonGather::build( PhotonMapStructure::E structure, const Photon* photons, unsigned int numPhotons, float ppmRadius )
+{
+    m_structure = structure;
+    m_photons.clear();
+    m_cellOffsets.clear();
+    m_cellKeys.clear();
+    m_hashedGridTable.clear();
+    m_hashTableCount.clear();
+
+    switch(structure)
+    {
+    case PhotonMapStructure::UNIFORM_GRID:
+        buildUniformGrid(photons, numPhotons);
+        break;
+    case PhotonMapStructure::STOCHASTIC_HASH:
+        buildStochasticHash(photons, numPhotons, ppmRadius);
+        break;
+    case PhotonMapStructure::KD_TREE_CPU:
+        buildKdTree(photons, numPhotons);
+        break;
+    case PhotonMapStructure::HASHED_GRID:
+        buildHashedGrid(photons, numPhotons, ppmRadius);
+        break;
+    }
+}
+
+unsigned int HostPhotonGather::getCellIndex( const uint3 & cell ) const
+{
+    if(m_gridLayout == PhotonGridLayout::MORTON)
+    {
+        return getPhotonGridIndexMorton(cell, m_mortonMasks);
+    }
+    return getPhotonGridIndex1D(cell, m_gridSize);
+}
+
+/*
+// Sort the valid photons by grid cell, the host counterpart of createUniformGridPhotonMap()
+*/
+
+void HostPhotonGather::buildUniformGrid( const Photon* photons, unsigned int numPhotons )
+{
+    std::vector<Photon> validPhotons(numPhotons);
+    float3 bbmin, bbmax;
+    m_numPhotons = numPhotons > 0 ? compactPhotons(photons, numPhotons, &validPhotons[0], bbmin, bbmax, m_scheduler) : 0;
+    if(m_numPhotons == 0)
+    {
+        return;
+    }
+
+    // Pad the bounds so no photon lies on the boundary of the grid
+    m_worldOrigo = bbmin - 0.0000001f;
+    float3 sceneExtent = (bbmax + 0.0000001f) - m_worldOrigo;
+    m_cellSize = getSmallestPossibleCellSize(sceneExtent, GRID_MAX_SIZE) + 0.001f;
+    m_gridSize = calculateGridSize(sceneExtent, m_cellSize);
+
+    if(m_gridSize.x*m_gridSize.y*m_gridSize.z > GRID_MAX_SIZE)
+    {
+        throw std::exception("Too many cells in HostPhotonGather, over GRID_MAX_SIZE.");
+    }
+
+    m_mortonMasks = getPhotonGridMortonMasks(m_gridSize);
+    const unsigned int numCellIndices = m_gridLayout == PhotonGridLayout::MORTON ? getPhotonGridMortonSize(m_mortonMasks)
+        : m_gridSize.x*m_gridSize.y*m_gridSize.z;
+
+    std::vector<unsigned int> photonCells(m_numPhotons);
+    m_scheduler.parallelFor(0, m_numPhotons, 64*1024,
+        CalculatePhotonCells(*this, &validPhotons[0], m_worldOrigo, m_cellSize, &photonCells[0]));
+
+    m_photons.resize(m_numPhotons);
+    m_cellOffsets.resize(numCellIndices+1);
+    sortPhotonsByCell(&validPhotons[0], &photonCells[0], m_numPhotons, numCellIndices, &m_photons[0], &m_cellOffsets[0], m_scheduler);
+}
+
+/*
+// Store the photons the way STORE_PHOTON does for the stochastic hash: every valid photon overwrites the photon of its
+// hash slot and increments the slot count. The table has a slot for every photon, rounded up to a power of two.
+*/
+
+void HostPhotonGather::buildStochasticHash( const Photon* photons, unsigned int numPhotons, float ppmRadius )
+{
+    float3 bbmin = make_float3(  std::numeric_limits<float>::max() );
+    float3 bbmax = make_float3( -std::numeric_limits<float>::max() );
+    m_numPhotons = 0;
+    for(unsigned int i = 0; i < numPhotons; i++)
+    {
+        if(fmaxf(photons[i].power) > 0)
+        {
+            bbmin = fminf(bbmin, photons[i].position);
+            bbmax = fmaxf(bbmax, photons[i].position);
+            m_numPhotons++;
+        }
+    }
+    if(m_numPhotons == 0)
+    {
+        return;
+    }
+
+    // The renderer pads the scene bounds, the photon bounds are the closest we have here
+    const float padding = ppmRadius + 0.0001f;
+    m_worldOrigo = bbmin - padding;
+    m_cellSize = ppmRadius;
+    m_gridSize = calculateGridSize((bbmax + padding) - m_worldOrigo, m_cellSize);
+
+    const unsigned int tableSize = pow2roundup(numPhotons);
+    Photon emptySlot;
+    memset(&emptySlot, 0, sizeof(Photon));
+    m_photons.assign(tableSize, emptySlot);
+    m_hashTableCount.assign(tableSize, 0);
+    for(unsigned int i = 0; i < numPhotons; i++)
+    {
+        const Photon & photon = photons[i];
+        if(fmaxf(photon.power) > 0)
+        {
+            uint3 gridLoc = getPhotonGridIndex(photon.position, m_worldOrigo, m_cellSize);
+            unsigned int hash = getHashValue(gridLoc, m_gridSize, tableSize);
+            m_photons[hash] = photon;
+            m_hashTableCount[hash]++;
+        }
+    }
+}
+
+/*
+// Sort the valid photons by the key of their hashed grid cell and insert the occupied cells into the table, the host
+// counterpart of createHashedGridPhotonMap(). Photons of a cell keep their order.
+*/
+
+void HostPhotonGather::buildHashedGrid( const Photon* photons, unsigned int numPhotons, float ppmRadius )
+{
+    std::vector<Photon> validPhotons(numPhotons);
+    float3 bbmin, bbmax;
+    m_numPhotons = numPhotons > 0 ? compactPhotons(photons, numPhotons, &validPhotons[0], bbmin, bbmax, m_scheduler) : 0;
+    if(m_numPhotons == 0)
+    {
+        return;
+    }
+
+    m_worldOrigo = bbmin - 0.0000001f;
+    m_cellSize = ppmRadius;
+    m_gridSize = calculateGridSize((bbmax + 0.0000001f) - m_worldOrigo, m_cellSize);
+    if(m_gridSize.x > PHOTON_HASHED_GRID_MAX_AXIS_CELLS || m_gridSize.y > PHOTON_HASHED_GRID_MAX_AXIS_CELLS
+        || m_gridSize.z > PHOTON_HASHED_GRID_MAX_AXIS_CELLS)
+    {
+        throw std::exception("Too many cells along an axis of the hashed grid in HostPhotonGather.");
+    }
+
+    std::vector<std::pair<unsigned long long, unsigned int> > photonKeys(m_numPhotons);
+    for(unsigned int i = 0; i < m_numPhotons; i++)
+    {
+        uint2 key = getHashedGridCellKey(getPhotonGridIndex(validPhotons[i].position, m_worldOrigo, m_cellSize));
+        photonKeys[i] = std::make_pair(((unsigned long long)key.y << 32) | key.x, i);
+    }
+    std::sort(photonKeys.begin(), photonKeys.end());
+
+    m_photons.resize(m_numPhotons);
+    for(unsigned int i = 0; i < m_numPhotons; i++)
+    {
+        m_photons[i] = validPhotons[photonKeys[i].second];
+        if(i == 0 || photonKeys[i].first != photonKeys[i-1].first)
+        {
+            m_cellKeys.push_back(photonKeys[i].first);
+            m_cellOffsets.push_back(i);
+        }
+    }
+    m_cellOffsets.push_back(m_numPhotons);
+
+    const unsigned int numCells = (unsigned int)m_cellKeys.size();
+    const unsigned int tableMask = getHashedGridTableSize(numCells) - 1;
+    m_hashedGridTable.assign(tableMask + 1, PHOTON_HASHED_GRID_EMPTY_SLOT);
+    for(unsigned int cell = 0; cell < numCells; cell++)
+    {
+        uint2 key = make_uint2((unsigned int)m_cellKeys[cell], (unsigned int)(m_cellKeys[cell] >> 32));
+        unsigned int slot = getHashedGridSlot(key, tableMask);
+        while(m_hashedGridTable[slot] != PHOTON_HASHED_GRID_EMPTY_SLOT)
+        {
+            slot = (slot + 1) & tableMask;
+        }
+        m_hashedGridTable[slot] = cell;
+    }
+}
+
+void HostPhotonGather::buildKdTree( const Photon* photons, unsigned int numPhotons )
+{
+    std::vector<Photon> validPhotons(numPhotons);
+    float3 bbmin, bbmax;
+    m_numPhotons = numPhotons > 0 ? compactPhotons(photons, numPhotons, &validPhotons[0], bbmin, bbmax, m_scheduler) : 0;
+    if(m_numPhotons == 0)
+    {
+        return;
+    }
+
+    m_photons.resize(pow2roundup(m_numPhotons+1)-1);
+    PhotonKdTreeBuilder builder(m_scheduler);
+    builder.build(&validPhotons[0], m_numPhotons, &m_photons[0], bbmin, bbmax);
+}
+
+void HostPhotonGather::gather( const Hitpoint* hitpoints, unsigned int numHitpoints, float ppmRadius,
+                               float emittedPhotonsPerIteration, float3* indirectRadiance,
+                               unsigned int* photonsVisited, unsigned int* cellsVisited ) const
+{
+    const unsigned int numPackets = (numHitpoints + PACKET_SIZE - 1) / PACKET_SIZE;
+    m_scheduler.parallelFor(0, numPackets, GATHER_GRAIN_PACKETS, GatherPackets(*this, hitpoints, numHitpoints, ppmRadius,
+        emittedPhotonsPerIteration, indirectRadiance, photonsVisited, cellsVisited));
+}
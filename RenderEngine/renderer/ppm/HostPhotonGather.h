@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <vector>
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PhotonMapStructure.h"
+
+class TaskScheduler;
+struct Hitpoint;
+
+// Cell numbering of the uniform grid, see getPhotonGridIndex1D() and getPhotonGridIndexMorton() in PhotonGrid.h
+namespace PhotonGridLayout
+{
+    enum E
+    {
+        LINEAR,
+        MORTON
+    };
+}
+
+/*
+Host reference implementation of the indirect radiance estimation pass (IndirectRadianceEstimation.cu). It builds
+the same photon map layouts as the renderer (sorted photons with a cell offset table for the uniform grid, sorted
+photons with the offsets, keys and hash table of the occupied cells for the hashed grid, a photon and a count per hash
+slot for the stochastic hash, the implicit balanced tree for the kd-tree) from the output of the photon pass and
+gathers them with the same radius test and Gaussian filter, so results can be compared against the GPU and the
+structures can be profiled without a device.
+
+Hitpoints are gathered in packets of four neighbouring hitpoints with SSE: every photon read is tested against all
+the hitpoints of the packet at once. The uniform and hashed grids walk the union of the cell ranges of a packet (or
+each hitpoint on its own when the union is larger than the ranges together), the kd-tree traverses a subtree while any hitpoint of
+the packet overlaps it and the stochastic hash loads the slots of the four hitpoints side by side. Packets are
+distributed over the TaskScheduler.
+
+The uniform grid is laid out like ENABLE_MORTON_ORDERED_PHOTON_GRID lays it out on the device unless setGridLayout()
+picks the other layout before build(). Its photons are sorted by cell with sortPhotonsByCell().
+*/
+
+class HostPhotonGather
+{
+public:
+    RENDER_ENGINE_EXPORT_API HostPhotonGather();
+    RENDER_ENGINE_EXPORT_API HostPhotonGather(TaskScheduler & scheduler);
+
+    // Build the photon map from the photon pass output photons[0, numPhotons), which may contain invalid (zero power)
+    // photons. The stochastic hash and the hashed grid use ppmRadius as their cell size and must be gathered with the
+    // same radius.
+    RENDER_ENGINE_EXPORT_API void build(PhotonMapStructure::E structure, const Photon* photons, unsigned int numPhotons,
+        float ppmRadius);
+
+    // Estimate the indirect radiance of each hitpoint like IndirectRadianceEstimation.cu. photonsVisited and
+    // cellsVisited are optional and receive the same counts as the debug output buffers of the kernel.
+    RENDER_ENGINE_EXPORT_API void gather(const Hitpoint* hitpoints, unsigned int numHitpoints, float ppmRadius,
+        float emittedPhotonsPerIteration, optix::float3* indirectRadiance,
+        unsigned int* photonsVisited = NULL, unsigned int* cellsVisited = NULL) const;
+
+    PhotonMapStructure::E getStructure() const { return m_structure; }
+    void setGridLayout(PhotonGridLayout::E layout) { m_gridLayout = layout; }
+    PhotonGridLayout::E getGridLayout() const { return m_gridLayout; }
+    // Number of valid photons in the photon map
+    unsigned int getNumPhotons() const { return m_numPhotons; }
+
+    // Number of occupied cells of the hashed grid
+    unsigned int getNumHashedGridCells() const { return (unsigned int)m_cellKeys.size(); }
+
+    // Uniform grid layout, for tools that replay the memory accesses of the gather
+    const optix::uint3 & getGridSize() const { return m_gridSize; }
+    const optix::float3 & getWorldOrigo() const { return m_worldOrigo; }
+    float getCellSize() const { return m_cellSize; }
+    const Photon* getPhotons() const { return m_photons.empty() ? NULL : &m_photons[0]; }
+    const unsigned int* getCellOffsets() const { return m_cellOffsets.empty() ? NULL : &m_cellOffsets[0]; }
+    RENDER_ENGINE_EXPORT_API unsigned int getCellIndex(const optix::uint3 & cell) const;
+
+    const static unsigned int GRID_MAX_SIZE;
+
+private:
+    class GatherPackets;
+    friend class GatherPackets;
+
+    void buildUniformGrid(const Photon* photons, unsigned int numPhotons);
+    void buildStochasticHash(const Photon* photons, unsigned int numPhotons, float ppmRadius);
+    void buildHashedGrid(const Photon* photons, unsigned int numPhotons, float ppmRadius);
+    void buildKdTree(const Photon* photons, unsigned int numPhotons);
+
+    TaskScheduler & m_scheduler;
+    PhotonMapStructure::E m_structure;
+    PhotonGridLayout::E m_gridLayout;
+    unsigned int m_numPhotons;
+
+    // Sorted photons (uniform grid), hash slots (stochastic hash) or tree nodes (kd-tree)
+    std::vector<Photon> m_photons;
+    // Offset of the first photon of each cell index (uniform grid) or occupied cell (hashed grid), plus one entry
+    // holding the total
+    std::vector<unsigned int> m_cellOffsets;
+    // Key of each occupied cell and the open addressing table of the cells (hashed grid), see PhotonGrid.h
+    std::vector<unsigned long long> m_cellKeys;
+    std::vector<unsigned int> m_hashedGridTable;
+    // Photons stored in each hash slot (stochastic hash)
+    std::vector<unsigned int> m_hashTableCount;
+
+    optix::uint3 m_gridSize;
+    optix::uint3 m_mortonMasks;
+    optix::float3 m_worldOrigo;
+    float m_cellSize;
+};
@@ -15,13 +15,13 @@
 #include "renderer/RayType.h"
 #include "renderer/Hitpoint.h"
 #include "renderer/ppm/PhotonGrid.h"
+#include "renderer/ppm/PhotonBuffer.h"
 #include "renderer/RadiancePRD.h"
 
 using namespace optix;
 
 rtDeclareVariable(uint2, launchIndex, rtLaunchIndex, );
 
-rtBuffer<Photon, 1> photons;
 rtBuffer<Hitpoint, 2> raytracePassOutputBuffer;
 rtBuffer<float3, 2> indirectRadianceBuffer;
 
@@ -31,39 +31,75 @@ rtDeclareVariable(float, ppmRadius, ,);
 rtDeclareVariable(float, ppmRadiusSquared, ,);
 rtDeclareVariable(float, ppmRadiusSquaredNew, ,);
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
+rtDeclareVariable(uint, photonMapStructure, , );
+
+// Uniform grid and stochastic hash
 rtDeclareVariable(uint3, photonsGridSize, , );
+rtDeclareVariable(uint3, photonsGridMortonMasks, , );
 rtDeclareVariable(float3, photonsWorldOrigo, ,);
 rtDeclareVariable(float, photonsGridCellSize, ,);
 rtBuffer<uint, 1> hashmapOffsetTable;
-#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
-rtDeclareVariable(uint3, photonsGridSize, , );
-rtDeclareVariable(float3, photonsWorldOrigo, ,);
-rtDeclareVariable(float, photonsGridCellSize, ,);
 rtDeclareVariable(unsigned int, photonsSize, ,);
 rtBuffer<unsigned int, 1> photonsHashTableCount;
-#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
+
+// Hashed grid, hashmapOffsetTable holds the offsets of its cells
+rtDeclareVariable(int, hashedGridCellKeysBufferId, , );   // rtBufferId<uint2, 1>
+rtDeclareVariable(int, hashedGridTableBufferId, , );      // rtBufferId<uint, 1>
+rtDeclareVariable(uint, hashedGridTableMask, , );
+
+// Kd-tree
 rtBuffer<Photon, 1> photonKdTree;
-#endif
 
 #if ENABLE_RENDER_DEBUG_OUTPUT
 rtBuffer<uint, 2> debugIndirectRadianceCellsVisisted;
 rtBuffer<uint, 2> debugIndirectRadiancePhotonsVisisted;
 #endif
 
-__device__ __inline float validPhoton(const Photon & photon, const float distance2, const float radius2, const float3 & hitNormal)
+__device__ __inline float validPhoton(const float3 & photonDirection, const float distance2, const float radius2, const float3 & hitNormal)
 {
-    return distance2 <= radius2 && dot(-photon.rayDirection, hitNormal) >= 0; 
+    return distance2 <= radius2 && dot(-photonDirection, hitNormal) >= 0; 
 }
 
-__device__ __inline float3 photonPower(const Photon & photon, const float distance2, const float radius2)
+__device__ __inline float3 photonPower(const float3 & power, const float distance2, const float radius2)
 {
     // Use the gaussian filter from Realistic Image Synthesis Using Photon Mapping, Wann Jensen
     const float alpha = 1.818;
     const float beta = 1.953;
     const float expNegativeBeta = 0.141847;
     float weight = alpha*(1 - (1-exp(-beta*distance2/(2*radius2)))/(1-expNegativeBeta));
-    return photon.power*weight;
+    return power*weight;
+}
+
+// Gather the sorted photons [offset, offsetTo) of a run of uniform grid cells
+__device__ __inline void gatherCellRange(unsigned int offset, unsigned int offsetTo, const Hitpoint & rec, const float radius2,
+                                         float3 & indirectAccumulatedPower, int & _dPhotonsVisited)
+{
+    for(unsigned int i = offset; i < offsetTo; i++)
+    {
+        float3 diff = rec.position - readPhotonPosition(i);
+        float distance2 = dot(diff, diff);
+        // The direction and power are only read for the photons in range
+        if(distance2 <= radius2 && validPhoton(readPhotonDirection(i), distance2, radius2, rec.normal))
+        {
+            indirectAccumulatedPower += photonPower(readPhotonPower(i), distance2, radius2);
+        }
+        _dPhotonsVisited++;
+    }
+}
+
+// Cells of the uniform or hashed grid overlapped by the radius around position, clamped to the grid. Empty when
+// lo.x > hi.x.
+__device__ __inline void getGatherCellRange(const float3 & position, const float radius, optix::uint3 & lo, optix::uint3 & hi)
+{
+    float invCellSize = 1.f/photonsGridCellSize;
+    float3 normalizedPosition = position - photonsWorldOrigo;
+    lo.x = (unsigned int)max(0, (int)((normalizedPosition.x - radius) * invCellSize));
+    lo.y = (unsigned int)max(0, (int)((normalizedPosition.y - radius) * invCellSize));
+    lo.z = (unsigned int)max(0, (int)((normalizedPosition.z - radius) * invCellSize));
+
+    hi.x = (unsigned int)min(photonsGridSize.x-1, (unsigned int)((normalizedPosition.x + radius) * invCellSize));
+    hi.y = (unsigned int)min(photonsGridSize.y-1, (unsigned int)((normalizedPosition.y + radius) * invCellSize));
+    hi.z = (unsigned int)min(photonsGridSize.z-1, (unsigned int)((normalizedPosition.z + radius) * invCellSize));
 }
 
 RT_PROGRAM void kernel()
@@ -81,133 +117,152 @@ RT_PROGRAM void kernel()
         float radius2 = ppmRadiusSquared;
         float radius = ppmRadius;
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
-        
-        float invCellSize = 1.f/photonsGridCellSize;
-        float3 normalizedPosition = rec.position - photonsWorldOrigo;
-        unsigned int x_lo = (unsigned int)max(0, (int)((normalizedPosition.x - radius) * invCellSize));
-        unsigned int y_lo = (unsigned int)max(0, (int)((normalizedPosition.y - radius) * invCellSize));
-        unsigned int z_lo = (unsigned int)max(0, (int)((normalizedPosition.z - radius) * invCellSize));
-     
-        unsigned int x_hi = (unsigned int)min(photonsGridSize.x-1, (unsigned int)((normalizedPosition.x + radius) * invCellSize));
-        unsigned int y_hi = (unsigned int)min(photonsGridSize.y-1, (unsigned int)((normalizedPosition.y + radius) * invCellSize));
-        unsigned int z_hi = (unsigned int)min(photonsGridSize.z-1, (unsigned int)((normalizedPosition.z + radius) * invCellSize));    
-
-        if(x_lo <= x_hi)
+        if(photonMapStructure == ACCELERATION_STRUCTURE_UNIFORM_GRID)
         {
-            for(unsigned int z = z_lo; z <= z_hi; z++)
+            optix::uint3 lo, hi;
+            getGatherCellRange(rec.position, radius, lo, hi);
+
+            if(lo.x <= hi.x)
             {
-                for(unsigned int y = y_lo; y <= y_hi; y++)
+                for(unsigned int z = lo.z; z <= hi.z; z++)
                 {
-                    optix::uint3 cell;
-                    cell.x = x_lo;
-                    cell.y = y;
-                    cell.z = z;
-                    unsigned int from = getPhotonGridIndex1D(cell, photonsGridSize);
-                    unsigned int to = from + (x_hi-x_lo);
-
-                    unsigned int offset = hashmapOffsetTable[from];
-                    unsigned int offsetTo = hashmapOffsetTable[to+1];
-                    unsigned int numPhotons = offsetTo-offset;
-
-                    _dCellsVisited++;
+                    for(unsigned int y = lo.y; y <= hi.y; y++)
+                    {
+                        optix::uint3 cell;
+                        cell.x = lo.x;
+                        cell.y = y;
+                        cell.z = z;
+#if ENABLE_MORTON_ORDERED_PHOTON_GRID
+                        // Step along x in Morton order, cells whose indices follow each other are gathered as one range
+                        unsigned int index = getPhotonGridIndexMorton(cell, photonsGridMortonMasks);
+                        unsigned int from = index;
+                        for(unsigned int x = lo.x; x <= hi.x; x++)
+                        {
+                            unsigned int next = incrementPhotonGridIndexMorton(index, photonsGridMortonMasks.x);
+                            if(x == hi.x || next != index+1)
+                            {
+                                _dCellsVisited++;
+                                gatherCellRange(hashmapOffsetTable[from], hashmapOffsetTable[index+1], rec, radius2,
+                                    indirectAccumulatedPower, _dPhotonsVisited);
+                                from = next;
+                            }
+                            index = next;
+                        }
+#else
+                        unsigned int from = getPhotonGridIndex1D(cell, photonsGridSize);
+                        unsigned int to = from + (hi.x-lo.x);
 
-                    for(unsigned int i = offset; i < offset+numPhotons; i++)
+                        _dCellsVisited++;
+                        gatherCellRange(hashmapOffsetTable[from], hashmapOffsetTable[to+1], rec, radius2,
+                            indirectAccumulatedPower, _dPhotonsVisited);
+#endif
+                    }
+                }
+            }
+        }
+        else if(photonMapStructure == ACCELERATION_STRUCTURE_HASHED_GRID)
+        {
+            rtBufferId<uint, 1> table = rtBufferId<uint, 1>(hashedGridTableBufferId);
+            rtBufferId<uint2, 1> cellKeys = rtBufferId<uint2, 1>(hashedGridCellKeysBufferId);
+            optix::uint3 lo, hi;
+            getGatherCellRange(rec.position, radius, lo, hi);
+            if(lo.x <= hi.x)
+            {
+                for(unsigned int z = lo.z; z <= hi.z; z++)
+                {
+                    for(unsigned int y = lo.y; y <= hi.y; y++)
                     {
-                        const Photon & photon = photons[i];
-                        float3 diff = rec.position - photon.position;
-                        float distance2 = dot(diff, diff);
-                        if(validPhoton(photon, distance2, radius2, rec.normal))
+                        // The first and the last cell of the row that hold photons bound the photons of the row
+                        unsigned int first, last;
+                        if(findHashedGridRowCells(table, cellKeys, hashedGridTableMask, lo.x, hi.x, y, z, first, last))
                         {
-                            indirectAccumulatedPower += photonPower(photon, distance2, radius2);
+                            _dCellsVisited++;
+                            gatherCellRange(hashmapOffsetTable[first], hashmapOffsetTable[last+1], rec, radius2,
+                                indirectAccumulatedPower, _dPhotonsVisited);
                         }
-                        _dPhotonsVisited++;
                     }
-
                 }
             }
         }
-
-#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH 
-        
-        optix::uint3 hitCell = getPhotonGridIndex(rec.position, photonsWorldOrigo, photonsGridCellSize);
-     
-        #pragma unroll 3
-        for(int dz = -1; dz <= 1; dz++)
+        else if(photonMapStructure == ACCELERATION_STRUCTURE_STOCHASTIC_HASH)
         {
+            optix::uint3 hitCell = getPhotonGridIndex(rec.position, photonsWorldOrigo, photonsGridCellSize);
+
             #pragma unroll 3
-            for(int dy = -1; dy <= 1; dy++)
+            for(int dz = -1; dz <= 1; dz++)
             {
                 #pragma unroll 3
-                for(int dx = -1; dx <= 1; dx++)
+                for(int dy = -1; dy <= 1; dy++)
                 {
-                    // No hit position can have grid position 0 in x, y or z (because of the padding to the AABB)
-                    optix::uint3 cell;
-                    cell.x = hitCell.x+dx;
-                    cell.y = hitCell.y+dy;
-                    cell.z = hitCell.z+dz;
-                    _dCellsVisited++;
-                    _dPhotonsVisited++;
-
-                    uint hash = getHashValue(cell, photonsGridSize, photonsSize); \
-                    const Photon & photon = photons[hash];
-                    float3 diff = rec.position - photon.position;
-                    float distance2 = dot(diff, diff);
-                    if(validPhoton(photon, distance2, radius2, rec.normal))
+                    #pragma unroll 3
+                    for(int dx = -1; dx <= 1; dx++)
                     {
-                        indirectAccumulatedPower += photonPower(photon, distance2, radius2)*float(photonsHashTableCount[hash]);
+                        // No hit position can have grid position 0 in x, y or z (because of the padding to the AABB)
+                        optix::uint3 cell;
+                        cell.x = hitCell.x+dx;
+                        cell.y = hitCell.y+dy;
+                        cell.z = hitCell.z+dz;
+                        _dCellsVisited++;
+                        _dPhotonsVisited++;
+
+                        uint hash = getHashValue(cell, photonsGridSize, photonsSize); \
+                        float3 diff = rec.position - readPhotonPosition(hash);
+                        float distance2 = dot(diff, diff);
+                        if(distance2 <= radius2 && validPhoton(readPhotonDirection(hash), distance2, radius2, rec.normal))
+                        {
+                            indirectAccumulatedPower += photonPower(readPhotonPower(hash), distance2, radius2)*float(photonsHashTableCount[hash]);
+                        }
                     }
                 }
             }
         }
-        
-#elif ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
-
-        // This code is based on the PPM sample in Optix 3.0.0 SDK by NVIDIA
+        else
+        {
+            // This code is based on the PPM sample in Optix 3.0.0 SDK by NVIDIA
 
-        const size_t MAX_DEPTH = 21;
-        unsigned int stack[MAX_DEPTH];
-        unsigned int stack_current = 0;
-        unsigned int node = 0;
-        #define push_node(N) stack[stack_current++] = (N)
-        #define pop_node() stack[--stack_current]
+            const size_t MAX_DEPTH = 21;
+            unsigned int stack[MAX_DEPTH];
+            unsigned int stack_current = 0;
+            unsigned int node = 0;
+            #define push_node(N) stack[stack_current++] = (N)
+            #define pop_node() stack[--stack_current]
 
-        push_node(0);
-        do 
-        {
-            Photon& photon = photonKdTree[ node ];
-            _dPhotonsVisited++;
-            uint axis = photon.axis;
-            if( !( axis & PPM_NULL ) )
+            push_node(0);
+            do
             {
-                float3 diff = rec.position - photon.position;
-                float distance2 = dot(diff, diff);
-                if(validPhoton(photon, distance2, radius2, rec.normal))
+                Photon& photon = photonKdTree[ node ];
+                _dPhotonsVisited++;
+                uint axis = photon.axis;
+                if( !( axis & PPM_NULL ) )
                 {
-                    indirectAccumulatedPower += photonPower(photon, distance2, radius2);
-                }
+                    float3 diff = rec.position - photon.position;
+                    float distance2 = dot(diff, diff);
+                    if(validPhoton(photon.rayDirection, distance2, radius2, rec.normal))
+                    {
+                        indirectAccumulatedPower += photonPower(photon.power, distance2, radius2);
+                    }
 
-                // Recurse
-                if( !( axis & PPM_LEAF ) ) {
-                    float d;
-                    if      ( axis & PPM_X ) d = diff.x;
-                    else if ( axis & PPM_Y ) d = diff.y;
-                    else                     d = diff.z;
-                    // Calculate the next child selector. 0 is left, 1 is right.
-                    int selector = d < 0.0f ? 0 : 1;
-                    if( d*d < radius2 ) {
-                        push_node( (node<<1) + 2 - selector );
+                    // Recurse
+                    if( !( axis & PPM_LEAF ) ) {
+                        float d;
+                        if      ( axis & PPM_X ) d = diff.x;
+                        else if ( axis & PPM_Y ) d = diff.y;
+                        else                     d = diff.z;
+                        // Calculate the next child selector. 0 is left, 1 is right.
+                        int selector = d < 0.0f ? 0 : 1;
+                        if( d*d < radius2 ) {
+                            push_node( (node<<1) + 2 - selector );
+                        }
+                        node = (node<<1) + 1 + selector;
+                    } else {
+                        node = pop_node();
                     }
-                    node = (node<<1) + 1 + selector;
                 } else {
                     node = pop_node();
                 }
-            } else {
-                node = pop_node();
             }
+            while ( node );
         }
-        while ( node );
-#endif
     }
 
     float3 indirectRadiance = indirectAccumulatedPower * rec.attenuation * (1.0f/(M_PIf*ppmRadiusSquared)) *  (1.0f/emittedPhotonsPerIterationFloat);
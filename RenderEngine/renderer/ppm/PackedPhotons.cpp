@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PackedPhotons.h"
+#include <cmath>
+#include "renderer/ppm/PhotonPacking.h"
+#include "renderer/Light.h"
+#include "renderer/LightAliasTable.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+namespace
+{
+    const unsigned int PACKING_GRAIN_SIZE = 64*1024;
+
+    class PackPhotons
+    {
+    public:
+        PackPhotons(const Photon* photons, float powerScale, float3* positions, unsigned int* directions,
+            unsigned int* powers)
+            : m_photons(photons), m_powerScale(powerScale), m_positions(positions), m_directions(directions),
+              m_powers(powers)
+        {
+
+        }
+
+        void operator()(unsigned int from, unsigned int to) const
+        {
+            for(unsigned int i = from; i < to; i++)
+            {
+                const Photon & photon = m_photons[i];
+                m_positions[i] = photon.position;
+                m_directions[i] = packUnitVectorOctahedral(photon.rayDirection);
+                m_powers[i] = packPhotonPower(photon.power, m_powerScale);
+            }
+        }
+
+    private:
+        const Photon* m_photons;
+        float m_powerScale;
+        float3* m_positions;
+        unsigned int* m_directions;
+        unsigned int* m_powers;
+    };
+
+    class UnpackPhotons
+    {
+    public:
+        UnpackPhotons(const float3* positions, const unsigned int* directions, const unsigned int* powers,
+            float powerScale, Photon* photons)
+            : m_positions(positions), m_directions(directions), m_powers(powers), m_powerScale(powerScale),
+              m_photons(photons)
+        {
+
+        }
+
+        void operator()(unsigned int from, unsigned int to) const
+        {
+            for(unsigned int i = from; i < to; i++)
+            {
+                Photon & photon = m_photons[i];
+                photon.position = m_positions[i];
+                photon.rayDirection = unpackUnitVectorOctahedral(m_directions[i]);
+                photon.power = unpackPhotonPower(m_powers[i], m_powerScale);
+                photon.axis = 0;
+            }
+        }
+
+    private:
+        const float3* m_positions;
+        const unsigned int* m_directions;
+        const unsigned int* m_powers;
+        float m_powerScale;
+        Photon* m_photons;
+    };
+}
+
+void packPhotons( const Photon* photons, unsigned int numPhotons, float powerScale, optix::float3* positions,
+                  unsigned int* directions, unsigned int* powers, TaskScheduler & scheduler )
+{
+    scheduler.parallelFor(0, numPhotons, PACKING_GRAIN_SIZE,
+        PackPhotons(photons, powerScale, positions, directions, powers));
+}
+
+void packPhotons( const Photon* photons, unsigned int numPhotons, float powerScale, optix::float3* positions,
+                  unsigned int* directions, unsigned int* powers )
+{
+    packPhotons(photons, numPhotons, powerScale, positions, directions, powers, TaskScheduler::get());
+}
+
+void unpackPhotons( const optix::float3* positions, const unsigned int* directions, const unsigned int* powers,
+                    unsigned int numPhotons, float powerScale, Photon* photons, TaskScheduler & scheduler )
+{
+    scheduler.parallelFor(0, numPhotons, PACKING_GRAIN_SIZE,
+        UnpackPhotons(positions, directions, powers, powerScale, photons));
+}
+
+void unpackPhotons( const optix::float3* positions, const unsigned int* directions, const unsigned int* powers,
+                    unsigned int numPhotons, float powerScale, Photon* photons )
+{
+    unpackPhotons(positions, directions, powers, numPhotons, powerScale, photons, TaskScheduler::get());
+}
+
+float getPhotonPowerScale( const Light* lights, const LightAliasEntry* aliasTable, unsigned int numLights )
+{
+    float scale = 0.f;
+    for(unsigned int i = 0; i < numLights; i++)
+    {
+        // The photon generator only samples the alias table with more than one light
+        float pickPdf = numLights > 1 ? aliasTable[i].pdf : 1.f;
+        float maxPower = fmaxf(lights[i].power.x, fmaxf(lights[i].power.y, lights[i].power.z));
+        if(pickPdf > 0.f && maxPower > 0.f)
+        {
+            scale = fmaxf(scale, maxPower/pickPdf);
+        }
+    }
+    return scale > 0.f ? scale : 1.f;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+
+class TaskScheduler;
+class Light;
+struct LightAliasEntry;
+
+/*
+Host side conversion between Photon and the structure of arrays layout of the photon pass output
+(ENABLE_PHOTON_SOA_LAYOUT, see PhotonBuffer.h). packPhotons() writes the position, the octahedral direction and the
+RGB9E5 power relative to powerScale of photons[0, numPhotons) to the three arrays, unpackPhotons() does the reverse with
+the precision the packing keeps. Empty slots (zero power) stay empty both ways, and unpacked photons get axis 0.
+*/
+
+RENDER_ENGINE_EXPORT_API void packPhotons(const Photon* photons, unsigned int numPhotons, float powerScale,
+    optix::float3* positions, unsigned int* directions, unsigned int* powers, TaskScheduler & scheduler);
+
+RENDER_ENGINE_EXPORT_API void packPhotons(const Photon* photons, unsigned int numPhotons, float powerScale,
+    optix::float3* positions, unsigned int* directions, unsigned int* powers);
+
+RENDER_ENGINE_EXPORT_API void unpackPhotons(const optix::float3* positions, const unsigned int* directions,
+    const unsigned int* powers, unsigned int numPhotons, float powerScale, Photon* photons, TaskScheduler & scheduler);
+
+RENDER_ENGINE_EXPORT_API void unpackPhotons(const optix::float3* positions, const unsigned int* directions,
+    const unsigned int* powers, unsigned int numPhotons, float powerScale, Photon* photons);
+
+// The photon power scale of a scene: the largest component of the power a photon leaves a light with, the light power
+// over its pick pdf in the alias table (PhotonGenerator.cu). 1 without lights.
+RENDER_ENGINE_EXPORT_API float getPhotonPowerScale(const Light* lights, const LightAliasEntry* aliasTable,
+    unsigned int numLights);
@@ -24,9 +24,8 @@ struct Photon
     optix::float3 power;
     optix::float3 position;
     optix::float3 rayDirection;
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU
+    // Split axis and leaf flags of kd-tree nodes (PPM_X, PPM_LEAF, ...), unused by the other photon maps
     optix::uint   axis;
-#endif
 #if ENABLE_PARTICIPATING_MEDIA
     optix::uint numDeposits;
 #endif
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+#include "renderer/ppm/PhotonPacking.h"
+
+/*
+// The photon pass output shared by the photon pass and the uniform grid and stochastic hash gathers. With
+// ENABLE_PHOTON_SOA_LAYOUT the photons are stored as three arrays, the position (12 bytes), the octahedral direction
+// and the RGB9E5 power relative to photonPowerScale (4 bytes each), instead of the 40 byte Photon. The gather reads the position of every photon
+// in range and the direction and power only of those it accepts. The photon pass appends its photons (see
+// store_photon.h), the uniform grid and kd-tree builds read the first OptixRenderer::getNumPhotonDeposits() of them.
+// A slot with power 0 is empty in both layouts.
+*/
+
+#if ENABLE_PHOTON_SOA_LAYOUT
+rtBuffer<optix::float3, 1> photonPositions;
+rtBuffer<optix::uint, 1> photonDirections;
+rtBuffer<optix::uint, 1> photonPowers;
+rtDeclareVariable(float, photonPowerScale, , );
+#else
+rtBuffer<Photon, 1> photons;
+#endif
+
+__device__ __inline void writePhoton(unsigned int index, const Photon & photon)
+{
+#if ENABLE_PHOTON_SOA_LAYOUT
+    photonPositions[index] = photon.position;
+    photonDirections[index] = packUnitVectorOctahedral(photon.rayDirection);
+    photonPowers[index] = packPhotonPower(photon.power, photonPowerScale);
+#else
+    photons[index] = photon;
+#endif
+}
+
+__device__ __inline optix::float3 readPhotonPosition(unsigned int index)
+{
+#if ENABLE_PHOTON_SOA_LAYOUT
+    return photonPositions[index];
+#else
+    return photons[index].position;
+#endif
+}
+
+__device__ __inline optix::float3 readPhotonDirection(unsigned int index)
+{
+#if ENABLE_PHOTON_SOA_LAYOUT
+    return unpackUnitVectorOctahedral(photonDirections[index]);
+#else
+    return photons[index].rayDirection;
+#endif
+}
+
+__device__ __inline optix::float3 readPhotonPower(unsigned int index)
+{
+#if ENABLE_PHOTON_SOA_LAYOUT
+    return unpackPhotonPower(photonPowers[index], photonPowerScale);
+#else
+    return photons[index].power;
+#endif
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonCompaction.h"
+#include <vector>
+#include <limits>
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+namespace
+{
+    const unsigned int COMPACTION_BLOCK_SIZE = 64*1024;
+
+    struct BlockSummary
+    {
+        unsigned int numValid;
+        float3 bbmin;
+        float3 bbmax;
+    };
+
+    inline bool isValidPhoton(const Photon & photon)
+    {
+        return fmaxf(photon.power) > 0.0f;
+    }
+
+    class CountAndBoundBlocks
+    {
+    public:
+        CountAndBoundBlocks(const Photon* photons, unsigned int numPhotons, BlockSummary* blocks)
+            : m_photons(photons), m_numPhotons(numPhotons), m_blocks(blocks)
+        {
+
+        }
+
+        void operator()(unsigned int fromBlock, unsigned int toBlock) const
+        {
+            for(unsigned int block = fromBlock; block < toBlock; block++)
+            {
+                const unsigned int from = block*COMPACTION_BLOCK_SIZE;
+                const unsigned int to = from + COMPACTION_BLOCK_SIZE < m_numPhotons ? from + COMPACTION_BLOCK_SIZE : m_numPhotons;
+                unsigned int numValid = 0;
+                float3 bbmin = make_float3(  std::numeric_limits<float>::max() );
+                float3 bbmax = make_float3( -std::numeric_limits<float>::max() );
+                for(unsigned int i = from; i < to; i++)
+                {
+                    const Photon & photon = m_photons[i];
+                    if(isValidPhoton(photon))
+                    {
+                        numValid++;
+                        bbmin = fminf(bbmin, photon.position);
+                        bbmax = fmaxf(bbmax, photon.position);
+                    }
+                }
+                m_blocks[block].numValid = numValid;
+                m_blocks[block].bbmin = bbmin;
+                m_blocks[block].bbmax = bbmax;
+            }
+        }
+
+    private:
+        const Photon* m_photons;
+        unsigned int m_numPhotons;
+        BlockSummary* m_blocks;
+    };
+
+    class ScatterBlocks
+    {
+    public:
+        ScatterBlocks(const Photon* photons, unsigned int numPhotons, const unsigned int* blockOffsets, Photon* output)
+            : m_photons(photons), m_numPhotons(numPhotons), m_blockOffsets(blockOffsets), m_output(output)
+        {
+
+        }
+
+        void operator()(unsigned int fromBlock, unsigned int toBlock) const
+        {
+            for(unsigned int block = fromBlock; block < toBlock; block++)
+            {
+                const unsigned int from = block*COMPACTION_BLOCK_SIZE;
+                const unsigned int to = from + COMPACTION_BLOCK_SIZE < m_numPhotons ? from + COMPACTION_BLOCK_SIZE : m_numPhotons;
+                Photon* out = m_output + m_blockOffsets[block];
+                for(unsigned int i = from; i < to; i++)
+                {
+                    if(isValidPhoton(m_photons[i]))
+                    {
+                        *out++ = m_photons[i];
+                    }
+                }
+            }
+        }
+
+    private:
+        const Photon* m_photons;
+        unsigned int m_numPhotons;
+        const unsigned int* m_blockOffsets;
+        Photon* m_output;
+    };
+}
+
+unsigned int compactPhotons( const Photon* photons, unsigned int numPhotons, Photon* output,
+                             optix::float3 & bbmin, optix::float3 & bbmax, TaskScheduler & scheduler )
+{
+    const unsigned int numBlocks = (numPhotons + COMPACTION_BLOCK_SIZE - 1) / COMPACTION_BLOCK_SIZE;
+
+    bbmin = make_float3(  std::numeric_limits<float>::max() );
+    bbmax = make_float3( -std::numeric_limits<float>::max() );
+    if(numBlocks == 0)
+    {
+        return 0;
+    }
+
+    // Count valid photons and reduce their bounds per block, in one read of the input
+    std::vector<BlockSummary> blocks(numBlocks);
+    scheduler.parallelFor(0, numBlocks, 1, CountAndBoundBlocks(photons, numPhotons, &blocks[0]));
+
+    // Exclusive scan of the block counts gives the output offset of each block
+    std::vector<unsigned int> blockOffsets(numBlocks);
+    unsigned int numValid = 0;
+    for(unsigned int block = 0; block < numBlocks; block++)
+    {
+        blockOffsets[block] = numValid;
+        numValid += blocks[block].numValid;
+        bbmin = fminf(bbmin, blocks[block].bbmin);
+        bbmax = fmaxf(bbmax, blocks[block].bbmax);
+    }
+
+    scheduler.parallelFor(0, numBlocks, 1, ScatterBlocks(photons, numPhotons, &blockOffsets[0], output));
+    return numValid;
+}
+
+unsigned int compactPhotons( const Photon* photons, unsigned int numPhotons, Photon* output,
+                             optix::float3 & bbmin, optix::float3 & bbmax )
+{
+    return compactPhotons(photons, numPhotons, output, bbmin, bbmax, TaskScheduler::get());
+}
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+
+class TaskScheduler;
+
+/*
+Parallel stream compaction of the photon pass output on the host. Copies the photons with non-zero power from
+photons[0, numPhotons) to output[0, numValid), keeping their relative order, and returns numValid.
+
+The input is split into blocks. The first pass counts the valid photons of each block and reduces their bounding box,
+an exclusive scan over the block counts gives each block its output offset, and the second pass scatters the valid photons.
+bbmin/bbmax are set to the bounds of the valid photons (inverted bounds when there are none).
+*/
+
+RENDER_ENGINE_EXPORT_API unsigned int compactPhotons(const Photon* photons, unsigned int numPhotons, Photon* output,
+    optix::float3 & bbmin, optix::float3 & bbmax, TaskScheduler & scheduler);
+
+RENDER_ENGINE_EXPORT_API unsigned int compactPhotons(const Photon* photons, unsigned int numPhotons, Photon* output,
+    optix::float3 & bbmin, optix::float3 & bbmax);
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonDump.h"
+#include <exception>
+#include <QFile>
+#include <QString>
+
+namespace
+{
+    const unsigned int PHOTON_DUMP_MAGIC = 0x44505050; // "PPPD"
+    const unsigned int PHOTON_DUMP_VERSION = 1;
+
+    struct PhotonDumpHeader
+    {
+        unsigned int magic;
+        unsigned int version;
+        unsigned int photonSize;
+        unsigned int hitpointSize;
+        unsigned int numPhotons;
+        unsigned int width;
+        unsigned int height;
+        float ppmRadius;
+        float emittedPhotonsPerIteration;
+    };
+
+    void throwFileError(const char* message, const QString & fileName)
+    {
+        QString string = QString("%1 %2.").arg(message).arg(fileName);
+        throw std::exception(string.toLatin1().constData());
+    }
+}
+
+void savePhotonDump( const QString & fileName, const PhotonDump & dump )
+{
+    QFile file (fileName);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        throwFileError("Unable to write the photon dump", fileName);
+    }
+
+    PhotonDumpHeader header;
+    header.magic = PHOTON_DUMP_MAGIC;
+    header.version = PHOTON_DUMP_VERSION;
+    header.photonSize = sizeof(Photon);
+    header.hitpointSize = sizeof(Hitpoint);
+    header.numPhotons = (unsigned int)dump.photons.size();
+    header.width = dump.width;
+    header.height = dump.height;
+    header.ppmRadius = dump.ppmRadius;
+    header.emittedPhotonsPerIteration = dump.emittedPhotonsPerIteration;
+
+    qint64 photonBytes = qint64(dump.photons.size())*sizeof(Photon);
+    qint64 hitpointBytes = qint64(dump.hitpoints.size())*sizeof(Hitpoint);
+    bool ok = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+    ok = ok && (photonBytes == 0 || file.write(reinterpret_cast<const char*>(&dump.photons[0]), photonBytes) == photonBytes);
+    ok = ok && (hitpointBytes == 0 || file.write(reinterpret_cast<const char*>(&dump.hitpoints[0]), hitpointBytes) == hitpointBytes);
+    if(!ok)
+    {
+        throwFileError("An error occurred writing the photon dump", fileName);
+    }
+}
+
+void loadPhotonDump( const QString & fileName, PhotonDump & dump )
+{
+    QFile file (fileName);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        throwFileError("Unable to open the photon dump", fileName);
+    }
+
+    PhotonDumpHeader header;
+    if(file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+        || header.magic != PHOTON_DUMP_MAGIC || header.version != PHOTON_DUMP_VERSION)
+    {
+        throwFileError("Not a photon dump:", fileName);
+    }
+    if(header.photonSize != sizeof(Photon) || header.hitpointSize != sizeof(Hitpoint))
+    {
+        throwFileError("The Photon or Hitpoint layout of this build differs from the one of the photon dump", fileName);
+    }
+
+    dump.width = header.width;
+    dump.height = header.height;
+    dump.ppmRadius = header.ppmRadius;
+    dump.emittedPhotonsPerIteration = header.emittedPhotonsPerIteration;
+    dump.photons.resize(header.numPhotons);
+    dump.hitpoints.resize(header.width*header.height);
+
+    qint64 photonBytes = qint64(dump.photons.size())*sizeof(Photon);
+    qint64 hitpointBytes = qint64(dump.hitpoints.size())*sizeof(Hitpoint);
+    bool ok = photonBytes == 0 || file.read(reinterpret_cast<char*>(&dump.photons[0]), photonBytes) == photonBytes;
+    ok = ok && (hitpointBytes == 0 || file.read(reinterpret_cast<char*>(&dump.hitpoints[0]), hitpointBytes) == hitpointBytes);
+    if(!ok)
+    {
+        throwFileError("The photon dump is truncated:", fileName);
+    }
+}
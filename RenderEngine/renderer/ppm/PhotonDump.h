@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <vector>
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+#include "renderer/Hitpoint.h"
+
+class QString;
+
+/*
+The photon pass output and the ray trace pass hitpoints of one PPM iteration, captured with
+OptixRenderer::savePhotonDump() so the photon map structures can be profiled on the host with real scene data.
+The file holds a small header followed by the raw Photon and Hitpoint arrays, so it can only be loaded by a build
+with the same Photon and Hitpoint layout (ENABLE_PARTICIPATING_MEDIA).
+*/
+
+struct PhotonDump
+{
+    std::vector<Photon> photons;
+    std::vector<Hitpoint> hitpoints;
+    unsigned int width;
+    unsigned int height;
+    float ppmRadius;
+    float emittedPhotonsPerIteration;
+};
+
+RENDER_ENGINE_EXPORT_API void savePhotonDump(const QString & fileName, const PhotonDump & dump);
+RENDER_ENGINE_EXPORT_API void loadPhotonDump(const QString & fileName, PhotonDump & dump);
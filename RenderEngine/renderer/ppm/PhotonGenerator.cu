@@ -12,6 +12,7 @@
 #include <cuda_runtime.h>
 #include "config.h"
 #include "renderer/Light.h"
+#include "renderer/LightAliasTable.h"
 #include "renderer/ShadowPRD.h"
 #include "renderer/RayType.h"
 #include "renderer/helpers/helpers.h"
@@ -24,11 +25,11 @@
 using namespace optix;
 
 rtDeclareVariable(rtObject, sceneRootObject, , );
-rtBuffer<Photon, 1> photons;
-rtBuffer<RandomState, 2> randomStates;
-rtDeclareVariable(uint, maxPhotonDepositsPerEmitted, , );
+rtDeclareVariable(uint, randomSeed, , );
+rtDeclareVariable(uint, randomIterationNumber, , );
 rtDeclareVariable(uint, photonLaunchWidth, , );
 rtBuffer<Light, 1> lights;
+rtDeclareVariable(int, lightAliasTableBufferId, , );    // rtBufferId<LightAliasEntry, 1>
 rtDeclareVariable(uint2, launchIndex, rtLaunchIndex, );
 //rtDeclareVariable(uint2, launchDim, rtLaunchDim, );		// vmarz: comment out unused
 rtDeclareVariable(Sphere, sceneBoundingSphere, , );
@@ -81,24 +82,24 @@ static __device__ void generatePhotonOriginAndDirection(const Light& light, Rand
 RT_PROGRAM void generator()
 {
 	PhotonPRD photonPrd;
-	photonPrd.pm_index = (launchIndex.y * photonLaunchWidth + launchIndex.x)*maxPhotonDepositsPerEmitted;
 	photonPrd.numStoredPhotons = 0;
 	photonPrd.depth = 0;
 	photonPrd.weight = 1.0f;
-	photonPrd.randomState = randomStates[launchIndex];
+	photonPrd.randomState = createRandomState(randomSeed, randomIterationNumber, launchIndex.y*photonLaunchWidth + launchIndex.x,
+		RandomStream::PHOTON);
 
-	// vmarz?: pick based on light power?
+	// Pick a light proportional to its power, photons of all lights then carry about the same power
 	int lightIndex = 0;
+	float lightPickPdf = 1.f;
 	if(lights.size() > 1)
 	{
 		float sample = getRandomUniformFloat(&photonPrd.randomState);
-		lightIndex = intmin((int)(sample*lights.size()), int(lights.size()-1));
+		lightIndex = sampleLightAliasTable(rtBufferId<LightAliasEntry, 1>(lightAliasTableBufferId), sample, lightPickPdf);
 	}
 
 	Light light = lights[lightIndex];
-	float powerScale = lights.size();
 
-	photonPrd.power = light.power*powerScale;
+	photonPrd.power = light.power/lightPickPdf;
 
 	float3 rayOrigin, rayDirection;
    
@@ -108,19 +109,8 @@ RT_PROGRAM void generator()
 
 	Ray photon = Ray(rayOrigin, rayDirection, RayType::PHOTON, 0.0001, RT_DEFAULT_MAX );
 
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_KD_TREE_CPU || ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_UNIFORM_GRID
-	// Clear photons owned by this thread
-	for(unsigned int i = 0; i < maxPhotonDepositsPerEmitted; ++i)
-	{
-		photons[photonPrd.pm_index+i].position = make_float3(0.0f);
-		photons[photonPrd.pm_index+i].power = make_float3(0.0f);
-	}
-#endif
-
 	rtTrace( sceneRootObject, photon, photonPrd );
 
-	randomStates[launchIndex] = photonPrd.randomState;
-
 #if ENABLE_RENDER_DEBUG_OUTPUT
 	debugPhotonPathLengthBuffer[launchIndex] = photonPrd.depth;
 #endif
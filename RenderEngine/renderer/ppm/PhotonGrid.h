@@ -31,3 +31,149 @@ __host__ __device__ __inline unsigned int getHashValue(const optix::uint3 & grid
 {
     return getPhotonGridIndex1D(gridPosition, gridSize) & (max-1);
 }
+
+/*
+// Z-order (Morton) cell numbering of the uniform grid. Each axis gets the bits its grid size needs, and the bits of the
+// three axes are interleaved from the lowest one up, an axis dropping out when its bits run out. Cells that are close
+// along any axis get close indices, and there are less than 8 indices per cell. The mask of an axis has the bits of
+// the index that hold its coordinate.
+*/
+
+__host__ __device__ __inline optix::uint3 getPhotonGridMortonMasks(const optix::uint3 & gridSize)
+{
+    optix::uint3 bits = optix::make_uint3(0u);
+    while((1u << bits.x) < gridSize.x) bits.x++;
+    while((1u << bits.y) < gridSize.y) bits.y++;
+    while((1u << bits.z) < gridSize.z) bits.z++;
+
+    optix::uint3 masks = optix::make_uint3(0u);
+    unsigned int position = 0;
+    for(unsigned int bit = 0; bit < bits.x || bit < bits.y || bit < bits.z; bit++)
+    {
+        if(bit < bits.x) masks.x |= 1u << position++;
+        if(bit < bits.y) masks.y |= 1u << position++;
+        if(bit < bits.z) masks.z |= 1u << position++;
+    }
+    return masks;
+}
+
+// Number of Morton indices, the size of the offset table without its last entry
+__host__ __device__ __inline unsigned int getPhotonGridMortonSize(const optix::uint3 & mortonMasks)
+{
+    return (mortonMasks.x | mortonMasks.y | mortonMasks.z) + 1;
+}
+
+// Spread the low bits of value over the set bits of mask
+__host__ __device__ __inline unsigned int depositBits(unsigned int value, unsigned int mask)
+{
+    unsigned int result = 0;
+    for(unsigned int bit = 1; mask != 0; bit <<= 1)
+    {
+        unsigned int lowest = mask & (~mask + 1);
+        if(value & bit)
+        {
+            result |= lowest;
+        }
+        mask ^= lowest;
+    }
+    return result;
+}
+
+__host__ __device__ __inline unsigned int getPhotonGridIndexMorton(const optix::uint3 & gridPosition, const optix::uint3 & mortonMasks)
+{
+    return depositBits(gridPosition.x, mortonMasks.x) | depositBits(gridPosition.y, mortonMasks.y) | depositBits(gridPosition.z, mortonMasks.z);
+}
+
+// Morton index of the next cell along the axis of axisMask, without decoding the index
+__host__ __device__ __inline unsigned int incrementPhotonGridIndexMorton(unsigned int index, unsigned int axisMask)
+{
+    return (((index | ~axisMask) + 1) & axisMask) | (index & ~axisMask);
+}
+
+/*
+// Sparse hashed grid. Its cells are one PPM radius wide and only the cells holding photons are stored. A cell is
+// keyed by its coordinates, 21 bits per axis packed into 64 bits as x | y << 21 | z << 42 (lo and hi word of a uint2).
+// The photons are sorted by key, so the cells of a row along x that hold photons are consecutive, and each cell has
+// an entry in an open addressing table (linear probing, at most half full) that holds its index in the sorted cells.
+*/
+
+#define PHOTON_HASHED_GRID_MAX_AXIS_CELLS (1u << 21)
+#define PHOTON_HASHED_GRID_EMPTY_SLOT 0xFFFFFFFFu
+
+__host__ __device__ __inline optix::uint2 getHashedGridCellKey(const optix::uint3 & cell)
+{
+    return optix::make_uint2(cell.x | (cell.y << 21), (cell.y >> 11) | (cell.z << 10));
+}
+
+__host__ __device__ __inline unsigned int getHashedGridSlot(const optix::uint2 & key, unsigned int tableMask)
+{
+    unsigned int hash = key.x ^ (key.y*0x85EBCA6Bu);
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352Du;
+    hash ^= hash >> 15;
+    hash *= 0x846CA68Bu;
+    hash ^= hash >> 16;
+    return hash & tableMask;
+}
+
+// Slots of the table of numCells cells, a power of two
+__host__ __device__ __inline unsigned int getHashedGridTableSize(unsigned int numCells)
+{
+    unsigned int size = 2;
+    while(size < 2*numCells)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+__host__ __device__ __inline bool isHashedGridCellKey(const optix::uint2 & cellKey, const optix::uint2 & key)
+{
+    return cellKey.x == key.x && cellKey.y == key.y;
+}
+
+// Keys stored as 64 bit integers, lo word in the low bits
+__host__ __device__ __inline bool isHashedGridCellKey(unsigned long long cellKey, const optix::uint2 & key)
+{
+    return cellKey == (((unsigned long long)key.y << 32) | key.x);
+}
+
+// Index of the cell in the sorted cells, PHOTON_HASHED_GRID_EMPTY_SLOT if it is empty. The table and the keys of the
+// sorted cells are rtBufferIds on the device and std::vectors on the host.
+template<typename Table, typename CellKeys>
+__host__ __device__ __inline unsigned int findHashedGridCell(const Table & table, const CellKeys & cellKeys,
+    unsigned int tableMask, const optix::uint3 & cell)
+{
+    const optix::uint2 key = getHashedGridCellKey(cell);
+    unsigned int slot = getHashedGridSlot(key, tableMask);
+    for(;;)
+    {
+        unsigned int cellIndex = table[slot];
+        if(cellIndex == PHOTON_HASHED_GRID_EMPTY_SLOT || isHashedGridCellKey(cellKeys[cellIndex], key))
+        {
+            return cellIndex;
+        }
+        slot = (slot + 1) & tableMask;
+    }
+}
+
+// The non-empty cells of a row along x are consecutive in the sorted cells. Finds the first and the last of them among
+// the cells loX..hiX of the row at y, z, which bound the sorted items of these cells. False if they are all empty.
+template<typename Table, typename CellKeys>
+__host__ __device__ __inline bool findHashedGridRowCells(const Table & table, const CellKeys & cellKeys,
+    unsigned int tableMask, unsigned int loX, unsigned int hiX, unsigned int y, unsigned int z, unsigned int & first,
+    unsigned int & last)
+{
+    first = PHOTON_HASHED_GRID_EMPTY_SLOT;
+    last = 0;
+    for(unsigned int x = loX; x <= hiX; x++)
+    {
+        unsigned int cellIndex = findHashedGridCell(table, cellKeys, tableMask, optix::make_uint3(x, y, z));
+        if(cellIndex != PHOTON_HASHED_GRID_EMPTY_SLOT)
+        {
+            first = first == PHOTON_HASHED_GRID_EMPTY_SLOT ? cellIndex : first;
+            last = cellIndex;
+        }
+    }
+    return first != PHOTON_HASHED_GRID_EMPTY_SLOT;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonKdTreeBuilder.h"
+#include "util/TaskScheduler.h"
+#include "select.h"
+
+// Below this size the subtree is built serially by the thread that owns it. Large enough that the cost of
+// a task is negligible compared to partitioning, small enough to give every thread several subtrees to steal.
+const unsigned int PhotonKdTreeBuilder::PARALLEL_SUBTREE_MIN_PHOTONS = 32*1024;
+
+inline RT_HOSTDEVICE int max_component(optix::float3 a)
+{
+    if(a.x > a.y && a.x  > a.z)
+    {
+        return 0;
+    }
+    else if(a.y > a.z)
+    {
+        return 1;
+    }
+    return 2;
+}
+
+// Partition photons[start, end) around its median on the longest axis of the bounds, store the median in the tree
+// and return the median index and the bounds of the two halves
+static int splitNode(Photon* photons, int start, int end, Photon* kd_tree, int current_root,
+    const optix::float3 & bbmin, const optix::float3 & bbmax, optix::float3 & leftMax, optix::float3 & rightMin)
+{
+    int axis = max_component(bbmax-bbmin);
+
+    int median = (start+end) / 2;
+    Photon* start_addr = &(photons[start]);
+    switch( axis ) {
+    case 0:
+        select<Photon, 0>( start_addr, 0, end-start-1, median-start );
+        photons[median].axis = PPM_X;
+        break;
+    case 1:
+        select<Photon, 1>( start_addr, 0, end-start-1, median-start );
+        photons[median].axis = PPM_Y;
+        break;
+    case 2:
+        select<Photon, 2>( start_addr, 0, end-start-1, median-start );
+        photons[median].axis = PPM_Z;
+        break;
+    }
+    rightMin = bbmin;
+    leftMax  = bbmax;
+    optix::float3 midPoint = (photons[median]).position;
+    switch( axis ) {
+    case 0:
+        rightMin.x = midPoint.x;
+        leftMax.x  = midPoint.x;
+        break;
+    case 1:
+        rightMin.y = midPoint.y;
+        leftMax.y  = midPoint.y;
+        break;
+    case 2:
+        rightMin.z = midPoint.z;
+        leftMax.z  = midPoint.z;
+        break;
+    }
+
+    kd_tree[current_root] = (photons[median]);
+    return median;
+}
+
+// Returns true if the node is a leaf or NULL node and has been written
+static bool buildTerminalNode(Photon* photons, int start, int end, Photon* kd_tree, int current_root)
+{
+    // If we have zero photons, this is a NULL node
+    if( end - start == 0 ) {
+        kd_tree[current_root].axis = PPM_NULL;
+        kd_tree[current_root].power = optix::make_float3( 0.0f );
+        return true;
+    }
+
+    // If we have a single photon
+    if( end - start == 1 ) {
+        photons[start].axis = PPM_LEAF;
+        kd_tree[current_root] = (photons[start]);
+        return true;
+    }
+
+    return false;
+}
+
+static void buildKDTree( Photon* photons, int start, int end, Photon* kd_tree, int current_root,
+    optix::float3 bbmin, optix::float3 bbmax)
+{
+    if(buildTerminalNode(photons, start, end, kd_tree, current_root))
+    {
+        return;
+    }
+
+    optix::float3 leftMax, rightMin;
+    int median = splitNode(photons, start, end, kd_tree, current_root, bbmin, bbmax, leftMax, rightMin);
+    buildKDTree( photons, start, median, kd_tree, 2*current_root+1, bbmin,  leftMax );
+    buildKDTree( photons, median+1, end, kd_tree, 2*current_root+2, rightMin, bbmax );
+}
+
+namespace
+{
+    class BuildSubtreeTask : public Task
+    {
+    public:
+        BuildSubtreeTask(TaskScheduler & scheduler, Photon* photons, int start, int end, Photon* kd_tree, int current_root,
+            const optix::float3 & bbmin, const optix::float3 & bbmax)
+            : m_scheduler(scheduler), m_photons(photons), m_start(start), m_end(end), m_kdTree(kd_tree),
+              m_currentRoot(current_root), m_bbmin(bbmin), m_bbmax(bbmax)
+        {
+
+        }
+
+        virtual void run()
+        {
+            if(m_end - m_start < (int)PhotonKdTreeBuilder::PARALLEL_SUBTREE_MIN_PHOTONS)
+            {
+                buildKDTree(m_photons, m_start, m_end, m_kdTree, m_currentRoot, m_bbmin, m_bbmax);
+                return;
+            }
+
+            optix::float3 leftMax, rightMin;
+            int median = splitNode(m_photons, m_start, m_end, m_kdTree, m_currentRoot, m_bbmin, m_bbmax, leftMax, rightMin);
+
+            // Fork the right subtree, continue with the left one on this thread. Both live on this stack
+            // frame until the group has finished, so the recursion does not allocate.
+            BuildSubtreeTask right(m_scheduler, m_photons, median+1, m_end, m_kdTree, 2*m_currentRoot+2, rightMin, m_bbmax);
+            BuildSubtreeTask left(m_scheduler, m_photons, m_start, median, m_kdTree, 2*m_currentRoot+1, m_bbmin, leftMax);
+            TaskGroup group(m_scheduler);
+            group.run(right);
+            left.run();
+            group.wait();
+        }
+
+    private:
+        TaskScheduler & m_scheduler;
+        Photon* m_photons;
+        int m_start;
+        int m_end;
+        Photon* m_kdTree;
+        int m_currentRoot;
+        optix::float3 m_bbmin;
+        optix::float3 m_bbmax;
+    };
+}
+
+PhotonKdTreeBuilder::PhotonKdTreeBuilder()
+    : m_scheduler(TaskScheduler::get())
+{
+
+}
+
+PhotonKdTreeBuilder::PhotonKdTreeBuilder( TaskScheduler & scheduler )
+    : m_scheduler(scheduler)
+{
+
+}
+
+void PhotonKdTreeBuilder::build( Photon* photons, unsigned int numPhotons, Photon* kdTree,
+                                 const optix::float3 & bbmin, const optix::float3 & bbmax )
+{
+    BuildSubtreeTask root(m_scheduler, photons, 0, (int)numPhotons, kdTree, 0, bbmin, bbmax);
+    root.run();
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+
+class TaskScheduler;
+
+/*
+Builds the balanced photon kd-tree used by PhotonMapStructure::KD_TREE_CPU. Node i has its children
+at 2i+1 and 2i+2. The photons are median partitioned in place (select.h), subtrees larger than
+PARALLEL_SUBTREE_MIN_PHOTONS are built as tasks on the TaskScheduler so idle threads steal them.
+No memory is allocated during a build.
+*/
+
+class PhotonKdTreeBuilder
+{
+public:
+    RENDER_ENGINE_EXPORT_API PhotonKdTreeBuilder();
+    RENDER_ENGINE_EXPORT_API PhotonKdTreeBuilder(TaskScheduler & scheduler);
+
+    // Reorders photons[0, numPhotons) and writes the tree to kdTree, which must hold
+    // at least pow2roundup(numPhotons+1)-1 elements
+    RENDER_ENGINE_EXPORT_API void build(Photon* photons, unsigned int numPhotons, Photon* kdTree,
+        const optix::float3 & bbmin, const optix::float3 & bbmax);
+
+    const static unsigned int PARALLEL_SUBTREE_MIN_PHOTONS;
+
+private:
+    TaskScheduler & m_scheduler;
+};
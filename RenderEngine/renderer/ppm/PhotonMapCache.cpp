@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonMapCache.h"
+
+const unsigned long long PhotonMapCache::DEFAULT_MAX_SIZE_BYTES = 512ull*1024*1024;
+
+bool PhotonMapCache::Key::operator < (const Key & other) const
+{
+    // Ordered by iteration number first, the last entry of the map is the one to evict
+    if(iterationNumber != other.iterationNumber)
+    {
+        return iterationNumber < other.iterationNumber;
+    }
+    if(randomSeed != other.randomSeed)
+    {
+        return randomSeed < other.randomSeed;
+    }
+    if(structure != other.structure)
+    {
+        return structure < other.structure;
+    }
+    if(numEmittedPhotons != other.numEmittedPhotons)
+    {
+        return numEmittedPhotons < other.numEmittedPhotons;
+    }
+    return ppmRadius < other.ppmRadius;
+}
+
+unsigned long long PhotonMapCache::PhotonMap::getSizeBytes() const
+{
+    unsigned long long sizeBytes = 0;
+    for(int i = 0; i < buffers.size(); i++)
+    {
+        sizeBytes += buffers[i].size();
+    }
+    return sizeBytes;
+}
+
+PhotonMapCache::PhotonMapCache() :
+    m_maxSizeBytes(DEFAULT_MAX_SIZE_BYTES),
+    m_sizeBytes(0),
+    m_numHits(0),
+    m_numMisses(0),
+    m_savedMilliseconds(0)
+{
+
+}
+
+void PhotonMapCache::setMaxSizeBytes(unsigned long long maxSizeBytes)
+{
+    m_maxSizeBytes = maxSizeBytes;
+    evictUntilFits(0);
+}
+
+unsigned long long PhotonMapCache::getMaxSizeBytes() const
+{
+    return m_maxSizeBytes;
+}
+
+void PhotonMapCache::clear()
+{
+    m_photonMaps.clear();
+    m_sizeBytes = 0;
+}
+
+const PhotonMapCache::PhotonMap* PhotonMapCache::find(const Key & key)
+{
+    QMap<Key, PhotonMap>::const_iterator it = m_photonMaps.constFind(key);
+    if(it == m_photonMaps.constEnd())
+    {
+        m_numMisses++;
+        return NULL;
+    }
+    m_numHits++;
+    m_savedMilliseconds += it.value().buildMilliseconds;
+    return &it.value();
+}
+
+bool PhotonMapCache::isWorthInserting(const Key & key, unsigned long long sizeBytes) const
+{
+    if(sizeBytes > m_maxSizeBytes || m_photonMaps.contains(key))
+    {
+        return false;
+    }
+
+    // Only the entries of later iterations make room for this one
+    unsigned long long sizeAfterEviction = m_sizeBytes;
+    QMap<Key, PhotonMap>::const_iterator it = m_photonMaps.constEnd();
+    while(sizeAfterEviction + sizeBytes > m_maxSizeBytes && it != m_photonMaps.constBegin())
+    {
+        --it;
+        if(!(key < it.key()))
+        {
+            return false;
+        }
+        sizeAfterEviction -= it.value().getSizeBytes();
+    }
+    return true;
+}
+
+void PhotonMapCache::insert(const Key & key, const PhotonMap & photonMap)
+{
+    if(!isWorthInserting(key, photonMap.getSizeBytes()))
+    {
+        return;
+    }
+    evictUntilFits(photonMap.getSizeBytes());
+    m_photonMaps.insert(key, photonMap);
+    m_sizeBytes += photonMap.getSizeBytes();
+}
+
+void PhotonMapCache::evictUntilFits(unsigned long long sizeBytes)
+{
+    while(!m_photonMaps.isEmpty() && m_sizeBytes + sizeBytes > m_maxSizeBytes)
+    {
+        QMap<Key, PhotonMap>::iterator last = m_photonMaps.end() - 1;
+        m_sizeBytes -= last.value().getSizeBytes();
+        m_photonMaps.erase(last);
+    }
+}
+
+unsigned int PhotonMapCache::getNumEntries() const
+{
+    return m_photonMaps.size();
+}
+
+unsigned long long PhotonMapCache::getSizeBytes() const
+{
+    return m_sizeBytes;
+}
+
+unsigned long long PhotonMapCache::getNumHits() const
+{
+    return m_numHits;
+}
+
+unsigned long long PhotonMapCache::getNumMisses() const
+{
+    return m_numMisses;
+}
+
+double PhotonMapCache::getSavedMilliseconds() const
+{
+    return m_savedMilliseconds;
+}
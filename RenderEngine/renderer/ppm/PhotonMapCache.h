@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QByteArray>
+#include <QVector>
+#include <QMap>
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+#include "renderer/ppm/PhotonMapStructure.h"
+
+/*
+Host copies of the photon maps of past PPM iterations. The photon pass does not depend on the camera, so after a
+camera move (a new sequence restarting at iteration 0) OptixRenderer replays the cached photon map of an iteration
+instead of tracing the photons and building the map again.
+
+A photon map is cached by the iteration it was traced for, the random seed of the renderer, its structure, the number
+of photons emitted (the photon budget of the request) and the PPM radius (the stochastic hash and hashed grid cells are one radius wide). The cache is cleared when a scene is initialized, so all entries belong to the current scene.
+New sequences always start at iteration 0, so when the cache is over its memory budget the entry with the highest
+iteration number is evicted, and a map is not inserted at all if it would be that entry.
+*/
+
+class PhotonMapCache
+{
+public:
+    struct Key
+    {
+        unsigned long long iterationNumber;
+        unsigned int randomSeed;
+        PhotonMapStructure::E structure;
+        float ppmRadius;
+        unsigned int numEmittedPhotons;
+        RENDER_ENGINE_EXPORT_API bool operator < (const Key & other) const;
+    };
+
+    // The buffer contents and context variables OptixRenderer restores for one iteration. What each buffer holds
+    // depends on the structure, see OptixRenderer::storePhotonMap.
+    struct PhotonMap
+    {
+        QVector<QByteArray> buffers;
+        unsigned long long numPhotons;
+        optix::uint3 gridSize;
+        optix::uint3 gridMortonMasks;
+        optix::float3 gridOrigin;
+        float gridCellSize;
+        unsigned int gridNumCells;
+        // Time spent tracing the photons and building the map, saved by each hit
+        double buildMilliseconds;
+        // Bytes of the buffers, the memory budget counts these only
+        RENDER_ENGINE_EXPORT_API unsigned long long getSizeBytes() const;
+    };
+
+    RENDER_ENGINE_EXPORT_API PhotonMapCache();
+    RENDER_ENGINE_EXPORT_API void setMaxSizeBytes(unsigned long long maxSizeBytes);
+    RENDER_ENGINE_EXPORT_API unsigned long long getMaxSizeBytes() const;
+    RENDER_ENGINE_EXPORT_API void clear();
+
+    // The cached map of key or NULL, counts a hit or a miss. The pointer is valid until the next insert or clear.
+    RENDER_ENGINE_EXPORT_API const PhotonMap* find(const Key & key);
+    // False if a map of sizeBytes for key would be evicted right away, so the caller can skip copying it
+    RENDER_ENGINE_EXPORT_API bool isWorthInserting(const Key & key, unsigned long long sizeBytes) const;
+    RENDER_ENGINE_EXPORT_API void insert(const Key & key, const PhotonMap & photonMap);
+
+    RENDER_ENGINE_EXPORT_API unsigned int getNumEntries() const;
+    RENDER_ENGINE_EXPORT_API unsigned long long getSizeBytes() const;
+    RENDER_ENGINE_EXPORT_API unsigned long long getNumHits() const;
+    RENDER_ENGINE_EXPORT_API unsigned long long getNumMisses() const;
+    RENDER_ENGINE_EXPORT_API double getSavedMilliseconds() const;
+
+    const static unsigned long long DEFAULT_MAX_SIZE_BYTES;
+
+private:
+    void evictUntilFits(unsigned long long sizeBytes);
+
+    QMap<Key, PhotonMap> m_photonMaps;
+    unsigned long long m_maxSizeBytes;
+    unsigned long long m_sizeBytes;
+    unsigned long long m_numHits;
+    unsigned long long m_numMisses;
+    double m_savedMilliseconds;
+};
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "config.h"
+
+// Photon map acceleration structures a render request can pick from. The values are the ACCELERATION_STRUCTURE_*
+// constants of config.h, which the device programs compare the photonMapStructure variable against.
+
+namespace PhotonMapStructure
+{
+    enum E
+    {
+        UNIFORM_GRID = ACCELERATION_STRUCTURE_UNIFORM_GRID,
+        KD_TREE_CPU = ACCELERATION_STRUCTURE_KD_TREE_CPU,
+        STOCHASTIC_HASH = ACCELERATION_STRUCTURE_STOCHASTIC_HASH,
+        HASHED_GRID = ACCELERATION_STRUCTURE_HASHED_GRID
+    };
+}
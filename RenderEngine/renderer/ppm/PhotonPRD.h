@@ -10,7 +10,6 @@ struct PhotonPRD
 {
     optix::float3 power;
     float weight;					// vmarz: initially 1, scaled by fmax(Kd) at every hit, used to stop tracing when small
-    optix::uint pm_index;			// vmarz: index of the first photon stored by a given light path/thread
     optix::uint numStoredPhotons;
     optix::uint depth;
     RandomState randomState;
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include "config.h"
+
+/*
+// Compact encodings of the photon direction and power used by the structure of arrays photon layout
+// (ENABLE_PHOTON_SOA_LAYOUT), 4 bytes each instead of the 12 bytes of a float3.
+*/
+
+/*
+// Unit vectors in octahedral encoding: the vector is projected onto the octahedron |x|+|y|+|z| = 1, the lower half
+// is folded over the upper one and x and y are stored as 16 bit signed normalized values (x in the low half).
+// The round trip error is below 1e-4 radians.
+*/
+
+__host__ __device__ __inline unsigned int packSnorm16(float value)
+{
+    value = value < -1.f ? -1.f : (value > 1.f ? 1.f : value);
+    int quantized = (int)floorf(value*32767.f + 0.5f);
+    return (unsigned int)quantized & 0xffff;
+}
+
+__host__ __device__ __inline float unpackSnorm16(unsigned int bits)
+{
+    float value = float((short)(bits & 0xffff))*(1.f/32767.f);
+    return value < -1.f ? -1.f : value;
+}
+
+__host__ __device__ __inline unsigned int packUnitVectorOctahedral(const optix::float3 & v)
+{
+    float invL1Norm = 1.f/(fabsf(v.x) + fabsf(v.y) + fabsf(v.z));
+    float x = v.x*invL1Norm;
+    float y = v.y*invL1Norm;
+    if(v.z < 0)
+    {
+        float foldedX = (1.f - fabsf(y))*(x >= 0 ? 1.f : -1.f);
+        float foldedY = (1.f - fabsf(x))*(y >= 0 ? 1.f : -1.f);
+        x = foldedX;
+        y = foldedY;
+    }
+    return packSnorm16(x) | (packSnorm16(y) << 16);
+}
+
+__host__ __device__ __inline optix::float3 unpackUnitVectorOctahedral(unsigned int packed)
+{
+    float x = unpackSnorm16(packed);
+    float y = unpackSnorm16(packed >> 16);
+    float z = 1.f - fabsf(x) - fabsf(y);
+    if(z < 0)
+    {
+        float unfoldedX = (1.f - fabsf(y))*(x >= 0 ? 1.f : -1.f);
+        float unfoldedY = (1.f - fabsf(x))*(y >= 0 ? 1.f : -1.f);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+    float invLength = 1.f/sqrtf(x*x + y*y + z*z);
+    return optix::make_float3(x*invLength, y*invLength, z*invLength);
+}
+
+/*
+// RGB in the shared exponent format of EXT_texture_shared_exponent: three 9 bit mantissas (r in the low bits) and a
+// 5 bit exponent with a bias of 15. Covers [0, 65408], the components keep an error below 1/511 of the largest one.
+// Negative and NaN components are stored as 0, and only black packs to 0.
+*/
+
+__host__ __device__ __inline float clampRGB9E5(float value)
+{
+    const float maxValue = 65408.f; // 511/512 * 2^16
+    return value > 0.f ? (value < maxValue ? value : maxValue) : 0.f;
+}
+
+__host__ __device__ __inline unsigned int packRGB9E5(const optix::float3 & rgb)
+{
+    float r = clampRGB9E5(rgb.x);
+    float g = clampRGB9E5(rgb.y);
+    float b = clampRGB9E5(rgb.z);
+    float maxComponent = r > g ? (r > b ? r : b) : (g > b ? g : b);
+    if(maxComponent == 0.f)
+    {
+        return 0;
+    }
+
+    // maxComponent = m*2^exponent with m in [0.5, 1), the shared exponent makes it a 9 bit mantissa
+    int exponent;
+    frexpf(maxComponent, &exponent);
+    int sharedExponent = exponent + 15 > 0 ? exponent + 15 : 0;
+    float scale = ldexpf(1.f, 24 - sharedExponent);
+    if((unsigned int)floorf(maxComponent*scale + 0.5f) == 512)
+    {
+        sharedExponent++;
+        scale *= 0.5f;
+    }
+
+    unsigned int rm = (unsigned int)floorf(r*scale + 0.5f);
+    unsigned int gm = (unsigned int)floorf(g*scale + 0.5f);
+    unsigned int bm = (unsigned int)floorf(b*scale + 0.5f);
+    return rm | (gm << 9) | (bm << 18) | ((unsigned int)sharedExponent << 27);
+}
+
+__host__ __device__ __inline optix::float3 unpackRGB9E5(unsigned int packed)
+{
+    float scale = ldexpf(1.f, int(packed >> 27) - 24);
+    return optix::make_float3(float(packed & 0x1ff)*scale, float((packed >> 9) & 0x1ff)*scale,
+        float((packed >> 18) & 0x1ff)*scale);
+}
+
+/*
+// Photon powers are packed relative to the photon power scale of the scene, the largest power a photon leaves a light
+// with (getPhotonPowerScale, PackedPhotons.h). Light powers are far beyond the RGB9E5 range, the scaled powers of the
+// photons are at most 1 on emission and keep the precision of the shared exponent down to 2^-15.
+*/
+
+__host__ __device__ __inline unsigned int packPhotonPower(const optix::float3 & power, float powerScale)
+{
+    return packRGB9E5(power*(1.f/powerScale));
+}
+
+__host__ __device__ __inline optix::float3 unpackPhotonPower(unsigned int packed, float powerScale)
+{
+    return unpackRGB9E5(packed)*powerScale;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "PhotonRadixSort.h"
+#include <vector>
+#include "util/TaskScheduler.h"
+
+namespace
+{
+    const unsigned int RADIX_BITS = 8;
+    const unsigned int RADIX = 1 << RADIX_BITS;
+    const unsigned int SORT_BLOCK_SIZE = 64*1024;
+
+    // One pass reads the keys and photon indices of the previous pass, the first pass reads photonCells and the
+    // photon indices are implicit
+    struct SortPass
+    {
+        const unsigned int* keysIn;
+        const unsigned int* indicesIn;
+        unsigned int* keysOut;
+        unsigned int* indicesOut;
+        unsigned int shift;
+        unsigned int numKeys;
+    };
+
+    class CountDigits
+    {
+    public:
+        CountDigits(const SortPass & pass, unsigned int* blockCounts)
+            : m_pass(pass), m_blockCounts(blockCounts)
+        {
+
+        }
+
+        void operator()(unsigned int fromBlock, unsigned int toBlock) const
+        {
+            for(unsigned int block = fromBlock; block < toBlock; block++)
+            {
+                unsigned int* counts = m_blockCounts + block*RADIX;
+                for(unsigned int digit = 0; digit < RADIX; digit++)
+                {
+                    counts[digit] = 0;
+                }
+                const unsigned int from = block*SORT_BLOCK_SIZE;
+                const unsigned int to = from + SORT_BLOCK_SIZE < m_pass.numKeys ? from + SORT_BLOCK_SIZE : m_pass.numKeys;
+                for(unsigned int i = from; i < to; i++)
+                {
+                    counts[(m_pass.keysIn[i] >> m_pass.shift) & (RADIX-1)]++;
+                }
+            }
+        }
+
+    private:
+        SortPass m_pass;
+        unsigned int* m_blockCounts;
+    };
+
+    class ScatterDigits
+    {
+    public:
+        ScatterDigits(const SortPass & pass, const unsigned int* blockOffsets)
+            : m_pass(pass), m_blockOffsets(blockOffsets)
+        {
+
+        }
+
+        void operator()(unsigned int fromBlock, unsigned int toBlock) const
+        {
+            for(unsigned int block = fromBlock; block < toBlock; block++)
+            {
+                unsigned int next[RADIX];
+                for(unsigned int digit = 0; digit < RADIX; digit++)
+                {
+                    next[digit] = m_blockOffsets[block*RADIX + digit];
+                }
+                const unsigned int from = block*SORT_BLOCK_SIZE;
+                const unsigned int to = from + SORT_BLOCK_SIZE < m_pass.numKeys ? from + SORT_BLOCK_SIZE : m_pass.numKeys;
+                for(unsigned int i = from; i < to; i++)
+                {
+                    const unsigned int key = m_pass.keysIn[i];
+                    const unsigned int position = next[(key >> m_pass.shift) & (RADIX-1)]++;
+                    m_pass.keysOut[position] = key;
+                    m_pass.indicesOut[position] = m_pass.indicesIn ? m_pass.indicesIn[i] : i;
+                }
+            }
+        }
+
+    private:
+        SortPass m_pass;
+        const unsigned int* m_blockOffsets;
+    };
+
+    class GatherPhotons
+    {
+    public:
+        GatherPhotons(const Photon* photons, const unsigned int* indices, Photon* sortedPhotons)
+            : m_photons(photons), m_indices(indices), m_sortedPhotons(sortedPhotons)
+        {
+
+        }
+
+        void operator()(unsigned int from, unsigned int to) const
+        {
+            for(unsigned int i = from; i < to; i++)
+            {
+                m_sortedPhotons[i] = m_photons[m_indices[i]];
+            }
+        }
+
+    private:
+        const Photon* m_photons;
+        const unsigned int* m_indices;
+        Photon* m_sortedPhotons;
+    };
+
+    // The first photon of a cell writes the offsets of the empty cells before it, so every entry is written once
+    class CreateCellOffsets
+    {
+    public:
+        CreateCellOffsets(const unsigned int* sortedCells, unsigned int numPhotons, unsigned int numCells, unsigned int* cellOffsets)
+            : m_sortedCells(sortedCells), m_numPhotons(numPhotons), m_numCells(numCells), m_cellOffsets(cellOffsets)
+        {
+
+        }
+
+        void operator()(unsigned int from, unsigned int to) const
+        {
+            for(unsigned int i = from; i < to; i++)
+            {
+                const unsigned int firstCell = i > 0 ? m_sortedCells[i-1] + 1 : 0;
+                const unsigned int lastCell = i < m_numPhotons ? m_sortedCells[i] : m_numCells;
+                for(unsigned int cell = firstCell; cell <= lastCell; cell++)
+                {
+                    m_cellOffsets[cell] = i;
+                }
+            }
+        }
+
+    private:
+        const unsigned int* m_sortedCells;
+        unsigned int m_numPhotons;
+        unsigned int m_numCells;
+        unsigned int* m_cellOffsets;
+    };
+}
+
+void sortPhotonsByCell( const Photon* photons, const unsigned int* photonCells, unsigned int numPhotons,
+                        unsigned int numCells, Photon* sortedPhotons, unsigned int* cellOffsets, TaskScheduler & scheduler )
+{
+    unsigned int numPasses = 1;
+    while(numPasses*RADIX_BITS < 32 && (numCells-1) >> (numPasses*RADIX_BITS) != 0)
+    {
+        numPasses++;
+    }
+
+    const unsigned int numBlocks = (numPhotons + SORT_BLOCK_SIZE - 1) / SORT_BLOCK_SIZE;
+    std::vector<unsigned int> keys[2];
+    std::vector<unsigned int> indices[2];
+    std::vector<unsigned int> blockOffsets(numBlocks*RADIX);
+    keys[0].resize(numPhotons);
+    indices[0].resize(numPhotons);
+    if(numPasses > 1)
+    {
+        keys[1].resize(numPhotons);
+        indices[1].resize(numPhotons);
+    }
+
+    const unsigned int* sortedCells = photonCells;
+    const unsigned int* sortedIndices = NULL;
+    for(unsigned int pass = 0; pass < numPasses && numPhotons > 0; pass++)
+    {
+        SortPass sortPass;
+        sortPass.keysIn = sortedCells;
+        sortPass.indicesIn = sortedIndices;
+        sortPass.keysOut = &keys[pass & 1][0];
+        sortPass.indicesOut = &indices[pass & 1][0];
+        sortPass.shift = pass*RADIX_BITS;
+        sortPass.numKeys = numPhotons;
+
+        scheduler.parallelFor(0, numBlocks, 1, CountDigits(sortPass, &blockOffsets[0]));
+
+        // Exclusive scan, digit major so that the blocks keep their order within a digit
+        unsigned int offset = 0;
+        for(unsigned int digit = 0; digit < RADIX; digit++)
+        {
+            for(unsigned int block = 0; block < numBlocks; block++)
+            {
+                unsigned int count = blockOffsets[block*RADIX + digit];
+                blockOffsets[block*RADIX + digit] = offset;
+                offset += count;
+            }
+        }
+
+        scheduler.parallelFor(0, numBlocks, 1, ScatterDigits(sortPass, &blockOffsets[0]));
+        sortedCells = sortPass.keysOut;
+        sortedIndices = sortPass.indicesOut;
+    }
+
+    scheduler.parallelFor(0, numPhotons, SORT_BLOCK_SIZE, GatherPhotons(photons, sortedIndices, sortedPhotons));
+    scheduler.parallelFor(0, numPhotons+1, SORT_BLOCK_SIZE, CreateCellOffsets(sortedCells, numPhotons, numCells, cellOffsets));
+}
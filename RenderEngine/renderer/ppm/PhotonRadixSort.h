@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+#include "config.h"
+#include "renderer/ppm/Photon.h"
+
+class TaskScheduler;
+
+/*
+Host side construction of the uniform grid photon map layout, the counterpart of the thrust sort and scan in
+OptixRenderer_SpatialHash.cu. Sorts photons[0, numPhotons) by their cell index photonCells[i] < numCells into
+sortedPhotons, keeping the order of photons within a cell, and writes the offset of the first photon of each cell to
+cellOffsets[0, numCells), with cellOffsets[numCells] = numPhotons.
+
+The cell indices are sorted with a least significant digit radix sort, 8 bits per pass and only as many passes as
+numCells needs. Each pass counts the digits of every block of the input in parallel, an exclusive scan over the counts
+(digit major, block minor) gives each block its output position per digit, and the blocks are scattered in parallel.
+Only the cell index and the photon index move during the passes, the photons are copied once at the end.
+*/
+
+RENDER_ENGINE_EXPORT_API void sortPhotonsByCell(const Photon* photons, const unsigned int* photonCells, unsigned int numPhotons,
+    unsigned int numCells, Photon* sortedPhotons, unsigned int* cellOffsets, TaskScheduler & scheduler);
@@ -19,7 +19,8 @@ using namespace optix;
 
 rtDeclareVariable(rtObject, sceneRootObject, , );
 rtBuffer<Hitpoint, 2> raytracePassOutputBuffer;
-rtBuffer<RandomState, 2> randomStates;
+rtDeclareVariable(uint, randomSeed, , );
+rtDeclareVariable(uint, randomIterationNumber, , );
 //rtDeclareVariable(float, ppmDefaultRadius2, , );		// vmarz: was not used
 rtDeclareVariable(Camera, camera, , );
 //rtDeclareVariable(float, camera_aperture, , );		// vmarz: was not used
@@ -35,7 +36,8 @@ RT_PROGRAM void generateRay()
     radiancePrd.radiance = make_float3(0.f);
     radiancePrd.depth = 0;
     radiancePrd.flags = 0;
-    radiancePrd.randomState = randomStates[launchIndex];
+    radiancePrd.randomState = createRandomState(randomSeed, randomIterationNumber,
+        launchIndex.y*raytracePassOutputBuffer.size().x + launchIndex.x, RandomStream::CAMERA);
 #if ENABLE_PARTICIPATING_MEDIA
     radiancePrd.volumetricRadiance = make_float3(0);
 #endif
@@ -62,7 +64,6 @@ RT_PROGRAM void generateRay()
 #if ENABLE_PARTICIPATING_MEDIA
     rec.volumetricRadiance = radiancePrd.volumetricRadiance;
 #endif
-    randomStates[launchIndex] = radiancePrd.randomState;
 }
 
 //
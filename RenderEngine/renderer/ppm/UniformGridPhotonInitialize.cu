@@ -4,8 +4,6 @@
  * file that was distributed with this source code.
 */
 #include "config.h"
-
-#if ACCELERATION_STRUCTURE == ACCELERATION_STRUCTURE_STOCHASTIC_HASH
 #include <optix.h>
 #include <optix_device.h>
 #include <optixu/optixu_math_namespace.h>
@@ -17,8 +15,8 @@ rtBuffer<float, 1> photonsHashTableCount;
 //rtBuffer<Photon, 1> photons;
 rtDeclareVariable(uint1, launchIndex, rtLaunchIndex, );
 
+// Clears the stochastic hash photon counts before the photon pass
 RT_PROGRAM void kernel()
 {
     photonsHashTableCount[launchIndex.x] = 0.0f;
-}
-#endif
\ No newline at end of file
+}
\ No newline at end of file
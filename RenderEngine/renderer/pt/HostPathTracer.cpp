@@ -0,0 +1,514 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "HostPathTracer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <exception>
+#include <cstdio>
+#include "config.h"
+#include "renderer/Camera.h"
+#include "scene/IScene.h"
+#include "util/Image.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+const unsigned int HostPathTracer::TILE_SIZE = 16;
+
+namespace
+{
+    const int NUM_PATHS = 5;
+    const unsigned int RAY_MASK_RADIANCE = 1;
+    const unsigned int RAY_MASK_SHADOW = 2;
+
+    // Samplers of renderer/helpers/helpers.h and samplers.h
+
+    void createCoordinateSystem(const float3 & N, float3 & U, float3 & V)
+    {
+        if(fabs(N.x) > fabs(N.y))
+        {
+            float invLength = 1.f/sqrtf(N.x*N.x + N.z*N.z);
+            U = make_float3(-N.z*invLength, 0.f, N.x*invLength);
+        }
+        else
+        {
+            float invLength = 1.f/sqrtf(N.y*N.y + N.z*N.z);
+            U = make_float3(0.f, N.z*invLength, -N.y*invLength);
+        }
+        V = cross(N, U);
+    }
+
+    float3 sampleUnitHemisphereCos(const float3 & normal, const float2 & sample)
+    {
+        float theta = acosf(sqrtf(sample.x));
+        float phi = 2.0f * M_PIf *sample.y;
+        float xs = sinf(theta) * cosf(phi);
+        float ys = cosf(theta);
+        float zs = sinf(theta) * sinf(phi);
+        float3 U, V;
+        createCoordinateSystem(normal, U, V);
+        return normalize(xs*U + ys*normal + zs*V);
+    }
+
+    float2 sampleUnitDisc(const float2 & sample)
+    {
+        float r = sqrtf(sample.x);
+        float theta = 2.f*M_PIf*sample.y;
+        return make_float2(r*cosf(theta), r*sinf(theta));
+    }
+
+    bool isNaN(const float3 & v)
+    {
+        return v.x != v.x || v.y != v.y || v.z != v.z;
+    }
+
+    float reflectionFactor(float cosI, float cosT, float n1, float n2)
+    {
+        float rp = (n2*cosI - n1*cosT)/(n2*cosI+n1*cosT);
+        float rs = (n1*cosI - n2*cosT)/(n1*cosI+n2*cosT);
+        return ( rp*rp + rs*rs ) / 2.f ;
+    }
+}
+
+/*
+// State of a camera path, the host counterpart of RadiancePRD
+*/
+
+struct HostPathTracer::RadiancePath
+{
+    float3 attenuation;
+    float3 radiance;
+    float3 position;
+    float3 normal;
+    float3 randomNewDirection;
+    unsigned int depth;
+    unsigned int flags;
+    RandomState randomState;
+};
+
+namespace
+{
+    enum PathFlags
+    {
+        PATH_MISS = 1,
+        PATH_HIT_EMITTER = 2,
+        PATH_HIT_NON_SPECULAR = 4,
+        PATH_HIT_SPECULAR = 8
+    };
+}
+
+class HostPathTracer::RenderBlocks
+{
+public:
+    RenderBlocks(const HostPathTracer & tracer, const Camera & camera, const RenderTile & tile, unsigned int numBlocksX,
+                 unsigned long long iterationNumber, unsigned int randomSeed, Sampler::E sampler, bool isFirstLocalIteration,
+                 float3* output)
+        : m_tracer(tracer),
+          m_camera(camera),
+          m_tile(tile),
+          m_numBlocksX(numBlocksX),
+          m_iterationNumber(iterationNumber),
+          m_randomSeed(randomSeed),
+          m_sampler(sampler),
+          m_isFirstLocalIteration(isFirstLocalIteration),
+          m_output(output)
+    {
+
+    }
+
+    void operator()(unsigned int from, unsigned int to) const
+    {
+        for(unsigned int block = from; block < to; block++)
+        {
+            unsigned int blockX = m_tile.getX() + (block % m_numBlocksX)*TILE_SIZE;
+            unsigned int blockY = m_tile.getY() + (block / m_numBlocksX)*TILE_SIZE;
+            unsigned int endX = std::min(blockX + TILE_SIZE, m_tile.getX() + m_tile.getWidth());
+            unsigned int endY = std::min(blockY + TILE_SIZE, m_tile.getY() + m_tile.getHeight());
+            for(unsigned int y = blockY; y < endY; y++)
+            {
+                for(unsigned int x = blockX; x < endX; x++)
+                {
+                    unsigned int pixelIndex = y*m_tracer.m_width + x;
+                    RandomState randomState = createRandomState(m_randomSeed, m_iterationNumber, pixelIndex,
+                        RandomStream::CAMERA, m_sampler);
+                    float3 radiance = m_tracer.tracePixel(x, y, m_camera, randomState);
+                    if(!isNaN(radiance))
+                    {
+                        m_output[pixelIndex] = m_isFirstLocalIteration ? radiance : m_output[pixelIndex] + radiance;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    const HostPathTracer & m_tracer;
+    const Camera & m_camera;
+    RenderTile m_tile;
+    unsigned int m_numBlocksX;
+    unsigned long long m_iterationNumber;
+    unsigned int m_randomSeed;
+    Sampler::E m_sampler;
+    bool m_isFirstLocalIteration;
+    float3* m_output;
+};
+
+HostPathTracer::HostPathTracer()
+    : m_scheduler(TaskScheduler::get()),
+      m_bvh(m_scheduler),
+      m_width(0),
+      m_height(0)
+{
+
+}
+
+HostPathTracer::HostPathTracer( TaskScheduler & scheduler )
+    : m_scheduler(scheduler),
+      m_bvh(m_scheduler),
+      m_width(0),
+      m_height(0)
+{
+
+}
+
+void HostPathTracer::initScene( IScene & scene )
+{
+    if(scene.getSceneLights().size() == 0)
+    {
+        throw std::exception("No lights exists in this scene.");
+    }
+    m_lights = scene.getSceneLights();
+    scene.getHostSceneGeometry(m_geometry);
+
+    // Shadow rays pass through emitters (gatherAnyHitOnEmitter)
+    const QVector<HostMaterial> & materials = m_geometry.getMaterials();
+    const QVector<unsigned int> & triangleMaterials = m_geometry.getTriangleMaterials();
+    std::vector<unsigned int> triangleMasks(m_geometry.getNumTriangles());
+    for(unsigned int i = 0; i < triangleMasks.size(); i++)
+    {
+        bool isEmitter = materials[triangleMaterials[i]].type == HostMaterialType::DIFFUSE_EMITTER;
+        triangleMasks[i] = isEmitter ? RAY_MASK_RADIANCE : RAY_MASK_RADIANCE | RAY_MASK_SHADOW;
+    }
+    m_bvh.build(m_geometry, triangleMasks.empty() ? NULL : &triangleMasks[0]);
+    printf("HostPathTracer scene %s: %u triangles, %u BVH nodes\n", scene.getSceneName(), m_geometry.getNumTriangles(),
+        m_bvh.getNumNodes());
+}
+
+void HostPathTracer::renderNextIteration( unsigned long long iterationNumber, unsigned long long localIterationNumber, 
+    const Camera & camera, unsigned int width, unsigned int height, const RenderTile & tile, unsigned int randomSeed,
+    Sampler::E sampler )
+{
+    if(width != m_width || height != m_height)
+    {
+        m_width = width;
+        m_height = height;
+        m_outputBuffer.assign(m_width*m_height, make_float3(0.f));
+    }
+
+    // zero out output buf before first iteration
+    if(localIterationNumber == 0)
+    {
+        std::fill(m_outputBuffer.begin(), m_outputBuffer.end(), make_float3(0.f));
+    }
+
+    RenderTile renderTile = tile.isFullFrame() ? RenderTile(0, 0, m_width, m_height) : tile;
+    if(!renderTile.isInsideFrame(m_width, m_height))
+    {
+        throw std::exception("The render tile is outside of the frame.");
+    }
+    if(renderTile.getNumPixels() == 0)
+    {
+        return;
+    }
+
+    unsigned int numBlocksX = (renderTile.getWidth() + TILE_SIZE - 1)/TILE_SIZE;
+    unsigned int numBlocksY = (renderTile.getHeight() + TILE_SIZE - 1)/TILE_SIZE;
+    m_scheduler.parallelFor(0, numBlocksX*numBlocksY, 1, RenderBlocks(*this, camera, renderTile, numBlocksX,
+        iterationNumber, randomSeed, sampler, localIterationNumber == 0, &m_outputBuffer[0]));
+}
+
+void HostPathTracer::getOutputBuffer( void* data ) const
+{
+    if(m_outputBuffer.size() > 0)
+    {
+        memcpy(data, &m_outputBuffer[0], m_outputBuffer.size()*sizeof(float3));
+    }
+}
+
+void HostPathTracer::getOutputBuffer( void* data, const RenderTile & tile ) const
+{
+    if(tile.isFullFrame())
+    {
+        getOutputBuffer(data);
+        return;
+    }
+
+    float3* tileData = reinterpret_cast<float3*>(data);
+    for(unsigned int y = 0; y < tile.getHeight(); y++)
+    {
+        memcpy(tileData + y*tile.getWidth(), &m_outputBuffer[(tile.getY() + y)*m_width + tile.getX()], tile.getWidth()*sizeof(float3));
+    }
+}
+
+/*
+// Camera path of RayGeneratorPT.cu generateRay() with direct light sampling
+*/
+
+float3 HostPathTracer::tracePixel( unsigned int x, unsigned int y, const Camera & camera, RandomState & randomState ) const
+{
+    RadiancePath path;
+    path.attenuation = make_float3(1.0f);
+    path.radiance = make_float3(0.f);
+    path.depth = 0;
+    path.randomState = randomState;
+
+    float2 screen = make_float2(float(m_width), float(m_height));
+    float2 sample = getRandomUniformFloat2(&path.randomState);
+    float2 d = (make_float2(float(x), float(y)) + sample) / screen * 2.0f - 1.0f;
+
+    float3 rayOrigin = camera.eye;
+    float3 rayDirection = normalize(d.x*camera.camera_u + d.y*camera.camera_v + camera.lookdir);
+
+    // modifyRayForDepthOfField
+    if(camera.aperture > 0)
+    {
+        float3 focalPlaneCenterPoint = camera.eye + camera.lookdir;
+        float3 camLookDir = normalize(camera.lookdir);
+        float focalPlaneT = (dot(camLookDir, focalPlaneCenterPoint) - dot(camLookDir, camera.eye))/dot(camLookDir, rayDirection); 
+        float3 lookAt = rayOrigin + focalPlaneT*rayDirection;
+        float2 disc = sampleUnitDisc(getRandomUniformFloat2(&path.randomState));
+        rayOrigin += disc.x*camera.camera_u*camera.aperture + disc.y*camera.camera_v*camera.aperture;
+        rayDirection = normalize(lookAt - rayOrigin);
+    }
+
+    float3 finalRadiance = make_float3(0);
+    const int numLights = m_lights.size();
+
+    for(int i = 0; i < NUM_PATHS; i++)
+    {
+        path.flags = 0;
+        traceRadiance(rayOrigin, rayDirection, 0.001f, path);
+
+        if(path.flags & PATH_HIT_EMITTER)
+        {
+            if(path.flags & PATH_HIT_SPECULAR || i == 0)
+            {
+                finalRadiance = path.radiance;
+            }
+            break;
+        }
+        else if(path.flags & PATH_HIT_NON_SPECULAR)
+        {
+            int randomLightIndex = std::min(int(getRandomUniformFloat(&path.randomState)*numLights), numLights-1);
+            float3 lightContrib = float(numLights)*getLightContribution(m_lights[randomLightIndex], path.position, path.normal, 
+                path.randomState);
+            finalRadiance += path.attenuation*lightContrib;
+
+            rayOrigin = path.position;
+            rayDirection = path.randomNewDirection;
+        }
+        else
+        {
+            break;
+        }
+
+        if(i >= PATH_TRACING_RR_START_DEPTH) // Russian Roulette sampling
+        {
+            float sample = getRandomUniformFloat(&path.randomState);
+            float probabilityContinue = fmaxf(path.attenuation);
+            if(sample > probabilityContinue)
+            {
+                break;
+            }
+            path.attenuation /= probabilityContinue;
+        }
+    }
+
+    randomState = path.randomState;
+    return finalRadiance;
+}
+
+/*
+// The closest hit radiance programs of the materials. Mirror and glass continue the ray in place of the recursive rtTrace.
+*/
+
+void HostPathTracer::traceRadiance( float3 origin, float3 direction, float tMin, RadiancePath & path ) const
+{
+    const QVector<HostMaterial> & materials = m_geometry.getMaterials();
+    const QVector<int3> & triangles = m_geometry.getTriangles();
+    const QVector<float3> & normals = m_geometry.getNormals();
+    const QVector<float2> & texCoords = m_geometry.getTexCoords();
+
+    for(;;)
+    {
+        HostBvh::Hit hit;
+        if(!m_bvh.intersect(origin, direction, tMin, std::numeric_limits<float>::max(), hit, RAY_MASK_RADIANCE))
+        {
+            path.flags = PATH_MISS;
+            path.attenuation = make_float3(0.f);
+            return;
+        }
+
+        const int3 & triangle = triangles[hit.triangle];
+        const HostMaterial & material = materials[m_geometry.getTriangleMaterials()[hit.triangle]];
+        const float alpha = 1.0f - hit.beta - hit.gamma;
+        float3 normal = normalize(normals[triangle.y]*hit.beta + normals[triangle.z]*hit.gamma + normals[triangle.x]*alpha);
+        float3 hitPoint = origin + hit.t*direction;
+
+        if(material.type == HostMaterialType::DIFFUSE)
+        {
+            path.flags |= PATH_HIT_NON_SPECULAR;
+            if(material.diffuseImage != NULL)
+            {
+                float2 texCoord = texCoords[triangle.y]*hit.beta + texCoords[triangle.z]*hit.gamma + texCoords[triangle.x]*alpha;
+                path.randomNewDirection = sampleUnitHemisphereCos(normal, getRandomUniformFloat2(&path.randomState));
+                path.attenuation *= getTexel(material, texCoord);
+            }
+            else
+            {
+                path.attenuation *= material.Kd;
+                path.depth++;
+                path.randomNewDirection = sampleUnitHemisphereCos(normal, getRandomUniformFloat2(&path.randomState));
+            }
+            path.normal = normal;
+            path.position = hitPoint;
+            return;
+        }
+        else if(material.type == HostMaterialType::DIFFUSE_EMITTER)
+        {
+            path.flags |= PATH_HIT_EMITTER;
+            if(dot(normal, -direction) >= 0.f)
+            {
+                path.radiance += path.attenuation*material.powerPerArea/M_PIf;
+            }
+            return;
+        }
+        else if(material.type == HostMaterialType::MIRROR)
+        {
+            path.depth++;
+            if(path.depth > MAX_RADIANCE_TRACE_DEPTH)
+            {
+                return;
+            }
+            path.attenuation *= material.Kr;
+            direction = reflect(direction, normal);
+        }
+        else if(material.type == HostMaterialType::GLASS)
+        {
+            bool isHitFromOutside = dot(normal, direction) < 0;
+            float3 N = isHitFromOutside ? normal : -normal;
+            float n1 = isHitFromOutside ? 1.f : material.indexOfRefraction;
+            float n2 = isHitFromOutside ? material.indexOfRefraction : 1.f;
+
+            float3 refractionDirection;
+            bool validRefraction = refract(refractionDirection, direction, N, n2/n1);
+            float cosThetaI = -dot(direction, N);
+            float cosThetaT = -dot(refractionDirection, N);
+            float reflFactor = validRefraction ? reflectionFactor(cosThetaI, cosThetaT, n1, n2) : 1.f;
+
+            if(getRandomUniformFloat(&path.randomState) <= reflFactor)
+            {
+                direction = reflect(direction, N);
+            }
+            else
+            {
+                direction = refractionDirection;
+                path.attenuation *= (n2*n2)/(n1*n1);
+            }
+
+            path.flags |= PATH_HIT_SPECULAR;
+            path.flags &= ~PATH_HIT_NON_SPECULAR;
+            path.depth++;
+            if(path.depth > MAX_RADIANCE_TRACE_DEPTH)
+            {
+                path.attenuation *= 0;
+                return;
+            }
+        }
+        else
+        {
+            // Participating media are not path traced
+            return;
+        }
+
+        origin = hitPoint;
+        tMin = 0.0001f;
+    }
+}
+
+/*
+// getLightContribution of renderer/helpers/light.h. Emitters do not cast shadows (gatherAnyHitOnEmitter).
+*/
+
+float3 HostPathTracer::getLightContribution( const Light & light, const float3 & position, const float3 & normal,
+    RandomState & randomState ) const
+{
+    float lightFactor = 1;
+    float3 pointOnLight;
+    if(light.lightType == Light::AREA)
+    {
+        float2 sample = getRandomUniformFloat2(&randomState);
+        pointOnLight = light.position + sample.x*light.v1 + sample.y*light.v2;
+    }
+    else if(light.lightType == Light::POINT)
+    {
+        pointOnLight = light.position;
+        lightFactor *= 1.f/4.f;
+    }
+    else
+    {
+        return make_float3(0);
+    }
+
+    float3 towardsLight = pointOnLight - position;
+    float lightDistance = length(towardsLight);
+    towardsLight = towardsLight / lightDistance;
+    float n_dot_l = std::max(0.f, dot(normal, towardsLight));
+    lightFactor *= n_dot_l / (M_PIf*lightDistance*lightDistance);
+    if(light.lightType == Light::AREA)
+    {
+        lightFactor *= std::max(0.f, dot(-towardsLight, light.normal));
+    }
+
+    if(lightFactor > 0.0f && !m_bvh.isOccluded(position, towardsLight, 0.0001f, lightDistance-0.0001f, RAY_MASK_SHADOW))
+    {
+        return light.power*lightFactor;
+    }
+    return make_float3(0);
+}
+
+float3 HostPathTracer::getTexel( const HostMaterial & material, const float2 & texCoord ) const
+{
+    // Bilinear filtering with repeat wrapping and normalized coordinates, like the texture sampler of Texture.cpp
+    const Image & image = *material.diffuseImage;
+    const int width = (int)image.getWidth();
+    const int height = (int)image.getHeight();
+    float u = texCoord.x*width - 0.5f;
+    float v = texCoord.y*height - 0.5f;
+    float u0 = floorf(u);
+    float v0 = floorf(v);
+    float fu = u - u0;
+    float fv = v - v0;
+
+    float3 result = make_float3(0.f);
+    for(int j = 0; j < 2; j++)
+    {
+        for(int i = 0; i < 2; i++)
+        {
+            int x = ((int)u0 + i) % width;
+            int y = ((int)v0 + j) % height;
+            x = x < 0 ? x + width : x;
+            y = y < 0 ? y + height : y;
+            const unsigned char* texel = image.constData() + 4*(y*width + x);
+            float weight = (i ? fu : 1.f - fu)*(j ? fv : 1.f - fv);
+            result += weight*make_float3(texel[0], texel[1], texel[2])/255.f;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <vector>
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+#include "renderer/Light.h"
+#include "renderer/RandomState.h"
+#include "clientserver/RenderTile.h"
+#include "scene/HostSceneGeometry.h"
+#include "scene/HostBvh.h"
+
+class TaskScheduler;
+class IScene;
+class Camera;
+
+/*
+Host implementation of the path tracing pass (RayGeneratorPT.cu) for machines without a CUDA device. It traces the
+triangles of IScene::getHostSceneGeometry with the same estimator as the device programs: five path segments with
+one shadow ray to a randomly picked light at every non-specular hit, Russian roulette from PATH_TRACING_RR_START_DEPTH,
+mirrors and glass followed up to MAX_RADIANCE_TRACE_DEPTH and the output buffer holding the sum of the samples since
+local iteration 0. 
+
+The frame (or render tile) is split into TILE_SIZE x TILE_SIZE pixel blocks that are distributed over the
+TaskScheduler. Every pixel creates its random state of RandomState.h from the seed, its index and the iteration number
+like the device program, so the result does not depend on which thread renders it and the device draws the same
+random numbers for the pixel.
+*/
+
+class HostPathTracer
+{
+public:
+    RENDER_ENGINE_EXPORT_API HostPathTracer();
+    RENDER_ENGINE_EXPORT_API HostPathTracer(TaskScheduler & scheduler);
+    // Throws std::exception if the scene has no lights or no host geometry
+    RENDER_ENGINE_EXPORT_API void initScene(IScene & scene);
+    RENDER_ENGINE_EXPORT_API void renderNextIteration(unsigned long long iterationNumber, unsigned long long localIterationNumber,
+        const Camera & camera, unsigned int width, unsigned int height, const RenderTile & tile = RenderTile(),
+        unsigned int randomSeed = 0, Sampler::E sampler = Sampler::E(DEFAULT_SAMPLER));
+    RENDER_ENGINE_EXPORT_API void getOutputBuffer(void* data) const;
+    // Copy the pixels of tile, row by row, to data (tile.getNumPixels() float3)
+    RENDER_ENGINE_EXPORT_API void getOutputBuffer(void* data, const RenderTile & tile) const;
+    unsigned int getWidth() const { return m_width; }
+    unsigned int getHeight() const { return m_height; }
+
+    const static unsigned int TILE_SIZE;
+
+private:
+    class RenderBlocks;
+    friend class RenderBlocks;
+
+    struct RadiancePath;
+
+    void traceRadiance(optix::float3 origin, optix::float3 direction, float tMin, RadiancePath & path) const;
+    optix::float3 getLightContribution(const Light & light, const optix::float3 & position, const optix::float3 & normal,
+        RandomState & randomState) const;
+    optix::float3 tracePixel(unsigned int x, unsigned int y, const Camera & camera, RandomState & randomState) const;
+    optix::float3 getTexel(const HostMaterial & material, const optix::float2 & texCoord) const;
+
+    TaskScheduler & m_scheduler;
+    HostSceneGeometry m_geometry;
+    HostBvh m_bvh;
+    QVector<Light> m_lights;
+    std::vector<optix::float3> m_outputBuffer;
+    unsigned int m_width;
+    unsigned int m_height;
+};
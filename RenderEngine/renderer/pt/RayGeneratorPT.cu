@@ -24,8 +24,11 @@ rtDeclareVariable(rtObject, sceneRootObject, , );
 rtDeclareVariable(Camera, camera, , );
 rtBuffer<Light, 1> lights;
 rtBuffer<float3, 2> outputBuffer;
-rtBuffer<RandomState, 2> randomStates;
+rtDeclareVariable(uint, randomSeed, , );
+rtDeclareVariable(uint, randomIterationNumber, , );
+rtDeclareVariable(uint, sampler, , );
 rtDeclareVariable(uint2, launchIndex, rtLaunchIndex, );
+rtDeclareVariable(uint2, renderTileOrigin, , );
 rtDeclareVariable(uint, localIterationNumber, , );
 rtDeclareVariable(RadiancePRD, radiancePrd, rtPayload, );
 rtDeclareVariable(optix::Ray, ray, rtCurrentRay, );
@@ -49,11 +52,15 @@ RT_PROGRAM void generateRay()
     radiancePrd.attenuation = make_float3( 1.0f );
     radiancePrd.radiance = make_float3(0.f);
     radiancePrd.depth = 0u; 
-    radiancePrd.randomState = randomStates[launchIndex];
+
+    // The launch covers the render tile only
+    const uint2 pixelIndex = launchIndex + renderTileOrigin;
+    radiancePrd.randomState = createRandomState(randomSeed, randomIterationNumber, pixelIndex.y*outputBuffer.size().x + pixelIndex.x,
+        RandomStream::CAMERA, sampler);
 
     float2 screen = make_float2( outputBuffer.size() );
     float2 sample = getRandomUniformFloat2(&radiancePrd.randomState);
-    float2 d = ( make_float2(launchIndex) + sample ) / screen * 2.0f - 1.0f; // vmarz: map pixel pos to [-1,1]
+    float2 d = ( make_float2(pixelIndex) + sample ) / screen * 2.0f - 1.0f; // vmarz: map pixel pos to [-1,1]
 
     float3 rayOrigin = camera.eye;
     float3 rayDirection = normalize(d.x*camera.camera_u + d.y*camera.camera_v + camera.lookdir);
@@ -86,7 +93,7 @@ RT_PROGRAM void generateRay()
 
             for(int shadowSample = 0; shadowSample < numShadowSamples; shadowSample++)
             {
-                int randomLightIndex = int(getRandomUniformFloat(&randomStates[launchIndex])*numLights);
+                int randomLightIndex = int(getRandomUniformFloat(&radiancePrd.randomState)*numLights);
                 Light & light = lights[randomLightIndex];
                 float scale = numLights; // vmarz: scales by numLights to apply light pick pdf (equivavelnt to dividing by 1/numLights)
 
@@ -108,7 +115,7 @@ RT_PROGRAM void generateRay()
 
         if(i >= PATH_TRACING_RR_START_DEPTH) // Russian Roulette sampling
         {
-            float sample = getRandomUniformFloat(&randomStates[launchIndex]);
+            float sample = getRandomUniformFloat(&radiancePrd.randomState);
             float probabilityContinue = fmaxf(radiancePrd.attenuation);
             if(sample > probabilityContinue)
             {
@@ -125,9 +132,8 @@ RT_PROGRAM void generateRay()
     // something bad happens in few bottom rows in somve scenes (exact straight rows of black pixels)
     if (!isNaN(finalRadiance))
     {
-        outputBuffer[launchIndex] = localIterationNumber == 0 ? finalRadiance : outputBuffer[launchIndex] + finalRadiance;
+        outputBuffer[pixelIndex] = localIterationNumber == 0 ? finalRadiance : outputBuffer[pixelIndex] + finalRadiance;
     }
-    randomStates[launchIndex] = radiancePrd.randomState;
 }
 
 //
@@ -44,23 +44,23 @@
 #include "renderer/device_common.h"
 #include "renderer/helpers/helpers.h"
 
-RT_FUNCTION float localCosTheta( const optix::float3 & w )
+__host__ RT_FUNCTION float localCosTheta( const optix::float3 & w )
 {
     return w.z;
 }
 
-RT_FUNCTION float localSinThetaSquared( const optix::float3 & w )
+__host__ RT_FUNCTION float localSinThetaSquared( const optix::float3 & w )
 {
     return 1.0f - w.z*w.z;
 }
 
-RT_FUNCTION bool localIsSameHemisphere( const optix::float3 & wo, const optix::float3 & wi )
+__host__ RT_FUNCTION bool localIsSameHemisphere( const optix::float3 & wo, const optix::float3 & wi )
 {
     return wo.z * wi.z > 0.0f;
 }
 
 
-RT_FUNCTION optix::float3 localReflect( const optix::float3 & w )
+__host__ RT_FUNCTION optix::float3 localReflect( const optix::float3 & w )
 {
     return optix::make_float3(-w.x, -w.y, w.z);
 }
@@ -77,9 +77,9 @@ public:
 
 
 public:
-    RT_FUNCTION Fresnel(Type type) : m_type(type) {  }
+    __host__ RT_FUNCTION Fresnel(Type type) : m_type(type) {  }
 
-    RT_FUNCTION Type type() const { return m_type; }
+    __host__ RT_FUNCTION Type type() const { return m_type; }
 
     // optix::float3 evaluate(float cosi) const;
 
@@ -92,10 +92,10 @@ class FresnelNoOp : public Fresnel
 {
 
 public:
-    RT_FUNCTION FresnelNoOp() : Fresnel(NoOp) {  }
+    __host__ RT_FUNCTION FresnelNoOp() : Fresnel(NoOp) {  }
 
 public:
-    RT_FUNCTION float evaluate(float) const
+    __host__ RT_FUNCTION float evaluate(float) const
     {
         return 1.0f;
     }
@@ -132,10 +132,10 @@ public:
 class FresnelDielectric : public Fresnel 
 {
 public:
-    RT_FUNCTION FresnelDielectric(float ei, float et) : Fresnel(Fresnel::Dielectric),
+    __host__ RT_FUNCTION FresnelDielectric(float ei, float et) : Fresnel(Fresnel::Dielectric),
         eta_i(ei), eta_t(et) {  }
 
-    RT_FUNCTION float evaluate(float cosi) const 
+    __host__ RT_FUNCTION float evaluate(float cosi) const 
     {
         using namespace optix;
 
@@ -1,4 +1,4 @@
-/* 
+/*
  * Copyright (c) 2014 Opposite Renderer
  * For the full copyright and license information, please view the LICENSE.txt
  * file that was distributed with this source code.
@@ -7,21 +7,84 @@
 */
 
 #pragma once
-//#include <optix_world.h>
-#include "renderer/BSDF.h"
-#include "optix.h"
+#include <optixu/optixu_math_namespace.h>
+#include "renderer/ppm/PhotonPacking.h"
+
+/*
+// Light vertices are stored in the light vertex cache in a compact encoding instead of with their full VcmBSDF.
+// They are only stored on non-specular surfaces, whose light BSDFs are a Lambertian, optionally followed by a Phong
+// lobe (Diffuse, Texture, Glossy). The BSDF is kept as the BxDFs it has, their parameters, the shading normal and the
+// direction the vertex was reached from, and is rebuilt from them when the vertex is loaded (renderer/vcm/vcm.h).
+// Directions use the octahedral and reflectances the RGB9E5 encoding of the photons (renderer/ppm/PhotonPacking.h).
+*/
+
+namespace LightVertexBxDF
+{
+    enum E
+    {
+        LAMBERTIAN = 1 << 0,
+        PHONG      = 1 << 1
+    };
+}
 
 struct LightVertex
 {
     optix::float3   hitPoint;
     optix::float3   throughput;
-    VcmBSDF         bsdf;
-    optix::uint2    launchIndex;    // for debug TODO remove
-    optix::uint     pathLen;
+    optix::uint     packedNormal;       // octahedral shading normal of the BSDF
+    optix::uint     packedDirFix;       // octahedral world direction the vertex was reached from
+    optix::uint     packedDiffuse;      // RGB9E5 Lambertian reflectance
+    optix::uint     packedGlossy;       // RGB9E5 Phong reflectance
+    float           glossyExponent;
+    optix::uint     bxdfsAndPathLen;    // LightVertexBxDF flags in the low byte, path length above them
     float           dVCM;
     float           dVC;
     float           dVM;
 //#if VCM_UNIFORM_VERTEX_SAMPLING
 //    float   dVC_unif_vert;
 //#endif
-};
\ No newline at end of file
+};
+
+// BSDF parameters of a light vertex as they are packed and unpacked
+struct LightVertexMaterial
+{
+    optix::float3   normal;
+    optix::float3   dirFix;
+    optix::uint     bxdfs;              // LightVertexBxDF flags
+    optix::float3   diffuseReflectance;
+    optix::float3   glossyReflectance;
+    float           glossyExponent;
+};
+
+__host__ __device__ __inline void packLightVertexMaterial(LightVertex & vertex, const LightVertexMaterial & material,
+    optix::uint pathLen)
+{
+    vertex.packedNormal = packUnitVectorOctahedral(material.normal);
+    vertex.packedDirFix = packUnitVectorOctahedral(material.dirFix);
+    vertex.packedDiffuse = (material.bxdfs & LightVertexBxDF::LAMBERTIAN) ? packRGB9E5(material.diffuseReflectance) : 0;
+    vertex.packedGlossy = (material.bxdfs & LightVertexBxDF::PHONG) ? packRGB9E5(material.glossyReflectance) : 0;
+    vertex.glossyExponent = (material.bxdfs & LightVertexBxDF::PHONG) ? material.glossyExponent : 0.f;
+    vertex.bxdfsAndPathLen = (material.bxdfs & 0xff) | (pathLen << 8);
+}
+
+__host__ __device__ __inline LightVertexMaterial unpackLightVertexMaterial(const LightVertex & vertex)
+{
+    LightVertexMaterial material;
+    material.normal = unpackUnitVectorOctahedral(vertex.packedNormal);
+    material.dirFix = unpackUnitVectorOctahedral(vertex.packedDirFix);
+    material.bxdfs = vertex.bxdfsAndPathLen & 0xff;
+    material.diffuseReflectance = unpackRGB9E5(vertex.packedDiffuse);
+    material.glossyReflectance = unpackRGB9E5(vertex.packedGlossy);
+    material.glossyExponent = vertex.glossyExponent;
+    return material;
+}
+
+__host__ __device__ __inline optix::uint getLightVertexPathLen(const LightVertex & vertex)
+{
+    return vertex.bxdfsAndPathLen >> 8;
+}
+
+__host__ __device__ __inline optix::float3 getLightVertexDirFix(const LightVertex & vertex)
+{
+    return unpackUnitVectorOctahedral(vertex.packedDirFix);
+}
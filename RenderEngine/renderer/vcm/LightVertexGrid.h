@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+
+/*
+Sparse hashed grid over the light vertex cache for vertex merging, rebuilt after every VCM light pass. It has the
+layout of the photon hashed grid (renderer/ppm/PhotonGrid.h): cells one merging radius wide, keyed by their
+coordinates, the light vertex indices sorted by cell key and an open addressing table from key to cell. The vertices
+themselves stay where the light pass wrote them, only their indices are sorted.
+
+The buffers are bindless, the struct is set as one context variable and passed on to the camera hit programs.
+*/
+
+struct LightVertexGrid
+{
+    int vertexIndexBufferId;        // rtBufferId<uint, 1>, light vertex indices sorted by cell
+    int cellKeyBufferId;            // rtBufferId<uint2, 1>, key of each non-empty cell
+    int cellOffsetBufferId;         // rtBufferId<uint, 1>, first sorted index of each cell, numCells+1 entries
+    int tableBufferId;              // rtBufferId<uint, 1>, cell of each slot or PHOTON_HASHED_GRID_EMPTY_SLOT
+    unsigned int tableMask;
+    unsigned int numCells;          // 0 when merging is off
+    optix::uint3 gridSize;
+    optix::float3 worldOrigo;
+    float cellSize;
+    float radiusSquared;
+};
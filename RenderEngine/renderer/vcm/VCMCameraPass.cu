@@ -40,9 +40,12 @@ rtDeclareVariable(rtObject, sceneRootObject, , );
 rtBuffer<Light, 1> lights;
 rtBuffer<float3, 2> outputBuffer;                   // TODO change to float4
 rtDeclareVariable(uint, localIterationNumber, , );
-rtBuffer<RandomState, 2> randomStates;
+rtDeclareVariable(uint, randomSeed, , );
+rtDeclareVariable(uint, randomIterationNumber, , );
+rtDeclareVariable(uint, sampler, , );
 rtDeclareVariable(uint2, launchIndex, rtLaunchIndex, );
 rtDeclareVariable(uint2, launchDim, rtLaunchDim, );
+rtDeclareVariable(uint2, renderTileOrigin, , );
 
 #define OPTIX_PRINTF_ENABLED 0
 #define OPTIX_PRINTFI_ENABLED 0
@@ -72,11 +75,10 @@ RT_PROGRAM void cameraPass()
         cameraRay.direction = cameraPrd.direction;
     }
 
-    float3 bufColor = outputBuffer[launchIndex];
+    float3 bufColor = outputBuffer[cameraPrd.launchIndex];
     bufColor = bufColor + cameraPrd.color;
     float3 avgColor = bufColor / (localIterationNumber + 1);
-    outputBuffer[launchIndex] = bufColor;
-    randomStates[launchIndex] = cameraPrd.randomState;
+    outputBuffer[cameraPrd.launchIndex] = bufColor;
 }
 
 
@@ -107,9 +109,13 @@ rtDeclareVariable(uint,     lightSubpathCount, , );
 // Initialize camera payload - partial MIS terms [tech. rep. (31)-(33)]
 RT_FUNCTION void initCameraPayload(SubpathPRD & aCameraPrd)
 {
-    aCameraPrd.launchIndex   = launchIndex;
-    aCameraPrd.launchIndex1D = getBufIndex1D(launchIndex, launchDim);
-    aCameraPrd.randomState = randomStates[launchIndex];
+    // The launch covers the render tile only, the camera subpath is indexed by its pixel in the frame
+    const uint2 pixelIndex = launchIndex + renderTileOrigin;
+    const uint2 frameSize = make_uint2(outputBuffer.size().x, outputBuffer.size().y);
+    aCameraPrd.launchIndex   = pixelIndex;
+    aCameraPrd.launchIndex1D = getBufIndex1D(pixelIndex, frameSize);
+    aCameraPrd.randomState = createRandomState(randomSeed, randomIterationNumber, aCameraPrd.launchIndex1D, RandomStream::VCM_CAMERA,
+        sampler);
     aCameraPrd.throughput = make_float3(1.0f);
     aCameraPrd.color = make_float3(0.0f);
     aCameraPrd.depth = 0;
@@ -124,7 +130,7 @@ RT_FUNCTION void initCameraPayload(SubpathPRD & aCameraPrd)
 
     float2 screen = make_float2( outputBuffer.size() );
     float2 sample = getRandomUniformFloat2(&aCameraPrd.randomState);            // jitter pixel pos
-    float2 d = ( make_float2(launchIndex) + sample ) / screen * 2.0f - 1.0f;    // vmarz: map pixel pos to [-1,1]
+    float2 d = ( make_float2(pixelIndex) + sample ) / screen * 2.0f - 1.0f;    // vmarz: map pixel pos to [-1,1]
     
     aCameraPrd.origin = camera.eye;
     aCameraPrd.direction = normalize(d.x*camera.camera_u + d.y*camera.camera_v + camera.lookdir);
@@ -17,6 +17,7 @@
 #include "renderer/helpers/helpers.h"
 #include "config.h"
 #include "renderer/Light.h"
+#include "renderer/LightAliasTable.h"
 #include "renderer/RayType.h"
 #include "renderer/helpers/samplers.h"
 #include "renderer/helpers/random.h"
@@ -42,8 +43,11 @@ using namespace optix;
 
 rtDeclareVariable(rtObject, sceneRootObject, , );
 rtDeclareVariable(Sphere,   sceneBoundingSphere, , );
-rtBuffer<RandomState, 2> randomStates;
+rtDeclareVariable(uint, randomSeed, , );
+rtDeclareVariable(uint, randomIterationNumber, , );
+rtDeclareVariable(uint, sampler, , );
 rtBuffer<Light, 1> lights;
+rtDeclareVariable(int, lightAliasTableBufferId, , );         // <LightAliasEntry, 1>
 rtDeclareVariable(uint2, launchIndex, rtLaunchIndex, );
 rtDeclareVariable(uint2, launchDim, rtLaunchDim, );
 rtDeclareVariable(uint,  localIterationNumber, , );
@@ -84,8 +88,6 @@ RT_PROGRAM void lightPass()
         lightRay.origin = lightPrd.origin;
         lightRay.direction = lightPrd.direction;
     }
-
-    randomStates[launchIndex] = lightPrd.randomState;
 }
 
 
@@ -127,7 +129,8 @@ RT_FUNCTION void initLightPayload(SubpathPRD & aLightPrd)
     aLightPrd.dVCM = 0.f;
     aLightPrd.done = false;
     aLightPrd.isSpecularPath = true;
-    aLightPrd.randomState = randomStates[launchIndex];
+    aLightPrd.randomState = createRandomState(randomSeed, randomIterationNumber, aLightPrd.launchIndex1D, RandomStream::VCM_LIGHT,
+        sampler);
 
     float *pVertPickPdf = NULL;
 #if VCM_UNIFORM_VERTEX_SAMPLING
@@ -135,16 +138,16 @@ RT_FUNCTION void initLightPayload(SubpathPRD & aLightPrd)
     pVertPickPdf = &vertexPickPdf;
 #endif
 
-    // vmarz TODO: pick based on light power
+    // Pick a light proportional to its power
     int lightIndex = 0;
+    float lightPickPdf = 1.f;
     if (1 < lights.size())
     {
         float sample = getRandomUniformFloat(&aLightPrd.randomState);
-        lightIndex = intmin((int)(sample*lights.size()), int(lights.size()-1));
+        lightIndex = sampleLightAliasTable(rtBufferId<LightAliasEntry, 1>(lightAliasTableBufferId), sample, lightPickPdf);
     }
 
-    const Light light        = lights[lightIndex];
-    const float lightPickPdf = 1.f / lights.size();
+    const Light light = lights[lightIndex];
 
     float emissionPdfW;
     float directPdfW;
@@ -12,16 +12,9 @@
 //#define OPTIX_PRINTFI_DEF
 //#define OPTIX_PRINTFID_DEF
 
-#include <optix.h>
-#include <optix_device.h>
 #include <optixu/optixu_math_namespace.h>
-#include "renderer/RayType.h"
-#include "renderer/ShadowPRD.h"
-#include "renderer/helpers/samplers.h"
-#include "renderer/helpers/random.h"
-#include "renderer/helpers/light.h"
 #include "renderer/Light.h"
-#include "renderer/Camera.h"
+#include "renderer/BxDF.h"
 #include "renderer/helpers/helpers.h"
 #include "renderer/vcm/SubpathPRD.h"
 #include "renderer/vcm/config_vcm.h"
@@ -32,7 +25,7 @@
 #define OPTIX_PRINTFID_ENABLED 0
 
 // Initialize light payload partial MIS terms  [tech. rep. (31)-(33)]
-RT_FUNCTION void initLightMisTerms(SubpathPRD & aLightPrd, const Light & aLight, const float aCostAtLight,
+__host__ RT_FUNCTION void initLightMisTerms(SubpathPRD & aLightPrd, const Light & aLight, const float aCostAtLight,
                                     const float aDirectPdfW, const float aEmissionPdfW,
                                     const float misVcWeightFactor, const float const * aVertexPickPdf = NULL)
 {
@@ -44,7 +37,7 @@ RT_FUNCTION void initLightMisTerms(SubpathPRD & aLightPrd, const Light & aLight,
     // dVCM_1 = p0_connect / ( p0_trace * p1 )
     //    connect/trace refer to potentially potentially different techniques for sampling points depending if point is 
     //    used to connect to a subpath or as a starting point of a new one
-    // directPdfW = p0_connect = areaSamplePdfA * lightPickPdf
+    // directPdfW = p0_connect = areaSamplePdfA * lightPickPdf, lightPickPdf from the light alias table
     // emissionPdfW = p0_trace * p1
     //    p0_trace = areaSamplePdf * lightPickPdf
     //    p1 = directionSamplePdfW * g1 = (cos / Pi) * g1 [g1 added after tracing]
@@ -80,7 +73,7 @@ RT_FUNCTION void initLightMisTerms(SubpathPRD & aLightPrd, const Light & aLight,
 
 
 // Initialize camera payload partial MIS terms [tech. rep. (31)-(33)]
-RT_FUNCTION void initCameraMisTerms(SubpathPRD & aCameraPrd, const float aCameraPdfW, const optix::uint aVcmLightSubpathCount)
+__host__ RT_FUNCTION void initCameraMisTerms(SubpathPRD & aCameraPrd, const float aCameraPdfW, const optix::uint aVcmLightSubpathCount)
 {
     // Initialize sub-path MIS quantities, partially [tech. rep. (31)-(33)]
     aCameraPrd.dVC = .0f;
@@ -106,7 +99,7 @@ RT_FUNCTION void initCameraMisTerms(SubpathPRD & aCameraPrd, const float aCamera
 
 // Update MIS quantities before storing at the vertex, follows initialization on light [tech. rep. (31)-(33)]
 // or scatter from surface [tech. rep. (34)-(36)]
-RT_FUNCTION void updateMisTermsOnHit(SubpathPRD & aLightPrd, const float aCosThetaIn, const float aRayLen)
+__host__ RT_FUNCTION void updateMisTermsOnHit(SubpathPRD & aLightPrd, const float aCosThetaIn, const float aRayLen)
 {
     // infinite lights potentially need additional handling here if MIS handled via solid angle integration [tech. rep. Section 5.1]
 
@@ -130,7 +123,7 @@ RT_FUNCTION void updateMisTermsOnHit(SubpathPRD & aLightPrd, const float aCosThe
 //%__cuda_local_var_528573_11_non_const_bsdfDirPdfW.4 = phi float [ %__cuda_local_var_528573_11_non_const_bsdfDirPdfW.1609, %568 ], [ %580, %578 ], [ %__cuda_local_var_528573_11_non_const_bsdfDirPdfW.1609, %568 ], !dbg !515
 
 // Initializes MIS terms for next event, partial implementation of [tech. rep. (34)-(36)], completed on hit
-RT_FUNCTION void updateMisTermsOnScatter(SubpathPRD & aPathPrd, const float & aCosThetaOut, const float & aBsdfDirPdfW,
+__host__ RT_FUNCTION void updateMisTermsOnScatter(SubpathPRD & aPathPrd, const float & aCosThetaOut, const float & aBsdfDirPdfW,
                                          const float & aBsdfRevPdfW, const float & aMisVcWeightFactor, const float & aMisVmWeightFactor,
                                          BxDF::Type aSampledEvent, const float const * aVertexPickPdf = NULL)
 {
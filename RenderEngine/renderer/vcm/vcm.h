@@ -24,9 +24,12 @@
 #include "renderer/helpers/random.h"
 #include "renderer/helpers/light.h"
 #include "renderer/Light.h"
+#include "renderer/LightAliasTable.h"
 #include "renderer/Camera.h"
 #include "renderer/BSDF.h"
 #include "renderer/vcm/LightVertex.h"
+#include "renderer/vcm/LightVertexGrid.h"
+#include "renderer/ppm/PhotonGrid.h"
 #include "renderer/vcm/SubpathPRD.h"
 #include "renderer/vcm/config_vcm.h"
 #include "renderer/vcm/mis.h"
@@ -138,13 +141,13 @@ RT_FUNCTION void connectCameraT1( const rtObject        & aSceneRootObject,
     // wLight also needs to account for different image point sampling techniques that could be used when 
     // generating (p0trace) or when connecting to camera (p0connect). In our case both p0connect and p0trace 
     // are imageSamplePdfA and cancel out
-    const float wLight = vcmMis(lightHitpointRevPdfA / aLightSubpathCount) * // * p0connect/p0trace *
-        (aMisVmWeightFactor + aLightPrd.dVCM + aLightPrd.dVC * vcmMis(bsdfRevPdfW));
+    const float wLight = vcmConnectionPartialMisWeight(lightHitpointRevPdfA / aLightSubpathCount, // * p0connect/p0trace
+        aLightPrd.dVCM, aLightPrd.dVC, bsdfRevPdfW, aMisVmWeightFactor);
 
     // Partial eye sub-path weight is 0 [tech. rep. (47)]
 
     // Full path MIS weight [tech. rep. (37)]. No MIS for traditional light tracing.
-    const float misWeight = 1.f / (wLight + 1.f);
+    const float misWeight = vcmMisWeight(wLight, 0.f);
 
     // Pixel integral is over image plane area, hence we need to convert invert cameraPdfA to get
     // image area pdf. cameraPdfA is imageSamplePdf converted to represent possibility to sample point aLightHitpoint
@@ -205,6 +208,58 @@ RT_FUNCTION void sampleScattering( SubpathPRD                   & aSubpathPrd,
 
 
 
+// Packs a light vertex BSDF into the light vertex, only Lambertian and Phong BxDFs are kept since vertices are not
+// stored on specular surfaces
+RT_FUNCTION void packLightVertexBsdf( LightVertex & aLightVertex, const VcmBSDF & aLightBsdf, const optix::uint aPathLen )
+{
+    using namespace optix;
+
+    LightVertexMaterial material;
+    material.normal = aLightBsdf.differentialGeometry().normal;
+    material.dirFix = aLightBsdf.worldDirFix();
+    material.bxdfs = 0;
+    material.diffuseReflectance = make_float3(0.f);
+    material.glossyReflectance = make_float3(0.f);
+    material.glossyExponent = 0.f;
+    for (unsigned int i = 0; i < aLightBsdf.nBxDFs(); ++i)
+    {
+        const BxDF * bxdf = aLightBsdf.bxdfAt(i);
+        if (bxdf->tag() == BxDFTag<Lambertian>::value)
+        {
+            material.bxdfs |= LightVertexBxDF::LAMBERTIAN;
+            material.diffuseReflectance = static_cast<const Lambertian *>(bxdf)->_reflectance;
+        }
+        else if (bxdf->tag() == BxDFTag<Phong>::value)
+        {
+            const Phong * phong = static_cast<const Phong *>(bxdf);
+            material.bxdfs |= LightVertexBxDF::PHONG;
+            material.glossyReflectance = phong->_reflectance;
+            material.glossyExponent = phong->_exponent;
+        }
+    }
+    packLightVertexMaterial(aLightVertex, material, aPathLen);
+}
+
+// Rebuilds the BSDF of a stored light vertex, Lambertian before Phong as the materials add them
+RT_FUNCTION VcmBSDF unpackLightVertexBsdf( const LightVertex & aLightVertex )
+{
+    LightVertexMaterial material = unpackLightVertexMaterial(aLightVertex);
+    VcmBSDF lightBsdf = VcmBSDF(material.normal, material.dirFix, true);
+    if (material.bxdfs & LightVertexBxDF::LAMBERTIAN)
+    {
+        Lambertian lambertian(material.diffuseReflectance);
+        lightBsdf.AddBxDF(&lambertian);
+    }
+    if (material.bxdfs & LightVertexBxDF::PHONG)
+    {
+        Phong phong(material.glossyReflectance, material.glossyExponent);
+        lightBsdf.AddBxDF(&phong);
+    }
+    return lightBsdf;
+}
+
+
+
 #define OPTIX_PRINTFID_ENABLED 0
 #define OPTIX_PRINTFCID_ENABLED 0
 RT_FUNCTION void lightHit( const rtObject               & aSceneRootObject,
@@ -223,7 +278,7 @@ RT_FUNCTION void lightHit( const rtObject               & aSceneRootObject,
                            const optix::float2            aPixelSizeFactor,
                            rtBufferId<float3, 2>          aOutputBuffer,
                            rtBufferId<LightVertex, 1>     aLightVertexBuffer,
-                           rtBufferId<optix::uint, 1>     aLightVertexBufferIndexBuffer,
+                           rtBufferId<optix::uint, 1>     aLightSubpathVertexOffsetBuffer,
                            rtBufferId<optix::uint, 1>     aLightSubpathVertexCountBuffer,
 #if !VCM_UNIFORM_VERTEX_SAMPLING                         // for 1 to 1 camera - light path connections
                            rtBufferId<optix::uint, 2>     aLightSubpathVertexIndexBuffer
@@ -256,16 +311,30 @@ RT_FUNCTION void lightHit( const rtObject               & aSceneRootObject,
     if (!isBsdfSpecular)
     {
         // vertex count can be lower that path length since not stored on specular surfaces
-        uint currPathVertIdx = aLightSubpathVertexCountBuffer[aLightPrd.launchIndex1D]++;
-        
+        uint currPathVertIdx = aLightSubpathVertexCountBuffer[aLightPrd.launchIndex1D];
+
+        // The count pass only counts. The store pass traces the same subpath, its vertices go to the slots from the
+        // offset of the subpath in the packed cache (exclusive scan of the counts) up to the offset of the next one.
+        uint vertIdx = 0;
+        bool storeVertex = false;
+        if (aLightVertexCountEstimatePass)
+        {
+            aLightSubpathVertexCountBuffer[aLightPrd.launchIndex1D] = currPathVertIdx + 1;
+        }
+        else
+        {
+            vertIdx = aLightSubpathVertexOffsetBuffer[aLightPrd.launchIndex1D] + currPathVertIdx;
+            storeVertex = vertIdx < aLightSubpathVertexOffsetBuffer[aLightPrd.launchIndex1D + 1];
+            if (storeVertex)
+                aLightSubpathVertexCountBuffer[aLightPrd.launchIndex1D] = currPathVertIdx + 1;
+        }
+
         // store path vertex
-        if (!aLightVertexCountEstimatePass)
+        if (storeVertex)
         {
             LightVertex lightVertex;
-            lightVertex.launchIndex = aLightPrd.launchIndex;
             lightVertex.hitPoint = aHitPoint;
             lightVertex.throughput = aLightPrd.throughput;
-            lightVertex.pathLen = aLightPrd.depth;
             lightVertex.dVCM = aLightPrd.dVCM;
             lightVertex.dVC = aLightPrd.dVC;
             lightVertex.dVM = aLightPrd.dVM;
@@ -275,10 +344,9 @@ RT_FUNCTION void lightHit( const rtObject               & aSceneRootObject,
             // and do not affect connection to camera/light source and dVC is not present in weight equation for VM.
             // equations in [tech. rep. (38-47)]
 #endif
-            lightVertex.bsdf = aLightBsdf;
+            packLightVertexBsdf(lightVertex, aLightBsdf, aLightPrd.depth);
 
             // Store in buffer
-            uint vertIdx = atomicAdd(&aLightVertexBufferIndexBuffer[0], 1u);
             aLightVertexBuffer[vertIdx] = lightVertex;
 
 #if !VCM_UNIFORM_VERTEX_SAMPLING
@@ -343,14 +411,15 @@ RT_FUNCTION void connectVertices( const rtObject        & aSceneRootObject,
     cameraBsdfRevPdfW *= cameraCont;
 
     // Evaluate BSDF at light vertex
+    const VcmBSDF lightBsdf = unpackLightVertexBsdf(aLightVertex);
     float lightCosTheta, lightBsdfDirPdfW, lightBsdfRevPdfW;
-    const float3 lightBsdfFactor = aLightVertex.bsdf.vcmF(-direction, lightCosTheta, &lightBsdfDirPdfW, &lightBsdfRevPdfW);
+    const float3 lightBsdfFactor = lightBsdf.vcmF(-direction, lightCosTheta, &lightBsdfDirPdfW, &lightBsdfRevPdfW);
     
     if (isZero(lightBsdfFactor))
         return;
 
     // Add camera continuation probability (for russian roulette)
-    const float lightCont = aLightVertex.bsdf.continuationProb();
+    const float lightCont = lightBsdf.continuationProb();
     lightBsdfDirPdfW *= lightCont;
     lightBsdfRevPdfW *= lightCont;
 
@@ -376,18 +445,18 @@ RT_FUNCTION void connectVertices( const rtObject        & aSceneRootObject,
 #endif
 
     // Partial light sub-path MIS weight [tech. rep. (40)]
-    const float wLight = vcmMis(cameraBsdfDirPdfA) * 
-        ( aMisVmWeightFactor * invVertPickPdf + aLightVertex.dVCM + aLightVertex.dVC * vcmMis(lightBsdfRevPdfW) );
+    const float wLight = vcmConnectionPartialMisWeight(cameraBsdfDirPdfA, aLightVertex.dVCM, aLightVertex.dVC,
+        lightBsdfRevPdfW, aMisVmWeightFactor * invVertPickPdf);
     // lightBsdfRevPdfW is Reverse with respect to light path, e.g. in eye path progression 
     // dirrection (note same arrow dirs in formula)
     // note (40) and (41) uses light subpath Y and camera subpath z;
 
     // Partial eye sub-path MIS weight [tech. rep. (41)]
-    const float wCamera = vcmMis(lightBsdfDirPdfA) * 
-        ( aMisVmWeightFactor * invVertPickPdf + aCameraPrd.dVCM + aCameraPrd_dVC * vcmMis(cameraBsdfRevPdfW) );
+    const float wCamera = vcmConnectionPartialMisWeight(lightBsdfDirPdfA, aCameraPrd.dVCM, aCameraPrd_dVC,
+        cameraBsdfRevPdfW, aMisVmWeightFactor * invVertPickPdf);
 
     // Full path MIS weight [tech. rep. (37)]
-    const float misWeight = 1.f / (wLight + 1.f + wCamera);
+    const float misWeight = vcmMisWeight(wLight, wCamera);
 
     float3 contrib = geometryTerm * cameraBsdfFactor * lightBsdfFactor * invVertPickPdf;
     contrib *= misWeight * aCameraPrd.throughput * aLightVertex.throughput;
@@ -406,6 +475,7 @@ RT_FUNCTION void connectVertices( const rtObject        & aSceneRootObject,
 RT_FUNCTION void connectLightSourceS1( const rtObject             & aSceneRootObject,
                                        const Sphere               & aSceneBoundingSphere,
                                        const rtBufferId<Light, 1>   aLightsBuffer,
+                                       const rtBufferId<LightAliasEntry, 1> aLightAliasTable,
                                        SubpathPRD                 & aCameraPrd,
                                        const VcmBSDF              & aCameraBsdf,
                                        const optix::float3        & aCameraHitpoint,
@@ -414,16 +484,16 @@ RT_FUNCTION void connectLightSourceS1( const rtObject             & aSceneRootOb
 {
     using namespace optix;
 
+    // Pick a light proportional to its power
     int lightIndex = 0;
+    float lightPickProb = 1.f;
     if (1 < aLightsBuffer.size())
     {
         float sample = getRandomUniformFloat(&aCameraPrd.randomState);
-        lightIndex = intmin((int)(sample*aLightsBuffer.size()), int(aLightsBuffer.size()-1));
+        lightIndex = sampleLightAliasTable(aLightAliasTable, sample, lightPickProb);
     }
 
-    const Light light               = aLightsBuffer[lightIndex];
-    const float inverseLightPickPdf = aLightsBuffer.size();
-    const float lightPickProb        = 1.f / aLightsBuffer.size();
+    const Light light = aLightsBuffer[lightIndex];
 
     float emissionPdfW;
     float directPdfW;
@@ -453,7 +523,7 @@ RT_FUNCTION void connectLightSourceS1( const rtObject             & aSceneRootOb
     // light source, their distance^2 and cosine terms cancel out.
     // Therefore we can write wLight as a ratio of solid angle pdfs,
     // both expressed w.r.t. the same shading point.
-    const float wLight = vcmMis(bsdfDirPdfW / (lightPickProb * directPdfW));
+    const float wLight = vcmLightSampleMisWeight(bsdfDirPdfW, lightPickProb * directPdfW);
 
     // Comment from SmallVCM
     // Partial eye sub-path MIS weight [tech. rep. (45)].
@@ -471,11 +541,11 @@ RT_FUNCTION void connectLightSourceS1( const rtObject             & aSceneRootOb
     //
     // Also note that both emissionPdfW and directPdfW should be
     // multiplied by lightPickProb, so it cancels out.
-    const float wCamera = vcmMis(emissionPdfW * cosToLight / (directPdfW * cosAtLight)) *
-        (aMisVmWeightFactor + aCameraPrd.dVCM + aCameraPrd.dVC * vcmMis(bsdfRevPdfW));
+    const float wCamera = vcmConnectionPartialMisWeight(emissionPdfW * cosToLight / (directPdfW * cosAtLight),
+        aCameraPrd.dVCM, aCameraPrd.dVC, bsdfRevPdfW, aMisVmWeightFactor);
 
     // Full path MIS weight [tech. rep. (37)]
-    const float misWeight = 1.f / (wLight + 1.f + wCamera);
+    const float misWeight = vcmMisWeight(wLight, wCamera);
     float3 contrib = (misWeight * cosToLight / (lightPickProb * directPdfW)) * (radiance * bsdfFactor);
 
     if (isZero(contrib))
@@ -512,17 +582,95 @@ RT_FUNCTION void connectLightSourceS0(SubpathPRD & aCameraPrd, const optix::floa
 
     // Partial eye sub-path MIS weight [tech. rep. (43)].
     // If the last hit was specular, then dVCM == 0.
-    const float wCamera = vcmMis(aDirectPdfA) * aCameraPrd.dVCM + vcmMis(aEmissionPdfW * aCameraPrd.dVC);
+    const float wCamera = vcmLightHitPartialMisWeight(aDirectPdfA, aEmissionPdfW, aCameraPrd.dVCM, aCameraPrd.dVC);
     // Partial light sub-path weight is 0 [tech. rep. (42)].
 
     // Full path MIS weight [tech. rep. (37)].
-    const float misWeight = 1.f / (1.f + wCamera);
+    const float misWeight = vcmMisWeight(0.f, wCamera);
 
     aCameraPrd.color += aCameraPrd.throughput * misWeight * aRadiance;
 }
 
 
 
+#define OPTIX_PRINTFID_ENABLED 0
+// Merges camera subpath vertex with the light vertices within the merging radius, e.g. photon density estimation
+// weighted against the other techniques [tech. rep. (38)-(39)]
+RT_FUNCTION void mergeVertices( const LightVertexGrid             & aGrid,
+                                const rtBufferId<LightVertex, 1>    aLightVertexBuffer,
+                                SubpathPRD                        & aCameraPrd,
+                                const VcmBSDF                     & aCameraBsdf,
+                                const optix::float3               & aCameraHitpoint,
+                                const optix::uint                   aMaxPathLen,
+                                const float                         aMisVcWeightFactor,
+                                const float                         aVmNormalizationFactor )
+{
+    using namespace optix;
+
+    rtBufferId<uint, 1> vertexIndices = rtBufferId<uint, 1>(aGrid.vertexIndexBufferId);
+    rtBufferId<uint, 1> cellOffsets   = rtBufferId<uint, 1>(aGrid.cellOffsetBufferId);
+    rtBufferId<uint, 1> table         = rtBufferId<uint, 1>(aGrid.tableBufferId);
+    rtBufferId<uint2, 1> cellKeys     = rtBufferId<uint2, 1>(aGrid.cellKeyBufferId);
+
+    // Cells overlapped by the merging radius, clamped to the grid
+    const float radius = aGrid.cellSize;
+    const float invCellSize = 1.f / aGrid.cellSize;
+    const float3 position = aCameraHitpoint - aGrid.worldOrigo;
+    uint3 lo, hi;
+    lo.x = (uint)max(0, (int)((position.x - radius) * invCellSize));
+    lo.y = (uint)max(0, (int)((position.y - radius) * invCellSize));
+    lo.z = (uint)max(0, (int)((position.z - radius) * invCellSize));
+    hi.x = (uint)min((int)aGrid.gridSize.x - 1, (int)((position.x + radius) * invCellSize));
+    hi.y = (uint)min((int)aGrid.gridSize.y - 1, (int)((position.y + radius) * invCellSize));
+    hi.z = (uint)min((int)aGrid.gridSize.z - 1, (int)((position.z + radius) * invCellSize));
+    if (hi.x < lo.x || hi.y < lo.y || hi.z < lo.z)
+        return;
+
+    float3 contrib = make_float3(0.f);
+    for (uint z = lo.z; z <= hi.z; z++)
+    {
+        for (uint y = lo.y; y <= hi.y; y++)
+        {
+            // Non-empty cells of a row are consecutive in the sorted cells
+            uint first, last;
+            if (!findHashedGridRowCells(table, cellKeys, aGrid.tableMask, lo.x, hi.x, y, z, first, last))
+                continue;
+
+            for (uint i = cellOffsets[first]; i < cellOffsets[last+1]; i++)
+            {
+                const LightVertex & lightVertex = aLightVertexBuffer[vertexIndices[i]];
+                if (aMaxPathLen < getLightVertexPathLen(lightVertex) + aCameraPrd.depth)
+                    continue;
+
+                const float3 diff = lightVertex.hitPoint - aCameraHitpoint;
+                if (aGrid.radiusSquared < dot(diff, diff))
+                    continue;
+
+                // Evaluate camera BSDF in the direction the light vertex was reached from
+                const float3 lightDirection = getLightVertexDirFix(lightVertex);
+                float cameraCosTheta, cameraBsdfDirPdfW, cameraBsdfRevPdfW;
+                const float3 cameraBsdfFactor = aCameraBsdf.vcmF(lightDirection, cameraCosTheta, &cameraBsdfDirPdfW,
+                    &cameraBsdfRevPdfW);
+
+                if (isZero(cameraBsdfFactor))
+                    continue;
+
+                cameraBsdfDirPdfW *= aCameraBsdf.continuationProb();
+                cameraBsdfRevPdfW *= unpackLightVertexBsdf(lightVertex).continuationProb();
+
+                const float misWeight = vcmMergingMisWeight(lightVertex.dVCM, lightVertex.dVM, aCameraPrd.dVCM,
+                    aCameraPrd.dVM, cameraBsdfDirPdfW, cameraBsdfRevPdfW, aMisVcWeightFactor);
+
+                contrib += misWeight * cameraBsdfFactor * lightVertex.throughput;
+            }
+        }
+    }
+
+    aCameraPrd.color += aCameraPrd.throughput * aVmNormalizationFactor * contrib;
+}
+
+
+
 #define OPTIX_PRINTFID_ENABLED 0
 RT_FUNCTION void cameraHit( const rtObject                     & aSceneRootObject,
                             const Sphere                       & aSceneBoundingSphere,
@@ -536,10 +684,13 @@ RT_FUNCTION void cameraHit( const rtObject                     & aSceneRootObjec
                             const optix::uint                    aLightSubpathCount,
                             const float                          aMisVcWeightFactor,
                             const float                          aMisVmWeightFactor,
+                            const float                          aVmNormalizationFactor,
                             const rtBufferId<Light, 1>           aLightsBuffer,
+                            const rtBufferId<LightAliasEntry, 1> aLightAliasTable,
                             const rtBufferId<LightVertex>        aLightVertexBuffer,
                             const rtBufferId<optix::uint>        aLightVertexBufferIndexBuffer,
                             const rtBufferId<optix::uint>        aLightSubpathVertexCountBuffer,
+                            const LightVertexGrid              & aLightVertexGrid,
 #if !VCM_UNIFORM_VERTEX_SAMPLING                                // for 1 to 1 camera - light path connections
                             const rtBufferId<optix::uint, 2>     aLightSubpathVertexIndexBuffer
 #else                                                           // uniform vertex sampling
@@ -573,7 +724,7 @@ RT_FUNCTION void cameraHit( const rtObject                     & aSceneRootObjec
     if (!isBsdfSpecular)
     {
         // Connect by sampling a vetex on light source, e.g. light path length = 1
-        connectLightSourceS1(aSceneRootObject, aSceneBoundingSphere, aLightsBuffer, aCameraPrd, aCameraBsdf, aHitPoint, aMisVmWeightFactor);
+        connectLightSourceS1(aSceneRootObject, aSceneBoundingSphere, aLightsBuffer, aLightAliasTable, aCameraPrd, aCameraBsdf, aHitPoint, aMisVmWeightFactor);
     }
 #endif
     
@@ -617,6 +768,13 @@ RT_FUNCTION void cameraHit( const rtObject                     & aSceneRootObjec
 #endif
     }
 
+    // Merge with light vertices
+    if (!isBsdfSpecular && 0 < aLightVertexGrid.numCells)
+    {
+        mergeVertices(aLightVertexGrid, aLightVertexBuffer, aCameraPrd, aCameraBsdf, aHitPoint, aMaxPathLen,
+                      aMisVcWeightFactor, aVmNormalizationFactor);
+    }
+
     // Terminate if path too long for connections and merging
     if (aMaxPathLen <= aCameraPrd.depth)
     {
@@ -14,4 +14,51 @@ static __host__ RT_FUNCTION float vcmMis(const float & aPdf)
 {
     // balance heuristic for now
     return aPdf;
+}
+
+// Full path MIS weight from the partial light and eye sub-path weights [tech. rep. (37)]
+static __host__ RT_FUNCTION float vcmMisWeight(const float aWLight, const float aWCamera)
+{
+    return 1.f / (aWLight + 1.f + aWCamera);
+}
+
+// Partial sub-path MIS weight of a connection at the end vertex of a light or camera sub-path with at least one scatter
+// [tech. rep. (40)-(41), (45)-(46)]. aEndVertexPdfA is the area pdf of the other sub-path sampling the end vertex,
+// aRevPdfW the pdf of the end vertex BSDF sampling the vertex before it, reverse to the sub-path.
+static __host__ RT_FUNCTION float vcmConnectionPartialMisWeight(const float aEndVertexPdfA, const float aDVCM,
+                                                                const float aDVC, const float aRevPdfW,
+                                                                const float aMisVmWeightFactor)
+{
+    return vcmMis(aEndVertexPdfA) * (aMisVmWeightFactor + aDVCM + aDVC * vcmMis(aRevPdfW));
+}
+
+// Partial light sub-path MIS weight of a connection to a light source [tech. rep. (44)], the ratio of the camera BSDF pdf
+// and the light sample pdf of the light point, both as solid angle pdfs w.r.t. the shading point
+static __host__ RT_FUNCTION float vcmLightSampleMisWeight(const float aBsdfDirPdfW, const float aDirectPdfW)
+{
+    return vcmMis(aBsdfDirPdfW / aDirectPdfW);
+}
+
+// Partial eye sub-path MIS weight of a camera sub-path that hit a light [tech. rep. (43)], aDirectPdfA and aEmissionPdfW
+// including the light pick probability
+static __host__ RT_FUNCTION float vcmLightHitPartialMisWeight(const float aDirectPdfA, const float aEmissionPdfW,
+                                                              const float aDVCM, const float aDVC)
+{
+    return vcmMis(aDirectPdfA) * aDVCM + vcmMis(aEmissionPdfW * aDVC);
+}
+
+// Full path MIS weight of merging a camera subpath vertex with a light vertex [tech. rep. (38)-(39)].
+// aCameraBsdfDirPdfW is the camera BSDF pdf of sampling the direction the light vertex was reached from,
+// aCameraBsdfRevPdfW the pdf of the reverse direction with the continuation probability of the light vertex BSDF,
+// which would govern it had the light subpath continued.
+static __host__ RT_FUNCTION float vcmMergingMisWeight(const float aLightDVCM, const float aLightDVM, const float aCameraDVCM,
+                                                      const float aCameraDVM, const float aCameraBsdfDirPdfW,
+                                                      const float aCameraBsdfRevPdfW, const float aMisVcWeightFactor)
+{
+    // Partial light sub-path MIS weight [tech. rep. (38)]
+    const float wLight = aLightDVCM * aMisVcWeightFactor + aLightDVM * vcmMis(aCameraBsdfDirPdfW);
+    // Partial eye sub-path MIS weight [tech. rep. (39)]
+    const float wCamera = aCameraDVCM * aMisVcWeightFactor + aCameraDVM * vcmMis(aCameraBsdfRevPdfW);
+    // Full path MIS weight [tech. rep. (37)]
+    return vcmMisWeight(wLight, wCamera);
 }
\ No newline at end of file
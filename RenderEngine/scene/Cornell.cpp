@@ -16,6 +16,8 @@
 #include "material/ParticipatingMedium.h"
 #include "material/Mirror.h"
 #include "material/DiffuseEmitter.h"
+#include "SceneGeometryBuilder.h"
+#include "HostSceneGeometry.h"
 
 Cornell::Cornell(void)
 {
@@ -30,124 +32,99 @@ Cornell::Cornell(void)
 	m_sceneAABB.max = Vector3(556.0f, 548.85f, 559.2f) + 5;
 }
 
-optix::GeometryInstance Cornell::createParallelogram(
-	unsigned int meshId,
-	optix::Context & context,
-	const optix::float3& anchor,
-	const optix::float3& offset1,
-	const optix::float3& offset2,
-	Material & material)
+optix::Group Cornell::getSceneRootGroup(optix::Context & context)
 {
-	optix::Geometry parallelogram = context->createGeometry();
-	parallelogram->setPrimitiveCount( 1u );
-	parallelogram->setIntersectionProgram( m_pgram_intersection );
-	parallelogram->setBoundingBoxProgram( m_pgram_bounding_box );
-
-	optix::float3 normal = optix::normalize( optix::cross( offset1, offset2 ) );
-	float d = optix::dot( normal, anchor );
-	optix::float4 plane = optix::make_float4( normal, d );
-
-	optix::float3 v1 = offset1 / optix::dot( offset1, offset1 );
-	optix::float3 v2 = offset2 / optix::dot( offset2, offset2 );
-
-	parallelogram["meshId"]->setUint(meshId);
-	parallelogram["plane"]->setFloat( plane );
-	parallelogram["anchor"]->setFloat( anchor );
-	parallelogram["v1"]->setFloat( v1 );
-	parallelogram["v2"]->setFloat( v2 );
-
-	optix::Material matl = material.getOptixMaterial(context);
-
-	optix::GeometryInstance gi = context->createGeometryInstance( parallelogram, &matl, &matl+1 );
-	material.registerGeometryInstanceValues(gi);
-	return gi;
+	OptixSceneGeometryBuilder builder(context);
+	buildScene(builder);
+	return builder.createSceneRootGroup();
 }
 
-optix::Group Cornell::getSceneRootGroup(optix::Context & context)
+void Cornell::getHostSceneGeometry(HostSceneGeometry & geometry) const
 {
-	m_pgram_bounding_box = context->createProgramFromPTXFile( "parallelogram.cu.ptx", "bounds" );
-	m_pgram_intersection = context->createProgramFromPTXFile( "parallelogram.cu.ptx", "intersect" );
-
-	// create geometry instances
-	QVector<optix::GeometryInstance> gis;
+	geometry.clear();
+	HostSceneGeometryBuilder builder(geometry);
+	buildScene(builder);
+}
 
+void Cornell::buildScene(SceneGeometryBuilder & builder) const
+{
 	Diffuse diffuseWhite = Diffuse(optix::make_float3( 0.8f ));
 	Diffuse diffuseGreen = Diffuse(optix::make_float3( 0.05f, 0.8f, 0.05f ));
 	Diffuse diffuseRed = Diffuse(optix::make_float3( 1.f, 0.05f, 0.05f ));
 
 	// Floor
-	gis.push_back( createParallelogram(0, context, optix::make_float3( 0.0f, 0.0f, 0.0f ),
+	builder.addParallelogram(0, optix::make_float3( 0.0f, 0.0f, 0.0f ),
 		optix::make_float3( 0.0f, 0.0f, 559.2f ),
 		optix::make_float3( 556.0f, 0.0f, 0.0f ),
-		diffuseWhite ) );
+		diffuseWhite );
 
 	// Ceiling
-	gis.push_back( createParallelogram(1, context, optix::make_float3( 0.0f, 548.80f, 0.0f ),
+	builder.addParallelogram(1, optix::make_float3( 0.0f, 548.80f, 0.0f ),
 		optix::make_float3( 556.0f, 0.0f, 0.0f ),
 		optix::make_float3( 0.0f, 0.0f, 559.2f ),
-		diffuseWhite ) );
+		diffuseWhite );
 
 	// Back wall
-	gis.push_back( createParallelogram(2, context,optix::make_float3( 0.0f, 0.0f, 559.2f),
+	builder.addParallelogram(2, optix::make_float3( 0.0f, 0.0f, 559.2f),
 		optix::make_float3( 0.0f, 548.8f, 0.0f),
 		optix::make_float3( 556.0f, 0.0f, 0.0f),
-		diffuseWhite));
+		diffuseWhite);
 
 	// Right wall
-	gis.push_back( createParallelogram(3, context, optix::make_float3( 0.0f, 0.0f, 0.0f ),
+	builder.addParallelogram(3, optix::make_float3( 0.0f, 0.0f, 0.0f ),
 		optix::make_float3( 0.0f, 548.8f, 0.0f ),
 		optix::make_float3( 0.0f, 0.0f, 559.2f ),
-		diffuseGreen ) );
+		diffuseGreen );
 
 	// Left wall
-	gis.push_back( createParallelogram(4, context, optix::make_float3( 556.0f, 0.0f, 0.0f ),
+	builder.addParallelogram(4, optix::make_float3( 556.0f, 0.0f, 0.0f ),
 		optix::make_float3( 0.0f, 0.0f, 559.2f ),
 		optix::make_float3( 0.0f, 548.8f, 0.0f ),
-		diffuseRed ) );
+		diffuseRed );
 
 	//// Short block
-	//gis.push_back( createParallelogram(5, context, optix::make_float3( 130.0f, 165.0f, 65.0f),
+	//builder.addParallelogram(5, optix::make_float3( 130.0f, 165.0f, 65.0f),
 	//	optix::make_float3( -48.0f, 0.0f, 160.0f),
 	//	optix::make_float3( 160.0f, 0.0f, 49.0f),
-	//	diffuseWhite ) );
-	//gis.push_back( createParallelogram(6, context, optix::make_float3( 290.0f, 0.0f, 114.0f),
+	//	diffuseWhite );
+	//builder.addParallelogram(6, optix::make_float3( 290.0f, 0.0f, 114.0f),
 	//	optix::make_float3( 0.0f, 165.0f, 0.0f),
 	//	optix::make_float3( -50.0f, 0.0f, 158.0f),
-	//	diffuseWhite ) );
-	//gis.push_back( createParallelogram(7, context, optix::make_float3( 130.0f, 0.0f, 65.0f),
+	//	diffuseWhite );
+	//builder.addParallelogram(7, optix::make_float3( 130.0f, 0.0f, 65.0f),
 	//	optix::make_float3( 0.0f, 165.0f, 0.0f),
 	//	optix::make_float3( 160.0f, 0.0f, 49.0f),
-	//	diffuseWhite ) );
-	//gis.push_back( createParallelogram(8, context, optix::make_float3( 82.0f, 0.0f, 225.0f),
+	//	diffuseWhite );
+	//builder.addParallelogram(8, optix::make_float3( 82.0f, 0.0f, 225.0f),
 	//	optix::make_float3( 0.0f, 165.0f, 0.0f),
 	//	optix::make_float3( 48.0f, 0.0f, -160.0f),
-	//	diffuseWhite ) );
-	//gis.push_back( createParallelogram(9, context, optix::make_float3( 240.0f, 0.0f, 272.0f),
+	//	diffuseWhite );
+	//builder.addParallelogram(9, optix::make_float3( 240.0f, 0.0f, 272.0f),
 	//	optix::make_float3( 0.0f, 165.0f, 0.0f),
 	//	optix::make_float3( -158.0f, 0.0f, -47.0f),
-	//	diffuseWhite));
+	//	diffuseWhite);
 	//	
 	//// Tall block
-	//gis.push_back( createParallelogram(10, context, optix::make_float3( 423.0f, 340.0f, 247.0f),
+	//builder.addParallelogram(10, optix::make_float3( 423.0f, 340.0f, 247.0f),
 	//	optix::make_float3( -158.0f, 0.0f, 49.0f),
 	//	optix::make_float3( 49.0f, 0.0f, 159.0f),
-	//	diffuseWhite ) );
-	//gis.push_back( createParallelogram(11, context, optix::make_float3( 423.0f, 0.0f, 247.0f),
+	//	diffuseWhite );
+	//builder.addParallelogram(11, optix::make_float3( 423.0f, 0.0f, 247.0f),
 	//	optix::make_float3( 0.0f, 340.0f, 0.0f),
 	//	optix::make_float3( 49.0f, 0.0f, 159.0f),
-	//	diffuseWhite ) );
-	//gis.push_back( createParallelogram(12, context, optix::make_float3( 472.0f, 0.0f, 406.0f),
+	//	diffuseWhite );
+	//builder.addParallelogram(12, optix::make_float3( 472.0f, 0.0f, 406.0f),
 	//	optix::make_float3( 0.0f, 340.0f, 0.0f),
 	//	optix::make_float3( -158.0f, 0.0f, 50.0f),
-	//	diffuseWhite ) );
-	//gis.push_back( createParallelogram(13, context, optix::make_float3( 314.0f, 0.0f, 456.0f),
+	//	diffuseWhite );
+	//builder.addParallelogram(13, optix::make_float3( 314.0f, 0.0f, 456.0f),
 	//	optix::make_float3( 0.0f, 340.0f, 0.0f),
 	//	optix::make_float3( -49.0f, 0.0f, -160.0f),
-	//	diffuseWhite ) );
-	//gis.push_back( createParallelogram(14, context, optix::make_float3( 265.0f, 0.0f, 296.0f),
+	//	diffuseWhite );
+	//builder.addParallelogram(14, optix::make_float3( 265.0f, 0.0f, 296.0f),
 	//	optix::make_float3( 0.0f, 340.1f, 0.0f),
 	//	optix::make_float3( 158.0f, 0.0f, -49.0f),
-	//	diffuseWhite ) );
+	//	diffuseWhite );
 		
 	// Light
 
@@ -155,7 +132,7 @@ optix::Group Cornell::getSceneRootGroup(optix::Context & context)
 	emitter.setInverseArea(m_sceneLights[0].inverseArea);
 	for(int i = 0; i < m_sceneLights.size(); i++)
 	{
-		gis.push_back(createParallelogram(15 + i, context, m_sceneLights[i].position, m_sceneLights[i].v1, m_sceneLights[i].v2, emitter));
+		builder.addParallelogram(15 + i, m_sceneLights[i].position, m_sceneLights[i].v1, m_sceneLights[i].v2, emitter);
 	}
 
 	//Glass glass = Glass(1.5, optix::make_float3(1.f,1.f,1.f));
@@ -168,27 +145,9 @@ optix::Group Cornell::getSceneRootGroup(optix::Context & context)
 	ParticipatingMedium partmedium = ParticipatingMedium(0.001, 0.00);
 	AABInstance participatingMediumCube (partmedium, AAB(Vector3(-1), Vector3(556.0f, 548.85f, 559.2f)-1));
 	gis.push_back(participatingMediumCube.getOptixGeometryInstance(context));
-	SphereInstance sphere = SphereInstance(glass, Sphere(Vector3(250, 370, 250), 50));
-	gis.push_back(sphere.getOptixGeometryInstance(context));
+	builder.addSphere(Sphere(Vector3(250, 370, 250), 50), glass);
 #endif
-	SphereInstance sphere2 = SphereInstance(glass, Sphere(Vector3(450, 50, 300), 50));
-	gis.push_back(sphere2.getOptixGeometryInstance(context));*/
-
-	// Create geometry group
-	optix::GeometryGroup geometry_group = context->createGeometryGroup();
-	geometry_group->setChildCount( static_cast<unsigned int>( gis.size() ) );
-	for (int i = 0; i < gis.size(); ++i )
-		geometry_group->setChild( i, gis[i] );
-
-	geometry_group->setAcceleration(context->createAcceleration("NoAccel", "NoAccel")); // Bvh Sbvh Trbvh NoAccel
-
-	optix::Group gro = context->createGroup();
-	gro->setChildCount(1);
-	gro->setChild(0, geometry_group);
-	optix::Acceleration acceleration = context->createAcceleration("NoAccel", "NoAccel"); // Bvh BvhCompact NoAccel
-	gro->setAcceleration(acceleration);
-
-	return gro;
+	builder.addSphere(Sphere(Vector3(450, 50, 300), 50), glass);*/
 }
 
 const QVector<Light> & Cornell::getSceneLights(void) const
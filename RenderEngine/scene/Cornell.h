@@ -14,6 +14,7 @@
 
 
 class Material;
+class SceneGeometryBuilder;
 
 class Cornell : public IScene
 {
@@ -21,6 +22,7 @@ public:
     RENDER_ENGINE_EXPORT_API Cornell(void);
     RENDER_ENGINE_EXPORT_API virtual ~Cornell(void){}
     RENDER_ENGINE_EXPORT_API virtual optix::Group getSceneRootGroup(optix::Context & context);
+    RENDER_ENGINE_EXPORT_API virtual void getHostSceneGeometry(HostSceneGeometry & geometry) const;
     RENDER_ENGINE_EXPORT_API virtual const QVector<Light> & getSceneLights() const;
     RENDER_ENGINE_EXPORT_API virtual Camera getDefaultCamera(void) const;
     RENDER_ENGINE_EXPORT_API virtual const char* getSceneName() const;
@@ -32,18 +34,9 @@ public:
 private:
     optix::Material m_material;
     optix::Material m_glassMaterial;
-    optix::Program m_pgram_bounding_box;
-    optix::Program m_pgram_intersection;
     QVector<Light> m_sceneLights;
     AAB m_sceneAABB;
-    optix::GeometryInstance createParallelogram(
-		unsigned int meshId,
-		optix::Context & context,
-		const optix::float3& anchor,
-		const optix::float3& offset1,
-		const optix::float3& offset2,
-		Material & material
-	);
+    void buildScene(SceneGeometryBuilder & builder) const;
 
 };
 #endif
\ No newline at end of file
@@ -19,6 +19,8 @@
 #include "material/Mirror.h"
 #include "material/DiffuseEmitter.h"
 #include "material/Glossy.h"
+#include "SceneGeometryBuilder.h"
+#include "HostSceneGeometry.h"
 
 
 
@@ -76,48 +78,22 @@ void CornellSmall::initialize()
 //}
 
 
-optix::GeometryInstance CornellSmall::createParallelogram(
-    unsigned int meshId,
-    optix::Context & context,
-    const optix::float3& anchor,
-    const optix::float3& offset1,
-    const optix::float3& offset2,
-    Material & material)
+optix::Group CornellSmall::getSceneRootGroup(optix::Context & context)
 {
-    optix::Geometry parallelogram = context->createGeometry();
-    parallelogram->setPrimitiveCount( 1u );
-    parallelogram->setIntersectionProgram( m_pgram_intersection );
-    parallelogram->setBoundingBoxProgram( m_pgram_bounding_box );
-
-    optix::float3 normal = optix::normalize( optix::cross( offset1, offset2 ) );
-    float d = optix::dot( normal, anchor );
-    optix::float4 plane = optix::make_float4( normal, d );
-
-    optix::float3 v1 = offset1 / optix::dot( offset1, offset1 );
-    optix::float3 v2 = offset2 / optix::dot( offset2, offset2 );
-
-    parallelogram["meshId"]->setUint(meshId);
-    parallelogram["plane"]->setFloat( plane );
-    parallelogram["anchor"]->setFloat( anchor );
-    parallelogram["v1"]->setFloat( v1 );
-    parallelogram["v2"]->setFloat( v2 );
-
-    optix::Material matl = material.getOptixMaterial(context);
-
-    optix::GeometryInstance gi = context->createGeometryInstance( parallelogram, &matl, &matl+1 );
-    material.registerGeometryInstanceValues(gi);
-    return gi;
+    OptixSceneGeometryBuilder builder(context);
+    buildScene(builder);
+    return builder.createSceneRootGroup();
 }
 
-
-optix::Group CornellSmall::getSceneRootGroup(optix::Context & context)
+void CornellSmall::getHostSceneGeometry(HostSceneGeometry & geometry) const
 {
-    m_pgram_bounding_box = context->createProgramFromPTXFile( "parallelogram.cu.ptx", "bounds" );
-    m_pgram_intersection = context->createProgramFromPTXFile( "parallelogram.cu.ptx", "intersect" );
-
-    // create geometry instances
-    QVector<optix::GeometryInstance> gis;
+    geometry.clear();
+    HostSceneGeometryBuilder builder(geometry);
+    buildScene(builder);
+}
 
+void CornellSmall::buildScene(SceneGeometryBuilder & builder) const
+{
     Diffuse diffuseWhite = Diffuse(optix::make_float3( 0.8f ));
     Diffuse diffuseGreen = Diffuse(optix::make_float3( 0.05f, 0.8f, 0.05f ));
     Diffuse diffuseRed = Diffuse(optix::make_float3( 1.f, 0.05f, 0.05f ));
@@ -177,94 +153,94 @@ optix::Group CornellSmall::getSceneRootGroup(optix::Context & context)
 
     // Set geometry - Cornell box size in SmallVCM 2.56004, here rounded up slightly
     // Floor    
-    gis.push_back( createParallelogram(0, context, optix::make_float3( 0.0f, 0.0f, 0.0f ),
+    builder.addParallelogram(0, optix::make_float3( 0.0f, 0.0f, 0.0f ),
         optix::make_float3( 0.0f, 0.0f, 2.5f ),
         optix::make_float3( 2.5f, 0.0f, 0.0f ),
-        *matFloor ) );
+        *matFloor );
 
     // Ceiling
     if ((m_config & Config::LightPointDistant) == 0)
     {
-        gis.push_back( createParallelogram(1, context, optix::make_float3( 0.0f, 2.5f, 0.0f ),
+        builder.addParallelogram(1, optix::make_float3( 0.0f, 2.5f, 0.0f ),
             optix::make_float3( 2.5f, 0.0f, 0.0f ),
             optix::make_float3( 0.0f, 0.0f, 2.5f ),
-            *matCeiling ) );
+            *matCeiling );
     }
 
     // Back wall
-    gis.push_back( createParallelogram(2, context,optix::make_float3( 0.0f, 0.0f, 2.5f),
+    builder.addParallelogram(2, optix::make_float3( 0.0f, 0.0f, 2.5f),
         optix::make_float3( 0.0f, 2.5f, 0.0f),
         optix::make_float3( 2.5f, 0.0f, 0.0f),
-        *matBackWall));
+        *matBackWall);
 
     // Right wall
-    gis.push_back( createParallelogram(3, context, optix::make_float3( 0.0f, 0.0f, 0.0f ),
+    builder.addParallelogram(3, optix::make_float3( 0.0f, 0.0f, 0.0f ),
         optix::make_float3( 0.0f, 2.5f, 0.0f ),
         optix::make_float3( 0.0f, 0.0f, 2.5f ),
-        *matRightWall ) );
+        *matRightWall );
 
     // Left wall
-    gis.push_back( createParallelogram(4, context, optix::make_float3( 2.5f, 0.0f, 0.0f ),
+    builder.addParallelogram(4, optix::make_float3( 2.5f, 0.0f, 0.0f ),
         optix::make_float3( 0.0f, 0.0f, 2.5f ),
         optix::make_float3( 0.0f, 2.5f, 0.0f ),
-        *matLeftWall ) );
+        *matLeftWall );
 
 
     if ((m_config & Config::Blocks) != 0)
     {
         // Short block
-        gis.push_back( createParallelogram(5, context, 
+        builder.addParallelogram(5, 
             optix::make_float3( 130.0f, 165.0f, 65.0f) / 220.f,
             optix::make_float3( -48.0f, 0.0f, 160.0f) / 220.f,
             optix::make_float3( 160.0f, 0.0f, 49.0f) / 220.f,
-            *matShortBlock ) );
-        gis.push_back( createParallelogram(6, context, 
+            *matShortBlock );
+        builder.addParallelogram(6, 
             optix::make_float3( 290.0f, 0.0f, 114.0f) / 220.f,
             optix::make_float3( 0.0f, 165.0f, 0.0f) / 220.f,
             optix::make_float3( -50.0f, 0.0f, 158.0f) / 220.f,
-            *matShortBlock ) );
-        gis.push_back( createParallelogram(7, context, 
+            *matShortBlock );
+        builder.addParallelogram(7, 
             optix::make_float3( 130.0f, 0.0f, 65.0f) / 220.f,
             optix::make_float3( 0.0f, 165.0f, 0.0f) / 220.f,
             optix::make_float3( 160.0f, 0.0f, 49.0f) / 220.f,
-            *matShortBlock ) );
-        gis.push_back( createParallelogram(8, context, 
+            *matShortBlock );
+        builder.addParallelogram(8, 
             optix::make_float3( 82.0f, 0.0f, 225.0f) / 220.f,
             optix::make_float3( 0.0f, 165.0f, 0.0f) / 220.f,
             optix::make_float3( 48.0f, 0.0f, -160.0f) / 220.f,
-            *matShortBlock ) );
-        gis.push_back( createParallelogram(9, context,
+            *matShortBlock );
+        builder.addParallelogram(9, 
             optix::make_float3( 240.0f, 0.0f, 272.0f) / 220.f,
             optix::make_float3( 0.0f, 165.0f, 0.0f) / 220.f,
             optix::make_float3( -158.0f, 0.0f, -47.0f) / 220.f,
-            *matShortBlock));
+            *matShortBlock);
         
         // Tall block
-        gis.push_back( createParallelogram(10, context, 
+        builder.addParallelogram(10, 
             optix::make_float3( 423.0f, 340.0f, 247.0f) / 220.f,
             optix::make_float3( -158.0f, 0.0f, 49.0f) / 220.f,
             optix::make_float3( 49.0f, 0.0f, 159.0f) / 220.f,
-            *matTallBlock ) );
-        gis.push_back( createParallelogram(11, context, 
+            *matTallBlock );
+        builder.addParallelogram(11, 
             optix::make_float3( 423.0f, 0.0f, 247.0f) / 220.f,
             optix::make_float3( 0.0f, 340.0f, 0.0f) / 220.f,
             optix::make_float3( 49.0f, 0.0f, 159.0f) / 220.f,
-            *matTallBlock ) );
-        gis.push_back( createParallelogram(12, context, 
+            *matTallBlock );
+        builder.addParallelogram(12, 
             optix::make_float3( 472.0f, 0.0f, 406.0f) / 220.f,
             optix::make_float3( 0.0f, 340.0f, 0.0f) / 220.f,
             optix::make_float3( -158.0f, 0.0f, 50.0f) / 220.f,
-            *matTallBlock ) );
-        gis.push_back( createParallelogram(13, context, 
+            *matTallBlock );
+        builder.addParallelogram(13, 
             optix::make_float3( 314.0f, 0.0f, 456.0f) / 220.f,
             optix::make_float3( 0.0f, 340.0f, 0.0f) / 220.f,
             optix::make_float3( -49.0f, 0.0f, -160.0f) / 220.f,
-            *matTallBlock ) );
-        gis.push_back( createParallelogram(14, context, 
+            *matTallBlock );
+        builder.addParallelogram(14, 
             optix::make_float3( 265.0f, 0.0f, 296.0f) / 220.f,
             optix::make_float3( 0.0f, 340.1f, 0.0f) / 220.f,
             optix::make_float3( 158.0f, 0.0f, -49.0f) / 220.f,
-            *matTallBlock ) );
+            *matTallBlock );
     }
 
     // Area light
@@ -274,8 +250,8 @@ optix::Group CornellSmall::getSceneRootGroup(optix::Context & context)
         emitter.setInverseArea(m_sceneLights[0].inverseArea);
         for(int i = 0; i < m_sceneLights.size(); i++)
         {
-            gis.push_back(createParallelogram(15 + i, context, m_sceneLights[i].position, 
-                m_sceneLights[i].v1, m_sceneLights[i].v2, emitter));
+            builder.addParallelogram(15 + i, m_sceneLights[i].position, 
+                m_sceneLights[i].v1, m_sceneLights[i].v2, emitter);
         }
     }    
 
@@ -288,41 +264,22 @@ optix::Group CornellSmall::getSceneRootGroup(optix::Context & context)
             matLargeSphere = &glass;
 
         float radius = 0.8;
-        SphereInstance sphere = SphereInstance(*matLargeSphere, Sphere(Vector3(1.25f, radius, 1.25f), radius));
-        gis.push_back(sphere.getOptixGeometryInstance(context));
+        builder.addSphere(Sphere(Vector3(1.25f, radius, 1.25f), radius), *matLargeSphere);
     }
     
     // Small glass sphere right
     if ((m_config & Config::SmallGlassSphere))
     {
         float radius = 0.5;
-        SphereInstance sphere = SphereInstance(glass, Sphere(Vector3(1.25f - 0.535714269f, radius, 1.25f), radius));
-        gis.push_back(sphere.getOptixGeometryInstance(context));
+        builder.addSphere(Sphere(Vector3(1.25f - 0.535714269f, radius, 1.25f), radius), glass);
     }
 
     // Small mirror sphere left
     if ((m_config & Config::SmallMirrorSphere))
     {
         float radius = 0.5;
-        SphereInstance sphere = SphereInstance(mirror, Sphere(Vector3(1.25f + 0.535714269f, radius, 1.25f), radius));
-        gis.push_back(sphere.getOptixGeometryInstance(context));
+        builder.addSphere(Sphere(Vector3(1.25f + 0.535714269f, radius, 1.25f), radius), mirror);
     }
-
-    // Create geometry group
-    optix::GeometryGroup geometry_group = context->createGeometryGroup();
-    geometry_group->setChildCount( static_cast<unsigned int>( gis.size() ) );
-    for (int i = 0; i < gis.size(); ++i )
-        geometry_group->setChild( i, gis[i] );
-
-    geometry_group->setAcceleration(context->createAcceleration("NoAccel", "NoAccel")); // Bvh Sbvh Trbvh NoAccel // Bvh BvhCompact NoAccel
-
-    optix::Group gro = context->createGroup();
-    gro->setChildCount(1);
-    gro->setChild(0, geometry_group);
-    optix::Acceleration acceleration = context->createAcceleration("NoAccel", "NoAccel"); 
-    gro->setAcceleration(acceleration);
-
-    return gro;
 }
 
 const QVector<Light> & CornellSmall::getSceneLights(void) const
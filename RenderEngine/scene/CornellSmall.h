@@ -18,6 +18,7 @@
 
 
 class Material;
+class SceneGeometryBuilder;
 
 class CornellSmall : public IScene
 {
@@ -45,6 +46,7 @@ public:
     RENDER_ENGINE_EXPORT_API CornellSmall(uint config) : m_config(config) { initialize(); }
     RENDER_ENGINE_EXPORT_API virtual ~CornellSmall(void) {}
     RENDER_ENGINE_EXPORT_API virtual optix::Group getSceneRootGroup(optix::Context & context);
+    RENDER_ENGINE_EXPORT_API virtual void getHostSceneGeometry(HostSceneGeometry & geometry) const;
     RENDER_ENGINE_EXPORT_API virtual const QVector<Light> & getSceneLights() const;
     RENDER_ENGINE_EXPORT_API virtual Camera getDefaultCamera(void) const;
     RENDER_ENGINE_EXPORT_API virtual const char* getSceneName() const;
@@ -60,17 +62,8 @@ private:
     uint            m_config;
     optix::Material m_material;
     optix::Material m_glassMaterial;
-    optix::Program m_pgram_bounding_box;
-    optix::Program m_pgram_intersection;
     QVector<Light> m_sceneLights;
     AAB m_sceneAABB;
-    optix::GeometryInstance createParallelogram(
-        unsigned int meshId,
-        optix::Context & context,
-        const optix::float3& anchor,
-        const optix::float3& offset1,
-        const optix::float3& offset2,
-        Material & material
-    );
+    void buildScene(SceneGeometryBuilder & builder) const;
 };
 #endif
\ No newline at end of file
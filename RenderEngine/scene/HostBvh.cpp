@@ -0,0 +1,815 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "HostBvh.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <limits>
+#include "scene/HostSceneGeometry.h"
+#include "util/TaskScheduler.h"
+
+using namespace optix;
+
+// Ranges of up to MAX_LEAF_TRIANGLES triangles become leaves when the SAH says splitting them does not pay off,
+// larger ranges are always split
+const unsigned int HostBvh::MAX_LEAF_TRIANGLES = 4;
+
+// Same trade-off as PhotonKdTreeBuilder::PARALLEL_SUBTREE_MIN_PHOTONS, binning a triangle costs more than
+// partitioning a photon
+const unsigned int HostBvh::PARALLEL_SUBTREE_MIN_TRIANGLES = 8*1024;
+
+namespace
+{
+    const int NUM_BINS = 16;
+    const float TRAVERSAL_COST = 1.0f;
+    const float INTERSECTION_COST = 1.0f;
+
+    // From MAX_BUILD_DEPTH on ranges are split at the object median. This bounds the depth of the tree by
+    // MAX_BUILD_DEPTH + 32, and the traversal stack grows by at most three entries per level.
+    const unsigned int MAX_BUILD_DEPTH = 32;
+    const unsigned int STACK_SIZE = 256;
+
+    const float3 EMPTY_MIN = make_float3(std::numeric_limits<float>::max());
+    const float3 EMPTY_MAX = make_float3(-std::numeric_limits<float>::max());
+
+    inline float halfArea(const float3 & min, const float3 & max)
+    {
+        float3 d = max - min;
+        return d.x*d.y + d.y*d.z + d.z*d.x;
+    }
+
+    inline float getAxis(const float3 & v, int axis)
+    {
+        return (&v.x)[axis];
+    }
+
+    inline int getLongestAxis(const float3 & v)
+    {
+        return v.x > v.y ? (v.x > v.z ? 0 : 2) : (v.y > v.z ? 1 : 2);
+    }
+
+    template<typename BuildPrimitive> inline float3 getCentroid(const BuildPrimitive & primitive)
+    {
+        return (primitive.min + primitive.max)*0.5f;
+    }
+
+    // The bin of a centroid on each axis. Binning and partitioning must compute the same bin, so both go through here.
+    inline __m128i getBins(__m128 centroid, __m128 centroidMin, __m128 scale)
+    {
+        const __m128 maxBin = _mm_set1_ps(float(NUM_BINS-1));
+        return _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_sub_ps(centroid, centroidMin), scale), maxBin));
+    }
+
+    inline int getLane(__m128i v, int lane)
+    {
+        return _mm_cvtsi128_si32(lane == 0 ? v : lane == 1 ? _mm_shuffle_epi32(v, 1) : _mm_shuffle_epi32(v, 2));
+    }
+
+    // BuildPrimitive::min and max are followed by a 32 bit value, so they can be loaded as one __m128. The fourth lane
+    // is cleared, the triangle index would be a denormal float and those are very slow to compute with.
+    template<typename BuildPrimitive> inline __m128 getCentroid(const BuildPrimitive & primitive, __m128 & min, __m128 & max)
+    {
+        const __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+        min = _mm_and_ps(_mm_loadu_ps(&primitive.min.x), xyzMask);
+        max = _mm_and_ps(_mm_loadu_ps(&primitive.max.x), xyzMask);
+        return _mm_mul_ps(_mm_add_ps(min, max), _mm_set1_ps(0.5f));
+    }
+
+    inline float halfArea(__m128 min, __m128 max)
+    {
+        const __m128 d = _mm_sub_ps(max, min);
+        const __m128 dYZX = _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 0, 2, 1));
+        const __m128 products = _mm_mul_ps(d, dYZX);
+        return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(3, 3, 3, 1))),
+            _mm_shuffle_ps(products, products, _MM_SHUFFLE(3, 3, 3, 2))));
+    }
+
+    inline float3 toFloat3(__m128 v)
+    {
+        float result[4];
+        _mm_storeu_ps(result, v);
+        return make_float3(result[0], result[1], result[2]);
+    }
+
+    // Bounds of the primitives and of their centroids in one bin. The fourth lane is unused.
+    struct Bin
+    {
+        __m128 min;
+        __m128 max;
+        __m128 centroidMin;
+        __m128 centroidMax;
+        unsigned int count;
+    };
+
+    struct StackEntry
+    {
+        unsigned int node;
+        float tNear;
+    };
+
+    // Same as optix::intersect_triangle, both sides are hit
+    inline bool intersectTriangle(const float3 & origin, const float3 & direction, const float3 & p0, const float3 & e0,
+        const float3 & e1, const float3 & n, float & t, float & beta, float & gamma)
+    {
+        const float3 e2 = (1.0f/dot(n, direction))*(p0 - origin);
+        const float3 i = cross(direction, e2);
+        beta = dot(i, e1);
+        gamma = dot(i, e0);
+        t = dot(n, e2);
+        return beta >= 0.0f && gamma >= 0.0f && beta + gamma <= 1.0f;
+    }
+
+    // Ray data for the slab test against the four boxes of a node. The planes are picked by the sign of the
+    // inverse direction (-0 gives -inf) so that empty boxes (min > max) are always missed. 0*inf gives NaN,
+    // which _mm_max_ps and _mm_min_ps drop in favour of their second operand.
+    struct SimdRay
+    {
+        __m128 originX, originY, originZ;
+        __m128 inverseDirectionX, inverseDirectionY, inverseDirectionZ;
+        bool positiveX, positiveY, positiveZ;
+
+        SimdRay(const float3 & origin, const float3 & direction)
+        {
+            originX = _mm_set1_ps(origin.x);
+            originY = _mm_set1_ps(origin.y);
+            originZ = _mm_set1_ps(origin.z);
+            const float3 inverseDirection = make_float3(1.0f/direction.x, 1.0f/direction.y, 1.0f/direction.z);
+            inverseDirectionX = _mm_set1_ps(inverseDirection.x);
+            inverseDirectionY = _mm_set1_ps(inverseDirection.y);
+            inverseDirectionZ = _mm_set1_ps(inverseDirection.z);
+            positiveX = inverseDirection.x >= 0;
+            positiveY = inverseDirection.y >= 0;
+            positiveZ = inverseDirection.z >= 0;
+        }
+    };
+}
+
+struct HostBvh::BuildRange
+{
+    unsigned int begin;
+    unsigned int end;
+    unsigned int depth;
+    float3 min;
+    float3 max;
+    float3 centroidMin;
+    float3 centroidMax;
+
+    void reset(unsigned int begin_, unsigned int end_, unsigned int depth_)
+    {
+        begin = begin_;
+        end = end_;
+        depth = depth_;
+        min = centroidMin = EMPTY_MIN;
+        max = centroidMax = EMPTY_MAX;
+    }
+
+    void grow(const BuildPrimitive* primitives)
+    {
+        for(unsigned int i = begin; i < end; i++)
+        {
+            min = fminf(min, primitives[i].min);
+            max = fmaxf(max, primitives[i].max);
+            float3 centroid = getCentroid(primitives[i]);
+            centroidMin = fminf(centroidMin, centroid);
+            centroidMax = fmaxf(centroidMax, centroid);
+        }
+    }
+
+    void grow(const Bin & bin)
+    {
+        if(bin.count > 0)
+        {
+            min = fminf(min, toFloat3(bin.min));
+            max = fmaxf(max, toFloat3(bin.max));
+            centroidMin = fminf(centroidMin, toFloat3(bin.centroidMin));
+            centroidMax = fmaxf(centroidMax, toFloat3(bin.centroidMax));
+        }
+    }
+
+    unsigned int getCount() const
+    {
+        return end - begin;
+    }
+};
+
+class HostBvh::BuildNodeTask : public Task
+{
+public:
+    BuildNodeTask() : m_bvh(NULL) {}
+
+    void set(HostBvh* bvh, unsigned int nodeIndex, const BuildRange & left, const BuildRange & right)
+    {
+        m_bvh = bvh;
+        m_nodeIndex = nodeIndex;
+        m_left = left;
+        m_right = right;
+    }
+
+    virtual void run()
+    {
+        m_bvh->buildNode(m_nodeIndex, m_left, m_right);
+    }
+
+private:
+    HostBvh* m_bvh;
+    unsigned int m_nodeIndex;
+    BuildRange m_left;
+    BuildRange m_right;
+};
+
+class HostBvh::ComputeBuildPrimitives
+{
+public:
+    ComputeBuildPrimitives(HostBvh & bvh, const float3* positions, const int3* triangles)
+        : m_bvh(bvh), m_positions(positions), m_triangles(triangles)
+    {
+
+    }
+
+    void operator()(unsigned int from, unsigned int to) const
+    {
+        for(unsigned int i = from; i < to; i++)
+        {
+            const int3 & triangle = m_triangles[i];
+            const float3 & p0 = m_positions[triangle.x];
+            const float3 & p1 = m_positions[triangle.y];
+            const float3 & p2 = m_positions[triangle.z];
+            BuildPrimitive & primitive = m_bvh.m_buildPrimitives[i];
+            primitive.min = fminf(p0, fminf(p1, p2));
+            primitive.max = fmaxf(p0, fmaxf(p1, p2));
+            primitive.triangle = i;
+        }
+    }
+
+private:
+    HostBvh & m_bvh;
+    const float3* m_positions;
+    const int3* m_triangles;
+};
+
+class HostBvh::ComputeTriangles
+{
+public:
+    ComputeTriangles(HostBvh & bvh, const float3* positions, const int3* triangles, const unsigned int* triangleMasks)
+        : m_bvh(bvh), m_positions(positions), m_triangles(triangles), m_triangleMasks(triangleMasks)
+    {
+
+    }
+
+    void operator()(unsigned int from, unsigned int to) const
+    {
+        for(unsigned int i = from; i < to; i++)
+        {
+            unsigned int index = m_bvh.m_buildPrimitives[i].triangle;
+            const int3 & triangle = m_triangles[index];
+            const float3 & p0 = m_positions[triangle.x];
+            const float3 & p1 = m_positions[triangle.y];
+            const float3 & p2 = m_positions[triangle.z];
+            Triangle & result = m_bvh.m_triangles[i];
+            result.p0 = p0;
+            result.e0 = p1 - p0;
+            result.e1 = p0 - p2;
+            result.n = cross(result.e1, result.e0);
+            result.index = index;
+            result.mask = m_triangleMasks != NULL ? m_triangleMasks[index] : ~0u;
+        }
+    }
+
+private:
+    HostBvh & m_bvh;
+    const float3* m_positions;
+    const int3* m_triangles;
+    const unsigned int* m_triangleMasks;
+};
+
+namespace
+{
+    template<typename BuildPrimitive> class CompareCentroids
+    {
+    public:
+        CompareCentroids(int axis) : m_axis(axis) {}
+        bool operator()(const BuildPrimitive & a, const BuildPrimitive & b) const
+        {
+            return getAxis(a.min + a.max, m_axis) < getAxis(b.min + b.max, m_axis);
+        }
+    private:
+        int m_axis;
+    };
+}
+
+HostBvh::HostBvh()
+    : m_scheduler(TaskScheduler::get()),
+      m_numNodes(0),
+      m_boundsMin(EMPTY_MIN),
+      m_boundsMax(EMPTY_MAX)
+{
+
+}
+
+HostBvh::HostBvh( TaskScheduler & scheduler )
+    : m_scheduler(scheduler),
+      m_numNodes(0),
+      m_boundsMin(EMPTY_MIN),
+      m_boundsMax(EMPTY_MAX)
+{
+
+}
+
+void HostBvh::clear()
+{
+    m_nodes.clear();
+    m_triangles.clear();
+    m_buildPrimitives.clear();
+    m_numNodes.store(0);
+    m_boundsMin = EMPTY_MIN;
+    m_boundsMax = EMPTY_MAX;
+}
+
+void HostBvh::build( const HostSceneGeometry & geometry, const unsigned int* triangleMasks )
+{
+    build(geometry.getPositions().constData(), geometry.getTriangles().constData(), geometry.getNumTriangles(), triangleMasks);
+}
+
+void HostBvh::build( const float3* positions, const int3* triangles, unsigned int numTriangles, const unsigned int* triangleMasks )
+{
+    clear();
+    if(numTriangles == 0)
+    {
+        return;
+    }
+
+    m_buildPrimitives.resize(numTriangles);
+    m_scheduler.parallelFor(0, numTriangles, 4096, ComputeBuildPrimitives(*this, positions, triangles));
+
+    BuildRange root;
+    root.reset(0, numTriangles, 0);
+    root.grow(&m_buildPrimitives[0]);
+    m_boundsMin = root.min;
+    m_boundsMax = root.max;
+
+    // Every inner node has at least two children and every leaf at least one triangle, so there are
+    // fewer inner nodes than triangles
+    m_nodes.resize(numTriangles);
+    m_numNodes.store(1);
+
+    BuildRange left, right;
+    if(splitRange(root, left, right))
+    {
+        buildNode(0, left, right);
+    }
+    else
+    {
+        Node & node = m_nodes[0];
+        for(int i = 0; i < 4; i++)
+        {
+            node.minX[i] = node.minY[i] = node.minZ[i] = EMPTY_MIN.x;
+            node.maxX[i] = node.maxY[i] = node.maxZ[i] = EMPTY_MAX.x;
+            node.child[i] = 0;
+            node.count[i] = 0;
+        }
+        node.minX[0] = root.min.x;
+        node.minY[0] = root.min.y;
+        node.minZ[0] = root.min.z;
+        node.maxX[0] = root.max.x;
+        node.maxY[0] = root.max.y;
+        node.maxZ[0] = root.max.z;
+        node.count[0] = numTriangles;
+    }
+    m_nodes.resize(m_numNodes.load());
+
+    m_triangles.resize(numTriangles);
+    m_scheduler.parallelFor(0, numTriangles, 4096, ComputeTriangles(*this, positions, triangles, triangleMasks));
+    std::vector<BuildPrimitive>().swap(m_buildPrimitives);
+}
+
+unsigned int HostBvh::allocateNode()
+{
+    return (unsigned int)m_numNodes.fetchAndAddOrdered(1);
+}
+
+// Split range by the binned SAH, or at the object median if it has to be split and the SAH found no split.
+// Returns false if range should be a leaf. All three axes are binned in one pass over the primitives, and the
+// bounds of the two halves are merged from the bins.
+
+bool HostBvh::splitRange( const BuildRange & range, BuildRange & left, BuildRange & right )
+{
+    const unsigned int count = range.getCount();
+    if(count <= 1)
+    {
+        return false;
+    }
+
+    BuildPrimitive* primitives = &m_buildPrimitives[0];
+    const float3 centroidExtent = range.centroidMax - range.centroidMin;
+    const __m128 centroidMin = _mm_setr_ps(range.centroidMin.x, range.centroidMin.y, range.centroidMin.z, 0.f);
+    __m128 scale = _mm_setzero_ps();
+    Bin bins[3][NUM_BINS];
+    int bestAxis = -1;
+    int bestBin = 0;
+    float bestCost = std::numeric_limits<float>::max();
+
+    if(range.depth < MAX_BUILD_DEPTH && fmaxf(centroidExtent) > 0.f)
+    {
+        float scales[4] = { 0.f, 0.f, 0.f, 0.f };
+        for(int axis = 0; axis < 3; axis++)
+        {
+            const float extent = getAxis(centroidExtent, axis);
+            scales[axis] = extent > 0.f ? NUM_BINS*(1.f - 1e-5f)/extent : 0.f;
+            for(int b = 0; b < NUM_BINS; b++)
+            {
+                bins[axis][b].min = bins[axis][b].centroidMin = _mm_set1_ps(EMPTY_MIN.x);
+                bins[axis][b].max = bins[axis][b].centroidMax = _mm_set1_ps(EMPTY_MAX.x);
+                bins[axis][b].count = 0;
+            }
+        }
+        scale = _mm_loadu_ps(scales);
+
+        for(unsigned int i = range.begin; i < range.end; i++)
+        {
+            __m128 min, max;
+            const __m128 centroid = getCentroid(primitives[i], min, max);
+            const __m128i binIndices = getBins(centroid, centroidMin, scale);
+            for(int axis = 0; axis < 3; axis++)
+            {
+                Bin & bin = bins[axis][getLane(binIndices, axis)];
+                bin.min = _mm_min_ps(bin.min, min);
+                bin.max = _mm_max_ps(bin.max, max);
+                bin.centroidMin = _mm_min_ps(bin.centroidMin, centroid);
+                bin.centroidMax = _mm_max_ps(bin.centroidMax, centroid);
+                bin.count++;
+            }
+        }
+
+        for(int axis = 0; axis < 3; axis++)
+        {
+            if(scales[axis] <= 0.f)
+            {
+                continue;
+            }
+
+            // Sweep from the right, then from the left evaluating the split in front of every bin
+            float rightArea[NUM_BINS];
+            unsigned int rightCount[NUM_BINS];
+            __m128 sweepMin = _mm_set1_ps(EMPTY_MIN.x);
+            __m128 sweepMax = _mm_set1_ps(EMPTY_MAX.x);
+            unsigned int sweepCount = 0;
+            for(int b = NUM_BINS-1; b > 0; b--)
+            {
+                sweepMin = _mm_min_ps(sweepMin, bins[axis][b].min);
+                sweepMax = _mm_max_ps(sweepMax, bins[axis][b].max);
+                sweepCount += bins[axis][b].count;
+                rightArea[b] = sweepCount > 0 ? halfArea(sweepMin, sweepMax) : 0.f;
+                rightCount[b] = sweepCount;
+            }
+
+            sweepMin = _mm_set1_ps(EMPTY_MIN.x);
+            sweepMax = _mm_set1_ps(EMPTY_MAX.x);
+            sweepCount = 0;
+            for(int b = 1; b < NUM_BINS; b++)
+            {
+                sweepMin = _mm_min_ps(sweepMin, bins[axis][b-1].min);
+                sweepMax = _mm_max_ps(sweepMax, bins[axis][b-1].max);
+                sweepCount += bins[axis][b-1].count;
+                if(sweepCount == 0 || rightCount[b] == 0)
+                {
+                    continue;
+                }
+                float cost = halfArea(sweepMin, sweepMax)*sweepCount + rightArea[b]*rightCount[b];
+                if(cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+    }
+
+    if(bestAxis >= 0)
+    {
+        const float area = halfArea(range.min, range.max);
+        const float splitCost = TRAVERSAL_COST + INTERSECTION_COST*(area > 0.f ? bestCost/area : float(count));
+        if(count <= MAX_LEAF_TRIANGLES && splitCost >= INTERSECTION_COST*count)
+        {
+            return false;
+        }
+
+        BuildPrimitive* first = primitives + range.begin;
+        BuildPrimitive* last = primitives + range.end;
+        while(first < last)
+        {
+            __m128 min, max;
+            if(getLane(getBins(getCentroid(*first, min, max), centroidMin, scale), bestAxis) < bestBin)
+            {
+                first++;
+            }
+            else
+            {
+                std::swap(*first, *--last);
+            }
+        }
+
+        const unsigned int middle = (unsigned int)(first - primitives);
+        left.reset(range.begin, middle, range.depth);
+        right.reset(middle, range.end, range.depth);
+        for(int b = 0; b < NUM_BINS; b++)
+        {
+            (b < bestBin ? left : right).grow(bins[bestAxis][b]);
+        }
+        return true;
+    }
+
+    if(count <= MAX_LEAF_TRIANGLES)
+    {
+        return false;
+    }
+
+    const unsigned int middle = range.begin + count/2;
+    std::nth_element(primitives + range.begin, primitives + middle, primitives + range.end,
+        CompareCentroids<BuildPrimitive>(getLongestAxis(centroidExtent)));
+    left.reset(range.begin, middle, range.depth);
+    left.grow(primitives);
+    right.reset(middle, range.end, range.depth);
+    right.grow(primitives);
+    return true;
+}
+
+void HostBvh::buildNode( unsigned int nodeIndex, const BuildRange & left, const BuildRange & right )
+{
+    BuildRange children[4];
+    bool isLeaf[4] = { false, false, false, false };
+    children[0] = left;
+    children[1] = right;
+    unsigned int numChildren = 2;
+
+    // Open up the child with the largest surface area until the node is full
+    while(numChildren < 4)
+    {
+        int largest = -1;
+        float largestArea = -1.f;
+        for(unsigned int i = 0; i < numChildren; i++)
+        {
+            float area = halfArea(children[i].min, children[i].max);
+            if(!isLeaf[i] && children[i].getCount() > 1 && area > largestArea)
+            {
+                largest = (int)i;
+                largestArea = area;
+            }
+        }
+        if(largest < 0)
+        {
+            break;
+        }
+
+        BuildRange childLeft, childRight;
+        if(splitRange(children[largest], childLeft, childRight))
+        {
+            children[largest] = childLeft;
+            children[numChildren++] = childRight;
+        }
+        else
+        {
+            isLeaf[largest] = true;
+        }
+    }
+
+    // Split the children that become inner nodes, fork the large ones and build the others on this thread
+    Node & node = m_nodes[nodeIndex];
+    BuildNodeTask tasks[4];
+    bool isForked[4] = { false, false, false, false };
+    TaskGroup group(m_scheduler);
+    for(unsigned int i = 0; i < 4; i++)
+    {
+        if(i >= numChildren)
+        {
+            node.minX[i] = node.minY[i] = node.minZ[i] = EMPTY_MIN.x;
+            node.maxX[i] = node.maxY[i] = node.maxZ[i] = EMPTY_MAX.x;
+            node.child[i] = 0;
+            node.count[i] = 0;
+            continue;
+        }
+
+        const BuildRange & child = children[i];
+        node.minX[i] = child.min.x;
+        node.minY[i] = child.min.y;
+        node.minZ[i] = child.min.z;
+        node.maxX[i] = child.max.x;
+        node.maxY[i] = child.max.y;
+        node.maxZ[i] = child.max.z;
+
+        BuildRange childNode = child;
+        childNode.depth = left.depth + 1;
+        BuildRange childLeft, childRight;
+        if(isLeaf[i] || !splitRange(childNode, childLeft, childRight))
+        {
+            node.child[i] = child.begin;
+            node.count[i] = child.getCount();
+            continue;
+        }
+
+        node.child[i] = allocateNode();
+        node.count[i] = 0;
+        tasks[i].set(this, node.child[i], childLeft, childRight);
+        if(child.getCount() >= PARALLEL_SUBTREE_MIN_TRIANGLES)
+        {
+            group.run(tasks[i]);
+            isForked[i] = true;
+        }
+    }
+
+    for(unsigned int i = 0; i < numChildren; i++)
+    {
+        if(node.count[i] == 0 && !isForked[i])
+        {
+            tasks[i].run();
+        }
+    }
+    group.wait();
+}
+
+/*
+// Closest hit: children are visited front to back, and entries of the stack that start behind the closest hit
+// so far are skipped.
+*/
+
+bool HostBvh::intersect( const float3 & origin, const float3 & direction, float tMin, float tMax, Hit & hit,
+    unsigned int rayMask ) const
+{
+    if(m_nodes.empty())
+    {
+        return false;
+    }
+
+    const SimdRay ray(origin, direction);
+    bool found = false;
+    StackEntry stack[STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize].node = 0;
+    stack[stackSize].tNear = tMin;
+    stackSize++;
+
+    while(stackSize > 0)
+    {
+        const StackEntry entry = stack[--stackSize];
+        if(entry.tNear > tMax)
+        {
+            continue;
+        }
+
+        const Node & node = m_nodes[entry.node];
+        __m128 tNear = _mm_set1_ps(tMin);
+        __m128 tFar = _mm_set1_ps(tMax);
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveX ? node.minX : node.maxX), ray.originX), ray.inverseDirectionX);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveX ? node.maxX : node.minX), ray.originX), ray.inverseDirectionX);
+        tNear = _mm_max_ps(t0, tNear);
+        tFar = _mm_min_ps(t1, tFar);
+        t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveY ? node.minY : node.maxY), ray.originY), ray.inverseDirectionY);
+        t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveY ? node.maxY : node.minY), ray.originY), ray.inverseDirectionY);
+        tNear = _mm_max_ps(t0, tNear);
+        tFar = _mm_min_ps(t1, tFar);
+        t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveZ ? node.minZ : node.maxZ), ray.originZ), ray.inverseDirectionZ);
+        t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveZ ? node.maxZ : node.minZ), ray.originZ), ray.inverseDirectionZ);
+        tNear = _mm_max_ps(t0, tNear);
+        tFar = _mm_min_ps(t1, tFar);
+        int hitMask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+        if(hitMask == 0)
+        {
+            continue;
+        }
+
+        float tNearChildren[4];
+        _mm_storeu_ps(tNearChildren, tNear);
+
+        // Intersect the leaves right away, collect the inner nodes sorted by distance
+        StackEntry innerNodes[4];
+        unsigned int numInnerNodes = 0;
+        for(unsigned int i = 0; i < 4; i++)
+        {
+            if((hitMask & (1 << i)) == 0 || tNearChildren[i] > tMax)
+            {
+                continue;
+            }
+
+            if(node.count[i] == 0)
+            {
+                unsigned int j = numInnerNodes++;
+                for(; j > 0 && innerNodes[j-1].tNear < tNearChildren[i]; j--)
+                {
+                    innerNodes[j] = innerNodes[j-1];
+                }
+                innerNodes[j].node = node.child[i];
+                innerNodes[j].tNear = tNearChildren[i];
+                continue;
+            }
+
+            const Triangle* triangle = &m_triangles[node.child[i]];
+            const Triangle* end = triangle + node.count[i];
+            for(; triangle < end; triangle++)
+            {
+                float t, beta, gamma;
+                if((triangle->mask & rayMask) != 0
+                    && intersectTriangle(origin, direction, triangle->p0, triangle->e0, triangle->e1, triangle->n, t, beta, gamma)
+                    && t > tMin && t < tMax)
+                {
+                    tMax = t;
+                    hit.t = t;
+                    hit.triangle = triangle->index;
+                    hit.beta = beta;
+                    hit.gamma = gamma;
+                    found = true;
+                }
+            }
+        }
+
+        // Farthest first so the nearest is popped next
+        for(unsigned int i = 0; i < numInnerNodes; i++)
+        {
+            stack[stackSize++] = innerNodes[i];
+        }
+    }
+    return found;
+}
+
+bool HostBvh::isOccluded( const float3 & origin, const float3 & direction, float tMin, float tMax, unsigned int rayMask ) const
+{
+    if(m_nodes.empty())
+    {
+        return false;
+    }
+
+    const SimdRay ray(origin, direction);
+    unsigned int stack[STACK_SIZE];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+    const __m128 tMinSimd = _mm_set1_ps(tMin);
+    const __m128 tMaxSimd = _mm_set1_ps(tMax);
+
+    while(stackSize > 0)
+    {
+        const Node & node = m_nodes[stack[--stackSize]];
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveX ? node.minX : node.maxX), ray.originX), ray.inverseDirectionX);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveX ? node.maxX : node.minX), ray.originX), ray.inverseDirectionX);
+        __m128 tNear = _mm_max_ps(t0, tMinSimd);
+        __m128 tFar = _mm_min_ps(t1, tMaxSimd);
+        t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveY ? node.minY : node.maxY), ray.originY), ray.inverseDirectionY);
+        t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveY ? node.maxY : node.minY), ray.originY), ray.inverseDirectionY);
+        tNear = _mm_max_ps(t0, tNear);
+        tFar = _mm_min_ps(t1, tFar);
+        t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveZ ? node.minZ : node.maxZ), ray.originZ), ray.inverseDirectionZ);
+        t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ray.positiveZ ? node.maxZ : node.minZ), ray.originZ), ray.inverseDirectionZ);
+        tNear = _mm_max_ps(t0, tNear);
+        tFar = _mm_min_ps(t1, tFar);
+        int hitMask = _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+
+        for(unsigned int i = 0; i < 4; i++)
+        {
+            if((hitMask & (1 << i)) == 0)
+            {
+                continue;
+            }
+
+            if(node.count[i] == 0)
+            {
+                stack[stackSize++] = node.child[i];
+                continue;
+            }
+
+            const Triangle* triangle = &m_triangles[node.child[i]];
+            const Triangle* end = triangle + node.count[i];
+            for(; triangle < end; triangle++)
+            {
+                float t, beta, gamma;
+                if((triangle->mask & rayMask) != 0
+                    && intersectTriangle(origin, direction, triangle->p0, triangle->e0, triangle->e1, triangle->n, t, beta, gamma)
+                    && t > tMin && t < tMax)
+                {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+unsigned int HostBvh::getNumTriangles() const
+{
+    return (unsigned int)m_triangles.size();
+}
+
+unsigned int HostBvh::getNumNodes() const
+{
+    return (unsigned int)m_nodes.size();
+}
+
+float3 HostBvh::getBoundsMin() const
+{
+    return m_boundsMin;
+}
+
+float3 HostBvh::getBoundsMax() const
+{
+    return m_boundsMax;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <vector>
+#include <QAtomicInt>
+#include <optixu/optixu_math_namespace.h>
+#include "render_engine_export_api.h"
+
+class TaskScheduler;
+class HostSceneGeometry;
+
+/*
+Host side bounding volume hierarchy over a triangle soup, for ray queries on the CPU (HostPathTracer, picking,
+offline analysis of photon dumps).
+
+The tree is built top down with a binned SAH (16 bins on each axis). Nodes are 4 wide: a node is built by
+splitting the child with the largest surface area until it has four children, and the four child boxes are stored
+as structure of arrays so one SSE slab test intersects all of them. Subtrees larger than
+PARALLEL_SUBTREE_MIN_TRIANGLES are built as tasks on the TaskScheduler.
+
+Every triangle has a mask, a query only considers triangles whose mask shares a bit with the ray mask. The path
+tracer uses this to let shadow rays pass through emitters.
+*/
+
+class HostBvh
+{
+public:
+    struct Hit
+    {
+        float t;
+        unsigned int triangle;
+        // Barycentric coordinates of the hit, as in optix::intersect_triangle
+        float beta;
+        float gamma;
+    };
+
+    RENDER_ENGINE_EXPORT_API HostBvh();
+    RENDER_ENGINE_EXPORT_API HostBvh(TaskScheduler & scheduler);
+    // triangleMasks may be NULL, which gives every triangle the mask ~0
+    RENDER_ENGINE_EXPORT_API void build(const optix::float3* positions, const optix::int3* triangles, unsigned int numTriangles,
+        const unsigned int* triangleMasks = NULL);
+    RENDER_ENGINE_EXPORT_API void build(const HostSceneGeometry & geometry, const unsigned int* triangleMasks = NULL);
+    RENDER_ENGINE_EXPORT_API void clear();
+
+    // Closest hit in (tMin, tMax)
+    RENDER_ENGINE_EXPORT_API bool intersect(const optix::float3 & origin, const optix::float3 & direction, float tMin, float tMax,
+        Hit & hit, unsigned int rayMask = ~0u) const;
+    // Any hit in (tMin, tMax)
+    RENDER_ENGINE_EXPORT_API bool isOccluded(const optix::float3 & origin, const optix::float3 & direction, float tMin, float tMax,
+        unsigned int rayMask = ~0u) const;
+
+    RENDER_ENGINE_EXPORT_API unsigned int getNumTriangles() const;
+    RENDER_ENGINE_EXPORT_API unsigned int getNumNodes() const;
+    RENDER_ENGINE_EXPORT_API optix::float3 getBoundsMin() const;
+    RENDER_ENGINE_EXPORT_API optix::float3 getBoundsMax() const;
+
+    const static unsigned int MAX_LEAF_TRIANGLES;
+    const static unsigned int PARALLEL_SUBTREE_MIN_TRIANGLES;
+
+private:
+    class BuildNodeTask;
+    class ComputeBuildPrimitives;
+    class ComputeTriangles;
+    friend class BuildNodeTask;
+    friend class ComputeBuildPrimitives;
+    friend class ComputeTriangles;
+    struct BuildRange;
+
+    // The boxes of the four children as structure of arrays. Child i is a leaf with the triangles
+    // [child[i], child[i]+count[i]) if count[i] > 0, and the node child[i] otherwise. Unused children have
+    // an empty box (min > max).
+    struct Node
+    {
+        float minX[4];
+        float minY[4];
+        float minZ[4];
+        float maxX[4];
+        float maxY[4];
+        float maxZ[4];
+        unsigned int child[4];
+        unsigned int count[4];
+    };
+
+    // The triangles in leaf order, with the edges and normal of optix::intersect_triangle precomputed
+    struct Triangle
+    {
+        optix::float3 p0;
+        optix::float3 e0;
+        optix::float3 e1;
+        optix::float3 n;
+        unsigned int index;
+        unsigned int mask;
+    };
+
+    // Triangle bounds during the build, reordered in place as ranges are split
+    struct BuildPrimitive
+    {
+        optix::float3 min;
+        unsigned int triangle;
+        optix::float3 max;
+        unsigned int padding;
+    };
+
+    bool splitRange(const BuildRange & range, BuildRange & left, BuildRange & right);
+    void buildNode(unsigned int nodeIndex, const BuildRange & left, const BuildRange & right);
+    unsigned int allocateNode();
+
+    TaskScheduler & m_scheduler;
+    std::vector<Node> m_nodes;
+    std::vector<Triangle> m_triangles;
+    std::vector<BuildPrimitive> m_buildPrimitives;
+    QAtomicInt m_numNodes;
+    optix::float3 m_boundsMin;
+    optix::float3 m_boundsMax;
+};
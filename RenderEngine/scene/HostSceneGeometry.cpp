@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "HostSceneGeometry.h"
+#include "math/Sphere.h"
+#include <cmath>
+
+// Spheres are tessellated into SPHERE_SEGMENTS slices and SPHERE_SEGMENTS/2 stacks
+const unsigned int HostSceneGeometry::SPHERE_SEGMENTS = 64;
+
+HostSceneGeometry::HostSceneGeometry()
+{
+
+}
+
+void HostSceneGeometry::clear()
+{
+    m_positions.clear();
+    m_normals.clear();
+    m_texCoords.clear();
+    m_triangles.clear();
+    m_triangleMaterials.clear();
+    m_materials.clear();
+}
+
+unsigned int HostSceneGeometry::addMaterial( const HostMaterial & material )
+{
+    m_materials.push_back(material);
+    return (unsigned int)m_materials.size()-1;
+}
+
+void HostSceneGeometry::addTriangleMesh( const optix::float3* positions, const optix::float3* normals, 
+    const optix::float2* texCoords, unsigned int numVertices, const optix::int3* indices, unsigned int numTriangles,
+    unsigned int materialIndex )
+{
+    int firstVertex = m_positions.size();
+    for(unsigned int i = 0; i < numVertices; i++)
+    {
+        m_positions.push_back(positions[i]);
+        m_normals.push_back(normals[i]);
+        m_texCoords.push_back(texCoords != NULL ? texCoords[i] : optix::make_float2(0.f));
+    }
+    for(unsigned int i = 0; i < numTriangles; i++)
+    {
+        m_triangles.push_back(optix::make_int3(firstVertex + indices[i].x, firstVertex + indices[i].y, firstVertex + indices[i].z));
+        m_triangleMaterials.push_back(materialIndex);
+    }
+}
+
+// Two triangles with the normal of parallelogram.cu, cross(offset1, offset2)
+
+void HostSceneGeometry::addParallelogram( const optix::float3 & anchor, const optix::float3 & offset1, 
+    const optix::float3 & offset2, unsigned int materialIndex )
+{
+    optix::float3 normal = optix::normalize(optix::cross(offset1, offset2));
+    optix::float3 positions[4] = { anchor, anchor + offset1, anchor + offset1 + offset2, anchor + offset2 };
+    optix::float3 normals[4] = { normal, normal, normal, normal };
+    optix::float2 texCoords[4] = { optix::make_float2(0, 0), optix::make_float2(1, 0), optix::make_float2(1, 1), optix::make_float2(0, 1) };
+    optix::int3 indices[2] = { optix::make_int3(0, 1, 2), optix::make_int3(0, 2, 3) };
+    addTriangleMesh(positions, normals, texCoords, 4, indices, 2, materialIndex);
+}
+
+void HostSceneGeometry::addSphere( const Sphere & sphere, unsigned int materialIndex )
+{
+    const unsigned int numSlices = SPHERE_SEGMENTS;
+    const unsigned int numStacks = SPHERE_SEGMENTS/2;
+    const optix::float3 center = sphere.center;
+
+    QVector<optix::float3> positions;
+    QVector<optix::float3> normals;
+    QVector<optix::float2> texCoords;
+    for(unsigned int stack = 0; stack <= numStacks; stack++)
+    {
+        float theta = M_PIf*stack/numStacks;
+        for(unsigned int slice = 0; slice <= numSlices; slice++)
+        {
+            float phi = 2.f*M_PIf*slice/numSlices;
+            optix::float3 normal = optix::make_float3(sinf(theta)*cosf(phi), cosf(theta), sinf(theta)*sinf(phi));
+            positions.push_back(center + sphere.radius*normal);
+            normals.push_back(normal);
+            texCoords.push_back(optix::make_float2(float(slice)/numSlices, float(stack)/numStacks));
+        }
+    }
+
+    // Counter clockwise seen from outside, so the geometric normal points outwards like the shading normal
+    QVector<optix::int3> indices;
+    for(unsigned int stack = 0; stack < numStacks; stack++)
+    {
+        for(unsigned int slice = 0; slice < numSlices; slice++)
+        {
+            int i0 = stack*(numSlices+1) + slice;
+            int i1 = i0 + 1;
+            int i2 = i0 + numSlices + 1;
+            int i3 = i2 + 1;
+            if(stack > 0)
+            {
+                indices.push_back(optix::make_int3(i0, i1, i2));
+            }
+            if(stack < numStacks-1)
+            {
+                indices.push_back(optix::make_int3(i1, i3, i2));
+            }
+        }
+    }
+
+    addTriangleMesh(positions.constData(), normals.constData(), texCoords.constData(), positions.size(),
+        indices.constData(), indices.size(), materialIndex);
+}
+
+unsigned int HostSceneGeometry::getNumTriangles() const
+{
+    return (unsigned int)m_triangles.size();
+}
+
+const QVector<optix::float3> & HostSceneGeometry::getPositions() const
+{
+    return m_positions;
+}
+
+const QVector<optix::float3> & HostSceneGeometry::getNormals() const
+{
+    return m_normals;
+}
+
+const QVector<optix::float2> & HostSceneGeometry::getTexCoords() const
+{
+    return m_texCoords;
+}
+
+const QVector<optix::int3> & HostSceneGeometry::getTriangles() const
+{
+    return m_triangles;
+}
+
+const QVector<unsigned int> & HostSceneGeometry::getTriangleMaterials() const
+{
+    return m_triangleMaterials;
+}
+
+const QVector<HostMaterial> & HostSceneGeometry::getMaterials() const
+{
+    return m_materials;
+}
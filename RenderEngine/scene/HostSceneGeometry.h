@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixu_math_namespace.h>
+#include <QVector>
+#include "render_engine_export_api.h"
+#include "material/HostMaterial.h"
+
+class Sphere;
+
+/*
+Host copy of the scene geometry for the renderers that run without OptiX (HostPathTracer): a single triangle soup
+with per-vertex normals and texture coordinates, and a material index per triangle. Parallelograms and spheres of the
+procedural scenes are converted to triangles.
+*/
+
+class HostSceneGeometry
+{
+public:
+    RENDER_ENGINE_EXPORT_API HostSceneGeometry();
+    RENDER_ENGINE_EXPORT_API void clear();
+    RENDER_ENGINE_EXPORT_API unsigned int addMaterial(const HostMaterial & material);
+    // texCoords may be NULL
+    RENDER_ENGINE_EXPORT_API void addTriangleMesh(const optix::float3* positions, const optix::float3* normals,
+        const optix::float2* texCoords, unsigned int numVertices, const optix::int3* indices, unsigned int numTriangles,
+        unsigned int materialIndex);
+    RENDER_ENGINE_EXPORT_API void addParallelogram(const optix::float3 & anchor, const optix::float3 & offset1,
+        const optix::float3 & offset2, unsigned int materialIndex);
+    RENDER_ENGINE_EXPORT_API void addSphere(const Sphere & sphere, unsigned int materialIndex);
+
+    RENDER_ENGINE_EXPORT_API unsigned int getNumTriangles() const;
+    RENDER_ENGINE_EXPORT_API const QVector<optix::float3> & getPositions() const;
+    RENDER_ENGINE_EXPORT_API const QVector<optix::float3> & getNormals() const;
+    RENDER_ENGINE_EXPORT_API const QVector<optix::float2> & getTexCoords() const;
+    RENDER_ENGINE_EXPORT_API const QVector<optix::int3> & getTriangles() const;
+    RENDER_ENGINE_EXPORT_API const QVector<unsigned int> & getTriangleMaterials() const;
+    RENDER_ENGINE_EXPORT_API const QVector<HostMaterial> & getMaterials() const;
+
+    const static unsigned int SPHERE_SEGMENTS;
+
+private:
+    QVector<optix::float3> m_positions;
+    QVector<optix::float3> m_normals;
+    QVector<optix::float2> m_texCoords;
+    QVector<optix::int3> m_triangles;
+    QVector<unsigned int> m_triangleMaterials;
+    QVector<HostMaterial> m_materials;
+};
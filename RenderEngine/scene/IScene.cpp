@@ -18,6 +18,11 @@ IScene::~IScene()
 
 }
 
+void IScene::getHostSceneGeometry( HostSceneGeometry & geometry ) const
+{
+    throw std::exception("This scene has no host geometry.");
+}
+
 // This base implementation finds a initial PPM radius by looking at the scene extent
 
 float IScene::getSceneInitialPPMRadiusEstimate() const
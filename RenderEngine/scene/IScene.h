@@ -13,12 +13,16 @@
 #include "render_engine_export_api.h"
 #include "math/AAB.h"
 
+class HostSceneGeometry;
+
 class IScene
 {
 public:
     RENDER_ENGINE_EXPORT_API IScene();
     RENDER_ENGINE_EXPORT_API virtual ~IScene();
     RENDER_ENGINE_EXPORT_API virtual optix::Group getSceneRootGroup(optix::Context & context) = 0;
+    // Fill geometry with the triangles of the scene for the host renderer. Throws std::exception if the scene has no host geometry
+    RENDER_ENGINE_EXPORT_API virtual void getHostSceneGeometry(HostSceneGeometry & geometry) const;
     RENDER_ENGINE_EXPORT_API virtual const QVector<Light> & getSceneLights() const = 0;
     RENDER_ENGINE_EXPORT_API virtual Camera getDefaultCamera() const = 0;
     RENDER_ENGINE_EXPORT_API virtual const char* getSceneName() const = 0;
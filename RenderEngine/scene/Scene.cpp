@@ -21,6 +21,7 @@
 #include "material/Texture.h"
 #include "material/ParticipatingMedium.h"
 #include "geometry_instance/AABInstance.h"
+#include "HostSceneGeometry.h"
 #include "config.h"
 #include <cstdio>
 
@@ -358,6 +359,44 @@ optix::Group Scene::getSceneRootGroup( optix::Context & context )
     return rootNodeGroup;
 }
 
+void Scene::getHostSceneGeometry( HostSceneGeometry & geometry ) const
+{
+    geometry.clear();
+    for(int i = 0; i < m_materials.size(); i++)
+    {
+        geometry.addMaterial(m_materials.at(i)->getHostMaterial());
+    }
+
+    // The vertices are pre-transformed by Assimp (aiProcess_PreTransformVertices), so the meshes can be copied as they are
+
+    for(unsigned int i = 0; i < m_scene->mNumMeshes; i++)
+    {
+        aiMesh* mesh = m_scene->mMeshes[i];
+        QVector<optix::int3> indices(mesh->mNumFaces);
+        for(unsigned int j = 0; j < mesh->mNumFaces; j++)
+        {
+            aiFace face = mesh->mFaces[j];
+            indices[j] = optix::make_int3(face.mIndices[0], face.mIndices[1], face.mIndices[2]);
+        }
+
+        QVector<optix::float2> texCoords;
+        if(mesh->HasTextureCoords(0))
+        {
+            texCoords.resize(mesh->mNumVertices);
+            for(unsigned int j = 0; j < mesh->mNumVertices; j++)
+            {
+                aiVector3D texCoord = (mesh->mTextureCoords[0])[j];
+                texCoords[j] = optix::make_float2(texCoord.x, texCoord.y);
+            }
+        }
+
+        geometry.addTriangleMesh(reinterpret_cast<const optix::float3*>(mesh->mVertices), 
+            reinterpret_cast<const optix::float3*>(mesh->mNormals), 
+            texCoords.size() > 0 ? texCoords.constData() : NULL, mesh->mNumVertices, 
+            indices.constData(), mesh->mNumFaces, mesh->mMaterialIndex);
+    }
+}
+
 optix::Geometry Scene::createGeometryFromMesh(uint meshId, aiMesh* mesh, optix::Context & context)
 {
     unsigned int numFaces = mesh->mNumFaces;
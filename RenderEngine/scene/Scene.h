@@ -33,6 +33,7 @@ public:
     RENDER_ENGINE_EXPORT_API virtual ~Scene(void);
     RENDER_ENGINE_EXPORT_API static IScene* createFromFile(const char* file);
     virtual optix::Group getSceneRootGroup(optix::Context & context);
+    virtual void getHostSceneGeometry(HostSceneGeometry & geometry) const;
     void loadDefaultSceneCamera();
     virtual const QVector<Light> & getSceneLights() const;
     virtual Camera getDefaultCamera() const;
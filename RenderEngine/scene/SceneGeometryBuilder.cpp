@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "SceneGeometryBuilder.h"
+#include "HostSceneGeometry.h"
+#include "geometry_instance/SphereInstance.h"
+#include "material/Material.h"
+#include "math/Sphere.h"
+
+SceneGeometryBuilder::~SceneGeometryBuilder()
+{
+
+}
+
+OptixSceneGeometryBuilder::OptixSceneGeometryBuilder( optix::Context & context )
+    : m_context(context)
+{
+    m_pgram_bounding_box = context->createProgramFromPTXFile( "parallelogram.cu.ptx", "bounds" );
+    m_pgram_intersection = context->createProgramFromPTXFile( "parallelogram.cu.ptx", "intersect" );
+}
+
+void OptixSceneGeometryBuilder::addParallelogram( unsigned int meshId, const optix::float3 & anchor, 
+    const optix::float3 & offset1, const optix::float3 & offset2, Material & material )
+{
+    optix::Geometry parallelogram = m_context->createGeometry();
+    parallelogram->setPrimitiveCount( 1u );
+    parallelogram->setIntersectionProgram( m_pgram_intersection );
+    parallelogram->setBoundingBoxProgram( m_pgram_bounding_box );
+
+    optix::float3 normal = optix::normalize( optix::cross( offset1, offset2 ) );
+    float d = optix::dot( normal, anchor );
+    optix::float4 plane = optix::make_float4( normal, d );
+
+    optix::float3 v1 = offset1 / optix::dot( offset1, offset1 );
+    optix::float3 v2 = offset2 / optix::dot( offset2, offset2 );
+
+    parallelogram["meshId"]->setUint(meshId);
+    parallelogram["plane"]->setFloat( plane );
+    parallelogram["anchor"]->setFloat( anchor );
+    parallelogram["v1"]->setFloat( v1 );
+    parallelogram["v2"]->setFloat( v2 );
+
+    optix::Material matl = material.getOptixMaterial(m_context);
+
+    optix::GeometryInstance gi = m_context->createGeometryInstance( parallelogram, &matl, &matl+1 );
+    material.registerGeometryInstanceValues(gi);
+    m_geometryInstances.push_back(gi);
+}
+
+void OptixSceneGeometryBuilder::addSphere( const Sphere & sphere, Material & material )
+{
+    SphereInstance instance = SphereInstance(material, sphere);
+    m_geometryInstances.push_back(instance.getOptixGeometryInstance(m_context));
+}
+
+optix::Group OptixSceneGeometryBuilder::createSceneRootGroup()
+{
+    optix::GeometryGroup geometry_group = m_context->createGeometryGroup();
+    geometry_group->setChildCount( static_cast<unsigned int>( m_geometryInstances.size() ) );
+    for (int i = 0; i < m_geometryInstances.size(); ++i )
+        geometry_group->setChild( i, m_geometryInstances[i] );
+
+    geometry_group->setAcceleration(m_context->createAcceleration("NoAccel", "NoAccel")); // Bvh Sbvh Trbvh NoAccel
+
+    optix::Group gro = m_context->createGroup();
+    gro->setChildCount(1);
+    gro->setChild(0, geometry_group);
+    optix::Acceleration acceleration = m_context->createAcceleration("NoAccel", "NoAccel"); // Bvh BvhCompact NoAccel
+    gro->setAcceleration(acceleration);
+
+    return gro;
+}
+
+HostSceneGeometryBuilder::HostSceneGeometryBuilder( HostSceneGeometry & geometry )
+    : m_geometry(geometry)
+{
+
+}
+
+void HostSceneGeometryBuilder::addParallelogram( unsigned int meshId, const optix::float3 & anchor, 
+    const optix::float3 & offset1, const optix::float3 & offset2, Material & material )
+{
+    m_geometry.addParallelogram(anchor, offset1, offset2, getMaterialIndex(material));
+}
+
+void HostSceneGeometryBuilder::addSphere( const Sphere & sphere, Material & material )
+{
+    m_geometry.addSphere(sphere, getMaterialIndex(material));
+}
+
+unsigned int HostSceneGeometryBuilder::getMaterialIndex( const Material & material )
+{
+    if(!m_materialIndices.contains(&material))
+    {
+        m_materialIndices.insert(&material, m_geometry.addMaterial(material.getHostMaterial()));
+    }
+    return m_materialIndices.value(&material);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <optixu/optixpp_namespace.h>
+#include <QVector>
+#include <QHash>
+
+class Material;
+class Sphere;
+class HostSceneGeometry;
+
+/*
+The procedural scenes (Cornell, CornellSmall) describe their geometry once to a SceneGeometryBuilder, which either
+creates the OptiX geometry instances or fills a HostSceneGeometry for the host renderer.
+*/
+
+class SceneGeometryBuilder
+{
+public:
+    virtual ~SceneGeometryBuilder();
+    virtual void addParallelogram(unsigned int meshId, const optix::float3 & anchor, const optix::float3 & offset1,
+        const optix::float3 & offset2, Material & material) = 0;
+    virtual void addSphere(const Sphere & sphere, Material & material) = 0;
+};
+
+class OptixSceneGeometryBuilder : public SceneGeometryBuilder
+{
+public:
+    OptixSceneGeometryBuilder(optix::Context & context);
+    virtual void addParallelogram(unsigned int meshId, const optix::float3 & anchor, const optix::float3 & offset1,
+        const optix::float3 & offset2, Material & material);
+    virtual void addSphere(const Sphere & sphere, Material & material);
+    optix::Group createSceneRootGroup();
+
+private:
+    optix::Context m_context;
+    optix::Program m_pgram_bounding_box;
+    optix::Program m_pgram_intersection;
+    QVector<optix::GeometryInstance> m_geometryInstances;
+};
+
+class HostSceneGeometryBuilder : public SceneGeometryBuilder
+{
+public:
+    HostSceneGeometryBuilder(HostSceneGeometry & geometry);
+    virtual void addParallelogram(unsigned int meshId, const optix::float3 & anchor, const optix::float3 & offset1,
+        const optix::float3 & offset2, Material & material);
+    virtual void addSphere(const Sphere & sphere, Material & material);
+
+private:
+    unsigned int getMaterialIndex(const Material & material);
+    HostSceneGeometry & m_geometry;
+    QHash<const Material*, unsigned int> m_materialIndices;
+};
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "RenderTrace.h"
+#include <cstring>
+#include <exception>
+#include <QFile>
+#include <QDataStream>
+#include "renderer/helpers/nsight.h"
+
+const unsigned int RenderTrace::DEFAULT_CAPACITY = 16*1024;
+
+RenderTrace::ScopedEvent::ScopedEvent(RenderTrace & trace, const char* name, unsigned long long numElements,
+    unsigned long long numBytes)
+    : m_trace(trace),
+      m_name(name),
+      m_startNanoseconds(trace.getNanoseconds()),
+      m_numElements(numElements),
+      m_numBytes(numBytes)
+{
+    nvtx::RangePush(name);
+}
+
+RenderTrace::ScopedEvent::~ScopedEvent()
+{
+    nvtx::RangePop();
+    m_trace.record(m_name, m_startNanoseconds, m_trace.getNanoseconds() - m_startNanoseconds, m_numElements, m_numBytes);
+}
+
+void RenderTrace::ScopedEvent::setNumElements(unsigned long long numElements)
+{
+    m_numElements = numElements;
+}
+
+void RenderTrace::ScopedEvent::setNumBytes(unsigned long long numBytes)
+{
+    m_numBytes = numBytes;
+}
+
+RenderTrace::RenderTrace(unsigned int capacity)
+    : m_events(capacity > 0 ? capacity : 1),
+      m_numRecordedEvents(0),
+      m_iterationNumber(0),
+      m_enabled(true)
+{
+    m_timer.start();
+}
+
+void RenderTrace::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool RenderTrace::isEnabled() const
+{
+    return m_enabled;
+}
+
+void RenderTrace::setIterationNumber(unsigned long long iterationNumber)
+{
+    m_iterationNumber = iterationNumber;
+}
+
+void RenderTrace::record(const char* name, qint64 startNanoseconds, qint64 durationNanoseconds, unsigned long long numElements,
+    unsigned long long numBytes)
+{
+    if(!m_enabled)
+    {
+        return;
+    }
+    QMutexLocker lock(&m_mutex);
+    Event & event = m_events[int(m_numRecordedEvents % m_events.size())];
+    event.name = name;
+    event.iterationNumber = m_iterationNumber;
+    event.startNanoseconds = startNanoseconds;
+    event.durationNanoseconds = durationNanoseconds;
+    event.numElements = numElements;
+    event.numBytes = numBytes;
+    m_numRecordedEvents++;
+}
+
+qint64 RenderTrace::getNanoseconds() const
+{
+    return m_timer.nsecsElapsed();
+}
+
+void RenderTrace::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_numRecordedEvents = 0;
+}
+
+unsigned long long RenderTrace::getNumRecordedEvents() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_numRecordedEvents;
+}
+
+QVector<RenderTrace::Event> RenderTrace::getEvents(unsigned long long firstEvent) const
+{
+    QMutexLocker lock(&m_mutex);
+    unsigned long long capacity = m_events.size();
+    unsigned long long oldestEvent = m_numRecordedEvents > capacity ? m_numRecordedEvents - capacity : 0;
+    QVector<Event> events;
+    for(unsigned long long i = firstEvent > oldestEvent ? firstEvent : oldestEvent; i < m_numRecordedEvents; i++)
+    {
+        events.push_back(m_events[int(i % capacity)]);
+    }
+    return events;
+}
+
+RenderTraceSummary RenderTrace::summarize(unsigned long long firstEvent) const
+{
+    QVector<Event> events = getEvents(firstEvent);
+    RenderTraceSummary summary;
+    for(int i = 0; i < events.size(); i++)
+    {
+        summary.add(events[i].name, 1, events[i].durationNanoseconds*1e-9, events[i].numElements, events[i].numBytes);
+    }
+    return summary;
+}
+
+// Chrome trace event format: complete events ("ph":"X") with times in microseconds, one process and thread since the
+// renderer runs its passes one after another
+
+QByteArray RenderTrace::toChromeTraceJson() const
+{
+    QVector<Event> events = getEvents();
+    QByteArray json;
+    json.reserve(events.size()*160 + 64);
+    json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for(int i = 0; i < events.size(); i++)
+    {
+        const Event & event = events[i];
+        QByteArray name(event.name);
+        name.replace('\\', "\\\\").replace('"', "\\\"");
+        json += (i > 0 ? ",\n" : "\n");
+        json += "{\"name\":\"" + name + "\",\"cat\":\"render\",\"ph\":\"X\",\"pid\":0,\"tid\":0";
+        json += ",\"ts\":" + QByteArray::number(event.startNanoseconds*1e-3, 'f', 3);
+        json += ",\"dur\":" + QByteArray::number(event.durationNanoseconds*1e-3, 'f', 3);
+        json += ",\"args\":{\"iteration\":" + QByteArray::number(event.iterationNumber);
+        json += ",\"elements\":" + QByteArray::number(event.numElements);
+        json += ",\"bytes\":" + QByteArray::number(event.numBytes) + "}}";
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+void RenderTrace::saveChromeTrace(const QString & fileName) const
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        throw std::exception("Could not open the render trace file for writing.");
+    }
+    QByteArray json = toChromeTraceJson();
+    if(file.write(json) != json.size())
+    {
+        throw std::exception("Could not write the render trace file.");
+    }
+}
+
+void RenderTraceSummary::add(const char* name, unsigned int count, double seconds, unsigned long long numElements,
+    unsigned long long numBytes)
+{
+    int index = 0;
+    while(index < m_passes.size() && m_passes[index].name != name)
+    {
+        index++;
+    }
+    if(index == m_passes.size())
+    {
+        Pass pass;
+        pass.name = name;
+        pass.count = 0;
+        pass.seconds = 0;
+        pass.numElements = 0;
+        pass.numBytes = 0;
+        m_passes.push_back(pass);
+    }
+    Pass & pass = m_passes[index];
+    pass.count += count;
+    pass.seconds += seconds;
+    pass.numElements += numElements;
+    pass.numBytes += numBytes;
+}
+
+void RenderTraceSummary::merge(const RenderTraceSummary & other)
+{
+    for(int i = 0; i < other.m_passes.size(); i++)
+    {
+        const Pass & pass = other.m_passes[i];
+        add(pass.name.constData(), pass.count, pass.seconds, pass.numElements, pass.numBytes);
+    }
+}
+
+const QVector<RenderTraceSummary::Pass> & RenderTraceSummary::getPasses() const
+{
+    return m_passes;
+}
+
+bool RenderTraceSummary::isEmpty() const
+{
+    return m_passes.isEmpty();
+}
+
+QString RenderTraceSummary::toString() const
+{
+    QString string;
+    for(int i = 0; i < m_passes.size(); i++)
+    {
+        const Pass & pass = m_passes[i];
+        string += QString("%1%2: %3x %4 ms (%5 ms avg), %6 elements, %7 MB")
+            .arg(i > 0 ? "\n" : "")
+            .arg(QString(pass.name))
+            .arg(pass.count)
+            .arg(pass.seconds*1000, 0, 'f', 1)
+            .arg(pass.count > 0 ? pass.seconds*1000/pass.count : 0, 0, 'f', 2)
+            .arg(pass.numElements)
+            .arg(pass.numBytes/double(1024*1024), 0, 'f', 1);
+    }
+    return string;
+}
+
+QDataStream & operator << (QDataStream & out, const RenderTraceSummary & summary)
+{
+    const QVector<RenderTraceSummary::Pass> & passes = summary.getPasses();
+    out << (quint32)passes.size();
+    for(int i = 0; i < passes.size(); i++)
+    {
+        out << passes[i].name << (quint32)passes[i].count << passes[i].seconds << (quint64)passes[i].numElements
+            << (quint64)passes[i].numBytes;
+    }
+    return out;
+}
+
+QDataStream & operator >> (QDataStream & in, RenderTraceSummary & summary)
+{
+    summary = RenderTraceSummary();
+    quint32 numPasses = 0;
+    in >> numPasses;
+    for(quint32 i = 0; i < numPasses && in.status() == QDataStream::Ok; i++)
+    {
+        QByteArray name;
+        quint32 count;
+        double seconds;
+        quint64 numElements, numBytes;
+        in >> name >> count >> seconds >> numElements >> numBytes;
+        summary.add(name.constData(), count, seconds, numElements, numBytes);
+    }
+    return in;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <QByteArray>
+#include <QVector>
+#include <QString>
+#include <QMutex>
+#include <QElapsedTimer>
+#include "render_engine_export_api.h"
+
+class RenderTraceSummary;
+
+/*
+Record of where the renderer spends its time. Every pass of an iteration (a launch, a photon map build, a buffer
+readback) is an event with its wall time, the number of elements it processed and the bytes it moved between host and
+device. Events go to a fixed size ring buffer, so recording does not allocate and the oldest events are overwritten.
+
+The buffer can be saved as a Chrome trace (JSON object format, open it in chrome://tracing) or summarized per pass.
+Servers send the summary of the iterations of a packet back to the client in the RenderResultPacket.
+
+Event names must be string literals, only the pointer is stored.
+*/
+
+class RenderTrace
+{
+public:
+    struct Event
+    {
+        const char* name;
+        unsigned long long iterationNumber;
+        qint64 startNanoseconds;
+        qint64 durationNanoseconds;
+        unsigned long long numElements;
+        unsigned long long numBytes;
+    };
+
+    // Records the time from construction to destruction as one event, also as an NVTX range for Nsight
+    class ScopedEvent
+    {
+    public:
+        RENDER_ENGINE_EXPORT_API ScopedEvent(RenderTrace & trace, const char* name, unsigned long long numElements = 0,
+            unsigned long long numBytes = 0);
+        RENDER_ENGINE_EXPORT_API ~ScopedEvent();
+        RENDER_ENGINE_EXPORT_API void setNumElements(unsigned long long numElements);
+        RENDER_ENGINE_EXPORT_API void setNumBytes(unsigned long long numBytes);
+    private:
+        RenderTrace & m_trace;
+        const char* m_name;
+        qint64 m_startNanoseconds;
+        unsigned long long m_numElements;
+        unsigned long long m_numBytes;
+        ScopedEvent(const ScopedEvent &);
+        ScopedEvent & operator=(const ScopedEvent &);
+    };
+
+    RENDER_ENGINE_EXPORT_API RenderTrace(unsigned int capacity = DEFAULT_CAPACITY);
+    RENDER_ENGINE_EXPORT_API void setEnabled(bool enabled);
+    RENDER_ENGINE_EXPORT_API bool isEnabled() const;
+    // The iteration the following events belong to
+    RENDER_ENGINE_EXPORT_API void setIterationNumber(unsigned long long iterationNumber);
+    RENDER_ENGINE_EXPORT_API void record(const char* name, qint64 startNanoseconds, qint64 durationNanoseconds,
+        unsigned long long numElements = 0, unsigned long long numBytes = 0);
+    // Time since the trace was created, the clock of the events
+    RENDER_ENGINE_EXPORT_API qint64 getNanoseconds() const;
+    RENDER_ENGINE_EXPORT_API void clear();
+
+    // Events are numbered in the order they are recorded, these count all events ever recorded
+    RENDER_ENGINE_EXPORT_API unsigned long long getNumRecordedEvents() const;
+    // The events from number firstEvent on that are still in the buffer, oldest first
+    RENDER_ENGINE_EXPORT_API QVector<Event> getEvents(unsigned long long firstEvent = 0) const;
+    RENDER_ENGINE_EXPORT_API RenderTraceSummary summarize(unsigned long long firstEvent = 0) const;
+    RENDER_ENGINE_EXPORT_API QByteArray toChromeTraceJson() const;
+    // Throws std::exception if the file cannot be written
+    RENDER_ENGINE_EXPORT_API void saveChromeTrace(const QString & fileName) const;
+
+    RENDER_ENGINE_EXPORT_API const static unsigned int DEFAULT_CAPACITY;
+
+private:
+    mutable QMutex m_mutex;
+    QElapsedTimer m_timer;
+    QVector<Event> m_events;
+    unsigned long long m_numRecordedEvents;
+    unsigned long long m_iterationNumber;
+    bool m_enabled;
+};
+
+/*
+Events of a trace added up per pass name, in the order the passes first appear.
+*/
+
+class RenderTraceSummary
+{
+public:
+    struct Pass
+    {
+        QByteArray name;
+        unsigned int count;
+        double seconds;
+        unsigned long long numElements;
+        unsigned long long numBytes;
+    };
+
+    RENDER_ENGINE_EXPORT_API void add(const char* name, unsigned int count, double seconds, unsigned long long numElements,
+        unsigned long long numBytes);
+    RENDER_ENGINE_EXPORT_API void merge(const RenderTraceSummary & other);
+    RENDER_ENGINE_EXPORT_API const QVector<Pass> & getPasses() const;
+    RENDER_ENGINE_EXPORT_API bool isEmpty() const;
+    // One line per pass: count, total and average milliseconds, elements and MB
+    RENDER_ENGINE_EXPORT_API QString toString() const;
+
+private:
+    QVector<Pass> m_passes;
+};
+
+class QDataStream;
+RENDER_ENGINE_EXPORT_API QDataStream & operator << (QDataStream & out, const RenderTraceSummary & summary);
+RENDER_ENGINE_EXPORT_API QDataStream & operator >> (QDataStream & in, RenderTraceSummary & summary);
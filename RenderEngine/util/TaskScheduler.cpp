@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#include "TaskScheduler.h"
+#include <QThread>
+#include <QMutexLocker>
+
+class TaskScheduler::WorkerThread : public QThread
+{
+public:
+    WorkerThread(TaskScheduler & scheduler, int queueIndex)
+        : m_scheduler(scheduler), m_queueIndex(queueIndex)
+    {
+
+    }
+
+    TaskScheduler & getScheduler() const
+    {
+        return m_scheduler;
+    }
+
+    int getQueueIndex() const
+    {
+        return m_queueIndex;
+    }
+
+protected:
+    virtual void run()
+    {
+        m_scheduler.workerLoop(m_queueIndex);
+    }
+
+private:
+    TaskScheduler & m_scheduler;
+    int m_queueIndex;
+};
+
+TaskGroup::TaskGroup()
+    : m_scheduler(TaskScheduler::get()), m_numPending(0)
+{
+
+}
+
+TaskGroup::TaskGroup(TaskScheduler & scheduler)
+    : m_scheduler(scheduler), m_numPending(0)
+{
+
+}
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+void TaskGroup::run(Task & task)
+{
+    task.m_group = this;
+    m_numPending.ref();
+    m_scheduler.push(&task);
+}
+
+void TaskGroup::wait()
+{
+    const int queueIndex = m_scheduler.currentQueueIndex();
+    while(m_numPending.load() > 0)
+    {
+        if(!m_scheduler.executeOne(queueIndex))
+        {
+            QThread::yieldCurrentThread();
+        }
+    }
+}
+
+TaskScheduler::TaskScheduler(unsigned int numWorkerThreads)
+    : m_numQueued(0),
+      m_shutdown(0)
+{
+    for(unsigned int i = 0; i < numWorkerThreads+1; ++i)
+    {
+        TaskQueue* queue = new TaskQueue();
+        queue->head = 0;
+        m_queues.push_back(queue);
+    }
+
+    for(unsigned int i = 0; i < numWorkerThreads; ++i)
+    {
+        WorkerThread* worker = new WorkerThread(*this, i);
+        worker->setObjectName(QString("TaskScheduler::Worker %1").arg(i));
+        m_workers.push_back(worker);
+        worker->start();
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        QMutexLocker lock(&m_sleepMutex);
+        m_shutdown.store(1);
+        m_wakeUp.wakeAll();
+    }
+
+    for(size_t i = 0; i < m_workers.size(); ++i)
+    {
+        m_workers[i]->wait();
+        delete m_workers[i];
+    }
+
+    for(size_t i = 0; i < m_queues.size(); ++i)
+    {
+        delete m_queues[i];
+    }
+}
+
+TaskScheduler & TaskScheduler::get()
+{
+    // Intentionally never destroyed: joining the worker threads while the DLL is being unloaded
+    // would dead lock on the loader lock.
+    static TaskScheduler* scheduler = new TaskScheduler(QThread::idealThreadCount() > 1 ? QThread::idealThreadCount()-1 : 0);
+    return *scheduler;
+}
+
+unsigned int TaskScheduler::getNumThreads() const
+{
+    return (unsigned int)m_workers.size() + 1;
+}
+
+int TaskScheduler::currentQueueIndex() const
+{
+    WorkerThread* worker = dynamic_cast<WorkerThread*>(QThread::currentThread());
+    if(worker != NULL && &worker->getScheduler() == this)
+    {
+        return worker->getQueueIndex();
+    }
+    return (int)m_queues.size()-1;
+}
+
+void TaskScheduler::push(Task* task)
+{
+    TaskQueue & queue = *m_queues[currentQueueIndex()];
+    {
+        QMutexLocker lock(&queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    m_numQueued.ref();
+
+    QMutexLocker lock(&m_sleepMutex);
+    m_wakeUp.wakeOne();
+}
+
+// Owner end of the deque: newest task first (depth first, good locality)
+Task* TaskScheduler::pop(int queueIndex)
+{
+    TaskQueue & queue = *m_queues[queueIndex];
+    QMutexLocker lock(&queue.mutex);
+    if(queue.head == queue.tasks.size())
+    {
+        return NULL;
+    }
+    Task* task = queue.tasks.back();
+    queue.tasks.pop_back();
+    if(queue.head == queue.tasks.size())
+    {
+        queue.tasks.clear();
+        queue.head = 0;
+    }
+    return task;
+}
+
+// Thief end of the deque: oldest task first, which is the largest piece of work in recursive algorithms
+Task* TaskScheduler::steal(int thiefIndex)
+{
+    const int numQueues = (int)m_queues.size();
+    for(int i = 1; i <= numQueues; ++i)
+    {
+        TaskQueue & queue = *m_queues[(thiefIndex + i) % numQueues];
+        QMutexLocker lock(&queue.mutex);
+        if(queue.head < queue.tasks.size())
+        {
+            Task* task = queue.tasks[queue.head++];
+            if(queue.head == queue.tasks.size())
+            {
+                queue.tasks.clear();
+                queue.head = 0;
+            }
+            return task;
+        }
+    }
+    return NULL;
+}
+
+bool TaskScheduler::executeOne(int queueIndex)
+{
+    if(m_numQueued.load() == 0)
+    {
+        return false;
+    }
+
+    Task* task = pop(queueIndex);
+    if(task == NULL)
+    {
+        task = steal(queueIndex);
+    }
+    if(task == NULL)
+    {
+        return false;
+    }
+
+    m_numQueued.deref();
+    execute(task);
+    return true;
+}
+
+void TaskScheduler::execute(Task* task)
+{
+    TaskGroup* group = task->m_group;
+    task->run();
+    group->m_numPending.deref();
+}
+
+void TaskScheduler::workerLoop(int queueIndex)
+{
+    while(m_shutdown.load() == 0)
+    {
+        if(executeOne(queueIndex))
+        {
+            continue;
+        }
+
+        QMutexLocker lock(&m_sleepMutex);
+        if(m_numQueued.load() == 0 && m_shutdown.load() == 0)
+        {
+            m_wakeUp.wait(&m_sleepMutex);
+        }
+    }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2014 Opposite Renderer
+ * For the full copyright and license information, please view the LICENSE.txt
+ * file that was distributed with this source code.
+*/
+
+#pragma once
+#include <vector>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+#include "render_engine_export_api.h"
+
+/*
+Host side fork/join task scheduler used by the CPU parts of the renderer (kd-tree build etc.).
+
+Each worker thread owns a task deque. A worker pops the newest task from its own deque and, when that is empty,
+steals the oldest task from another worker. Threads that are not workers (the render thread) push into a shared
+deque and help executing tasks while they wait on a TaskGroup, so the calling thread is never idle.
+
+Tasks are not owned by the scheduler; the caller keeps them alive (usually on the stack) until TaskGroup::wait()
+returns. This way recursive algorithms can fork without allocating.
+*/
+
+class TaskGroup;
+class TaskScheduler;
+
+class Task
+{
+public:
+    Task() : m_group(NULL) {}
+    virtual ~Task() {}
+    virtual void run() = 0;
+private:
+    friend class TaskGroup;
+    friend class TaskScheduler;
+    TaskGroup* m_group;
+};
+
+class TaskGroup
+{
+public:
+    RENDER_ENGINE_EXPORT_API TaskGroup();
+    RENDER_ENGINE_EXPORT_API TaskGroup(TaskScheduler & scheduler);
+    RENDER_ENGINE_EXPORT_API ~TaskGroup();
+    // Schedule task for execution. The task must stay alive until wait() returns.
+    RENDER_ENGINE_EXPORT_API void run(Task & task);
+    // Block until all tasks in this group are finished, executing pending tasks in the meantime.
+    RENDER_ENGINE_EXPORT_API void wait();
+private:
+    friend class TaskScheduler;
+    TaskScheduler & m_scheduler;
+    QAtomicInt m_numPending;
+};
+
+class TaskScheduler
+{
+public:
+    RENDER_ENGINE_EXPORT_API TaskScheduler(unsigned int numWorkerThreads);
+    RENDER_ENGINE_EXPORT_API ~TaskScheduler();
+    RENDER_ENGINE_EXPORT_API static TaskScheduler & get();
+
+    // Number of threads executing tasks, including the calling thread
+    RENDER_ENGINE_EXPORT_API unsigned int getNumThreads() const;
+
+    // Calls body(from, to) for consecutive sub ranges of [begin, end) no larger than grainSize.
+    // Chunks are handed out dynamically so uneven work per element is balanced between threads.
+    template<typename Body> void parallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const Body & body);
+
+private:
+    class WorkerThread;
+    friend class TaskGroup;
+    friend class WorkerThread;
+
+    struct TaskQueue
+    {
+        QMutex mutex;
+        std::vector<Task*> tasks;
+        unsigned int head;
+    };
+
+    void push(Task* task);
+    Task* pop(int queueIndex);
+    Task* steal(int thiefIndex);
+    bool executeOne(int queueIndex);
+    void execute(Task* task);
+    int currentQueueIndex() const;
+    void workerLoop(int queueIndex);
+
+    std::vector<TaskQueue*> m_queues; // one per worker, the last one is shared by non-worker threads
+    std::vector<WorkerThread*> m_workers;
+    QAtomicInt m_numQueued;
+    QAtomicInt m_shutdown;
+    QMutex m_sleepMutex;
+    QWaitCondition m_wakeUp;
+};
+
+template<typename Body>
+class ParallelForTask : public Task
+{
+public:
+    ParallelForTask() : m_body(NULL), m_next(NULL) {}
+    void set(const Body* body, QAtomicInt* next, unsigned int end, unsigned int grainSize)
+    {
+        m_body = body;
+        m_next = next;
+        m_end = end;
+        m_grainSize = grainSize;
+    }
+    virtual void run()
+    {
+        for(;;)
+        {
+            unsigned int from = (unsigned int)m_next->fetchAndAddOrdered((int)m_grainSize);
+            if(from >= m_end)
+            {
+                break;
+            }
+            unsigned int to = from + m_grainSize < m_end ? from + m_grainSize : m_end;
+            (*m_body)(from, to);
+        }
+    }
+private:
+    const Body* m_body;
+    QAtomicInt* m_next;
+    unsigned int m_end;
+    unsigned int m_grainSize;
+};
+
+template<typename Body>
+void TaskScheduler::parallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const Body & body)
+{
+    if(begin >= end)
+    {
+        return;
+    }
+
+    grainSize = grainSize > 0 ? grainSize : 1;
+    unsigned int numChunks = (end - begin + grainSize - 1) / grainSize;
+    unsigned int numTasks = numChunks < getNumThreads() ? numChunks : getNumThreads();
+
+    if(numTasks <= 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    QAtomicInt next((int)begin);
+    std::vector<ParallelForTask<Body> > tasks(numTasks);
+    TaskGroup group(*this);
+    for(unsigned int i = 1; i < numTasks; ++i)
+    {
+        tasks[i].set(&body, &next, end, grainSize);
+        group.run(tasks[i]);
+    }
+
+    // The calling thread takes part in the loop as well
+    tasks[0].set(&body, &next, end, grainSize);
+    tasks[0].run();
+    group.wait();
+}
@@ -8,14 +8,17 @@
 #include "ComputeDevice.h"
 #include <QTcpSocket>
 #include "clientserver/RenderServerRenderRequest.h"
+#include "clientserver/RenderResultPacketEncoding.h"
 #include <QThread>
+#include <cstdio>
 
 RenderServer::RenderServer(void)
     : m_renderState(RenderServerState::NOT_VALID_RENDER_STATE),
       m_clientSocket(NULL),
       m_renderServerRenderer(RenderServerRenderer(*this)),
       m_clientSocketDataStream(NULL),
-      m_clientExpectingBytes(0)
+      m_clientExpectingBytes(0),
+      m_resultEncoding(RenderResultPacketEncoding::FLOAT)
 {
     m_renderServerRendererThread = new QThread();
     m_renderServerRenderer.moveToThread(m_renderServerRendererThread);
@@ -62,6 +65,7 @@ void RenderServer::initializeClient(QTcpSocket & clientSocket)
     setRenderState(RenderServerState::WAITING_FOR_INTRODUCTION_REQUEST);
     m_renderState = RenderServerState::WAITING_FOR_INTRODUCTION_REQUEST;
     m_clientExpectingBytes = 0;
+    m_resultEncoding = RenderResultPacketEncoding::FLOAT;
     m_renderServerRenderer.initializeNewClient();
 }
 
@@ -84,6 +88,16 @@ void RenderServer::onDataFromClient()
                 .arg(m_renderServerRenderer.getComputeDevice().getDeviceId())
                 .arg(m_renderServerRenderer.getComputeDevice().getComputeCapability());
             *m_clientSocketDataStream << computeDeviceName;
+
+            // "GET SERVER DETAILS ENCODING <n>" asks for an encoding of the render result packets. The answer
+            // always ends with the encoding this server will use, raw floats if none was asked for.
+            unsigned int requestedEncoding;
+            if(sscanf(dataPtr, "GET SERVER DETAILS ENCODING %u", &requestedEncoding) == 1)
+            {
+                m_resultEncoding = negotiateRenderResultPacketEncoding(requestedEncoding);
+            }
+            *m_clientSocketDataStream << (quint32)m_resultEncoding;
+            appendToLog(QString("Sending render results as %1.").arg(renderResultPacketEncodingToString(m_resultEncoding)));
             m_clientSocket->waitForBytesWritten();
             setRenderState(RenderServerState::RENDERING);
             return;
@@ -141,6 +155,7 @@ void RenderServer::onNewRenderResultPacket(RenderResultPacket result)
     // object so that the client can see performance measure
     result.setRenderTimeSeconds(getRenderTimeSeconds());
     result.setTotalTimeSeconds(getTotalTimeSeconds());
+    result.setEncoding(m_resultEncoding);
 
     //printf("Sending result it %d size %d to client. Pending: %d\n", result.getIterationNumber(), result.getDirectRadiance().size(), m_pendingRenderCommands);
 
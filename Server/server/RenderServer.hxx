@@ -59,6 +59,7 @@ private:
     QTcpSocket* m_clientSocket;
     QDataStream* m_clientSocketDataStream;
     int m_clientExpectingBytes;
+    unsigned int m_resultEncoding;
 
     RenderServerRenderer m_renderServerRenderer;
     QThread* m_renderServerRendererThread;
@@ -92,7 +92,9 @@ void RenderServerRenderer::onNewRenderCommandInQueue()
         // Process the next RenderServerRenderRequest
 
         RenderServerRenderRequest renderRequest = m_queue.dequeue();
+        RenderTile tile = getRenderTile(renderRequest);
         QString iterationNumbersInPacketString = "";
+        unsigned long long firstTraceEvent = m_renderer.getRenderTrace().getNumRecordedEvents();
 
         for(int i = 0; i < renderRequest.getNumIterations(); i++)
         {            
@@ -113,7 +115,8 @@ void RenderServerRenderer::onNewRenderCommandInQueue()
                 // Render the frame with local iteration number going from 0 to renderRequestsCurrentPacket.size()
                 // We only need to create the output buffer for the last iteration of the packet
                 bool createOutputBuffer = i == renderRequest.getNumIterations() - 1;
-                renderFrame(renderRequest.getIterationNumbers().at(i), i, renderRequest.getPPMRadii().at(i), createOutputBuffer, renderRequest.getDetails());
+                renderFrame(renderRequest.getIterationNumbers().at(i), i, renderRequest.getPPMRadii().at(i), createOutputBuffer, renderRequest.getDetails(),
+                    tile);
                 iterationNumbersInPacketString += " " + QString::number(renderRequest.getIterationNumbers().at(i));
             }
         }
@@ -124,10 +127,16 @@ void RenderServerRenderer::onNewRenderCommandInQueue()
 
         if(renderRequest.getSequenceNumber() == m_currentSequenceNumber)
         {
-            RenderResultPacket result = createRenderResultPacket(renderRequest);
-            QString logString = QString("TRANSFERRING packet (%1 iteration:%2) in sequence %3 to client.")
+            RenderResultPacket result = createRenderResultPacket(renderRequest, tile, firstTraceEvent);
+            QString tileString = tile.isFullFrame() ? QString("") : QString(" tile %1,%2 %3x%4")
+                .arg(tile.getX())
+                .arg(tile.getY())
+                .arg(tile.getWidth())
+                .arg(tile.getHeight());
+            QString logString = QString("TRANSFERRING packet (%1 iteration:%2%3) in sequence %4 to client.")
                 .arg(result.getNumIterationsInPacket())
                 .arg(iterationNumbersInPacketString)
+                .arg(tileString)
                 .arg(result.getSequenceNumber());
             emit newLogString(logString);
             emit newRenderResultPacket(result);
@@ -144,14 +153,14 @@ void RenderServerRenderer::onNewRenderCommandInQueue()
 }
 
 void RenderServerRenderer::renderFrame(unsigned long long iterationNumber, unsigned long long localIterationNumber, 
-    float PPMRadius, bool createOutputBuffer, const RenderServerRenderRequestDetails & details)
+    float PPMRadius, bool createOutputBuffer, const RenderServerRenderRequestDetails & details, const RenderTile & tile)
 {
     // We perform the rendering using m_renderer
 
     BenchmarkTimer frameTime;
     frameTime.start();
     m_renderTime.resume();
-    m_renderer.renderNextIteration(iterationNumber, localIterationNumber, PPMRadius, createOutputBuffer, details);
+    m_renderer.renderNextIteration(iterationNumber, localIterationNumber, PPMRadius, createOutputBuffer, details, tile);
     m_renderTime.pause();
     double frameRenderTime = frameTime.elapsedSeconds();
 
@@ -164,13 +173,40 @@ void RenderServerRenderer::renderFrame(unsigned long long iterationNumber, unsig
     emit newLogString(logString);
 }
 
-RenderResultPacket RenderServerRenderer::createRenderResultPacket(const RenderServerRenderRequest & request)
+// The tile to render for the request. PPM and VCM trace their photons and light subpaths for the whole frame, so a tile
+// would repeat that work for every tile; a tile that does not fit the frame is a request we do not understand. These are
+// rendered (and sent) as full frames.
+
+RenderTile RenderServerRenderer::getRenderTile(const RenderServerRenderRequest & request) const
+{
+    const RenderServerRenderRequestDetails & details = request.getDetails();
+    const RenderTile & tile = request.getTile();
+    if(details.getRenderMethod() == RenderMethod::PROGRESSIVE_PHOTON_MAPPING
+        || details.getRenderMethod() == RenderMethod::VCM_BIDIRECTIONAL_PATH_TRACING
+        || !tile.isInsideFrame(details.getWidth(), details.getHeight()))
+    {
+        return RenderTile();
+    }
+    return tile;
+}
+
+// The trace summary of the packet covers the events from firstTraceEvent on, the passes of its iterations and the
+// readback of the output. All PPM iterations of a request emit the photon budget of the request.
+
+RenderResultPacket RenderServerRenderer::createRenderResultPacket(const RenderServerRenderRequest & request, const RenderTile & tile,
+    unsigned long long firstTraceEvent)
 {
     QByteArray outputBuffer;
-    int bufferSizeBytes = m_renderer.getScreenBufferSizeBytes();
+    int bufferSizeBytes = tile.isFullFrame() ? m_renderer.getScreenBufferSizeBytes() : tile.getNumPixels()*3*sizeof(float);
     outputBuffer.resize(bufferSizeBytes);
-    m_renderer.getOutputBuffer(outputBuffer.data());
+    m_renderer.getOutputBuffer(outputBuffer.data(), tile);
     RenderResultPacket result = RenderResultPacket(request.getSequenceNumber(), request.getIterationNumbers(), outputBuffer);
+    result.setTile(tile);
+    result.setTraceSummary(m_renderer.getRenderTrace().summarize(firstTraceEvent));
+    if(request.getDetails().getRenderMethod() == RenderMethod::PROGRESSIVE_PHOTON_MAPPING)
+    {
+        result.setNumEmittedPhotons((unsigned long long)m_renderer.getNumEmittedPhotonsPerIteration()*request.getNumIterations());
+    }
     return result;
 }
 
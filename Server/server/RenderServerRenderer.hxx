@@ -49,8 +49,11 @@ private slots:
     void onNewRenderCommandInQueue();
 
 private:
-    void renderFrame(unsigned long long iterationNumber, unsigned long long localIterationNumber, float PPMRadius, bool createOutputBuffer, const RenderServerRenderRequestDetails & details);
-    RenderResultPacket createRenderResultPacket(const RenderServerRenderRequest & request);
+    void renderFrame(unsigned long long iterationNumber, unsigned long long localIterationNumber, float PPMRadius, bool createOutputBuffer, const RenderServerRenderRequestDetails & details,
+        const RenderTile & tile);
+    RenderTile getRenderTile(const RenderServerRenderRequest & request) const;
+    RenderResultPacket createRenderResultPacket(const RenderServerRenderRequest & request, const RenderTile & tile,
+        unsigned long long firstTraceEvent);
     void loadNewScene(const QByteArray & sceneName  );
     const RenderServer & m_renderServer;
     OptixRenderer m_renderer;
@@ -29,6 +29,12 @@ StandaloneApplication::StandaloneApplication(QApplication & qApplication, const
     connect(&m_renderManager, SIGNAL(renderManagerError(QString)), 
         this, SIGNAL(applicationError(QString)),
         Qt::QueuedConnection);
+
+    // The host device only renders path tracing
+    if(device.isHost())
+    {
+        setRenderMethod(RenderMethod::PATH_TRACING);
+    }
 }
 
 StandaloneApplication::~StandaloneApplication(void)
@@ -97,7 +97,8 @@ void StandaloneRenderManager::renderNextIteration()
             QVector<double> ppmRadii;
 
             RenderServerRenderRequestDetails details (m_camera, QByteArray(m_currentScene->getSceneName()), 
-                m_application.getRenderMethod(), m_application.getWidth(), m_application.getHeight(), PPMAlpha);
+                m_application.getRenderMethod(), m_application.getWidth(), m_application.getHeight(), PPMAlpha,
+                m_application.getPPMSettingsModel().getPhotonMapStructure());
 
             RenderServerRenderRequest renderRequest (m_application.getSequenceNumber(), iterationNumbers, ppmRadii, details);
 
@@ -152,8 +153,10 @@ void StandaloneRenderManager::fillRenderStatistics()
 
     if(m_application.getRenderMethod() == RenderMethod::PROGRESSIVE_PHOTON_MAPPING)
     {
-        m_application.getRenderStatisticsModel().setNumEmittedPhotonsPerIteration(OptixRenderer::EMITTED_PHOTONS_PER_ITERATION);
-        m_application.getRenderStatisticsModel().setNumEmittedPhotons(OptixRenderer::EMITTED_PHOTONS_PER_ITERATION*m_nextIterationNumber);
+        // Standalone requests leave the photon budget to the renderer, every iteration emits the same number
+        const unsigned long long numEmittedPhotonsPerIteration = m_renderer.getNumEmittedPhotonsPerIteration();
+        m_application.getRenderStatisticsModel().setNumEmittedPhotonsPerIteration(numEmittedPhotonsPerIteration);
+        m_application.getRenderStatisticsModel().setNumEmittedPhotons(numEmittedPhotonsPerIteration*m_nextIterationNumber);
     }
     else
     {
@@ -76,12 +76,11 @@ int main( int argc, char** argv )
 
         const std::vector<ComputeDevice> & repo = repository.getComputeDevices();
 
-        if(repo.empty())
+        // The host device is always in the repository, after the CUDA devices
+        int numCudaDevices = 0;
+        for(int i = 0; i < repo.size(); i++)
         {
-            out << "You must have a CUDA enabled GPU to run this application." 
-                << endl << "Press ENTER to quit." << endl;
-            in.read(1);
-            return 1;
+            numCudaDevices += repo.at(i).isHost() ? 0 : 1;
         }
 
         out << "Available compute devices:" << endl;
@@ -89,10 +88,26 @@ int main( int argc, char** argv )
         for(int i = 0; i < repo.size(); i++)
         {
             const ComputeDevice & device = repo.at(i);
-            out << "   " <<  i << ": " << device.getName() << " (CC " << device.getComputeCapability() << " PCI Bus "<< device.getPCIBusId() <<")" << endl;
+            if(device.isHost())
+            {
+                out << "   " <<  i << ": " << device.getName() << " (path tracing only)" << endl;
+            }
+            else
+            {
+                out << "   " <<  i << ": " << device.getName() << " (CC " << device.getComputeCapability() << " PCI Bus "<< device.getPCIBusId() <<")" << endl;
+            }
         }
 
-        int deviceNumber = repo.size() == 1 ? 0 : -1;
+        int deviceNumber = -1;
+        if(numCudaDevices == 0)
+        {
+            out << "No CUDA enabled GPU found, rendering on the host." << endl;
+            deviceNumber = (int)repo.size()-1;
+        }
+        else if(numCudaDevices == 1)
+        {
+            deviceNumber = 0;
+        }
 
         while (deviceNumber >= repo.size() || deviceNumber < 0)
         {